@@ -1,3 +1,9 @@
+-- OPTIONS --
+newoption {
+    trigger = 'no-profiling',
+    description = 'Compile out the PROFILE_* scopes (--trace then records nothing)'
+}
+
 -- WORKSPACE --
 workspace 'Tuto'
 configurations {'Debug', 'Release'}
@@ -19,9 +25,12 @@ files {
 
 links {
     'glfw',
-    'vulkan'
+    'dl', -- The Vulkan loader is opened at runtime (see VulkanLoader), not linked
+    'shaderc_shared' -- Shaders are compiled at runtime (see ShaderCompiler), for the cache and hot reload
 }
 
+defines {'VK_NO_PROTOTYPES'} -- The vk* functions are VulkanLoader's pointers
+
 buildoptions {
     '-m64', -- x64 build
     '-Wall',
@@ -32,6 +41,10 @@ includedirs {
     'src'
 }
 
+if not _OPTIONS['no-profiling'] then
+    defines {'PROFILING_ENABLED'}
+end
+
 pchheader 'pch.hpp'
 pchsource 'pch.cpp'
 
@@ -39,6 +52,45 @@ objdir('build/obj')
 targetdir('build/bin/%{cfg.buildcfg}')
 targetname 'program'
 
+-- LOG_COMPILE_LEVEL: most verbose LOG_* level compiled in (see Logger::LogLevel)
+filter {'configurations:Debug'}
+defines {'DEBUG', 'LOG_COMPILE_LEVEL=5'}
+symbols 'On'
+optimize 'Off'
+
+filter {'configurations:Release'}
+defines {'NDEBUG', 'LOG_COMPILE_LEVEL=3'}
+optimize 'On'
+
+filter {'files:**.c'}
+flags {'NoPCH'}
+
+-- PACKER --
+-- Offline tool writing the asset packs the engine maps with --assets (see core/AssetPackFormat.hpp)
+project 'Packer'
+kind 'ConsoleApp'
+language 'C++'
+cppdialect 'C++17'
+flags {'Verbose', 'ShowCommandLine'}
+
+files {
+    'tools/packer/**.hpp',
+    'tools/packer/**.cpp'
+}
+
+buildoptions {
+    '-m64', -- x64 build
+    '-Wall'
+}
+
+includedirs {
+    'src' -- Only for the header-only format, hashing and Exception
+}
+
+objdir('build/obj/packer')
+targetdir('build/bin/%{cfg.buildcfg}')
+targetname 'packer'
+
 filter {'configurations:Debug'}
 defines {'DEBUG'}
 symbols 'On'
@@ -48,5 +100,66 @@ filter {'configurations:Release'}
 defines {'NDEBUG'}
 optimize 'On'
 
+-- BENCH --
+-- Headless benchmarks of the engine with JSON results, compared to a baseline (see tools/bench/Bench.cpp).
+-- Runs without a GPU or a display on a software Vulkan driver: bench --icd path/to/lvp_icd.json
+project 'Bench'
+kind 'ConsoleApp'
+language 'C++'
+cppdialect 'C++17'
+flags {'Verbose', 'ShowCommandLine'}
+
+files {
+    'src/**.h',
+    'src/**.hpp',
+    'src/**.c',
+    'src/**.cpp',
+    'tools/bench/**.hpp',
+    'tools/bench/**.cpp'
+}
+
+removefiles {
+    'src/core/EntryPoint.cpp' -- tools/bench/Bench.cpp has the main()
+}
+
+links {
+    'glfw',
+    'dl',
+    'shaderc_shared'
+}
+
+defines {'VK_NO_PROTOTYPES'}
+
+buildoptions {
+    '-m64', -- x64 build
+    '-Wall',
+    '-Winvalid-pch'
+}
+
+includedirs {
+    'src'
+}
+
+if not _OPTIONS['no-profiling'] then
+    defines {'PROFILING_ENABLED'}
+end
+
+pchheader 'pch.hpp'
+pchsource 'src/pch.cpp'
+
+objdir('build/obj/bench')
+targetdir('build/bin/%{cfg.buildcfg}')
+targetname 'bench'
+
+-- Benchmark the Release configuration, Debug enables the validation layers
+filter {'configurations:Debug'}
+defines {'DEBUG', 'LOG_COMPILE_LEVEL=5'}
+symbols 'On'
+optimize 'Off'
+
+filter {'configurations:Release'}
+defines {'NDEBUG', 'LOG_COMPILE_LEVEL=3'}
+optimize 'On'
+
 filter {'files:**.c'}
 flags {'NoPCH'}
@@ -0,0 +1,17 @@
+#version 450
+
+// Behind everything a Window draws, with fullscreen.vert
+layout(location = 0) in vec2 inUV;
+
+layout(set = 0, binding = 0) uniform Background
+{
+    vec4 topColor;
+    vec4 bottomColor;
+} background;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    outColor = mix(background.topColor, background.bottomColor, inUV.y);
+}
@@ -0,0 +1,10 @@
+// Shared by the fragment shaders, editing it reloads every shader that includes it
+
+#define FALLBACK_COLOR vec4(1.0, 0.0, 1.0, 1.0)
+
+// Checkerboard of `cells` cells per side, 0 or 1
+float checker(vec2 uv, float cells)
+{
+    vec2 cell = floor(uv * cells);
+    return mod(cell.x + cell.y, 2.0);
+}
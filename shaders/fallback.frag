@@ -0,0 +1,11 @@
+#version 450
+
+#include "common.glsl"
+
+// Drawn in place of a pipeline that is still compiling. No inputs, so it goes with any vertex shader
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    outColor = FALLBACK_COLOR * mix(0.6, 1.0, checker(gl_FragCoord.xy, 1.0 / 16.0));
+}
@@ -2,9 +2,15 @@
 
 #include "Application.hpp"
 #include "Exception.hpp"
+#include "FrameLimiter.hpp"
 #include "Logger.hpp"
+#include "Profiler.hpp"
 #include "graphics/Window.hpp"
+#include "vulkan/VulkanDevice.hpp"
+#include "vulkan/VulkanFrameBatch.hpp"
 #include "vulkan/VulkanInstance.hpp"
+#include "vulkan/VulkanLoader.hpp"
+#include "vulkan/VulkanRecordingBenchmark.hpp"
 
 #include <csignal>
 #include <iostream>
@@ -13,9 +19,11 @@
 Application* Application::s_instance = nullptr;
 
 
-Application::Application()
-    : m_shouldStop(false)
+Application::Application(const Settings& settings, JobSystem* jobSystem)
+    : m_settings(settings), m_shouldStop(false), m_frameLimiter(settings.targetFps), m_jobSystem(jobSystem)
 {
+    PROFILE_FUNCTION();
+
     try {
         if (Application::s_instance)
             throw Exception("An instance of Application already exists. Only one instance is allowed");
@@ -24,12 +32,46 @@ Application::Application()
         // by calling this once
         Logger::instance();
 
-        if (glfwInit() == GLFW_FALSE)
-            throw Exception("Failed to initialize GLFW");
+        for (auto& path : m_settings.logFiles)
+            Logger::instance().addFileSink(path);
+
+        if (m_settings.asyncLog)
+            Logger::instance().enableAsync(ASYNC_LOG_DEFAULT_QUEUE_SIZE, m_settings.logOverflowPolicy);
 
-        glfwSetErrorCallback(Application::errorCallbackGLFW);
+        if (!m_jobSystem) {
+            m_ownedJobSystem = std::make_unique<JobSystem>(m_settings.threadCount);
+            m_jobSystem = m_ownedJobSystem.get();
+        }
+        m_settings.threadCount = m_jobSystem->getThreadCount();  // Per-thread resources are sized on it
+        m_startupTimer.mark("logger and job system");
+
+        // Fails right away, with a clear message, on machines without a Vulkan loader
+        VulkanLoader::load();
+        m_startupTimer.mark("Vulkan loader");
+
+        // There is no display to connect to in headless mode, GLFW is never initialized
+        if (!m_settings.headless) {
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+            // Surfaces then come from the same loader, GLFW doesn't open its own
+            glfwInitVulkanLoader(vkGetInstanceProcAddr);
+#endif
+            if (glfwInit() == GLFW_FALSE)
+                throw Exception("Failed to initialize GLFW");
+
+            glfwSetErrorCallback(Application::errorCallbackGLFW);
+            m_startupTimer.mark("GLFW");
+        }
 
-        m_VulkanInstance = std::make_unique<VulkanInstance>();
+        // Loader and driver initialization take hundreds of milliseconds, the GLFW windows
+        // are created in the meantime. Joined by waitForVulkan()
+        startVulkan();
+
+        m_frameStats = std::make_unique<FrameStats>(m_settings.statsPath);
+
+        // The main loop doesn't allocate once these have reached their working size
+        m_windows.reserve(WINDOW_CAPACITY);
+        m_windowsToUpdate.reserve(WINDOW_CAPACITY);
+        m_windowsToDestroy.reserve(WINDOW_CAPACITY);
 
         // Register this instance
         Application::s_instance = this;
@@ -40,6 +82,10 @@ Application::Application()
         LOG_TRACE("Initialized Application");
 
     } catch (const std::runtime_error& ex) {
+        // The destructor won't run, the bring-up job refers to this
+        if (m_jobSystem)
+            m_jobSystem->wait(m_vulkanReady);
+
         // Here we can't log the error, because the logger may not be initialized
         throw Exception("Failed to initialize Application\n" + std::string(ex.what()));
     }
@@ -50,13 +96,23 @@ Application::~Application()
 {
     LOG_TRACE("Closing Application");
 
+    // Never joined if the Application failed before its first Window was attached
+    m_jobSystem->wait(m_vulkanReady);
+
     // Make sure everything has been cleared before calling glfwTerminate
     if (m_windows.size() > 0) {
         LOG_TRACE("Destroying remaining Windows ({})", m_windows.size());
         destroyAllWindows();
     }
 
-    glfwTerminate();
+    // Nothing draws them, only their uploads may still be in flight
+    if (!m_assets.meshes.empty() || !m_assets.textures.empty()) {
+        m_VulkanInstance->getDevice().getUploader().waitIdle();
+        m_assets = {};
+    }
+
+    if (!m_settings.headless)
+        glfwTerminate();
 
     // Reset signal handlers
     std::signal(SIGINT, SIG_DFL);
@@ -70,49 +126,50 @@ void Application::run(int argc, const char* argv[])
 {
     try {
         // Exit if command line args are invalid
-        if (!Application::processCommandLineArgs(argc, argv)) return;
-        Application app;
-
-        app.m_mainWindowID = app.createWindow(654, 498, "Test");
-        app.createWindow(456, 723, "Test2");
+        Settings settings;
+        if (!Application::processCommandLineArgs(argc, argv, settings)) return;
 
+        if (!settings.tracePath.empty()) {
+            Profiler::instance().setThreadName("Main thread");
+            Profiler::instance().start();
+        }
 
-        while (!app.m_shouldStop) {
-            try {
-                std::vector<WindowID> windowsToDestroy;
-
-                glfwPollEvents();
+        Application app(settings);
 
-                for (auto& w : app.m_windows) {
-                    auto& currentWindow = w.second;
+        if (app.m_settings.benchRecording) {
+            VulkanRecordingBenchmark benchmark(app.waitForVulkan().getDevice(), *app.m_jobSystem);
+            benchmark.run(BENCH_RECORDING_DRAWS, BENCH_RECORDING_FRAMES);
 
+            if (!app.m_settings.tracePath.empty())
+                Profiler::instance().writeTrace(app.m_settings.tracePath);
+            return;
+        }
 
-                    if (currentWindow->shouldClose()) {
-                        windowsToDestroy.push_back(w.first);
+        app.m_mainWindowID = app.createWindow(654, 498, "Test");
+        app.createWindow(456, 723, "Test2");
+        app.m_startupTimer.mark("windows");
 
-                        if (w.first == app.m_mainWindowID) {
-                            LOG_TRACE("Main Window resquested closing, terminating Application.");
-                            app.m_shouldStop = true;
-                        }
-                    }
+        // First surface creation, nothing more can happen without the device
+        app.waitForVulkan();
 
-                    currentWindow->update();
-                }
+        auto startTime = std::chrono::steady_clock::now();
 
-                // Destroy everything here to prevent iterator invalidation
-                for (auto& w : windowsToDestroy)
-                    app.destroyWindow(w);
+        while (!app.m_shouldStop)
+            app.runFrame();
 
-            } catch (const Exception& ex) {
-                if (ex.isFatal())
-                    throw;
-                else
-                    LOG_ERROR("Exception caught: {}", ex.what());
-            }
-        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+        LOG_INFO(
+            "Ran {} frames in {:.3f}s ({:.1f} fps)",
+            app.m_frameCount,
+            elapsed.count(),
+            elapsed.count() > 0.0 ? app.m_frameCount / elapsed.count() : 0.0);
+        app.m_frameStats->report();
 
         app.destroyAllWindows();
 
+        if (!app.m_settings.tracePath.empty())
+            Profiler::instance().writeTrace(app.m_settings.tracePath);
+
     } catch (const Exception& ex) {
         // At this point, unhandeled exceptions are concidered fatal.
         // Resources are freed, Application destructor was called
@@ -145,8 +202,10 @@ void Application::errorCallbackGLFW(int error, const char* description)
 }
 
 
-bool Application::processCommandLineArgs(int argc, const char* argv[]) noexcept
+bool Application::processCommandLineArgs(int argc, const char* argv[], Settings& settings) noexcept
 {
+    bool frameCountSet = false;
+
     int i = 1;
     while (i < argc) {
         if (!std::strcmp(argv[i], "-d") || !std::strcmp(argv[i], "--debug")) {
@@ -164,6 +223,170 @@ bool Application::processCommandLineArgs(int argc, const char* argv[]) noexcept
                 Logger::instance().setLoggingLevel(static_cast<Logger::LogLevel>(lvl));  // This cast is safe
                 ++i;
 
+            } catch (const std::exception& ex) {
+                stdoutUsage();
+                return false;
+            }
+        } else if (!std::strcmp(argv[i], "--vk-mute")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.mutedValidationMessages.push_back(argv[++i]);
+
+        } else if (!std::strcmp(argv[i], "--pipeline-cache")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.pipelineCachePath = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--no-pipeline-cache")) {
+            settings.pipelineCachePath.clear();
+
+        } else if (!std::strcmp(argv[i], "--shader-cache")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.shaderCachePath = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--no-shader-cache")) {
+            settings.shaderCachePath.clear();
+
+        } else if (!std::strcmp(argv[i], "--no-hot-reload")) {
+            settings.shaderHotReload = false;
+
+        } else if (!std::strcmp(argv[i], "--assets")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.assetPacks.push_back(argv[++i]);
+
+        } else if (!std::strcmp(argv[i], "--dump-graph")) {
+            settings.dumpRenderGraph = true;
+
+        } else if (!std::strcmp(argv[i], "--gpu")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.gpu = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--fps")) {
+            try {
+                settings.targetFps = std::stod(argv[i + 1]);  // Convertion errors are catched below
+                ++i;
+
+            } catch (const std::exception& ex) {
+                stdoutUsage();
+                return false;
+            }
+        } else if (!std::strcmp(argv[i], "--threads")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            try {
+                std::string value = argv[++i];
+                size_t end = 0;
+                long long count = std::stoll(value, &end);  // Convertion errors are catched below
+                if (end != value.size() || count < 0) {
+                    stdoutUsage();
+                    return false;
+                }
+
+                // More workers than hardware threads only take turns on the same cores
+                uint32_t hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+                if (count > hardwareThreads) {
+                    Logger::instance();  // Before it, LOG_* go to spdlog's own default logger
+                    LOG_WARN("{} threads requested, clamped to the {} hardware threads", count, hardwareThreads);
+                    count = hardwareThreads;
+                }
+
+                settings.threadCount = static_cast<uint32_t>(count);
+
+            } catch (const std::exception& ex) {
+                stdoutUsage();
+                return false;
+            }
+        } else if (!std::strcmp(argv[i], "--present-mode")) {
+            const char* mode = i + 1 < argc ? argv[++i] : "";
+
+            if (!std::strcmp(mode, "mailbox"))
+                settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+            else if (!std::strcmp(mode, "fifo"))
+                settings.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+            else if (!std::strcmp(mode, "immediate"))
+                settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+            else {
+                stdoutUsage();
+                return false;
+            }
+
+        } else if (!std::strcmp(argv[i], "--no-idle-wait")) {
+            settings.idleWait = false;
+
+        } else if (!std::strcmp(argv[i], "--trace")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.tracePath = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--stats")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.statsPath = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--bench-recording")) {
+            settings.benchRecording = true;
+            settings.headless = true;  // Nothing is presented
+
+        } else if (!std::strcmp(argv[i], "--log-file")) {
+            if (i + 1 >= argc) {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.logFiles.push_back(argv[++i]);
+
+        } else if (!std::strcmp(argv[i], "--async-log")) {
+            const char* policy = i + 1 < argc ? argv[++i] : "";
+
+            if (!std::strcmp(policy, "block"))
+                settings.logOverflowPolicy = Logger::OverflowPolicy::BLOCK;
+            else if (!std::strcmp(policy, "drop-oldest"))
+                settings.logOverflowPolicy = Logger::OverflowPolicy::DROP_OLDEST;
+            else if (!std::strcmp(policy, "count-dropped"))
+                settings.logOverflowPolicy = Logger::OverflowPolicy::COUNT_DROPPED;
+            else {
+                stdoutUsage();
+                return false;
+            }
+
+            settings.asyncLog = true;
+
+        } else if (!std::strcmp(argv[i], "--headless")) {
+            settings.headless = true;
+
+        } else if (!std::strcmp(argv[i], "--frames")) {
+            try {
+                settings.frameCount = std::stoull(argv[i + 1]);  // Convertion errors are catched below
+                frameCountSet = true;
+                ++i;
+
             } catch (const std::exception& ex) {
                 stdoutUsage();
                 return false;
@@ -175,6 +398,10 @@ bool Application::processCommandLineArgs(int argc, const char* argv[]) noexcept
         ++i;
     }
 
+    // Nothing can close a headless Application but a signal, so bound it by default
+    if (settings.headless && !frameCountSet)
+        settings.frameCount = HEADLESS_DEFAULT_FRAME_COUNT;
+
     return true;
 }
 
@@ -186,34 +413,279 @@ void Application::stdoutUsage() noexcept
               << "Options:" << std::endl
               << "  -d, --debug             Starts the program in debug mode" << std::endl
               << "  --debug-level LEVEL     Set the logging level. ([0-5], none=0, default=3)" << std::endl
+              << "  --trace FILE            Write a Chrome trace (chrome://tracing) of the run to FILE" << std::endl
+              << "  --stats FILE            Write the CPU and GPU frame timings to FILE (CSV)" << std::endl
+              << "  --bench-recording       Measure draw recording throughput against the thread count, then exit" << std::endl
+              << "  --log-file FILE         Also write the log to FILE (can be repeated)" << std::endl
+              << "  --async-log POLICY      Log from a background thread. POLICY is the behavior" << std::endl
+              << "                          when the queue is full: block, drop-oldest, count-dropped" << std::endl
+              << "  --vk-mute ID            Never log the Vulkan debug message ID (number or VUID name, can be repeated)" << std::endl
+              << "  --pipeline-cache FILE   Load and save the pipeline cache from FILE (default=pipeline_cache.bin)" << std::endl
+              << "  --no-pipeline-cache     Don't persist the pipeline cache" << std::endl
+              << "  --shader-cache DIR      Keep compiled shaders in DIR (default=shader_cache)" << std::endl
+              << "  --no-shader-cache       Compile every shader at launch" << std::endl
+              << "  --no-hot-reload         Don't recompile shaders when their sources change" << std::endl
+              << "  --assets FILE           Load the asset pack FILE at startup (repeatable)" << std::endl
+              << "  --dump-graph            Log the passes, barriers and memory of the render graphs when compiled" << std::endl
+              << "  --gpu GPU               Use this GPU (index or UUID, as logged in debug mode)" << std::endl
+              << "  --fps FPS               Limit the frame rate to FPS (0=uncapped, default)" << std::endl
+              << "  --no-idle-wait          Keep polling events when every Window is idle" << std::endl
+              << "  --present-mode MODE     mailbox (default, low latency), fifo (vsync) or immediate (may tear)." << std::endl
+              << "                          Unsupported modes fall back to fifo" << std::endl
+              << "  --threads COUNT         Job system threads (0=one per hardware thread, default)" << std::endl
+              << "  --headless              Run without a display, Windows render offscreen" << std::endl
+              << "  --frames COUNT          Stop after COUNT frames (0=unlimited, headless default=" << HEADLESS_DEFAULT_FRAME_COUNT << ")" << std::endl
 
               << std::endl;
 }
 
 
+void Application::startVulkan()
+{
+    m_jobSystem->runBackground(
+        [this]() {
+            PROFILE_SCOPE("Vulkan bring-up");
+            auto startTime = std::chrono::steady_clock::now();
+
+            // Rethrown on the main thread by waitForVulkan()
+            try {
+                m_VulkanInstance = std::make_unique<VulkanInstance>(m_settings, *m_jobSystem);
+            } catch (...) {
+                m_vulkanError = std::current_exception();
+            }
+
+            m_vulkanTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        },
+        &m_vulkanReady);
+
+    // Ran inline when the main thread is the only worker, nothing overlaps it
+    if (m_jobSystem->getThreadCount() == 1)
+        m_startupTimer.mark("Vulkan instance, device");
+}
+
+
+VulkanInstance& Application::waitForVulkan()
+{
+    if (m_vulkanError)
+        std::rethrow_exception(m_vulkanError);
+    if (m_vulkanJoined)
+        return *m_VulkanInstance;
+
+    PROFILE_FUNCTION();
+
+    auto waitStart = std::chrono::steady_clock::now();
+    m_jobSystem->wait(m_vulkanReady);
+    double waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count();
+
+    m_vulkanJoined = true;
+    if (m_jobSystem->getThreadCount() > 1) {
+        m_startupTimer.mark("waiting for Vulkan");
+        m_startupTimer.addBackground("Vulkan instance, device", m_vulkanTime, waited);
+    }
+
+    if (m_vulkanError)
+        std::rethrow_exception(m_vulkanError);
+
+    m_frameBatch = std::make_unique<VulkanFrameBatch>(m_VulkanInstance->getDevice());
+
+    if (!m_settings.assetPacks.empty()) {
+        loadAssetPacks();
+        m_startupTimer.mark("asset packs");
+    }
+
+    for (auto& window : m_windows)
+        window->attach(*m_VulkanInstance);
+    m_startupTimer.mark("surfaces, swapchains");
+
+    return *m_VulkanInstance;
+}
+
+
+void Application::loadAssetPacks()
+{
+    PROFILE_FUNCTION();
+
+    auto& device = m_VulkanInstance->getDevice();
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (auto& path : m_settings.assetPacks) {
+        // Unmapped once loaded, the payloads are in staging memory by then
+        AssetPack pack(path);
+        auto assets = device.getAssetLoader().loadAll(pack);
+
+        std::move(assets.meshes.begin(), assets.meshes.end(), std::back_inserter(m_assets.meshes));
+        std::move(assets.textures.begin(), assets.textures.end(), std::back_inserter(m_assets.textures));
+    }
+
+    device.getUploader().flush();
+
+    auto stats = device.getAssetLoader().getStats();
+    LOG_INFO(
+        "Loaded {} asset packs: {} meshes, {} textures, {:.1f} MiB in {:.1f} ms",
+        m_settings.assetPacks.size(),
+        stats.meshes,
+        stats.textures,
+        stats.bytes / double(1 << 20),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+
+void Application::runFrame()
+{
+    PROFILE_SCOPE("Frame");
+
+    try {
+        // Nothing to draw: sleep until an event comes in rather than spinning.
+        // Input wakes the wait immediately, so this adds no latency
+        if (!m_settings.headless) {
+            PROFILE_SCOPE("Events");
+
+            if (m_settings.idleWait && allWindowsIdle())
+                glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+            else
+                glfwPollEvents();
+        }
+
+        bool idleFrame = allWindowsIdle();
+        m_frameLimiter.beginFrame();
+        auto frameStart = FrameStats::Clock::now();
+
+        uint32_t frameIndex = m_frameCount % MAX_FRAMES_IN_FLIGHT;
+
+        m_windowsToUpdate.clear();
+        for (size_t i = 0; i < m_windows.size(); i++) {
+            auto& currentWindow = m_windows[i];
+
+            // GLFW calls stay on the main thread
+            if (currentWindow->shouldClose()) {
+                WindowID id = m_windows.getHandle(i);
+                destroyWindow(id);
+
+                if (id == m_mainWindowID) {
+                    LOG_TRACE("Main Window resquested closing, terminating Application.");
+                    m_shouldStop = true;
+                }
+            }
+
+            // Nothing new to present
+            if (!currentWindow->isIdle())
+                m_windowsToUpdate.push_back(currentWindow.get());
+        }
+
+        // Shaders edited on disk, compiled in the background since
+        m_VulkanInstance->getDevice().getShaderLibrary().applyReloads();
+
+        // The wait is the device's time, not the CPU's: large waits mean GPU bound
+        auto waitStart = FrameStats::Clock::now();
+        m_frameBatch->begin(frameIndex);
+        auto waitEnd = FrameStats::Clock::now();
+
+        addGpuStats();
+
+        // Windows are independent, record them across the workers...
+        std::exception_ptr updateError;
+        try {
+            m_jobSystem->parallelFor(0, m_windowsToUpdate.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    m_windowsToUpdate[i]->update(*m_frameBatch);
+            });
+        } catch (...) {
+            updateError = std::current_exception();
+        }
+
+        // ...then submit and present all of them at once. Even when one failed: the
+        // others hold acquired images, and the failed one a semaphore to wait on
+        m_frameBatch->submit();
+
+        if (updateError)
+            std::rethrow_exception(updateError);
+
+        // Validation messages repeated since the last summary
+        m_VulkanInstance->getMessageFilter().update();
+
+        // Idle frames draw nothing, they would only skew the percentiles down
+        if (!idleFrame) {
+            using ms = std::chrono::duration<double, std::milli>;
+            auto frameEnd = FrameStats::Clock::now();
+
+            m_frameStats->add(m_frameCount, "cpu frame", ms(frameEnd - frameStart).count());
+            m_frameStats->add(m_frameCount, "cpu wait", ms(waitEnd - waitStart).count());
+        }
+        m_frameStats->update();
+
+        m_frameLimiter.endFrame(idleFrame);
+
+        if (!m_startupTimer.isReported()) {
+            m_startupTimer.mark("first frame");
+            m_startupTimer.report();
+        }
+
+        // Nothing refers to them anymore
+        destroyPendingWindows();
+
+        if (++m_frameCount == m_settings.frameCount) {
+            LOG_TRACE("Reached the requested frame count ({}), terminating Application.", m_frameCount);
+            m_shouldStop = true;
+        }
+
+    } catch (const Exception& ex) {
+        if (ex.isFatal())
+            throw;
+        else
+            LOG_ERROR("Exception caught: {}", ex.what());
+    }
+}
+
+
+void Application::addGpuStats()
+{
+    // Read by VulkanFrameBatch::begin(), they are the frame before the previous frames in flight
+    auto& timestamps = m_VulkanInstance->getDevice().getTimestamps();
+    if (timestamps.getResults().empty())
+        return;
+
+    uint64_t frame = m_frameCount - MAX_FRAMES_IN_FLIGHT;
+    m_frameStats->add(frame, "gpu frame", timestamps.getFrameTime());
+
+    for (auto& result : timestamps.getResults())
+        m_frameStats->add(frame, result.name, result.milliseconds);
+}
+
+
 WindowID Application::createWindow(int width, int height, const std::string& title)
 {
-    WindowID cacheID = m_currentWindowID;
-    auto newWindow = std::make_unique<Window>(width, height, title);
+    auto newWindow = std::make_unique<Window>(width, height, title, m_settings);
+    if (m_vulkanJoined && m_VulkanInstance)
+        newWindow->attach(*m_VulkanInstance);
 
-    m_windows.insert({m_currentWindowID++, std::move(newWindow)});
+    WindowID id = m_windows.insert(std::move(newWindow));
 
-    LOG_TRACE("Added Window \"{}\" to handler (WindowID: {})", title, cacheID);
-    return cacheID;
+    LOG_TRACE("Added Window \"{}\" to handler (WindowID: {:#x})", title, id);
+    return id;
 }
 
 
 void Application::destroyWindow(WindowID id)
 {
-    auto it = m_windows.find(id);
-    if (it == m_windows.end()) {
+    if (!m_windows.contains(id)) {
         LOG_WARN("Trying to destroy an invalid Window");
-        LOG_WARN("Window with ID {} does not exist");
+        LOG_WARN("Window with ID {:#x} does not exist", id);
+        return;
+    }
 
-    } else {
-        LOG_TRACE("Removing Window \"{}\" from handler (WindowID: {})", it->second->getTitle(), it->first);
-        m_windows.erase(it);
+    if (std::find(m_windowsToDestroy.begin(), m_windowsToDestroy.end(), id) == m_windowsToDestroy.end())
+        m_windowsToDestroy.push_back(id);
+}
+
+
+void Application::destroyPendingWindows()
+{
+    for (auto id : m_windowsToDestroy) {
+        LOG_TRACE("Removing Window \"{}\" from handler (WindowID: {:#x})", (*m_windows.get(id))->getTitle(), id);
+        m_windows.erase(id);
     }
+
+    m_windowsToDestroy.clear();
 }
 
 
@@ -221,5 +693,16 @@ void Application::destroyAllWindows() noexcept
 {
     LOG_TRACE("Clearing Window handler");
     m_windows.clear();
-    m_currentWindowID = FIRST_WINDOW_ID;
+    m_windowsToDestroy.clear();
+}
+
+
+bool Application::allWindowsIdle() const noexcept
+{
+    for (auto& w : m_windows) {
+        if (!w->isIdle())
+            return false;
+    }
+
+    return true;
 }
\ No newline at end of file
@@ -1,15 +1,23 @@
 #pragma once
 #include "pch.hpp"
 
+#include "FrameLimiter.hpp"
+#include "FrameStats.hpp"
+#include "Settings.hpp"
+#include "SlotMap.hpp"
+#include "StartupTimer.hpp"
+#include "jobs/JobSystem.hpp"
+#include "vulkan/VulkanAssetLoader.hpp"
+#include "vulkan/VulkanFrameBatch.hpp"
 #include "vulkan/VulkanInstance.hpp"
 #include "graphics/Window.hpp"
 
-#include <map>
+#include <exception>
 #include <memory>
 
-#define NO_MAIN_WINDOW 0
-#define FIRST_WINDOW_ID 1
-typedef unsigned long long WindowID;
+#define NO_MAIN_WINDOW NULL_SLOT_HANDLE
+#define WINDOW_CAPACITY 16  // Windows the loop handles without allocating, more still work
+typedef SlotMap<std::unique_ptr<Window>>::Handle WindowID;
 
 class Application
 {
@@ -19,28 +27,61 @@ class Application
   private:
     static void signalHandler(int signum) noexcept;
     static void errorCallbackGLFW(int error, const char* description);
-    static bool processCommandLineArgs(int argc, const char* argv[]) noexcept;
+    static bool processCommandLineArgs(int argc, const char* argv[], Settings& settings) noexcept;
     static void stdoutUsage() noexcept;
 
+    void startVulkan();
+    // Joins the bring-up started by startVulkan(), the first call then creates what depends on
+    // the device and attaches the Windows created meanwhile. Rethrows if the bring-up failed
+    VulkanInstance& waitForVulkan();
+    void loadAssetPacks();
+    void addGpuStats();
+    // One iteration of the main loop: events, every Window updated and presented, stats.
+    // Non fatal exceptions are logged, the next frame goes on
+    void runFrame();
+
+    // Attached right away once waitForVulkan() was called, by it otherwise
     WindowID createWindow(int width, int height, const std::string& title);
-    void destroyWindow(WindowID id);
+    void destroyWindow(WindowID id);  // Deferred to the end of the frame
+    void destroyPendingWindows();
     void destroyAllWindows() noexcept;
+    bool allWindowsIdle() const noexcept;
 
 
   private:
+    Settings m_settings;
     bool m_shouldStop;
+    FrameLimiter m_frameLimiter;
+    uint64_t m_frameCount = 0;
 
-    WindowID m_currentWindowID = FIRST_WINDOW_ID;
     WindowID m_mainWindowID = NO_MAIN_WINDOW;
-    std::map<WindowID, std::unique_ptr<Window>> m_windows;
+    SlotMap<std::unique_ptr<Window>> m_windows;
+    std::vector<Window*> m_windowsToUpdate;  // Reused every frame
+    std::vector<WindowID> m_windowsToDestroy;  // Reused every frame
+
+    std::unique_ptr<JobSystem> m_ownedJobSystem;
+    JobSystem* m_jobSystem = nullptr;  // m_ownedJobSystem, unless one was given
 
+    // Created by a background job while the main thread creates the GLFW windows
     std::unique_ptr<VulkanInstance> m_VulkanInstance;
+    JobCounter m_vulkanReady;
+    std::exception_ptr m_vulkanError;
+    double m_vulkanTime = 0.0;  // Milliseconds the bring-up took
+    bool m_vulkanJoined = false;
+
+    std::unique_ptr<VulkanFrameBatch> m_frameBatch;
+    std::unique_ptr<FrameStats> m_frameStats;
+    VulkanAssetLoader::Assets m_assets;  // Of every --assets pack, before the device goes
+    StartupTimer m_startupTimer;
 
   private:
     static Application* s_instance;
-    Application();
+    // Creates its JobSystem if `jobSystem` is null
+    Application(const Settings& settings, JobSystem* jobSystem = nullptr);
     ~Application();
 
+    friend class BenchSuite;  // Runs frames of a headless Application, @see tools/bench
+
   public:
     Application(const Application&) = delete;
     void operator=(const Application&) = delete;
@@ -0,0 +1,166 @@
+#include "pch.hpp"
+
+#include "AssetPack.hpp"
+#include "Hash.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+AssetPack::AssetPack(const std::string& path)
+    : m_path(path)
+{
+    int fd = open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw Exception("Failed to open asset pack \"" + m_path + "\": " + std::strerror(errno));
+
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        m_size = static_cast<size_t>(fileStat.st_size);
+        mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // The mapping stays valid
+
+    if (mapping == MAP_FAILED)
+        throw Exception("Failed to map asset pack \"" + m_path + "\"");
+
+    m_data = static_cast<const char*>(mapping);
+
+    try {
+        validate();
+
+    } catch (const Exception& ex) {
+        // The destructor won't run
+        munmap(mapping, m_size);
+        throw;
+    }
+
+    LOG_TRACE("Mapped asset pack \"{}\" ({} assets, {} MiB)", m_path, m_entryCount, m_size >> 20);
+}
+
+
+AssetPack::~AssetPack()
+{
+    munmap(const_cast<char*>(m_data), m_size);
+}
+
+// public
+
+const AssetPackEntry* AssetPack::find(std::string_view name) const noexcept
+{
+    uint64_t hash = hashBytes(name.data(), name.size());
+
+    auto it = std::lower_bound(begin(), end(), hash, [](const AssetPackEntry& entry, uint64_t hash) { return entry.nameHash < hash; });
+
+    // Colliding names are next to each other
+    for (; it != end() && it->nameHash == hash; ++it) {
+        if (getName(*it) == name)
+            return it;
+    }
+
+    return nullptr;
+}
+
+
+std::string_view AssetPack::getName(const AssetPackEntry& entry) const noexcept
+{
+    return std::string_view(m_names + entry.nameOffset, entry.nameSize);
+}
+
+
+void AssetPack::prefetch(const AssetPackEntry& entry) const noexcept
+{
+    // madvise() wants a page aligned address, payloads are only ASSET_PACK_ALIGNMENT aligned
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = entry.payloadOffset / pageSize * pageSize;
+    size_t end = entry.payloadOffset + entry.payloadSize;
+
+    madvise(const_cast<char*>(m_data) + begin, end - begin, MADV_WILLNEED);
+}
+
+// private
+
+void AssetPack::validate()
+{
+    if (m_size < sizeof(AssetPackHeader))
+        throw Exception("\"" + m_path + "\" is not an asset pack: too small");
+
+    auto& header = *reinterpret_cast<const AssetPackHeader*>(m_data);
+
+    if (header.magic != ASSET_PACK_MAGIC)
+        throw Exception("\"" + m_path + "\" is not an asset pack");
+
+    if (header.version != ASSET_PACK_VERSION)
+        throw Exception(
+            "Asset pack \"" + m_path + "\" has version " + std::to_string(header.version)
+            + ", expected " + std::to_string(ASSET_PACK_VERSION) + ". Run the packer again");
+
+    // Sizes are checked one at a time, so none of the sums below can overflow
+    uint64_t tocEnd = sizeof(AssetPackHeader) + uint64_t(header.entryCount) * sizeof(AssetPackEntry);
+    if (header.fileSize != m_size || tocEnd > m_size || header.namesOffset < tocEnd
+        || header.namesOffset > m_size || header.namesSize > m_size - header.namesOffset)
+        throw Exception("Asset pack \"" + m_path + "\" is truncated or corrupt");
+
+    uint64_t checksum = hashBytes(m_data + sizeof(AssetPackHeader), tocEnd - sizeof(AssetPackHeader));
+    checksum = hashBytes(m_data + header.namesOffset, header.namesSize, checksum);
+    if (checksum != header.tocChecksum)
+        throw Exception("Asset pack \"" + m_path + "\" has a corrupt table of contents");
+
+    m_entries = reinterpret_cast<const AssetPackEntry*>(m_data + sizeof(AssetPackHeader));
+    m_entryCount = header.entryCount;
+    m_names = m_data + header.namesOffset;
+
+    for (uint32_t i = 0; i < m_entryCount; i++) {
+        auto& entry = m_entries[i];
+
+        if (entry.nameOffset > header.namesSize || entry.nameSize > header.namesSize - entry.nameOffset)
+            throw Exception("Asset pack \"" + m_path + "\" has a corrupt table of contents");
+
+        if (i > 0 && entry.nameHash < m_entries[i - 1].nameHash)
+            throw Exception("Asset pack \"" + m_path + "\" has an unsorted table of contents");
+
+        validateEntry(entry);
+    }
+}
+
+
+void AssetPack::validateEntry(const AssetPackEntry& entry) const
+{
+    bool valid = entry.payloadOffset % ASSET_PACK_ALIGNMENT == 0
+                 && entry.payloadOffset <= m_size
+                 && entry.payloadSize <= m_size - entry.payloadOffset;
+
+    if (valid && entry.type == AssetType::MESH) {
+        auto& mesh = entry.mesh;
+        uint64_t indexSize = mesh.indexType == 0 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+        valid = mesh.vertexStride == sizeof(AssetPackVertex)
+                && mesh.indexType <= 1
+                && mesh.indexOffset % sizeof(uint32_t) == 0
+                && uint64_t(mesh.vertexCount) * mesh.vertexStride <= mesh.indexOffset
+                && mesh.indexOffset <= entry.payloadSize
+                && uint64_t(mesh.indexCount) * indexSize <= entry.payloadSize - mesh.indexOffset;
+
+    } else if (valid && entry.type == AssetType::TEXTURE) {
+        auto& texture = entry.texture;
+
+        // Bounded well past any device limit, so the mip sizes can't overflow
+        valid = texture.width > 0 && texture.width <= (1u << 16)
+                && texture.height > 0 && texture.height <= (1u << 16)
+                && texture.layerCount > 0 && texture.layerCount <= (1u << 12)
+                && texture.blockSize > 0 && texture.blockSize <= 16
+                && (texture.blockExtent == 1 || texture.blockExtent == 4)
+                && texture.mipLevels > 0 && texture.mipLevels <= ASSET_PACK_MAX_MIP_LEVELS
+                && getAssetMipOffset(texture, texture.mipLevels) <= entry.payloadSize;
+
+    } else {
+        valid = false;
+    }
+
+    if (!valid)
+        throw Exception("Asset pack \"" + m_path + "\": invalid asset \"" + std::string(getName(entry)) + "\"");
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "AssetPackFormat.hpp"
+
+#include <string>
+#include <string_view>
+
+// An asset pack mapped in memory, read only.
+// The table of contents is checked when the pack is opened, then every payload is used in place:
+// getPayload() points into the mapping, pages are read from the disk as they are touched.
+class AssetPack
+{
+  public:
+    explicit AssetPack(const std::string& path);  // Throws if the file isn't a valid pack
+    ~AssetPack();
+
+    const AssetPackEntry* find(std::string_view name) const noexcept;  // Null if missing
+    std::string_view getName(const AssetPackEntry& entry) const noexcept;
+
+    inline const void* getPayload(const AssetPackEntry& entry) const noexcept { return m_data + entry.payloadOffset; }
+    // Starts reading the payload from the disk ahead of its use, without waiting
+    void prefetch(const AssetPackEntry& entry) const noexcept;
+
+    inline const AssetPackEntry* begin() const noexcept { return m_entries; }
+    inline const AssetPackEntry* end() const noexcept { return m_entries + m_entryCount; }
+    inline uint32_t getEntryCount() const noexcept { return m_entryCount; }
+    inline size_t getSize() const noexcept { return m_size; }
+    inline const std::string& getPath() const noexcept { return m_path; }
+
+  private:
+    void validate();  // Sets the table of contents members
+    void validateEntry(const AssetPackEntry& entry) const;
+
+  private:
+    std::string m_path;
+    const char* m_data = nullptr;
+    size_t m_size = 0;
+
+    const AssetPackEntry* m_entries = nullptr;
+    uint32_t m_entryCount = 0;
+    const char* m_names = nullptr;
+
+  public:
+    AssetPack(const AssetPack&) = delete;
+    void operator=(const AssetPack&) = delete;
+};
@@ -0,0 +1,120 @@
+#pragma once
+
+// Layout of the asset pack files written by the packer (tools/packer) and mapped by AssetPack.
+// Shared by both projects, so nothing here depends on the rest of the engine.
+//
+//   AssetPackHeader
+//   AssetPackEntry[entryCount]  Sorted by name hash
+//   Names                       Not null terminated, for lookups and diagnostics
+//   Payloads                    Each on ASSET_PACK_ALIGNMENT, in the layout the device wants
+//
+// Payloads are copied as they are into staging memory: a mesh is its vertex buffer followed by
+// its index buffer, a texture is its mip levels one after the other, every array layer of a level
+// tightly packed. Little endian, like every platform the engine runs on.
+
+#include <cstdint>
+
+#define ASSET_PACK_MAGIC 0x4b505654  // "TVPK"
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 256  // Payload alignment, covers any optimalBufferCopyOffsetAlignment
+#define ASSET_PACK_MIP_ALIGNMENT 16  // Of each mip level in a texture payload
+#define ASSET_PACK_MAX_MIP_LEVELS 16
+
+enum class AssetType : uint32_t
+{
+    MESH = 1,
+    TEXTURE = 2
+};
+
+// Interleaved vertex of every mesh, 32 bytes
+struct AssetPackVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+struct AssetPackMesh
+{
+    uint32_t vertexCount;
+    uint32_t vertexStride;  // sizeof(AssetPackVertex)
+    uint32_t indexCount;
+    uint32_t indexType;  // VkIndexType: 0 = uint16, 1 = uint32
+    uint64_t indexOffset;  // In the payload, after the vertices
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct AssetPackTexture
+{
+    uint32_t format;  // VkFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t layerCount;
+    uint32_t blockSize;  // Bytes per texel block
+    uint32_t blockExtent;  // Texels per block side: 1, or 4 for block compressed formats
+    uint32_t reserved;
+};
+
+struct AssetPackEntry
+{
+    uint64_t nameHash;  // hashBytes() of the name
+    uint32_t nameOffset;  // From the start of the names
+    uint32_t nameSize;
+    uint64_t payloadOffset;  // From the start of the file
+    uint64_t payloadSize;
+    AssetType type;
+    uint32_t reserved;
+
+    union
+    {
+        AssetPackMesh mesh;
+        AssetPackTexture texture;
+    };
+};
+
+struct AssetPackHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t alignment;  // ASSET_PACK_ALIGNMENT when written
+    uint64_t fileSize;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+    uint64_t tocChecksum;  // hashBytes() of the entries and the names, payloads aren't hashed
+};
+
+static_assert(sizeof(AssetPackVertex) == 32, "Asset pack vertices must be tightly packed");
+static_assert(sizeof(AssetPackEntry) == 88, "Asset pack entries must not have padding");
+static_assert(sizeof(AssetPackHeader) == 48, "Asset pack header must not have padding");
+
+
+inline uint64_t alignAssetOffset(uint64_t offset, uint64_t alignment) noexcept
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+
+// Size of one mip level, every layer included
+inline uint64_t getAssetMipSize(const AssetPackTexture& texture, uint32_t level) noexcept
+{
+    uint64_t width = texture.width >> level > 0 ? texture.width >> level : 1;
+    uint64_t height = texture.height >> level > 0 ? texture.height >> level : 1;
+    uint64_t blocksX = (width + texture.blockExtent - 1) / texture.blockExtent;
+    uint64_t blocksY = (height + texture.blockExtent - 1) / texture.blockExtent;
+
+    return blocksX * blocksY * texture.blockSize * texture.layerCount;
+}
+
+
+// Offset of a mip level in the texture payload, level == mipLevels gives the payload size
+inline uint64_t getAssetMipOffset(const AssetPackTexture& texture, uint32_t level) noexcept
+{
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < level; i++)
+        offset = alignAssetOffset(offset + getAssetMipSize(texture, i), ASSET_PACK_MIP_ALIGNMENT);
+
+    return offset;
+}
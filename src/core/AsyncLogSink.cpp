@@ -0,0 +1,308 @@
+#include "pch.hpp"
+
+#include "AsyncLogSink.hpp"
+#include "Exception.hpp"
+
+#include <cstring>
+
+AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> targets, size_t queueSize, Logger::OverflowPolicy policy)
+    : m_targets(std::move(targets)), m_policy(policy)
+{
+    // The ring buffer indexes slots with a mask
+    size_t capacity = 2;
+    while (capacity < queueSize)
+        capacity <<= 1;
+
+    m_slots = std::make_unique<Slot[]>(capacity);
+    m_mask = capacity - 1;
+
+    for (size_t i = 0; i < capacity; i++)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    m_flushThread = std::thread(&AsyncLogSink::flushThreadLoop, this);
+}
+
+
+AsyncLogSink::~AsyncLogSink()
+{
+    stop();
+}
+
+// public
+
+void AsyncLogSink::log(const spdlog::details::log_msg& msg)
+{
+    // Nothing drains the queue anymore, write on the caller's thread
+    if (m_stopped.load(std::memory_order_acquire)) {
+        writeToTargets(msg);
+        return;
+    }
+
+    size_t position;
+    Slot* slot = claim(position);
+    if (!slot) {
+        if (m_stopped.load(std::memory_order_acquire))
+            writeToTargets(msg);
+        return;
+    }
+
+    slot->level = msg.level;
+    slot->time = msg.time;
+    slot->threadID = msg.thread_id;
+    slot->loggerName = msg.logger_name;
+    slot->formatFunction = nullptr;
+    slot->format = nullptr;
+    slot->size = std::min(msg.payload.size(), sizeof(slot->payload));
+    std::memcpy(slot->payload, msg.payload.data(), slot->size);
+
+    if (msg.payload.size() > sizeof(slot->payload))
+        std::memcpy(slot->payload + sizeof(slot->payload) - 3, "...", 3);
+
+    publish(slot, position);
+}
+
+
+void AsyncLogSink::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_stopping) return;
+
+    uint64_t request = ++m_flushRequests;
+    m_wakeUp.notify_one();
+    m_flushed.wait(lock, [&] { return m_flushesDone >= request || m_stopping; });
+}
+
+
+void AsyncLogSink::set_pattern(const std::string& pattern)
+{
+    for (auto& t : m_targets)
+        t->set_pattern(pattern);
+}
+
+
+void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter)
+{
+    for (auto& t : m_targets)
+        t->set_formatter(sinkFormatter->clone());
+}
+
+
+void AsyncLogSink::stop() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stopping) return;
+        m_stopping = true;
+    }
+
+    m_wakeUp.notify_one();
+    if (m_flushThread.joinable())
+        m_flushThread.join();
+
+    // From here on log() writes on the caller's thread. Messages queued meanwhile are written here
+    m_stopped.store(true, std::memory_order_release);
+    drain();
+    reportDropped();
+    for (auto& t : m_targets) {
+        try {
+            t->flush();
+        } catch (const std::exception& ex) {
+            std::cerr << "Async logger failed to flush: " << ex.what() << std::endl;
+        }
+    }
+
+    m_flushed.notify_all();
+}
+
+// private
+
+AsyncLogSink::Slot* AsyncLogSink::claim(size_t& position)
+{
+    if (Slot* slot = tryClaim(position)) return slot;
+
+    switch (m_policy) {
+    case Logger::OverflowPolicy::BLOCK:
+        // Waiting on a stopped sink would never end
+        while (!m_stopped.load(std::memory_order_acquire)) {
+            wakeFlushThread();
+            std::this_thread::yield();
+
+            if (Slot* slot = tryClaim(position)) return slot;
+        }
+        return nullptr;
+
+    case Logger::OverflowPolicy::DROP_OLDEST:
+        // Producers may consume too: discard the oldest message to make room
+        while (true) {
+            if (Slot* oldest = tryPop()) {
+                release(oldest);
+                m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if (Slot* slot = tryClaim(position)) return slot;
+        }
+
+    case Logger::OverflowPolicy::COUNT_DROPPED:
+        m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+        wakeFlushThread();
+        return nullptr;
+    }
+
+    return nullptr;
+}
+
+
+AsyncLogSink::Slot* AsyncLogSink::tryClaim(size_t& position) noexcept
+{
+    position = m_enqueuePos.load(std::memory_order_relaxed);
+
+    while (true) {
+        Slot* slot = &m_slots[position & m_mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return slot;
+        } else if (diff < 0) {
+            return nullptr;  // Full
+        } else {
+            position = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+void AsyncLogSink::publish(Slot* slot, size_t position) noexcept
+{
+    slot->sequence.store(position + 1, std::memory_order_release);
+    wakeFlushThread();
+}
+
+
+AsyncLogSink::Slot* AsyncLogSink::tryPop() noexcept
+{
+    size_t position = m_dequeuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+
+    while (true) {
+        slot = &m_slots[position & m_mask];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+
+        if (diff == 0) {
+            if (m_dequeuePos.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return slot;
+        } else if (diff < 0) {
+            return nullptr;  // Empty
+        } else {
+            position = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+
+void AsyncLogSink::release(Slot* slot) noexcept
+{
+    // A popped slot holds sequence = position + 1, hand it back to producers one lap later
+    size_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + m_mask, std::memory_order_release);
+}
+
+
+void AsyncLogSink::flushThreadLoop()
+{
+    while (true) {
+        bool wroteSomething = drain();
+        reportDropped();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_flushesDone < m_flushRequests) {
+            uint64_t requests = m_flushRequests;
+            lock.unlock();
+
+            drain();
+            for (auto& t : m_targets)
+                t->flush();
+
+            lock.lock();
+            m_flushesDone = requests;
+            m_flushed.notify_all();
+        }
+
+        if (m_stopping) {
+            lock.unlock();
+            drain();
+            reportDropped();
+            for (auto& t : m_targets)
+                t->flush();
+            return;
+        }
+
+        if (!wroteSomething) {
+            // A producer may miss this flag and not notify, the timeout bounds the delay
+            m_flushThreadSleeping.store(true, std::memory_order_relaxed);
+            m_wakeUp.wait_for(lock, IDLE_WAIT);
+            m_flushThreadSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+bool AsyncLogSink::drain()
+{
+    bool wroteSomething = false;
+
+    while (Slot* slot = tryPop()) {
+        try {
+            spdlog::string_view_t text(slot->payload, slot->size);
+            if (slot->formatFunction) {
+                m_text.clear();
+                slot->formatFunction(slot->format, slot->payload, m_text);
+                text = spdlog::string_view_t(m_text.data(), m_text.size());
+            }
+
+            spdlog::details::log_msg msg(slot->time, spdlog::source_loc{}, slot->loggerName, slot->level, text);
+            msg.thread_id = slot->threadID;
+            writeToTargets(msg);
+
+        } catch (const std::exception& ex) {
+            std::cerr << "Async logger failed to write a message: " << ex.what() << std::endl;
+        }
+
+        release(slot);
+        wroteSomething = true;
+    }
+
+    return wroteSomething;
+}
+
+
+void AsyncLogSink::writeToTargets(const spdlog::details::log_msg& msg)
+{
+    for (auto& t : m_targets) {
+        if (t->should_log(msg.level))
+            t->log(msg);
+    }
+}
+
+
+void AsyncLogSink::reportDropped()
+{
+    size_t dropped = m_droppedCount.load(std::memory_order_relaxed);
+    if (dropped == m_reportedDropCount) return;
+
+    std::string text = fmt::format("Async logger queue full, dropped {} messages", dropped - m_reportedDropCount);
+    m_reportedDropCount = dropped;
+
+    spdlog::details::log_msg msg("logger", spdlog::level::warn, text);
+    writeToTargets(msg);
+}
+
+
+void AsyncLogSink::wakeFlushThread() noexcept
+{
+    if (m_flushThreadSleeping.load(std::memory_order_relaxed))
+        m_wakeUp.notify_one();
+}
@@ -0,0 +1,238 @@
+#pragma once
+#include "pch.hpp"
+
+#include "Logger.hpp"
+
+#include <spdlog/details/os.h>
+#include <spdlog/sinks/sink.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#define ASYNC_LOG_PAYLOAD_SIZE 1024  // Longer messages are truncated, longer deferred arguments formatted by the caller
+
+// How a format argument is copied into a slot to be formatted on the flush thread.
+// Numbers, enums and pointers are copied as is, strings as their length and characters.
+// Anything else is formatted by the caller
+template <typename T, typename = void>
+struct LogArgument
+{
+    static constexpr bool deferrable = false;
+};
+
+template <typename T>
+struct LogArgument<T, std::enable_if_t<std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+                                       (std::is_pointer_v<T> && !std::is_same_v<std::remove_cv_t<std::remove_pointer_t<T>>, char>)>>
+{
+    static constexpr bool deferrable = true;
+    using Stored = T;
+
+    static bool valid(T) noexcept { return true; }
+    static size_t size(T) noexcept { return sizeof(T); }
+
+    static char* write(char* out, T value) noexcept
+    {
+        std::memcpy(out, &value, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    static T read(const char*& in) noexcept
+    {
+        T value;
+        std::memcpy(&value, in, sizeof(T));
+        in += sizeof(T);
+        return value;
+    }
+};
+
+template <>
+struct LogArgument<fmt::string_view>
+{
+    static constexpr bool deferrable = true;
+    using Stored = fmt::string_view;
+
+    static bool valid(fmt::string_view) noexcept { return true; }
+    static size_t size(fmt::string_view text) noexcept { return sizeof(size_t) + text.size(); }
+
+    static char* write(char* out, fmt::string_view text) noexcept
+    {
+        size_t length = text.size();
+        std::memcpy(out, &length, sizeof(length));
+        std::memcpy(out + sizeof(length), text.data(), length);
+        return out + sizeof(length) + length;
+    }
+
+    // Points into the slot, valid until the slot is released
+    static fmt::string_view read(const char*& in) noexcept
+    {
+        size_t length;
+        std::memcpy(&length, in, sizeof(length));
+        fmt::string_view text(in + sizeof(length), length);
+        in += sizeof(length) + length;
+        return text;
+    }
+};
+
+template <>
+struct LogArgument<std::string> : LogArgument<fmt::string_view> {};
+
+template <>
+struct LogArgument<std::string_view> : LogArgument<fmt::string_view> {};
+
+template <>
+struct LogArgument<const char*> : LogArgument<fmt::string_view>
+{
+    static bool valid(const char* text) noexcept { return text != nullptr; }  // Checked before the others
+};
+
+template <>
+struct LogArgument<char*> : LogArgument<const char*> {};
+
+// spdlog sink that hands messages over to a background thread through a preallocated,
+// lock-free bounded ring buffer (Vyukov MPMC queue). Through logDeferred() (the LOG_*
+// macros) the logging thread only copies the format arguments into a slot; formatting,
+// the pattern and I/O to the target sinks happen on the flush thread. Messages logged
+// through spdlog arrive formatted and are only copied.
+// Once stopped, messages are written on the caller's thread.
+class AsyncLogSink : public spdlog::sinks::sink
+{
+  public:
+    // Reads the arguments deferred with `format` back from a slot and formats them into `text`
+    using FormatFunction = void (*)(const char* format, const char* arguments, fmt::memory_buffer& text);
+
+    AsyncLogSink(std::vector<spdlog::sink_ptr> targets, size_t queueSize, Logger::OverflowPolicy policy);
+    ~AsyncLogSink() override;
+
+    void log(const spdlog::details::log_msg& msg) override;
+
+    // Enqueues the message unformatted, `logger` must log to this sink only. The format must be
+    // a string literal, it is read on the flush thread. False when the caller has to log it
+    // through spdlog instead: no arguments, arguments that can't be copied (@see LogArgument)
+    // or don't fit a slot, or a stopped sink
+    template <size_t N, typename... Args>
+    bool logDeferred(const spdlog::logger& logger, spdlog::level::level_enum level, const char (&format)[N], const Args&... args);
+    template <typename Format, typename... Args>
+    inline bool logDeferred(const spdlog::logger&, spdlog::level::level_enum, const Format&, const Args&...) noexcept { return false; }
+
+    // The sink of Logger, if async (@see Logger::enableAsync)
+    inline static AsyncLogSink* getDefault() noexcept { return s_default; }
+    inline static void setDefault(AsyncLogSink* sink) noexcept { s_default = sink; }
+
+    void flush() override;  // Blocks until every message enqueued so far has been written
+
+    // Not thread safe, call these before logging from other threads
+    void set_pattern(const std::string& pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> sinkFormatter) override;
+
+    void stop() noexcept;  // Drains the queue and joins the flush thread
+    inline size_t getDroppedCount() const noexcept { return m_droppedCount.load(std::memory_order_relaxed); }
+
+  private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+
+        spdlog::level::level_enum level;
+        spdlog::log_clock::time_point time;
+        size_t threadID;
+        spdlog::string_view_t loggerName;  // Points to the logger's name, which outlives the sink
+        FormatFunction formatFunction;     // Null if the payload is the message text
+        const char* format;
+        size_t size;
+        char payload[ASYNC_LOG_PAYLOAD_SIZE];
+    };
+
+  private:
+    template <typename... Stored>
+    static void formatDeferred(const char* format, const char* arguments, fmt::memory_buffer& text);
+
+    Slot* claim(size_t& position);  // Applies the overflow policy, null if the message is not to be queued
+    Slot* tryClaim(size_t& position) noexcept;
+    void publish(Slot* slot, size_t position) noexcept;
+    Slot* tryPop() noexcept;
+    void release(Slot* slot) noexcept;
+
+    void flushThreadLoop();
+    bool drain();
+    void writeToTargets(const spdlog::details::log_msg& msg);
+    void reportDropped();
+    void wakeFlushThread() noexcept;
+
+  private:
+    std::vector<spdlog::sink_ptr> m_targets;
+    Logger::OverflowPolicy m_policy;
+
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_mask;
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) std::atomic<size_t> m_dequeuePos{0};
+    alignas(64) std::atomic<size_t> m_droppedCount{0};
+    size_t m_reportedDropCount = 0;  // Flush thread only
+    fmt::memory_buffer m_text;       // Flush thread only, deferred messages are formatted in it
+
+    std::thread m_flushThread;
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_flushed;
+    std::atomic<bool> m_flushThreadSleeping{false};
+    bool m_stopping = false;
+    std::atomic<bool> m_stopped{false};  // Set once the flush thread is gone
+    uint64_t m_flushRequests = 0;
+    uint64_t m_flushesDone = 0;
+
+  private:
+    static constexpr std::chrono::milliseconds IDLE_WAIT{100};
+    inline static AsyncLogSink* s_default = nullptr;
+};
+
+
+template <size_t N, typename... Args>
+bool AsyncLogSink::logDeferred(const spdlog::logger& logger, spdlog::level::level_enum level, const char (&format)[N], const Args&... args)
+{
+    if constexpr (sizeof...(Args) == 0 || !(LogArgument<std::decay_t<Args>>::deferrable && ...)) {
+        return false;
+    } else {
+        if (!(LogArgument<std::decay_t<Args>>::valid(args) && ...)) return false;
+
+        size_t size = (LogArgument<std::decay_t<Args>>::size(args) + ...);
+        if (size > ASYNC_LOG_PAYLOAD_SIZE || m_stopped.load(std::memory_order_acquire)) return false;
+        if (!should_log(level)) return true;
+
+        size_t position;
+        Slot* slot = claim(position);
+        if (!slot) return !m_stopped.load(std::memory_order_acquire);  // Dropped, unless stopped meanwhile
+
+        slot->level = level;
+        slot->time = spdlog::log_clock::now();
+        slot->threadID = spdlog::details::os::thread_id();
+        slot->loggerName = logger.name();
+        slot->formatFunction = &formatDeferred<typename LogArgument<std::decay_t<Args>>::Stored...>;
+        slot->format = format;
+        slot->size = size;
+
+        char* out = slot->payload;
+        ((out = LogArgument<std::decay_t<Args>>::write(out, args)), ...);
+
+        publish(slot, position);
+        return true;
+    }
+}
+
+
+template <typename... Stored>
+void AsyncLogSink::formatDeferred(const char* format, const char* arguments, fmt::memory_buffer& text)
+{
+    // Braced initialization reads the arguments in order
+    std::tuple<Stored...> values{LogArgument<Stored>::read(arguments)...};
+    std::apply([&](const Stored&... value) {
+        fmt::vformat_to(fmt::appender(text), format, fmt::make_format_args(value...));
+    }, values);
+}
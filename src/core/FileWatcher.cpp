@@ -0,0 +1,98 @@
+#include "pch.hpp"
+
+#include "FileWatcher.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#define FILE_WATCHER_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)
+
+FileWatcher::FileWatcher(const std::string& directory)
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0)
+        throw Exception(std::string("Failed to initialize inotify: ") + std::strerror(errno));
+
+    try {
+        if (!std::filesystem::is_directory(directory))
+            throw Exception("Can't watch \"" + directory + "\", not a directory");
+
+        addWatch(directory);
+        for (auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
+            if (entry.is_directory())
+                addWatch(entry.path().string());
+        }
+
+    } catch (const std::exception& ex) {
+        // The destructor won't run
+        close(m_fd);
+        throw Exception("Failed to watch \"" + directory + "\"\n" + ex.what());
+    }
+
+    LOG_TRACE("Watching \"{}\" ({} directories)", directory, m_directories.size());
+}
+
+
+FileWatcher::~FileWatcher()
+{
+    close(m_fd);  // Removes every watch
+}
+
+// public
+
+void FileWatcher::poll(std::vector<std::string>& changedPaths)
+{
+    alignas(inotify_event) char buffer[FILE_WATCHER_BUFFER_SIZE];
+
+    while (true) {
+        ssize_t size = read(m_fd, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) continue;
+        if (size <= 0) break;  // EAGAIN: nothing more for now
+
+        for (char* cursor = buffer; cursor < buffer + size;) {
+            auto event = reinterpret_cast<const inotify_event*>(cursor);
+            cursor += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                LOG_WARN("File watcher queue overflowed, some changes were missed");
+                continue;
+            }
+
+            auto directory = m_directories.find(event->wd);
+            if (directory == m_directories.end()) continue;
+
+            if (event->mask & IN_IGNORED) {
+                m_directories.erase(directory);  // Removed
+                continue;
+            }
+
+            if (event->len == 0) continue;  // About the directory itself
+
+            std::string path = (std::filesystem::path(directory->second) / event->name).lexically_normal().string();
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addWatch(path);
+
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                if (std::find(changedPaths.begin(), changedPaths.end(), path) == changedPaths.end())
+                    changedPaths.push_back(path);
+            }
+        }
+    }
+}
+
+// private
+
+void FileWatcher::addWatch(const std::string& directory)
+{
+    int wd = inotify_add_watch(m_fd, directory.c_str(), FILE_WATCHER_EVENTS);
+    if (wd < 0) {
+        LOG_WARN("Can't watch \"{}\": {}", directory, std::strerror(errno));
+        return;
+    }
+
+    m_directories[wd] = std::filesystem::path(directory).lexically_normal().string();
+}
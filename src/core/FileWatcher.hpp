@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define FILE_WATCHER_BUFFER_SIZE 4096  // Bytes of inotify events read at once
+
+// Files written in a directory tree, through inotify.
+// poll() never blocks, it can run every frame. Files are reported once they are closed after
+// writing, or renamed into place (editors saving through a temporary file). Directories created
+// later are watched too.
+class FileWatcher
+{
+  public:
+    explicit FileWatcher(const std::string& directory);
+    ~FileWatcher();
+
+    // Appends the files changed since the last call (the directory joined with their relative
+    // path, normalized), each one once
+    void poll(std::vector<std::string>& changedPaths);
+
+  private:
+    void addWatch(const std::string& directory);
+
+  private:
+    int m_fd = -1;
+    std::unordered_map<int, std::string> m_directories;  // Watch descriptor -> directory
+
+  public:
+    FileWatcher(const FileWatcher&) = delete;
+    void operator=(const FileWatcher&) = delete;
+};
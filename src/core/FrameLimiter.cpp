@@ -0,0 +1,112 @@
+#include "pch.hpp"
+
+#include "FrameLimiter.hpp"
+#include "Logger.hpp"
+
+#include <thread>
+
+FrameLimiter::FrameLimiter(double targetFps)
+{
+    setTargetFps(targetFps);
+
+    m_frameStart = Clock::now();
+    m_nextDeadline = m_frameStart + m_frameBudget;
+    m_lastReport = m_frameStart;
+}
+
+// public
+
+void FrameLimiter::setTargetFps(double targetFps) noexcept
+{
+    m_targetFps = targetFps > 0.0 ? targetFps : 0.0;
+    m_frameBudget = m_targetFps > 0.0
+                        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_targetFps))
+                        : Clock::duration::zero();
+}
+
+
+void FrameLimiter::beginFrame() noexcept
+{
+    m_frameStart = Clock::now();
+}
+
+
+void FrameLimiter::endFrame(bool idle) noexcept
+{
+    auto now = Clock::now();
+    auto work = now - m_frameStart;
+
+    if (idle) {
+        ++m_idleFrames;
+    } else {
+        ++m_frames;
+        m_totalWork += work;
+        m_worstWork = std::max(m_worstWork, work);
+
+        if (m_frameBudget != Clock::duration::zero() && work > m_frameBudget)
+            ++m_overBudgetFrames;
+    }
+
+    if (m_frameBudget != Clock::duration::zero()) {
+        // Fell behind (slow frame or idle wait): restart the schedule instead of
+        // rushing through frames to catch up
+        if (now >= m_nextDeadline)
+            m_nextDeadline = now + m_frameBudget;
+        else {
+            waitUntil(m_nextDeadline);
+            m_nextDeadline += m_frameBudget;
+        }
+    }
+
+    if (now - m_lastReport >= REPORT_INTERVAL)
+        report(now);
+}
+
+// private
+
+void FrameLimiter::waitUntil(Clock::time_point deadline) const noexcept
+{
+    auto remaining = deadline - Clock::now();
+    if (remaining > SPIN_THRESHOLD)
+        std::this_thread::sleep_for(remaining - SPIN_THRESHOLD);
+
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+
+void FrameLimiter::report(Clock::time_point now) noexcept
+{
+#if LOG_DEBUG_ENABLED
+    using ms = std::chrono::duration<double, std::milli>;
+
+    std::chrono::duration<double> elapsed = now - m_lastReport;
+    double avgWork = m_frames > 0 ? ms(m_totalWork).count() / m_frames : 0.0;
+
+    if (m_frameBudget != Clock::duration::zero()) {
+        LOG_DEBUG(
+            "Frame budget: {:.1f} fps, work avg {:.3f}ms / worst {:.3f}ms of {:.3f}ms ({:.0f}%), {} over budget, {} idle",
+            (m_frames + m_idleFrames) / elapsed.count(),
+            avgWork,
+            ms(m_worstWork).count(),
+            ms(m_frameBudget).count(),
+            100.0 * avgWork / ms(m_frameBudget).count(),
+            m_overBudgetFrames,
+            m_idleFrames);
+    } else {
+        LOG_DEBUG(
+            "Frame budget: {:.1f} fps (uncapped), work avg {:.3f}ms / worst {:.3f}ms, {} idle",
+            (m_frames + m_idleFrames) / elapsed.count(),
+            avgWork,
+            ms(m_worstWork).count(),
+            m_idleFrames);
+    }
+#endif
+
+    m_lastReport = now;
+    m_frames = 0;
+    m_idleFrames = 0;
+    m_overBudgetFrames = 0;
+    m_totalWork = Clock::duration::zero();
+    m_worstWork = Clock::duration::zero();
+}
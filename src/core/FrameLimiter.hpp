@@ -0,0 +1,47 @@
+#pragma once
+#include "pch.hpp"
+
+#include <chrono>
+
+// Paces the main loop to a target frame rate and reports how each frame used its budget.
+// Waiting is hybrid: sleep for the bulk of the remaining time, then spin for the last
+// moment, because sleep() alone routinely overshoots by a whole scheduler quantum.
+class FrameLimiter
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameLimiter(double targetFps = 0.0);
+
+    void setTargetFps(double targetFps) noexcept;
+    inline double getTargetFps() const noexcept { return m_targetFps; }
+
+    // Call once events are handled, right before the frame work starts
+    void beginFrame() noexcept;
+    // Call once the frame work is done. Waits for the next frame deadline if limited.
+    // `idle` frames (nothing drawn) are counted apart so they don't skew the report
+    void endFrame(bool idle = false) noexcept;
+
+  private:
+    void waitUntil(Clock::time_point deadline) const noexcept;
+    void report(Clock::time_point now) noexcept;
+
+  private:
+    double m_targetFps = 0.0;
+    Clock::duration m_frameBudget = Clock::duration::zero();  // zero when uncapped
+
+    Clock::time_point m_frameStart;
+    Clock::time_point m_nextDeadline;
+
+    // Budget report, accumulated between two reports
+    Clock::time_point m_lastReport;
+    uint64_t m_frames = 0;
+    uint64_t m_idleFrames = 0;
+    uint64_t m_overBudgetFrames = 0;
+    Clock::duration m_totalWork = Clock::duration::zero();
+    Clock::duration m_worstWork = Clock::duration::zero();
+
+  private:
+    static constexpr std::chrono::microseconds SPIN_THRESHOLD{1500};  // Below this, spin instead of sleeping
+    static constexpr std::chrono::seconds REPORT_INTERVAL{5};
+};
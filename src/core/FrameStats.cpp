@@ -0,0 +1,130 @@
+#include "pch.hpp"
+
+#include "FrameStats.hpp"
+#include "Logger.hpp"
+
+#include <cmath>
+
+FrameStats::FrameStats(const std::string& csvPath)
+    : m_csvPath(csvPath), m_lastReport(Clock::now())
+{
+    if (csvPath.empty())
+        return;
+
+    m_csv.open(csvPath, std::ios::trunc);
+    if (!m_csv)
+        throw Exception("Failed to create stats file \"" + csvPath + "\"");
+
+    m_csv << "frame,series,milliseconds\n";
+}
+
+
+FrameStats::~FrameStats()
+{
+    if (m_csv.is_open()) {
+        m_csv.close();
+        LOG_DEBUG("Wrote {} stats rows to \"{}\"", m_rowCount, m_csvPath);
+    }
+}
+
+// public
+
+void FrameStats::add(uint64_t frame, const std::string& series, double milliseconds)
+{
+    auto [it, inserted] = m_series.try_emplace(series);
+    if (inserted) {
+        it->second.samples.reserve(FRAME_STATS_WINDOW);
+        m_seriesOrder.push_back(series);
+    }
+
+    Series& s = it->second;
+    if (s.samples.size() < FRAME_STATS_WINDOW)
+        s.samples.push_back(static_cast<float>(milliseconds));
+    else
+        s.samples[s.next] = static_cast<float>(milliseconds);
+
+    s.next = (s.next + 1) % FRAME_STATS_WINDOW;
+
+    // Streamed, a killed run keeps what it measured up to the last flush
+    if (m_csv.is_open()) {
+        m_csv << frame << ',' << series << ',' << milliseconds << '\n';
+        m_rowCount++;
+    }
+}
+
+
+FrameStats::Percentiles FrameStats::getPercentiles(const std::string& series) const
+{
+    auto it = m_series.find(series);
+    return it != m_series.end() ? computePercentiles(it->second) : Percentiles{};
+}
+
+
+void FrameStats::update() noexcept
+{
+    auto now = Clock::now();
+    if (now - m_lastReport < REPORT_INTERVAL)
+        return;
+
+    m_lastReport = now;
+
+#if LOG_DEBUG_ENABLED
+    log(false);
+#endif
+}
+
+
+void FrameStats::report() const noexcept
+{
+    log(true);
+}
+
+// private
+
+FrameStats::Percentiles FrameStats::computePercentiles(const Series& series) const
+{
+    Percentiles percentiles;
+    percentiles.sampleCount = series.samples.size();
+    if (series.samples.empty())
+        return percentiles;
+
+    m_sorted.assign(series.samples.begin(), series.samples.end());
+    std::sort(m_sorted.begin(), m_sorted.end());
+
+    // Nearest rank
+    auto rank = [&](double p) {
+        size_t index = static_cast<size_t>(std::ceil(p * m_sorted.size()));
+        return m_sorted[std::clamp<size_t>(index, 1, m_sorted.size()) - 1];
+    };
+
+    percentiles.p50 = rank(0.50);
+    percentiles.p95 = rank(0.95);
+    percentiles.p99 = rank(0.99);
+    return percentiles;
+}
+
+
+void FrameStats::log(bool info) const noexcept
+{
+    for (auto& name : m_seriesOrder) {
+        Percentiles percentiles = computePercentiles(m_series.at(name));
+
+        if (info) {
+            LOG_INFO(
+                "{}: p50 {:.3f}ms, p95 {:.3f}ms, p99 {:.3f}ms ({} samples)",
+                name,
+                percentiles.p50,
+                percentiles.p95,
+                percentiles.p99,
+                percentiles.sampleCount);
+        } else {
+            LOG_DEBUG(
+                "{}: p50 {:.3f}ms, p95 {:.3f}ms, p99 {:.3f}ms ({} samples)",
+                name,
+                percentiles.p50,
+                percentiles.p95,
+                percentiles.p99,
+                percentiles.sampleCount);
+        }
+    }
+}
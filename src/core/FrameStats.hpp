@@ -0,0 +1,70 @@
+#pragma once
+#include "pch.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define FRAME_STATS_WINDOW 256  // Samples the percentiles are taken over, per series
+
+// Rolling CPU and GPU timings, to tell a CPU bound frame from a GPU bound one.
+// Every series ("cpu frame", "cpu wait", "gpu frame", "Graph/Pass"...) keeps its last samples, the
+// percentiles are taken over them. Every sample is also streamed to the CSV file if given, one
+// "frame,series,milliseconds" row each.
+class FrameStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Percentiles
+    {
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        size_t sampleCount = 0;
+    };
+
+  public:
+    explicit FrameStats(const std::string& csvPath = "");  // Empty = no CSV
+    ~FrameStats();
+
+    void add(uint64_t frame, const std::string& series, double milliseconds);
+
+    Percentiles getPercentiles(const std::string& series) const;
+
+    // Logs the percentiles of every series at debug level, at most every REPORT_INTERVAL
+    void update() noexcept;
+    // Logs them now, at info level
+    void report() const noexcept;
+
+  private:
+    struct Series
+    {
+        std::vector<float> samples;  // Ring buffer
+        size_t next = 0;
+    };
+
+  private:
+    Percentiles computePercentiles(const Series& series) const;
+    void log(bool info) const noexcept;
+
+  private:
+    std::unordered_map<std::string, Series> m_series;
+    std::vector<std::string> m_seriesOrder;  // First sample order, for stable reports
+    mutable std::vector<float> m_sorted;  // Reused by computePercentiles()
+
+    std::ofstream m_csv;
+    std::string m_csvPath;
+    uint64_t m_rowCount = 0;
+
+    Clock::time_point m_lastReport;
+
+  private:
+    static constexpr std::chrono::seconds REPORT_INTERVAL{5};
+
+  public:
+    FrameStats(const FrameStats&) = delete;
+    void operator=(const FrameStats&) = delete;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define HASH_SEED 0xcbf29ce484222325ull  // FNV-1a 64-bit offset basis
+
+// 64-bit FNV-1a. Chain calls through `hash` to hash several buffers as one
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = HASH_SEED) noexcept
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// Only for types without padding, whose bytes are all meaningful
+template <typename T>
+inline uint64_t hashValue(const T& value, uint64_t hash = HASH_SEED) noexcept
+{
+    return hashBytes(&value, sizeof(T), hash);
+}
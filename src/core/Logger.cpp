@@ -1,8 +1,10 @@
 #include "pch.hpp"
 
 #include "Logger.hpp"
+#include "AsyncLogSink.hpp"
 #include "Exception.hpp"
 
+#include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
 
@@ -29,6 +31,12 @@ Logger::Logger()
 Logger::~Logger()
 {
     m_console->trace("Destroying logger");
+
+    // Write out what is still queued before the sinks go away
+    if (m_asyncSink) {
+        AsyncLogSink::setDefault(nullptr);
+        m_asyncSink->stop();
+    }
 }
 
 // public:
@@ -36,6 +44,9 @@ Logger::~Logger()
 void Logger::setLoggingLevel(Logger::LogLevel level) noexcept
 {
     try {
+        if (level > LOG_COMPILE_LEVEL)
+            m_console->warn("Logging level {} is above this build's compiled level ({}), extra messages are compiled out", level, LOG_COMPILE_LEVEL);
+
         switch (level) {
         case LOG_TRACE: m_console->set_level(spdlog::level::trace); break;
         case LOG_DEBUG: m_console->set_level(spdlog::level::debug); break;
@@ -50,3 +61,60 @@ void Logger::setLoggingLevel(Logger::LogLevel level) noexcept
         LOG_ERROR("Could not set logging level to {}\n{}", level, ex.what());
     }
 }
+
+
+Logger::LogLevel Logger::getLoggingLevel() const noexcept
+{
+    switch (m_console->level()) {
+    case spdlog::level::trace: return LOG_TRACE;
+    case spdlog::level::debug: return LOG_DEBUG;
+    case spdlog::level::info: return LOG_INFO;
+    case spdlog::level::warn: return LOG_WARN;
+    case spdlog::level::err: return LOG_ERROR;
+    default: return LOG_CRITICAL;
+    }
+}
+
+
+void Logger::addFileSink(const std::string& path)
+{
+    if (m_asyncSink)
+        throw Exception("File sinks must be added before enabling async logging");
+
+    try {
+        auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path);
+        fileSink->set_pattern("[%Y-%m-%d %T.%e] [%t] <%l> %v");
+        m_console->sinks().push_back(fileSink);
+
+        m_console->trace("Logging to file \"{}\"", path);
+
+    } catch (const spdlog::spdlog_ex& ex) {
+        throw Exception("Failed to open log file \"" + path + "\"\n" + std::string(ex.what()));
+    }
+}
+
+
+void Logger::enableAsync(size_t queueSize, OverflowPolicy policy)
+{
+    if (m_asyncSink) return;
+
+    // The logger object itself is kept, so the LOG_* macros never see it change.
+    // Only its sinks move behind the queue
+    auto& sinks = m_console->sinks();
+    m_asyncSink = std::make_shared<AsyncLogSink>(sinks, queueSize, policy);
+    sinks.assign({m_asyncSink});
+    AsyncLogSink::setDefault(m_asyncSink.get());
+
+    m_console->trace("Enabled async logging (queue size: {})", queueSize);
+}
+
+
+void Logger::flush() noexcept
+{
+    try {
+        m_console->flush();
+    } catch (const spdlog::spdlog_ex& ex) {
+        std::cerr << "Failed to flush logger\n"
+                  << ex.what() << std::endl;
+    }
+}
@@ -4,7 +4,11 @@
 #include <spdlog/spdlog.h>
 
 #include <memory>
+#include <string>
 
+#define ASYNC_LOG_DEFAULT_QUEUE_SIZE 4096
+
+class AsyncLogSink;
 class Logger
 {
   public:
@@ -19,6 +23,13 @@ class Logger
         LOG_MIN = LOG_CRITICAL
     };
 
+    // What an async Logger does when its queue is full
+    enum class OverflowPolicy {
+        BLOCK,         // Wait for the flush thread to make room
+        DROP_OLDEST,   // Overwrite the oldest queued message
+        COUNT_DROPPED  // Discard the new message, the drop count is logged later
+    };
+
     inline static Logger& instance()
     {
         static Logger logger;
@@ -28,9 +39,17 @@ class Logger
     inline const std::shared_ptr<spdlog::logger>& logger() const noexcept { return m_console; }
 
     void setLoggingLevel(LogLevel level) noexcept;
+    LogLevel getLoggingLevel() const noexcept;
+
+    // Configuration, to be done at startup before other threads log
+    void addFileSink(const std::string& path);
+    void enableAsync(size_t queueSize, OverflowPolicy policy);
+
+    void flush() noexcept;
 
   private:
     std::shared_ptr<spdlog::logger> m_console = nullptr;
+    std::shared_ptr<AsyncLogSink> m_asyncSink = nullptr;
 
   private:
     Logger();
@@ -39,9 +58,60 @@ class Logger
     void operator=(const Logger&) = delete;
 };
 
-#define LOG_TRACE(message, args...) Logger::instance().logger()->trace(message, ##args)
-#define LOG_DEBUG(message, args...) Logger::instance().logger()->debug(message, ##args)
-#define LOG_INFO(message, args...) Logger::instance().logger()->info(message, ##args)
-#define LOG_WARN(message, args...) Logger::instance().logger()->warn(message, ##args)
-#define LOG_ERROR(message, args...) Logger::instance().logger()->error(message, ##args)
-#define LOG_CRITICAL(message, args...) Logger::instance().logger()->critical(message, ##args)
\ No newline at end of file
+// Most verbose level compiled in, set per configuration in premake5.lua (@see Logger::LogLevel).
+// More verbose calls compile to nothing, their arguments are not evaluated.
+// The runtime level still filters everything above that floor
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 5
+#endif
+
+// Whether messages of `level` (a Logger::LogLevel value) are compiled in. Guards the work done
+// only to build such a message: `#if LOG_DEBUG_ENABLED`
+#define LOG_LEVEL_ENABLED(level) (LOG_COMPILE_LEVEL >= (level))
+#define LOG_DEBUG_ENABLED LOG_LEVEL_ENABLED(4)
+
+// Goes straight to the default logger (set by Logger) to skip the Logger::instance() guard,
+// and checks the level before the arguments are evaluated.
+// When async, the message is formatted on the flush thread if its arguments allow it
+#define LOG_IMPL(level, message, args...)                                                  \
+    do {                                                                                   \
+        auto* logger_ = spdlog::default_logger_raw();                                      \
+        if (!logger_->should_log(level)) break;                                            \
+        auto* asyncSink_ = AsyncLogSink::getDefault();                                     \
+        if (!asyncSink_ || !asyncSink_->logDeferred(*logger_, level, message, ##args))     \
+            logger_->log(level, message, ##args);                                          \
+    } while (0)
+
+#if LOG_LEVEL_ENABLED(5)
+#define LOG_TRACE(message, args...) LOG_IMPL(spdlog::level::trace, message, ##args)
+#else
+#define LOG_TRACE(message, args...) do { } while (0)
+#endif
+
+#if LOG_LEVEL_ENABLED(4)
+#define LOG_DEBUG(message, args...) LOG_IMPL(spdlog::level::debug, message, ##args)
+#else
+#define LOG_DEBUG(message, args...) do { } while (0)
+#endif
+
+#if LOG_LEVEL_ENABLED(3)
+#define LOG_INFO(message, args...) LOG_IMPL(spdlog::level::info, message, ##args)
+#else
+#define LOG_INFO(message, args...) do { } while (0)
+#endif
+
+#if LOG_LEVEL_ENABLED(2)
+#define LOG_WARN(message, args...) LOG_IMPL(spdlog::level::warn, message, ##args)
+#else
+#define LOG_WARN(message, args...) do { } while (0)
+#endif
+
+#if LOG_LEVEL_ENABLED(1)
+#define LOG_ERROR(message, args...) LOG_IMPL(spdlog::level::err, message, ##args)
+#else
+#define LOG_ERROR(message, args...) do { } while (0)
+#endif
+
+#define LOG_CRITICAL(message, args...) LOG_IMPL(spdlog::level::critical, message, ##args)
+
+#include "AsyncLogSink.hpp"
@@ -0,0 +1,131 @@
+#include "pch.hpp"
+
+#include "Profiler.hpp"
+#include "Exception.hpp"
+#include "Logger.hpp"
+
+#include <fstream>
+
+// Initializing static members
+std::atomic<bool> Profiler::s_recording{false};
+
+// public
+
+void Profiler::start() noexcept
+{
+#ifndef PROFILING_ENABLED
+    LOG_WARN("Profiling is compiled out of this build, the trace will be empty");
+#endif
+
+    m_startNs = now();
+    s_recording.store(true, std::memory_order_relaxed);
+
+    LOG_TRACE("Started profiler");
+}
+
+
+void Profiler::writeTrace(const std::string& path)
+{
+    s_recording.store(false, std::memory_order_relaxed);
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+        throw Exception("Could not open trace file \"" + path + "\"");
+
+    // Names are mostly function signatures, escape what JSON strings can't hold
+    auto escape = [](const char* text) {
+        std::string escaped;
+        for (; *text; ++text) {
+            if (*text == '"' || *text == '\\') escaped += '\\';
+            escaped += *text;
+        }
+        return escaped;
+    };
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t eventCount = 0, droppedCount = 0;
+    bool first = true;
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+    for (auto& buffer : m_buffers) {
+        if (!buffer->threadName.empty()) {
+            file << (first ? "\n" : ",\n")
+                 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID
+                 << ",\"args\":{\"name\":\"" << escape(buffer->threadName.c_str()) << "\"}}";
+            first = false;
+        }
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const Event& e = buffer->events[i];
+
+            // Timestamps are in microseconds, keep the nanoseconds as decimals
+            file << (first ? "\n" : ",\n")
+                 << "{\"name\":\"" << escape(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID
+                 << ",\"ts\":" << fmt::format("{:.3f}", (e.startNs - m_startNs) / 1000.0)
+                 << ",\"dur\":" << fmt::format("{:.3f}", e.durationNs / 1000.0) << "}";
+            first = false;
+        }
+
+        eventCount += count;
+        droppedCount += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    file << "\n]}\n";
+
+    if (!file)
+        throw Exception("Failed to write trace file \"" + path + "\"");
+
+    LOG_INFO("Wrote {} trace events to \"{}\"", eventCount, path);
+    if (droppedCount > 0)
+        LOG_WARN("{} trace events were dropped, per-thread buffers were full", droppedCount);
+}
+
+
+void Profiler::setThreadName(const std::string& name)
+{
+    auto& buffer = getThreadBuffer();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer.threadName = name;
+}
+
+
+void Profiler::record(const char* name, uint64_t startNs, uint64_t endNs) noexcept
+{
+    ThreadBuffer* buffer;
+    try {
+        buffer = &getThreadBuffer();
+    } catch (const std::bad_alloc& ex) {
+        return;
+    }
+
+    size_t count = buffer->count.load(std::memory_order_relaxed);
+    if (count == PROFILER_EVENTS_PER_THREAD) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    buffer->events[count] = {name, startNs, endNs - startNs};
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+// private
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+    thread_local ThreadBuffer* t_buffer = nullptr;
+    if (t_buffer) return *t_buffer;
+
+    // First event on this thread, the buffer belongs to the Profiler so it outlives the thread
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events.reset(new Event[PROFILER_EVENTS_PER_THREAD]);  // Left uninitialized, pages are touched as needed
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer->threadID = static_cast<uint32_t>(m_buffers.size() + 1);
+    t_buffer = buffer.get();
+    m_buffers.push_back(std::move(buffer));
+
+    return *t_buffer;
+}
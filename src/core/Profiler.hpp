@@ -0,0 +1,110 @@
+#pragma once
+#include "pch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROFILER_EVENTS_PER_THREAD (1 << 18)  // Preallocated per thread, later events are dropped
+
+// Records timed scopes into per-thread buffers and dumps them in the Chrome trace event
+// format (chrome://tracing, Perfetto). Recording only happens between start() and
+// writeTrace(), and the PROFILE_* macros compile to nothing without PROFILING_ENABLED
+// (see premake5.lua).
+class Profiler
+{
+  public:
+    inline static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void start() noexcept;
+    void writeTrace(const std::string& path);  // Also stops recording
+
+    // Name shown for the calling thread in the trace
+    void setThreadName(const std::string& name);
+
+    inline static bool isRecording() noexcept { return s_recording.load(std::memory_order_relaxed); }
+    inline static uint64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // `name` must outlive the Profiler (string literals, __FUNCTION__)
+    void record(const char* name, uint64_t startNs, uint64_t endNs) noexcept;
+
+  private:
+    struct Event
+    {
+        const char* name;
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    // Only its thread writes to it. The count is published after the event is written,
+    // so the trace can be dumped while other threads are still running
+    struct ThreadBuffer
+    {
+        uint32_t threadID;
+        std::string threadName;
+        std::unique_ptr<Event[]> events;
+        std::atomic<size_t> count{0};
+        std::atomic<size_t> dropped{0};
+    };
+
+  private:
+    ThreadBuffer& getThreadBuffer();
+
+  private:
+    std::mutex m_mutex;  // Guards m_buffers
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    uint64_t m_startNs = 0;
+
+    static std::atomic<bool> s_recording;
+
+  private:
+    Profiler() = default;
+    Profiler(const Profiler&) = delete;
+    void operator=(const Profiler&) = delete;
+};
+
+
+// RAII timer, records its lifetime as one trace event
+class ProfileScope
+{
+  public:
+    explicit ProfileScope(const char* name) noexcept
+        : m_name(Profiler::isRecording() ? name : nullptr), m_startNs(m_name ? Profiler::now() : 0)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if (m_name)
+            Profiler::instance().record(m_name, m_startNs, Profiler::now());
+    }
+
+  private:
+    const char* m_name;
+    uint64_t m_startNs;
+
+  public:
+    ProfileScope(const ProfileScope&) = delete;
+    void operator=(const ProfileScope&) = delete;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef PROFILING_ENABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__PRETTY_FUNCTION__)
+#else
+#define PROFILE_SCOPE(name) do { } while (0)
+#define PROFILE_FUNCTION() do { } while (0)
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Logger.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define HEADLESS_DEFAULT_FRAME_COUNT 1000
+#define IDLE_WAIT_TIMEOUT 0.25  // Seconds, bounds how late a signal can be handled when idle
+
+// Runtime configuration, filled from the command line before the Application is created
+struct Settings
+{
+    bool headless = false;    // No display: no GLFW, Windows render offscreen
+    uint64_t frameCount = 0;  // Stop after this many frames, 0 = run until closed
+    double targetFps = 0.0;   // Frame limiter target, 0 = uncapped
+    bool idleWait = true;     // Block on events instead of polling when every Window is idle
+
+    // Mailbox never blocks the CPU on presentation, falls back to FIFO when unsupported
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+
+    uint32_t threadCount = 0;  // Job system threads, 0 = one per hardware thread (resolved by Application)
+
+    std::string tracePath;  // Chrome trace output of the PROFILE_* scopes, empty = don't profile
+    bool benchRecording = false;  // Run the command recording benchmark instead of the main loop
+    std::string statsPath;  // CSV of the CPU and GPU frame timings, empty = only log their percentiles
+
+    std::vector<std::string> logFiles;  // Extra sinks, written along with the console
+    bool asyncLog = false;
+    Logger::OverflowPolicy logOverflowPolicy = Logger::OverflowPolicy::BLOCK;
+
+    std::vector<std::string> mutedValidationMessages;  // Debug messenger IDs (number or name) never logged
+
+    std::string pipelineCachePath = "pipeline_cache.bin";  // Empty = don't persist the pipeline cache
+    std::string deviceCachePath = "device.cache";          // GPU picked by the last launch, empty = always scan
+    std::string gpu;                                       // Forced GPU: index or UUID, empty = best one
+
+    std::string shaderDirectory = "shaders";
+    std::string shaderCachePath = "shader_cache";  // SPIR-V of the previous runs, empty = compile every launch
+    bool shaderHotReload = true;                   // Recompile shaders when their sources change
+
+    std::vector<std::string> assetPacks;  // Loaded on the device at startup (see tools/packer)
+
+    bool dumpRenderGraph = false;  // Log the render graphs whenever they are compiled
+};
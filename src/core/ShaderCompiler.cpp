@@ -0,0 +1,340 @@
+#include "pch.hpp"
+
+#include "ShaderCompiler.hpp"
+#include "Hash.hpp"
+#include "Profiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+#define SHADER_CACHE_MAGIC 0x43535654  // "TVSC"
+#define SHADER_CACHE_VERSION 1
+
+// Debug builds keep the SPIR-V close to the source, for RenderDoc and the validation layers
+#ifdef NDEBUG
+#define SHADER_OPTIMIZATION_LEVEL shaderc_optimization_level_performance
+#else
+#define SHADER_OPTIMIZATION_LEVEL shaderc_optimization_level_zero
+#endif
+
+static const std::pair<const char*, shaderc_shader_kind> s_shaderKinds[] = {
+    {".vert", shaderc_vertex_shader},
+    {".frag", shaderc_fragment_shader},
+    {".comp", shaderc_compute_shader},
+    {".geom", shaderc_geometry_shader},
+    {".tesc", shaderc_tess_control_shader},
+    {".tese", shaderc_tess_evaluation_shader}};
+
+// Owned by shaderc between resolveInclude and releaseInclude
+struct IncludeData
+{
+    shaderc_include_result result;
+    std::string name;
+    std::string content;
+};
+
+
+static bool readFile(const std::string& path, std::string& content)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    content = stream.str();
+    return true;
+}
+
+
+// Extension of the stage, before a trailing .hlsl
+static bool getShaderKind(const std::string& path, shaderc_shader_kind& kind, bool& hlsl)
+{
+    std::filesystem::path file(path);
+    hlsl = file.extension() == ".hlsl";
+    std::string stage = hlsl ? file.stem().extension().string() : file.extension().string();
+
+    for (auto& [extension, shaderKind] : s_shaderKinds) {
+        if (stage == extension) {
+            kind = shaderKind;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+ShaderCompiler::ShaderCompiler(const std::string& includeDirectory, const std::string& cachePath)
+    : m_includeDirectory(includeDirectory), m_cachePath(cachePath)
+{
+    m_compiler = shaderc_compiler_initialize();
+    if (!m_compiler)
+        throw Exception("Failed to initialize the shader compiler");
+
+    if (!m_cachePath.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(m_cachePath, error);
+
+        if (error) {
+            LOG_WARN("Could not create shader cache directory \"{}\" ({}), shaders won't be cached", m_cachePath, error.message());
+            m_cachePath.clear();
+        }
+    }
+
+    LOG_TRACE("Initialized shader compiler (cache: \"{}\")", m_cachePath);
+}
+
+
+ShaderCompiler::~ShaderCompiler()
+{
+    shaderc_compiler_release(m_compiler);
+}
+
+// public
+
+ShaderCompiler::Result ShaderCompiler::compile(const std::string& path, const std::vector<std::string>& defines) const
+{
+    PROFILE_FUNCTION();
+
+    shaderc_shader_kind kind;
+    bool hlsl;
+    if (!getShaderKind(path, kind, hlsl))
+        throw Exception("Unknown shader stage for \"" + path + "\"");
+
+    std::string source;
+    if (!readFile(path, source))
+        throw Exception("Could not read shader \"" + path + "\"");
+
+    Result result;
+    result.kind = kind;
+    uint64_t key = makeKey(path, source, defines);
+
+    if (loadFromCache(key, result)) {
+        LOG_TRACE("Loaded shader \"{}\" from the cache ({:016x})", path, key);
+        return result;
+    }
+
+    IncludeContext context = {&m_includeDirectory, {}};
+
+    shaderc_compile_options_t options = shaderc_compile_options_initialize();
+    shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_0);
+    shaderc_compile_options_set_source_language(options, hlsl ? shaderc_source_language_hlsl : shaderc_source_language_glsl);
+    shaderc_compile_options_set_optimization_level(options, SHADER_OPTIMIZATION_LEVEL);
+#ifndef NDEBUG
+    shaderc_compile_options_set_generate_debug_info(options);
+#endif
+    shaderc_compile_options_set_include_callbacks(options, resolveInclude, releaseInclude, &context);
+
+    for (auto& define : defines) {
+        size_t equal = std::min(define.find('='), define.size());
+        const char* value = equal < define.size() ? define.c_str() + equal + 1 : nullptr;
+        shaderc_compile_options_add_macro_definition(options, define.c_str(), equal, value, value ? define.size() - equal - 1 : 0);
+    }
+
+    shaderc_compilation_result_t compilation = shaderc_compile_into_spv(m_compiler, source.data(), source.size(), kind, path.c_str(), "main", options);
+    shaderc_compile_options_release(options);
+
+    bool success = shaderc_result_get_compilation_status(compilation) == shaderc_compilation_status_success;
+    if (success) {
+        auto bytes = shaderc_result_get_bytes(compilation);
+        result.spirv.resize(shaderc_result_get_length(compilation) / sizeof(uint32_t));
+        std::memcpy(result.spirv.data(), bytes, result.spirv.size() * sizeof(uint32_t));
+    }
+
+    std::string error = success ? "" : shaderc_result_get_error_message(compilation);
+    shaderc_result_release(compilation);
+
+    if (!success)
+        throw Exception("Failed to compile shader \"" + path + "\"\n" + error);
+
+    for (auto& include : context.includes)
+        result.includes.push_back(include.path);
+
+    try {
+        saveToCache(key, context.includes, result.spirv);
+    } catch (const Exception& ex) {
+        LOG_WARN("Could not cache shader \"{}\"\n{}", path, ex.what());
+    }
+
+    LOG_DEBUG("Compiled shader \"{}\" ({} bytes of SPIR-V)", path, result.spirv.size() * sizeof(uint32_t));
+    return result;
+}
+
+
+bool ShaderCompiler::isShaderFile(const std::string& path)
+{
+    shaderc_shader_kind kind;
+    bool hlsl;
+    return getShaderKind(path, kind, hlsl);
+}
+
+// private
+
+uint64_t ShaderCompiler::makeKey(const std::string& path, const std::string& source, const std::vector<std::string>& defines) const
+{
+    // A set: the same defines in another order are the same shader
+    std::vector<const std::string*> sortedDefines;
+    for (auto& define : defines)
+        sortedDefines.push_back(&define);
+    std::sort(sortedDefines.begin(), sortedDefines.end(), [](auto a, auto b) { return *a < *b; });
+
+    // Strings are hashed with their terminator, {"AB", "C"} and {"A", "BC"} differ
+    uint64_t hash = hashBytes(path.c_str(), path.size() + 1);
+    hash = hashBytes(source.c_str(), source.size() + 1, hash);
+    for (auto define : sortedDefines)
+        hash = hashBytes(define->c_str(), define->size() + 1, hash);
+
+    int optimizationLevel = SHADER_OPTIMIZATION_LEVEL;
+    return hashValue(optimizationLevel, hash);
+}
+
+
+bool ShaderCompiler::loadFromCache(uint64_t key, Result& result) const
+{
+    if (m_cachePath.empty()) return false;
+
+    std::string data;
+    if (!readFile(getCacheFilePath(key), data)) return false;
+
+    // Anything out of place is a stale or corrupt entry, it gets recompiled and overwritten
+    size_t offset = 0;
+    auto read = [&](void* out, size_t size) {
+        if (data.size() - offset < size) return false;
+        std::memcpy(out, data.data() + offset, size);
+        offset += size;
+        return true;
+    };
+
+    CacheHeader header;
+    if (!read(&header, sizeof(header)) || header.magic != SHADER_CACHE_MAGIC || header.version != SHADER_CACHE_VERSION
+        || header.key != key || header.includeCount > data.size() || header.spirvSize > data.size() / sizeof(uint32_t))
+        return false;
+
+    std::vector<std::string> includes(header.includeCount);
+    for (auto& include : includes) {
+        uint32_t length;
+        uint64_t contentHash;
+        if (!read(&length, sizeof(length)) || length > data.size()) return false;
+
+        include.resize(length);
+        if (!read(include.data(), length) || !read(&contentHash, sizeof(contentHash))) return false;
+
+        std::string content;
+        if (!readFile(include, content) || hashBytes(content.data(), content.size()) != contentHash) {
+            LOG_TRACE("Shader cache entry {:016x} is stale, \"{}\" changed", key, include);
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> spirv(header.spirvSize);
+    if (!read(spirv.data(), spirv.size() * sizeof(uint32_t)) || offset != data.size()
+        || hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t)) != header.spirvChecksum)
+        return false;
+
+    result.spirv = std::move(spirv);
+    result.includes = std::move(includes);
+    result.fromCache = true;
+    return true;
+}
+
+
+void ShaderCompiler::saveToCache(uint64_t key, const std::vector<Include>& includes, const std::vector<uint32_t>& spirv) const
+{
+    if (m_cachePath.empty()) return;
+
+    CacheHeader header = {};
+    header.magic = SHADER_CACHE_MAGIC;
+    header.version = SHADER_CACHE_VERSION;
+    header.key = key;
+    header.includeCount = static_cast<uint32_t>(includes.size());
+    header.spirvSize = static_cast<uint32_t>(spirv.size());
+    header.spirvChecksum = hashBytes(spirv.data(), spirv.size() * sizeof(uint32_t));
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (auto& include : includes) {
+        uint32_t length = static_cast<uint32_t>(include.path.size());
+        data.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        data.append(include.path);
+        data.append(reinterpret_cast<const char*>(&include.contentHash), sizeof(include.contentHash));
+    }
+    data.append(reinterpret_cast<const char*>(spirv.data()), spirv.size() * sizeof(uint32_t));
+
+    // Write aside then rename, like the pipeline cache. The temporary name is per thread,
+    // two threads may compile the same shader
+    std::string path = getCacheFilePath(key);
+    std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw Exception("Could not open \"" + tmpPath + "\": " + std::strerror(errno));
+
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t result = write(fd, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        written += result;
+    }
+
+    bool ok = close(fd) == 0 && written == data.size();
+
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::string error = std::strerror(errno);
+        unlink(tmpPath.c_str());
+        throw Exception("Could not write \"" + path + "\": " + error);
+    }
+}
+
+
+std::string ShaderCompiler::getCacheFilePath(uint64_t key) const
+{
+    return fmt::format("{}/{:016x}.spv", m_cachePath, key);
+}
+
+
+shaderc_include_result* ShaderCompiler::resolveInclude(
+    void* userData,
+    const char* requestedSource,
+    int type,
+    const char* requestingSource,
+    size_t includeDepth)
+{
+    auto context = static_cast<IncludeContext*>(userData);
+    auto data = new IncludeData;
+
+    // "file" next to the including file first, <file> and unresolved "file" from the include directory
+    std::filesystem::path relative = std::filesystem::path(requestingSource).parent_path() / requestedSource;
+    std::filesystem::path path = type == shaderc_include_type_relative && std::filesystem::exists(relative)
+                                     ? relative
+                                     : std::filesystem::path(*context->includeDirectory) / requestedSource;
+    data->name = path.lexically_normal().string();
+
+    if (readFile(data->name, data->content)) {
+        uint64_t contentHash = hashBytes(data->content.data(), data->content.size());
+        auto sameFile = [&](const Include& include) { return include.path == data->name; };
+
+        if (std::find_if(context->includes.begin(), context->includes.end(), sameFile) == context->includes.end())
+            context->includes.push_back({data->name, contentHash});
+
+    } else {
+        // An empty name tells shaderc the include failed, the content is the error message
+        data->content = "Cannot open include file \"" + data->name + "\"";
+        data->name.clear();
+    }
+
+    data->result = {data->name.data(), data->name.size(), data->content.data(), data->content.size(), data};
+    return &data->result;
+}
+
+
+void ShaderCompiler::releaseInclude(void* userData, shaderc_include_result* includeResult)
+{
+    delete static_cast<IncludeData*>(includeResult->user_data);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <shaderc/shaderc.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GLSL or HLSL to SPIR-V through libshaderc, with a disk cache.
+// The stage comes from the extension (.vert, .frag, .comp, .geom, .tesc, .tese), HLSL sources
+// add .hlsl after it (tonemap.frag.hlsl). Cache entries are named after a hash of the path,
+// the source, the define set and the compile options. They also list every included file with
+// a hash of its content, an entry is only reused while all of them are unchanged.
+// Thread safe, compilations run concurrently.
+class ShaderCompiler
+{
+  public:
+    struct Result
+    {
+        std::vector<uint32_t> spirv;
+        shaderc_shader_kind kind;
+        std::vector<std::string> includes;  // Files pulled in by #include, a change to them needs a recompile
+        bool fromCache = false;
+    };
+
+  public:
+    // #include <...> is resolved from `includeDirectory`. An empty `cachePath` compiles every time
+    ShaderCompiler(const std::string& includeDirectory, const std::string& cachePath);
+    ~ShaderCompiler();
+
+    // `defines` are NAME or NAME=VALUE, their order doesn't matter.
+    // Throws with the compiler's messages when the shader doesn't compile
+    Result compile(const std::string& path, const std::vector<std::string>& defines) const;
+
+    static bool isShaderFile(const std::string& path);
+
+  private:
+    struct CacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t includeCount;  // Each one: uint32_t path length, the path, uint64_t content hash
+        uint32_t spirvSize;     // In words, after the includes
+        uint64_t spirvChecksum;
+    };
+
+    struct Include
+    {
+        std::string path;
+        uint64_t contentHash;
+    };
+
+    // Handed to the include callbacks of one compilation
+    struct IncludeContext
+    {
+        const std::string* includeDirectory;
+        std::vector<Include> includes;
+    };
+
+  private:
+    uint64_t makeKey(const std::string& path, const std::string& source, const std::vector<std::string>& defines) const;
+    bool loadFromCache(uint64_t key, Result& result) const;
+    void saveToCache(uint64_t key, const std::vector<Include>& includes, const std::vector<uint32_t>& spirv) const;
+    std::string getCacheFilePath(uint64_t key) const;
+
+    static shaderc_include_result* resolveInclude(void* userData, const char* requestedSource, int type, const char* requestingSource, size_t includeDepth);
+    static void releaseInclude(void* userData, shaderc_include_result* includeResult);
+
+  private:
+    shaderc_compiler_t m_compiler = nullptr;
+    std::string m_includeDirectory;
+    std::string m_cachePath;
+
+  public:
+    ShaderCompiler(const ShaderCompiler&) = delete;
+    void operator=(const ShaderCompiler&) = delete;
+};
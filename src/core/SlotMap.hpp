@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define NULL_SLOT_HANDLE 0ull  // Never returned by SlotMap::insert
+
+// Container of objects referred to by generational handles.
+// Values are stored contiguously and iterate like a vector, in no particular order. A handle
+// is a slot index and the generation of the slot when it was inserted: erasing bumps the
+// generation, so a stale handle is detected instead of reaching whatever reuses the slot.
+// Lookup, insertion and erasure are O(1), and only allocate when the map outgrows its
+// capacity (see reserve()).
+template <typename T>
+class SlotMap
+{
+  public:
+    using Handle = uint64_t;  // Generation in the high 32 bits, slot index in the low ones
+
+  public:
+    SlotMap() = default;
+
+    void reserve(size_t capacity)
+    {
+        m_values.reserve(capacity);
+        m_valueSlots.reserve(capacity);
+        m_slots.reserve(capacity);
+    }
+
+    Handle insert(T value)
+    {
+        uint32_t slotIndex;
+        if (m_freeHead != NO_SLOT) {
+            slotIndex = m_freeHead;
+            m_freeHead = m_slots[slotIndex].index;
+        } else {
+            slotIndex = static_cast<uint32_t>(m_slots.size());
+            m_slots.push_back({0, 1});  // Generation 0 would make a null handle
+        }
+
+        auto& slot = m_slots[slotIndex];
+        slot.index = static_cast<uint32_t>(m_values.size());
+        m_values.push_back(std::move(value));
+        m_valueSlots.push_back(slotIndex);
+
+        return makeHandle(slotIndex, slot.generation);
+    }
+
+    // False if `handle` was already erased
+    bool erase(Handle handle)
+    {
+        uint32_t slotIndex = getSlotIndex(handle);
+        if (!contains(handle)) return false;
+
+        // Fill the hole with the last value, so values stay contiguous
+        auto& slot = m_slots[slotIndex];
+        uint32_t last = static_cast<uint32_t>(m_values.size() - 1);
+        if (slot.index != last) {
+            m_values[slot.index] = std::move(m_values[last]);
+            m_valueSlots[slot.index] = m_valueSlots[last];
+            m_slots[m_valueSlots[last]].index = slot.index;
+        }
+
+        m_values.pop_back();
+        m_valueSlots.pop_back();
+
+        // Invalidates every handle to the slot. A slot whose generation wraps around is
+        // retired rather than risk handing out a handle equal to an old one
+        if (++slot.generation != 0) {
+            slot.index = m_freeHead;
+            m_freeHead = slotIndex;
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        while (!m_values.empty())
+            erase(getHandle(m_values.size() - 1));
+    }
+
+    inline bool contains(Handle handle) const noexcept
+    {
+        uint32_t slotIndex = getSlotIndex(handle);
+        return slotIndex < m_slots.size() && m_slots[slotIndex].generation == getGeneration(handle)
+               && getGeneration(handle) != 0;
+    }
+
+    // nullptr for stale handles
+    T* get(Handle handle) noexcept
+    {
+        return contains(handle) ? &m_values[m_slots[getSlotIndex(handle)].index] : nullptr;
+    }
+
+    const T* get(Handle handle) const noexcept
+    {
+        return contains(handle) ? &m_values[m_slots[getSlotIndex(handle)].index] : nullptr;
+    }
+
+    // Handle of the value at `position` in iteration order
+    inline Handle getHandle(size_t position) const noexcept
+    {
+        uint32_t slotIndex = m_valueSlots[position];
+        return makeHandle(slotIndex, m_slots[slotIndex].generation);
+    }
+
+    inline size_t size() const noexcept { return m_values.size(); }
+    inline bool empty() const noexcept { return m_values.empty(); }
+
+    inline T& operator[](size_t position) noexcept { return m_values[position]; }
+    inline const T& operator[](size_t position) const noexcept { return m_values[position]; }
+
+    inline auto begin() noexcept { return m_values.begin(); }
+    inline auto end() noexcept { return m_values.end(); }
+    inline auto begin() const noexcept { return m_values.begin(); }
+    inline auto end() const noexcept { return m_values.end(); }
+
+  private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Slot
+    {
+        uint32_t index;  // Of the value when used, of the next free slot otherwise
+        uint32_t generation;
+    };
+
+  private:
+    static inline Handle makeHandle(uint32_t slotIndex, uint32_t generation) noexcept
+    {
+        return (static_cast<Handle>(generation) << 32) | slotIndex;
+    }
+
+    static inline uint32_t getSlotIndex(Handle handle) noexcept { return static_cast<uint32_t>(handle); }
+    static inline uint32_t getGeneration(Handle handle) noexcept { return static_cast<uint32_t>(handle >> 32); }
+
+  private:
+    std::vector<T> m_values;
+    std::vector<uint32_t> m_valueSlots;  // Slot of every value, to fix it up when the value moves
+    std::vector<Slot> m_slots;
+    uint32_t m_freeHead = NO_SLOT;
+};
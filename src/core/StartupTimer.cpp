@@ -0,0 +1,49 @@
+#include "pch.hpp"
+
+#include "Logger.hpp"
+#include "StartupTimer.hpp"
+
+StartupTimer::StartupTimer()
+    : m_start(Clock::now()), m_lastMark(m_start)
+{
+}
+
+// public
+
+void StartupTimer::mark(const std::string& phase)
+{
+    auto now = Clock::now();
+    m_phases.push_back({phase, std::chrono::duration<double, std::milli>(now - m_lastMark).count(), false});
+    m_lastMark = now;
+}
+
+
+void StartupTimer::addBackground(const std::string& phase, double milliseconds, double waited)
+{
+    m_phases.push_back({phase, milliseconds, true});
+    m_overlapped += std::max(milliseconds - waited, 0.0);
+}
+
+
+void StartupTimer::report() noexcept
+{
+    if (m_reported)
+        return;
+
+    m_reported = true;
+
+    try {
+        std::string breakdown;
+        for (auto& phase : m_phases)
+            breakdown += fmt::format("\n  {:<24}{:>9.1f} ms{}", phase.name, phase.milliseconds, phase.background ? " (background)" : "");
+
+        LOG_INFO(
+            "Startup took {:.1f} ms, {:.1f} ms of background work overlapped:{}",
+            std::chrono::duration<double, std::milli>(m_lastMark - m_start).count(),
+            m_overlapped,
+            breakdown);
+
+    } catch (const std::exception& ex) {
+        LOG_ERROR("Failed to report the startup times: {}", ex.what());
+    }
+}
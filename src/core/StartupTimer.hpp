@@ -0,0 +1,42 @@
+#pragma once
+#include "pch.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Wall clock breakdown of the startup, from the Application constructor to the first frame.
+// Main thread phases are back to back, each ends with mark(). Phases run on another thread
+// overlap them and are added once joined: the time they saved is theirs minus the time the
+// main thread spent waiting for them.
+class StartupTimer
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    StartupTimer();  // Starts the clock
+
+    // Ends the main thread phase started by the previous mark()
+    void mark(const std::string& phase);
+    // A phase measured on another thread, `waited` is how long the main thread blocked on it
+    void addBackground(const std::string& phase, double milliseconds, double waited);
+
+    // Logs the breakdown once, at info level
+    void report() noexcept;
+    inline bool isReported() const noexcept { return m_reported; }
+
+  private:
+    struct Phase
+    {
+        std::string name;
+        double milliseconds;
+        bool background;
+    };
+
+  private:
+    Clock::time_point m_start;
+    Clock::time_point m_lastMark;
+    std::vector<Phase> m_phases;
+    double m_overlapped = 0.0;  // Background time the main thread didn't wait for
+    bool m_reported = false;
+};
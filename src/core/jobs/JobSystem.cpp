@@ -0,0 +1,422 @@
+#include "pch.hpp"
+
+#include "JobSystem.hpp"
+#include "core/Profiler.hpp"
+
+#define JOB_CACHE_SIZE 256  // Finished jobs kept per thread for reuse
+#define JOB_POOL_RESERVED_SIZE (4 * JOB_CACHE_SIZE)  // Returning jobs to the pool doesn't allocate below this
+
+struct Job
+{
+    JobSystem::JobFunction function;
+    JobCounter* counter;
+    uint32_t allocatingThread;  // Its cache gets the job back, through the pool if stolen
+};
+
+// Jobs are recycled by the thread that ran them, so steady state submission doesn't allocate
+struct JobCache
+{
+    std::vector<Job*> jobs;
+
+    JobCache() { jobs.reserve(JOB_CACHE_SIZE); }
+    ~JobCache()
+    {
+        for (auto job : jobs)
+            delete job;
+    }
+};
+
+// Stolen jobs are released by the thief, they go back to the pool so the thread that allocates
+// them gets them back instead of allocating forever. Full caches spill over here too
+struct JobPool
+{
+    std::mutex mutex;
+    std::vector<Job*> jobs;
+
+    JobPool() { jobs.reserve(JOB_POOL_RESERVED_SIZE); }
+    ~JobPool()
+    {
+        for (auto job : jobs)
+            delete job;
+    }
+};
+
+static thread_local JobCache t_jobCache;
+static JobPool s_jobPool;
+
+thread_local uint32_t JobSystem::s_threadIndex = NOT_A_WORKER;
+
+
+JobSystem::JobSystem(uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t i = 0; i < threadCount; i++)
+        m_queues.push_back(std::make_unique<Queue>());
+
+    // The calling thread is worker 0, it runs jobs while it waits
+    s_threadIndex = 0;
+
+    for (uint32_t i = 1; i < threadCount; i++)
+        m_threads.emplace_back(&JobSystem::workerLoop, this, i);
+
+    LOG_TRACE("Initialized job system ({} threads)", threadCount);
+}
+
+
+JobSystem::~JobSystem()
+{
+    LOG_TRACE("Destroying job system");
+
+    {
+        std::lock_guard lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+
+    uint32_t dropped = 0;
+    while (Job* job = findJob()) {
+        releaseJob(job);
+        dropped++;
+    }
+
+    for (auto job : m_backgroundQueue) {
+        releaseJob(job);
+        dropped++;
+    }
+
+    if (dropped > 0)
+        LOG_WARN("{} jobs were still queued when the job system stopped", dropped);
+
+    s_threadIndex = NOT_A_WORKER;
+}
+
+// public
+
+void JobSystem::run(JobFunction function, JobCounter* counter, JobCounter* dependency)
+{
+    Job* job = allocateJob();
+    job->function = std::move(function);
+    job->counter = counter;
+
+    if (counter)
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+    if (dependency) {
+        std::lock_guard lock(dependency->m_mutex);
+
+        // Scheduled by the last job of the dependency (see execute)
+        if (dependency->m_value.load(std::memory_order_acquire) > 0) {
+            dependency->m_dependents.push_back(job);
+            return;
+        }
+    }
+
+    schedule(job);
+}
+
+
+void JobSystem::runBackground(JobFunction function, JobCounter* counter)
+{
+    // No other worker would ever pick it up
+    if (m_threads.empty()) {
+        try {
+            function();
+        } catch (const std::exception& ex) {
+            LOG_ERROR("Uncaught exception in job: {}", ex.what());
+        }
+        return;
+    }
+
+    Job* job = allocateJob();
+    job->function = std::move(function);
+    job->counter = counter;
+
+    if (counter)
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard lock(m_backgroundMutex);
+        m_backgroundQueue.push_back(job);
+    }
+
+    // Counted before the wake up, so a worker about to sleep can't miss it (see workerLoop)
+    m_backgroundJobs.fetch_add(1);
+
+    if (m_sleepingWorkers.load() > 0) {
+        std::lock_guard lock(m_sleepMutex);
+        m_wakeCondition.notify_one();
+    }
+}
+
+
+void JobSystem::wait(JobCounter& counter)
+{
+    while (counter.m_value.load(std::memory_order_acquire) > 0) {
+        if (Job* job = findJob())
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last job may still hold the lock, the counter can't go away before it is done
+    std::lock_guard lock(counter.m_mutex);
+}
+
+
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grainSize, const RangeFunction& function)
+{
+    if (begin >= end) return;
+
+    size_t count = end - begin;
+    if (grainSize == 0)
+        grainSize = std::max<size_t>(1, count / (getThreadCount() * 4));
+
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount == 1) {
+        function(begin, end);
+        return;
+    }
+
+    // Captured by reference, so each job fits in std::function's inline storage
+    struct Range
+    {
+        size_t begin, end, grainSize;
+        const RangeFunction& function;
+    } range = {begin, end, grainSize, function};
+
+    JobCounter counter;
+    for (size_t chunk = 1; chunk < chunkCount; chunk++) {
+        run([&range, chunk] {
+            size_t chunkBegin = range.begin + chunk * range.grainSize;
+            range.function(chunkBegin, std::min(chunkBegin + range.grainSize, range.end));
+        }, &counter);
+    }
+
+    // First chunk on this thread, the others get stolen in the meantime. The jobs point to
+    // `range` and `counter`, so they must all be done before an exception leaves
+    std::exception_ptr error;
+    try {
+        function(begin, std::min(begin + grainSize, end));
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    wait(counter);
+
+    if (!error)
+        error = counter.m_error;
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// private
+
+void JobSystem::workerLoop(uint32_t index)
+{
+    s_threadIndex = index;
+
+    if (Profiler::isRecording())
+        Profiler::instance().setThreadName("Worker " + std::to_string(index));
+
+    uint32_t failedSearches = 0;
+
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (Job* job = findJob()) {
+            execute(job);
+            failedSearches = 0;
+            continue;
+        }
+
+        // Only idle workers get there, and they look for regular jobs again right after
+        if (Job* job = findBackgroundJob()) {
+            execute(job);
+            failedSearches = 0;
+            continue;
+        }
+
+        // Work often comes in bursts, spin a little before paying for a sleep and a wake up
+        if (++failedSearches < JOB_SPIN_COUNT) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        failedSearches = 0;
+
+        std::unique_lock lock(m_sleepMutex);
+        m_sleepingWorkers.fetch_add(1);
+        m_wakeCondition.wait(lock, [&] { return m_queuedJobs.load() > 0 || m_backgroundJobs.load() > 0 || m_stopping.load(); });
+        m_sleepingWorkers.fetch_sub(1);
+    }
+}
+
+
+void JobSystem::schedule(Job* job)
+{
+    // Counted before it is visible, so a worker about to sleep can't miss it (see workerLoop)
+    m_queuedJobs.fetch_add(1);
+
+    uint32_t index = s_threadIndex;
+    if (index < m_queues.size()) {
+        if (!m_queues[index]->push(job)) {
+            m_queuedJobs.fetch_sub(1);
+            execute(job);
+            return;
+        }
+
+    } else {
+        std::lock_guard lock(m_sharedMutex);
+        m_sharedQueue.push_back(job);
+        m_sharedJobs.fetch_add(1, std::memory_order_release);
+    }
+
+    if (m_sleepingWorkers.load() > 0) {
+        std::lock_guard lock(m_sleepMutex);
+        m_wakeCondition.notify_one();
+    }
+}
+
+
+Job* JobSystem::findJob() noexcept
+{
+    // Cheap exit for idle workers, nothing below would succeed
+    if (m_queuedJobs.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+
+    uint32_t index = s_threadIndex;
+    uint32_t queueCount = static_cast<uint32_t>(m_queues.size());
+    Job* job = nullptr;
+
+    if (index < queueCount)
+        job = m_queues[index]->pop();
+
+    if (!job && m_sharedJobs.load(std::memory_order_acquire) > 0) {
+        std::lock_guard lock(m_sharedMutex);
+        if (!m_sharedQueue.empty()) {
+            job = m_sharedQueue.front();
+            m_sharedQueue.pop_front();
+            m_sharedJobs.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Start with the next worker, so thieves spread over the victims
+    for (uint32_t i = 1; !job && i <= queueCount; i++) {
+        uint32_t victim = (index + i) % queueCount;
+        if (victim != index)
+            job = m_queues[victim]->steal();
+    }
+
+    if (job)
+        m_queuedJobs.fetch_sub(1);
+
+    return job;
+}
+
+
+Job* JobSystem::findBackgroundJob() noexcept
+{
+    if (m_backgroundJobs.load(std::memory_order_relaxed) == 0)
+        return nullptr;
+
+    std::lock_guard lock(m_backgroundMutex);
+    if (m_backgroundQueue.empty())
+        return nullptr;  // Counted but not pushed yet, or taken by another worker
+
+    Job* job = m_backgroundQueue.front();
+    m_backgroundQueue.pop_front();
+    m_backgroundJobs.fetch_sub(1);
+    return job;
+}
+
+
+void JobSystem::execute(Job* job)
+{
+    JobCounter* counter = job->counter;
+
+    // Stored before the counter is released, for the thread waiting on it
+    auto storeError = [counter] {
+        std::lock_guard lock(counter->m_mutex);
+        if (!counter->m_error)
+            counter->m_error = std::current_exception();
+    };
+
+    try {
+        job->function();
+    } catch (const std::exception& ex) {
+        if (counter)
+            storeError();
+        else
+            LOG_ERROR("Uncaught exception in job: {}", ex.what());
+    } catch (...) {
+        // Not an std::exception, the job still has to complete or its waiters hang
+        if (counter)
+            storeError();
+        else
+            LOG_ERROR("Uncaught exception in job (not an std::exception)");
+    }
+
+    releaseJob(job);
+
+    if (!counter) return;
+
+    // Under the lock, so run() can't add a dependent the last job would miss
+    std::vector<Job*> dependents;
+    {
+        std::lock_guard lock(counter->m_mutex);
+        if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            dependents.swap(counter->m_dependents);
+    }
+
+    for (auto dependent : dependents)
+        schedule(dependent);
+}
+
+
+Job* JobSystem::allocateJob()
+{
+    auto& jobs = t_jobCache.jobs;
+    if (jobs.empty()) {
+        std::lock_guard lock(s_jobPool.mutex);
+
+        size_t count = std::min<size_t>(s_jobPool.jobs.size(), JOB_CACHE_SIZE / 2);
+        jobs.insert(jobs.end(), s_jobPool.jobs.end() - count, s_jobPool.jobs.end());
+        s_jobPool.jobs.resize(s_jobPool.jobs.size() - count);
+    }
+
+    Job* job;
+    if (jobs.empty()) {
+        job = new Job();
+    } else {
+        job = jobs.back();
+        jobs.pop_back();
+    }
+
+    job->allocatingThread = s_threadIndex;
+    return job;
+}
+
+
+void JobSystem::releaseJob(Job* job) noexcept
+{
+    job->function = nullptr;  // Release the captures now
+
+    if (job->allocatingThread != s_threadIndex) {
+        std::lock_guard lock(s_jobPool.mutex);
+        s_jobPool.jobs.push_back(job);
+        return;
+    }
+
+    auto& jobs = t_jobCache.jobs;
+    if (jobs.size() >= JOB_CACHE_SIZE) {
+        std::lock_guard lock(s_jobPool.mutex);
+
+        s_jobPool.jobs.insert(s_jobPool.jobs.end(), jobs.end() - JOB_CACHE_SIZE / 2, jobs.end());
+        jobs.resize(jobs.size() - JOB_CACHE_SIZE / 2);
+    }
+
+    jobs.push_back(job);
+}
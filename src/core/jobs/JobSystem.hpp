@@ -0,0 +1,121 @@
+#pragma once
+
+#include "WorkStealingQueue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_QUEUE_CAPACITY 4096  // Per worker, a full queue runs the job inline
+#define JOB_SPIN_COUNT 64  // Failed job searches before a worker goes to sleep
+#define NOT_A_WORKER UINT32_MAX
+
+struct Job;  // Defined in JobSystem.cpp
+
+// Counts unfinished jobs. Jobs can be made to wait for a counter to reach zero before they
+// are scheduled (see JobSystem::run), and any thread can wait on it with JobSystem::wait.
+// Keeps the first exception thrown by its jobs, rethrown by JobSystem::parallelFor
+class JobCounter
+{
+  public:
+    JobCounter() = default;
+
+    inline bool isDone() const noexcept { return m_value.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> m_value{0};
+    std::mutex m_mutex;  // Guards m_dependents and m_error
+    std::vector<Job*> m_dependents;
+    std::exception_ptr m_error;
+
+  public:
+    JobCounter(const JobCounter&) = delete;
+    void operator=(const JobCounter&) = delete;
+};
+
+
+// Work-stealing thread pool.
+// Every worker owns a deque: jobs it submits go to its bottom and are popped back LIFO (hot in
+// cache), idle workers steal from the top of the others. The thread creating the JobSystem is
+// worker 0 and takes part whenever it waits. Other threads go through a shared queue.
+// Background jobs (long ones, like pipeline compilations) have their own FIFO queue, only taken
+// by workers with nothing else to do, never by a waiting thread, so they can't stall a frame.
+// Only one JobSystem may exist at a time.
+class JobSystem
+{
+  public:
+    using JobFunction = std::function<void()>;
+    using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+  public:
+    // 0 threads = one per hardware thread, the calling thread included
+    explicit JobSystem(uint32_t threadCount = 0);
+    ~JobSystem();  // Jobs still queued are dropped, wait for them first
+
+    // Increments `counter` until the job has run. With a `dependency`, the job is only
+    // scheduled once that counter reaches zero
+    void run(JobFunction function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+    // Runs `function` on a worker other than the main thread once the other jobs are done.
+    // Inline when the main thread is the only worker
+    void runBackground(JobFunction function, JobCounter* counter = nullptr);
+
+    // Runs queued jobs (not background ones) until `counter` reaches zero
+    void wait(JobCounter& counter);
+
+    // Calls `function` on [begin, end) split in chunks of `grainSize` (0 = automatic) across
+    // the workers, and returns once they are all done. Rethrows the first exception of a chunk,
+    // after every chunk is done
+    void parallelFor(size_t begin, size_t end, size_t grainSize, const RangeFunction& function);
+
+    inline uint32_t getThreadCount() const noexcept { return static_cast<uint32_t>(m_queues.size()); }
+
+    // [0, getThreadCount()) on worker threads, NOT_A_WORKER anywhere else
+    inline static uint32_t getThreadIndex() noexcept { return s_threadIndex; }
+
+  private:
+    using Queue = WorkStealingQueue<Job, JOB_QUEUE_CAPACITY>;
+
+  private:
+    void workerLoop(uint32_t index);
+
+    void schedule(Job* job);
+    Job* findJob() noexcept;
+    Job* findBackgroundJob() noexcept;
+    void execute(Job* job);
+
+    static Job* allocateJob();
+    static void releaseJob(Job* job) noexcept;
+
+  private:
+    std::vector<std::unique_ptr<Queue>> m_queues;  // One per worker, the main thread's first
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_sharedMutex;  // Guards m_sharedQueue
+    std::deque<Job*> m_sharedQueue;  // Jobs submitted from outside the workers
+    std::atomic<uint32_t> m_sharedJobs{0};  // Its size, readable without the lock
+
+    std::mutex m_backgroundMutex;  // Guards m_backgroundQueue
+    std::deque<Job*> m_backgroundQueue;
+    std::atomic<uint32_t> m_backgroundJobs{0};  // Its size, readable without the lock
+
+    std::atomic<uint32_t> m_queuedJobs{0};  // Scheduled but not started yet, background jobs aside
+    std::atomic<uint32_t> m_sleepingWorkers{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<bool> m_stopping{false};
+
+    static thread_local uint32_t s_threadIndex;
+
+  public:
+    JobSystem(const JobSystem&) = delete;
+    void operator=(const JobSystem&) = delete;
+};
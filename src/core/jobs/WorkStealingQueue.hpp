@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Bounded Chase-Lev deque (Lê et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models"). The owning thread pushes and pops at the bottom, any thread steals from the top.
+// `Capacity` must be a power of two.
+template <typename T, size_t Capacity>
+class WorkStealingQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+  public:
+    WorkStealingQueue() : m_items(new std::atomic<T*>[Capacity]) {}
+
+    // Owner only, false when full
+    bool push(T* item) noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= static_cast<int64_t>(Capacity))
+            return false;
+
+        m_items[bottom & (Capacity - 1)].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only, most recently pushed item first
+    T* pop() noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = m_items[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+
+        // Last item, race the thieves for it
+        if (top == bottom) {
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    // Any thread, oldest item first. Null when empty or when another thread won the race
+    T* steal() noexcept
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return nullptr;
+
+        T* item = m_items[top & (Capacity - 1)].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return item;
+    }
+
+  private:
+    // Owner and thieves hammer different ends, keep them on different cache lines
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    std::unique_ptr<std::atomic<T*>[]> m_items;
+
+  public:
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    void operator=(const WorkStealingQueue&) = delete;
+};
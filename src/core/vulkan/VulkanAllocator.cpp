@@ -0,0 +1,545 @@
+#include "pch.hpp"
+
+#include "VulkanAllocator.hpp"
+
+#include <bitset>
+
+#define ALLOCATOR_MIN_BLOCK_SIZE (4ull << 20)
+#define ALLOCATOR_MIN_SLOTS_PER_BLOCK 64ull
+#define ALLOCATOR_SIZE_CLASS_COUNT 16  // ALLOCATOR_MIN_SLOT_SIZE to ALLOCATOR_DEDICATED_THRESHOLD
+
+// Slots of one size class carved out of blocks of the same memory type and resource kind
+struct VulkanAllocator::Pool
+{
+    uint32_t memoryTypeIndex;
+    VkDeviceSize slotSize;
+    uint32_t slotsPerBlock;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+struct VulkanAllocator::Block
+{
+    VkDeviceMemory memory;
+    void* mappedData;
+    std::vector<uint32_t> freeSlots;  // Used as a stack, lowest slots first
+    std::vector<Allocation*> owners;  // Per slot, null when free
+    uint32_t usedSlots = 0;
+};
+
+VulkanAllocator::VulkanAllocator(
+    VkDevice device,
+    const VkPhysicalDeviceProperties& properties,
+    const VkPhysicalDeviceMemoryProperties& memoryProperties)
+    : m_device(device),
+      m_memoryProperties(memoryProperties),
+      m_maxAllocationCount(properties.limits.maxMemoryAllocationCount),
+      m_pools(VK_MAX_MEMORY_TYPES * 2 * ALLOCATOR_SIZE_CLASS_COUNT),
+      m_heapStats(memoryProperties.memoryHeapCount)
+{
+    for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+        m_heapStats[i].heapSize = m_memoryProperties.memoryHeaps[i].size;
+
+    LOG_TRACE("Initialized device memory allocator");
+}
+
+
+VulkanAllocator::~VulkanAllocator()
+{
+    LOG_TRACE("Destroying device memory allocator");
+
+    logStats();
+
+    uint32_t leaked = 0;
+    for (auto& stats : m_heapStats)
+        leaked += stats.allocationCount;
+
+    if (leaked > 0)
+        LOG_WARN("{} device memory allocations were never freed", leaked);
+
+    for (auto& pool : m_pools) {
+        if (!pool) continue;
+
+        for (auto& block : pool->blocks)
+            vkFreeMemory(m_device, block->memory, nullptr);
+    }
+}
+
+// public
+
+VulkanAllocator::Allocation* VulkanAllocator::allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceKind kind, bool dedicated)
+{
+    std::lock_guard lock(m_mutex);
+
+    VkDeviceSize slotSize = ALLOCATOR_MIN_SLOT_SIZE;
+    while (slotSize < requirements.size || slotSize < requirements.alignment)
+        slotSize <<= 1;
+
+    dedicated = dedicated || slotSize > ALLOCATOR_DEDICATED_THRESHOLD;
+
+    // Walk down the suitable memory types from the best one until one has room left
+    uint32_t typeBits = requirements.memoryTypeBits;
+    while (true) {
+        uint32_t memoryTypeIndex = findMemoryType(typeBits, usage);
+        if (memoryTypeIndex == UINT32_MAX)
+            throw Exception("Out of device memory");
+
+        Allocation* allocation = dedicated ? allocateDedicated(requirements.size, memoryTypeIndex)
+                                           : allocateFromPool(requirements.size, memoryTypeIndex, kind, slotSize);
+        if (allocation) {
+            auto& stats = m_heapStats[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+            stats.usedBytes += allocation->size;
+            stats.allocationCount++;
+            return allocation;
+        }
+
+        typeBits &= ~(1u << memoryTypeIndex);
+    }
+}
+
+
+void VulkanAllocator::free(Allocation* allocation)
+{
+    if (!allocation) return;
+
+    std::lock_guard lock(m_mutex);
+
+    auto& stats = m_heapStats[m_memoryProperties.memoryTypes[allocation->memoryTypeIndex].heapIndex];
+    stats.usedBytes -= allocation->size;
+    stats.allocationCount--;
+
+    if (!allocation->pool) {
+        stats.dedicatedCount--;
+        freeDeviceMemory(allocation->memory, allocation->size, allocation->memoryTypeIndex);
+
+    } else {
+        Block* block = allocation->block;
+        block->owners[allocation->slot] = nullptr;
+        block->freeSlots.push_back(allocation->slot);
+        block->usedSlots--;
+
+        if (block->usedSlots == 0)
+            releaseEmptyBlocks(*allocation->pool);
+    }
+
+    deleteAllocation(allocation);
+}
+
+
+VulkanAllocator::Allocation* VulkanAllocator::createBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer)
+{
+    if (vkCreateBuffer(m_device, &createInfo, nullptr, &buffer) != VK_SUCCESS)
+        throw Exception("Failed to create buffer");
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(m_device, buffer, &requirements);
+
+    Allocation* allocation = nullptr;
+    try {
+        allocation = allocate(requirements, usage, ResourceKind::LINEAR);
+
+        if (vkBindBufferMemory(m_device, buffer, allocation->memory, allocation->offset) != VK_SUCCESS)
+            throw Exception("Failed to bind buffer memory");
+
+    } catch (const Exception& ex) {
+        free(allocation);
+        vkDestroyBuffer(m_device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+
+    return allocation;
+}
+
+
+VulkanAllocator::Allocation* VulkanAllocator::createImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image)
+{
+    if (vkCreateImage(m_device, &createInfo, nullptr, &image) != VK_SUCCESS)
+        throw Exception("Failed to create image");
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_device, image, &requirements);
+
+    // Render targets are big and long lived, don't let them pin a shared block
+    bool dedicated = createInfo.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    auto kind = createInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceKind::OPTIMAL : ResourceKind::LINEAR;
+
+    Allocation* allocation = nullptr;
+    try {
+        allocation = allocate(requirements, usage, kind, dedicated);
+
+        if (vkBindImageMemory(m_device, image, allocation->memory, allocation->offset) != VK_SUCCESS)
+            throw Exception("Failed to bind image memory");
+
+    } catch (const Exception& ex) {
+        free(allocation);
+        vkDestroyImage(m_device, image, nullptr);
+        image = VK_NULL_HANDLE;
+        throw;
+    }
+
+    return allocation;
+}
+
+
+void VulkanAllocator::destroyBuffer(VkBuffer buffer, Allocation* allocation)
+{
+    vkDestroyBuffer(m_device, buffer, nullptr);
+    free(allocation);
+}
+
+
+void VulkanAllocator::destroyImage(VkImage image, Allocation* allocation)
+{
+    vkDestroyImage(m_device, image, nullptr);
+    free(allocation);
+}
+
+
+std::vector<VulkanAllocator::DefragmentationMove> VulkanAllocator::beginDefragmentation(VkDeviceSize maxBytes)
+{
+    std::lock_guard lock(m_mutex);
+
+    std::vector<DefragmentationMove> moves;
+    VkDeviceSize movedBytes = 0;
+
+    for (auto& pool : m_pools) {
+        if (!pool || pool->blocks.size() < 2) continue;
+
+        // Fill the fullest blocks with the content of the emptiest ones
+        std::stable_sort(pool->blocks.begin(), pool->blocks.end(), [](const auto& a, const auto& b) {
+            return a->usedSlots > b->usedSlots;
+        });
+
+        size_t freeSlots = 0;
+        for (auto& block : pool->blocks)
+            freeSlots += block->freeSlots.size();
+
+        size_t dst = 0;
+        for (size_t src = pool->blocks.size() - 1; src > dst; src--) {
+            Block& srcBlock = *pool->blocks[src];
+            freeSlots -= srcBlock.freeSlots.size();
+            if (srcBlock.usedSlots == 0) continue;
+
+            // Only worth it if the whole block ends up empty
+            if (freeSlots < srcBlock.usedSlots) break;
+            if (movedBytes + srcBlock.usedSlots * pool->slotSize > maxBytes) break;
+
+            for (uint32_t slot = 0; slot < pool->slotsPerBlock; slot++) {
+                Allocation* allocation = srcBlock.owners[slot];
+                if (!allocation) continue;
+
+                while (pool->blocks[dst]->freeSlots.empty())
+                    dst++;
+
+                Block& dstBlock = *pool->blocks[dst];
+                uint32_t dstSlot = dstBlock.freeSlots.back();
+                dstBlock.freeSlots.pop_back();
+                dstBlock.owners[dstSlot] = allocation;
+                dstBlock.usedSlots++;
+                freeSlots--;
+
+                moves.push_back({allocation, srcBlock.memory, allocation->offset, dstBlock.memory, dstSlot * pool->slotSize, allocation->size});
+                movedBytes += pool->slotSize;
+            }
+        }
+    }
+
+    LOG_DEBUG("Defragmentation planned {} moves ({} bytes)", moves.size(), movedBytes);
+    return moves;
+}
+
+
+void VulkanAllocator::endDefragmentation(const std::vector<DefragmentationMove>& moves)
+{
+    std::lock_guard lock(m_mutex);
+
+    for (auto& move : moves) {
+        Allocation* allocation = move.allocation;
+        Pool& pool = *allocation->pool;
+
+        Block* srcBlock = allocation->block;
+        srcBlock->owners[allocation->slot] = nullptr;
+        srcBlock->freeSlots.push_back(allocation->slot);
+        srcBlock->usedSlots--;
+
+        auto dstBlock = std::find_if(pool.blocks.begin(), pool.blocks.end(), [&](const auto& block) {
+            return block->memory == move.dstMemory;
+        });
+
+        allocation->memory = move.dstMemory;
+        allocation->offset = move.dstOffset;
+        allocation->block = dstBlock->get();
+        allocation->slot = static_cast<uint32_t>(move.dstOffset / pool.slotSize);
+        allocation->mappedData = allocation->block->mappedData ? static_cast<char*>(allocation->block->mappedData) + move.dstOffset : nullptr;
+    }
+
+    for (auto& pool : m_pools) {
+        if (pool) releaseEmptyBlocks(*pool);
+    }
+}
+
+
+std::vector<VulkanAllocator::HeapStats> VulkanAllocator::getHeapStats() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_heapStats;
+}
+
+
+void VulkanAllocator::logStats() const
+{
+    auto heapStats = getHeapStats();
+
+    for (size_t i = 0; i < heapStats.size(); i++) {
+        auto& stats = heapStats[i];
+        if (stats.reservedBytes == 0) continue;
+
+        LOG_DEBUG(
+            "Memory heap {}: {:.1f} / {:.1f} MiB used ({:.1f} MiB heap), {} allocations in {} blocks + {} dedicated",
+            i,
+            stats.usedBytes / double(1 << 20),
+            stats.reservedBytes / double(1 << 20),
+            stats.heapSize / double(1 << 20),
+            stats.allocationCount,
+            stats.blockCount,
+            stats.dedicatedCount);
+    }
+}
+
+
+uint32_t VulkanAllocator::findMemoryType(uint32_t typeBits, MemoryUsage usage) const
+{
+    VkMemoryPropertyFlags required = 0, preferred = 0, avoided = 0;
+
+    switch (usage) {
+    case MemoryUsage::GPU_ONLY:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        break;
+    case MemoryUsage::CPU_TO_GPU:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    case MemoryUsage::GPU_TO_CPU:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MemoryUsage::CPU_ONLY:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    }
+
+    // Never pick these up implicitly
+    avoided |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    VkMemoryPropertyFlags excluded = VK_MEMORY_PROPERTY_PROTECTED_BIT;
+
+    uint32_t best = UINT32_MAX;
+    int bestScore = INT32_MIN;
+
+    // Types are listed from the fastest, keep the first one among equals
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++) {
+        if (!(typeBits & (1u << i))) continue;
+
+        VkMemoryPropertyFlags flags = m_memoryProperties.memoryTypes[i].propertyFlags;
+        if ((flags & required) != required || (flags & excluded)) continue;
+
+        int score = 2 * static_cast<int>(std::bitset<32>(flags & preferred).count()) - static_cast<int>(std::bitset<32>(flags & avoided).count());
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+// private
+
+VkDeviceMemory VulkanAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData)
+{
+    if (m_deviceMemoryCount >= m_maxAllocationCount)
+        throw Exception("Reached the maximum number of device memory allocations (" + std::to_string(m_maxAllocationCount) + ")");
+
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(m_device, &allocInfo, nullptr, &memory);
+
+    // Running out is recoverable, the caller tries another memory type
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY)
+        return VK_NULL_HANDLE;
+    if (result != VK_SUCCESS)
+        throw Exception("Failed to allocate device memory");
+
+    *mappedData = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS) {
+            vkFreeMemory(m_device, memory, nullptr);
+            throw Exception("Failed to map device memory");
+        }
+    }
+
+    m_deviceMemoryCount++;
+    m_heapStats[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].reservedBytes += size;
+
+    return memory;
+}
+
+
+void VulkanAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+    // Freeing implicitly unmaps
+    vkFreeMemory(m_device, memory, nullptr);
+
+    m_deviceMemoryCount--;
+    m_heapStats[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].reservedBytes -= size;
+}
+
+
+VulkanAllocator::Allocation* VulkanAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex)
+{
+    void* mappedData = nullptr;
+    VkDeviceMemory memory = allocateDeviceMemory(size, memoryTypeIndex, &mappedData);
+    if (memory == VK_NULL_HANDLE) return nullptr;
+
+    m_heapStats[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].dedicatedCount++;
+
+    Allocation* allocation = newAllocation();
+    allocation->memory = memory;
+    allocation->size = size;
+    allocation->mappedData = mappedData;
+    allocation->memoryTypeIndex = memoryTypeIndex;
+
+    return allocation;
+}
+
+
+VulkanAllocator::Allocation* VulkanAllocator::allocateFromPool(VkDeviceSize size, uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize slotSize)
+{
+    Pool& pool = getPool(memoryTypeIndex, kind, slotSize);
+
+    // The fullest block with room left, so the others get a chance to empty out
+    Block* block = nullptr;
+    for (auto& candidate : pool.blocks) {
+        if (!candidate->freeSlots.empty() && (!block || candidate->usedSlots > block->usedSlots))
+            block = candidate.get();
+    }
+
+    if (!block) {
+        block = &addBlock(pool);
+        if (block->memory == VK_NULL_HANDLE) {
+            pool.blocks.pop_back();
+            return nullptr;
+        }
+    }
+
+    uint32_t slot = block->freeSlots.back();
+    block->freeSlots.pop_back();
+    block->usedSlots++;
+
+    Allocation* allocation = newAllocation();
+    allocation->memory = block->memory;
+    allocation->offset = slot * slotSize;
+    allocation->size = size;
+    allocation->mappedData = block->mappedData ? static_cast<char*>(block->mappedData) + allocation->offset : nullptr;
+    allocation->memoryTypeIndex = memoryTypeIndex;
+    allocation->pool = &pool;
+    allocation->block = block;
+    allocation->slot = slot;
+
+    block->owners[slot] = allocation;
+    return allocation;
+}
+
+
+VulkanAllocator::Pool& VulkanAllocator::getPool(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize slotSize)
+{
+    size_t index = (memoryTypeIndex * 2 + static_cast<size_t>(kind)) * ALLOCATOR_SIZE_CLASS_COUNT + getSizeClass(slotSize);
+    auto& pool = m_pools[index];
+
+    if (!pool) {
+        // Small classes get enough slots per block to amortize the allocation, but a block
+        // never takes more than an eighth of its heap
+        VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        VkDeviceSize blockSize = std::min(std::max(slotSize * ALLOCATOR_MIN_SLOTS_PER_BLOCK, ALLOCATOR_MIN_BLOCK_SIZE), ALLOCATOR_MAX_BLOCK_SIZE);
+        blockSize = std::max(std::min(blockSize, heapSize / 8), slotSize);
+
+        pool = std::make_unique<Pool>();
+        pool->memoryTypeIndex = memoryTypeIndex;
+        pool->slotSize = slotSize;
+        pool->slotsPerBlock = static_cast<uint32_t>(blockSize / slotSize);
+    }
+
+    return *pool;
+}
+
+
+VulkanAllocator::Block& VulkanAllocator::addBlock(Pool& pool)
+{
+    auto block = std::make_unique<Block>();
+    block->memory = allocateDeviceMemory(pool.slotSize * pool.slotsPerBlock, pool.memoryTypeIndex, &block->mappedData);
+
+    if (block->memory != VK_NULL_HANDLE) {
+        block->owners.resize(pool.slotsPerBlock, nullptr);
+        block->freeSlots.resize(pool.slotsPerBlock);
+        for (uint32_t i = 0; i < pool.slotsPerBlock; i++)
+            block->freeSlots[i] = pool.slotsPerBlock - 1 - i;
+
+        m_heapStats[m_memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].blockCount++;
+    }
+
+    pool.blocks.push_back(std::move(block));
+    return *pool.blocks.back();
+}
+
+
+void VulkanAllocator::releaseEmptyBlocks(Pool& pool)
+{
+    // Small blocks keep one empty block around so a free/allocate pattern doesn't hit the
+    // driver every time, big ones are not worth pinning
+    bool keptOne = pool.slotSize * pool.slotsPerBlock > ALLOCATOR_MIN_BLOCK_SIZE;
+
+    for (auto it = pool.blocks.begin(); it != pool.blocks.end();) {
+        if ((*it)->usedSlots > 0 || !keptOne) {
+            keptOne = keptOne || (*it)->usedSlots == 0;
+            ++it;
+            continue;
+        }
+
+        freeDeviceMemory((*it)->memory, pool.slotSize * pool.slotsPerBlock, pool.memoryTypeIndex);
+        m_heapStats[m_memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].blockCount--;
+        it = pool.blocks.erase(it);
+    }
+}
+
+
+VulkanAllocator::Allocation* VulkanAllocator::newAllocation()
+{
+    if (m_freeAllocations.empty())
+        return &m_allocationStorage.emplace_back();
+
+    Allocation* allocation = m_freeAllocations.back();
+    m_freeAllocations.pop_back();
+    return allocation;
+}
+
+
+void VulkanAllocator::deleteAllocation(Allocation* allocation)
+{
+    *allocation = Allocation();
+    m_freeAllocations.push_back(allocation);
+}
+
+
+uint32_t VulkanAllocator::getSizeClass(VkDeviceSize slotSize) noexcept
+{
+    uint32_t sizeClass = 0;
+    for (VkDeviceSize size = ALLOCATOR_MIN_SLOT_SIZE; size < slotSize; size <<= 1)
+        sizeClass++;
+
+    return sizeClass;
+}
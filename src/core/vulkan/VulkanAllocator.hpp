@@ -0,0 +1,136 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define ALLOCATOR_MIN_SLOT_SIZE 256ull
+#define ALLOCATOR_MAX_BLOCK_SIZE (64ull << 20)
+#define ALLOCATOR_DEDICATED_THRESHOLD (8ull << 20)  // Bigger requests get their own VkDeviceMemory
+
+// Device memory sub-allocator.
+// Requests up to ALLOCATOR_DEDICATED_THRESHOLD are rounded up to a power of two size class
+// and served from a slot in a shared VkDeviceMemory block of that class, larger ones get a
+// dedicated VkDeviceMemory. Buffers and optimal images never share a block, which keeps
+// bufferImageGranularity out of the picture. Host visible blocks are mapped once for their
+// whole lifetime. Thread safe.
+class VulkanAllocator
+{
+  public:
+    enum class MemoryUsage
+    {
+        GPU_ONLY,    // Device local, never touched by the host
+        CPU_TO_GPU,  // Written by the host, read by the device (staging, uniforms)
+        GPU_TO_CPU,  // Written by the device, read back by the host
+        CPU_ONLY     // Host memory the device can still access
+    };
+
+    enum class ResourceKind
+    {
+        LINEAR,  // Buffers and linear images
+        OPTIMAL  // Optimal tiling images
+    };
+
+    struct Pool;
+    struct Block;
+
+    struct Allocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;  // As requested, the slot may be bigger
+        void* mappedData = nullptr;  // Null unless host visible
+        uint32_t memoryTypeIndex = 0;
+
+      private:
+        friend class VulkanAllocator;
+        Pool* pool = nullptr;  // Null for dedicated allocations
+        Block* block = nullptr;
+        uint32_t slot = 0;
+    };
+
+    // One relocation of a defragmentation plan. Copy `size` bytes from the source to the
+    // destination (and recreate/rebind the resource) before calling endDefragmentation()
+    struct DefragmentationMove
+    {
+        Allocation* allocation;
+        VkDeviceMemory srcMemory;
+        VkDeviceSize srcOffset;
+        VkDeviceMemory dstMemory;
+        VkDeviceSize dstOffset;
+        VkDeviceSize size;
+    };
+
+    struct HeapStats
+    {
+        VkDeviceSize heapSize = 0;
+        VkDeviceSize reservedBytes = 0;  // Allocated from the driver
+        VkDeviceSize usedBytes = 0;  // Handed out to allocations
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;
+        uint32_t dedicatedCount = 0;
+    };
+
+  public:
+    VulkanAllocator(VkDevice device, const VkPhysicalDeviceProperties& properties, const VkPhysicalDeviceMemoryProperties& memoryProperties);
+    ~VulkanAllocator();
+
+    Allocation* allocate(const VkMemoryRequirements& requirements, MemoryUsage usage, ResourceKind kind, bool dedicated = false);
+    void free(Allocation* allocation);
+
+    // Create the resource, allocate and bind its memory
+    Allocation* createBuffer(const VkBufferCreateInfo& createInfo, MemoryUsage usage, VkBuffer& buffer);
+    Allocation* createImage(const VkImageCreateInfo& createInfo, MemoryUsage usage, VkImage& image);
+    void destroyBuffer(VkBuffer buffer, Allocation* allocation);
+    void destroyImage(VkImage image, Allocation* allocation);
+
+    // Plans moves that empty the least used blocks into the free slots of the others, up to
+    // `maxBytes`. Destination slots stay reserved until endDefragmentation(), which points
+    // the allocations at their new place and releases the emptied blocks
+    std::vector<DefragmentationMove> beginDefragmentation(VkDeviceSize maxBytes = ~0ull);
+    void endDefragmentation(const std::vector<DefragmentationMove>& moves);
+
+    std::vector<HeapStats> getHeapStats() const;
+    void logStats() const;
+
+    uint32_t findMemoryType(uint32_t typeBits, MemoryUsage usage) const;
+
+  private:
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+    void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex);
+
+    Allocation* allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+    Allocation* allocateFromPool(VkDeviceSize size, uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize slotSize);
+    Pool& getPool(uint32_t memoryTypeIndex, ResourceKind kind, VkDeviceSize slotSize);
+    Block& addBlock(Pool& pool);
+    void releaseEmptyBlocks(Pool& pool);
+
+    Allocation* newAllocation();
+    void deleteAllocation(Allocation* allocation);
+
+    static uint32_t getSizeClass(VkDeviceSize slotSize) noexcept;
+
+  private:
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    uint32_t m_maxAllocationCount;  // Driver limit on live VkDeviceMemory objects
+
+    mutable std::mutex m_mutex;
+
+    // Indexed by memory type, resource kind and size class, created on first use
+    std::vector<std::unique_ptr<Pool>> m_pools;
+
+    // Allocation objects are recycled to keep allocate() free of heap allocations
+    std::deque<Allocation> m_allocationStorage;
+    std::vector<Allocation*> m_freeAllocations;
+
+    uint32_t m_deviceMemoryCount = 0;
+    std::vector<HeapStats> m_heapStats;
+
+  public:
+    VulkanAllocator(const VulkanAllocator&) = delete;
+    void operator=(const VulkanAllocator&) = delete;
+};
@@ -0,0 +1,222 @@
+#include "pch.hpp"
+
+#include "VulkanAssetLoader.hpp"
+#include "VulkanDevice.hpp"
+#include "core/Profiler.hpp"
+
+#include <cstddef>
+
+VulkanMesh::~VulkanMesh()
+{
+    m_allocator.destroyBuffer(m_buffer, m_allocation);
+}
+
+// public
+
+std::vector<VkVertexInputBindingDescription> VulkanMesh::getVertexBindings()
+{
+    return {{0, sizeof(AssetPackVertex), VK_VERTEX_INPUT_RATE_VERTEX}};
+}
+
+
+std::vector<VkVertexInputAttributeDescription> VulkanMesh::getVertexAttributes()
+{
+    return {
+        {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AssetPackVertex, position)},
+        {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(AssetPackVertex, normal)},
+        {2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(AssetPackVertex, uv)}};
+}
+
+
+VulkanTexture::~VulkanTexture()
+{
+    vkDestroyImageView(m_device.getHandle(), m_view, nullptr);
+    m_device.getAllocator().destroyImage(m_image, m_allocation);
+}
+
+
+VulkanAssetLoader::VulkanAssetLoader(VulkanDevice& device)
+    : m_device(device)
+{
+    LOG_TRACE("Initialized asset loader");
+}
+
+// public
+
+std::unique_ptr<VulkanMesh> VulkanAssetLoader::loadMesh(const AssetPack& pack, const AssetPackEntry& entry)
+{
+    PROFILE_FUNCTION();
+
+    if (entry.type != AssetType::MESH)
+        throw Exception("Asset \"" + std::string(pack.getName(entry)) + "\" is not a mesh");
+
+    auto mesh = std::unique_ptr<VulkanMesh>(new VulkanMesh(m_device.getAllocator()));
+    mesh->m_indexOffset = entry.mesh.indexOffset;
+    mesh->m_indexType = entry.mesh.indexType == 0 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    mesh->m_indexCount = entry.mesh.indexCount;
+    mesh->m_vertexCount = entry.mesh.vertexCount;
+
+    // The payload is the buffer as the device wants it, indices included
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = std::max<VkDeviceSize>(entry.payloadSize, 1);
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    mesh->m_allocation = m_device.getAllocator().createBuffer(bufferInfo, VulkanAllocator::MemoryUsage::GPU_ONLY, mesh->m_buffer);
+
+    if (entry.payloadSize > 0)
+        m_device.getUploader().uploadBuffer(mesh->m_buffer, 0, pack.getPayload(entry), entry.payloadSize);
+
+    m_meshCount.fetch_add(1, std::memory_order_relaxed);
+    m_uploadedBytes.fetch_add(entry.payloadSize, std::memory_order_relaxed);
+
+    return mesh;
+}
+
+
+std::unique_ptr<VulkanTexture> VulkanAssetLoader::loadTexture(const AssetPack& pack, const AssetPackEntry& entry)
+{
+    PROFILE_FUNCTION();
+
+    if (entry.type != AssetType::TEXTURE)
+        throw Exception("Asset \"" + std::string(pack.getName(entry)) + "\" is not a texture");
+
+    auto& info = entry.texture;
+    auto format = static_cast<VkFormat>(info.format);
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(m_device.getPhysicalDevice(), format, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+        throw Exception(
+            "Texture \"" + std::string(pack.getName(entry)) + "\" has format " + std::to_string(info.format)
+            + ", which the device can't sample");
+
+    auto texture = std::unique_ptr<VulkanTexture>(new VulkanTexture(m_device));
+    texture->m_format = format;
+    texture->m_extent = {info.width, info.height};
+    texture->m_mipLevels = info.mipLevels;
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = {info.width, info.height, 1};
+    imageInfo.mipLevels = info.mipLevels;
+    imageInfo.arrayLayers = info.layerCount;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    texture->m_allocation = m_device.getAllocator().createImage(imageInfo, VulkanAllocator::MemoryUsage::GPU_ONLY, texture->m_image);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = texture->m_image;
+    viewInfo.viewType = info.layerCount > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, info.mipLevels, 0, info.layerCount};
+
+    if (vkCreateImageView(m_device.getHandle(), &viewInfo, nullptr, &texture->m_view) != VK_SUCCESS)
+        throw Exception("Failed to create image view for texture \"" + std::string(pack.getName(entry)) + "\"");
+
+    // One copy per level, every layer at once: they are contiguous in the payload
+    auto payload = static_cast<const char*>(pack.getPayload(entry));
+    for (uint32_t level = 0; level < info.mipLevels; level++) {
+        VkImageSubresourceLayers subresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, info.layerCount};
+        VkExtent3D extent = {std::max(info.width >> level, 1u), std::max(info.height >> level, 1u), 1};
+
+        m_device.getUploader().uploadImage(
+            texture->m_image,
+            subresource,
+            extent,
+            payload + getAssetMipOffset(info, level),
+            getAssetMipSize(info, level),
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+
+    m_textureCount.fetch_add(1, std::memory_order_relaxed);
+    m_uploadedBytes.fetch_add(entry.payloadSize, std::memory_order_relaxed);
+
+    return texture;
+}
+
+
+std::unique_ptr<VulkanMesh> VulkanAssetLoader::loadMesh(const AssetPack& pack, std::string_view name)
+{
+    return loadMesh(pack, findEntry(pack, name, AssetType::MESH));
+}
+
+
+std::unique_ptr<VulkanTexture> VulkanAssetLoader::loadTexture(const AssetPack& pack, std::string_view name)
+{
+    return loadTexture(pack, findEntry(pack, name, AssetType::TEXTURE));
+}
+
+
+VulkanAssetLoader::Assets VulkanAssetLoader::loadAll(const AssetPack& pack)
+{
+    PROFILE_FUNCTION();
+
+#if LOG_DEBUG_ENABLED
+    auto startTime = std::chrono::steady_clock::now();
+#endif
+
+    Assets assets;
+
+    // The packer lays out payloads in table order: the disk reads the next one during the copies
+    if (pack.getEntryCount() > 0)
+        pack.prefetch(*pack.begin());
+
+    for (auto entry = pack.begin(); entry != pack.end(); ++entry) {
+        if (entry + 1 != pack.end())
+            pack.prefetch(*(entry + 1));
+
+        if (entry->type == AssetType::MESH)
+            assets.meshes.push_back(loadMesh(pack, *entry));
+        else
+            assets.textures.push_back(loadTexture(pack, *entry));
+    }
+
+#if LOG_DEBUG_ENABLED
+    uint64_t bytes = 0;
+    for (const auto& entry : pack)
+        bytes += entry.payloadSize;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    LOG_DEBUG(
+        "Loaded \"{}\": {} meshes, {} textures, {:.1f} MiB in {:.1f} ms",
+        pack.getPath(),
+        assets.meshes.size(),
+        assets.textures.size(),
+        bytes / double(1 << 20),
+        seconds * 1000.0);
+#endif
+
+    return assets;
+}
+
+
+VulkanAssetLoader::Stats VulkanAssetLoader::getStats() const noexcept
+{
+    Stats stats;
+    stats.meshes = m_meshCount.load(std::memory_order_relaxed);
+    stats.textures = m_textureCount.load(std::memory_order_relaxed);
+    stats.bytes = m_uploadedBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// private
+
+const AssetPackEntry& VulkanAssetLoader::findEntry(const AssetPack& pack, std::string_view name, AssetType type) const
+{
+    const AssetPackEntry* entry = pack.find(name);
+    if (!entry || entry->type != type)
+        throw Exception(
+            "Asset pack \"" + pack.getPath() + "\" has no " + (type == AssetType::MESH ? "mesh" : "texture")
+            + " named \"" + std::string(name) + "\"");
+
+    return *entry;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "VulkanAllocator.hpp"
+#include "core/AssetPack.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+class VulkanDevice;
+
+// A mesh of an asset pack: its vertices then its indices, in one device local buffer
+class VulkanMesh
+{
+  public:
+    ~VulkanMesh();
+
+    inline VkBuffer getBuffer() const noexcept { return m_buffer; }  // Bind at offset 0 for the vertices
+    inline VkDeviceSize getIndexOffset() const noexcept { return m_indexOffset; }
+    inline VkIndexType getIndexType() const noexcept { return m_indexType; }
+    inline uint32_t getIndexCount() const noexcept { return m_indexCount; }
+    inline uint32_t getVertexCount() const noexcept { return m_vertexCount; }
+
+    // Vertex input of AssetPackVertex, for VulkanPipelineDescription
+    static std::vector<VkVertexInputBindingDescription> getVertexBindings();
+    static std::vector<VkVertexInputAttributeDescription> getVertexAttributes();
+
+  private:
+    friend class VulkanAssetLoader;
+    explicit VulkanMesh(VulkanAllocator& allocator) : m_allocator(allocator) { }
+
+    VulkanAllocator& m_allocator;
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    VulkanAllocator::Allocation* m_allocation = nullptr;
+    VkDeviceSize m_indexOffset = 0;
+    VkIndexType m_indexType = VK_INDEX_TYPE_UINT32;
+    uint32_t m_indexCount = 0;
+    uint32_t m_vertexCount = 0;
+
+  public:
+    VulkanMesh(const VulkanMesh&) = delete;
+    void operator=(const VulkanMesh&) = delete;
+};
+
+
+// A texture of an asset pack, with every mip level, in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+class VulkanTexture
+{
+  public:
+    ~VulkanTexture();
+
+    inline VkImage getImage() const noexcept { return m_image; }
+    inline VkImageView getView() const noexcept { return m_view; }  // 2D, or 2D array with several layers
+    inline VkFormat getFormat() const noexcept { return m_format; }
+    inline VkExtent2D getExtent() const noexcept { return m_extent; }
+    inline uint32_t getMipLevels() const noexcept { return m_mipLevels; }
+
+  private:
+    friend class VulkanAssetLoader;
+    explicit VulkanTexture(VulkanDevice& device) : m_device(device) { }
+
+    VulkanDevice& m_device;
+    VkImage m_image = VK_NULL_HANDLE;
+    VkImageView m_view = VK_NULL_HANDLE;
+    VulkanAllocator::Allocation* m_allocation = nullptr;
+    VkFormat m_format = VK_FORMAT_UNDEFINED;
+    VkExtent2D m_extent = {};
+    uint32_t m_mipLevels = 0;
+
+  public:
+    VulkanTexture(const VulkanTexture&) = delete;
+    void operator=(const VulkanTexture&) = delete;
+};
+
+
+// Creates device resources from asset packs.
+// Payloads are already in the layout the device wants, so loading one is a resource creation and
+// a copy from the pack's mapping straight into the uploader's staging memory, nothing is parsed
+// or converted. Uploads are only recorded: flush the uploader to submit them, the graphics queue
+// sees the data without waiting once they land. Thread safe.
+class VulkanAssetLoader
+{
+  public:
+    struct Assets
+    {
+        std::vector<std::unique_ptr<VulkanMesh>> meshes;
+        std::vector<std::unique_ptr<VulkanTexture>> textures;
+    };
+
+    struct Stats
+    {
+        uint64_t meshes = 0;
+        uint64_t textures = 0;
+        uint64_t bytes = 0;  // Payloads uploaded
+    };
+
+  public:
+    explicit VulkanAssetLoader(VulkanDevice& device);
+
+    std::unique_ptr<VulkanMesh> loadMesh(const AssetPack& pack, const AssetPackEntry& entry);
+    std::unique_ptr<VulkanTexture> loadTexture(const AssetPack& pack, const AssetPackEntry& entry);
+
+    // Throw if the pack has no asset of this name and type
+    std::unique_ptr<VulkanMesh> loadMesh(const AssetPack& pack, std::string_view name);
+    std::unique_ptr<VulkanTexture> loadTexture(const AssetPack& pack, std::string_view name);
+
+    // Every asset, in file order. The pack can be closed once it returns
+    Assets loadAll(const AssetPack& pack);
+
+    Stats getStats() const noexcept;
+
+  private:
+    const AssetPackEntry& findEntry(const AssetPack& pack, std::string_view name, AssetType type) const;
+
+  private:
+    VulkanDevice& m_device;
+
+    std::atomic<uint64_t> m_meshCount{0};
+    std::atomic<uint64_t> m_textureCount{0};
+    std::atomic<uint64_t> m_uploadedBytes{0};
+
+  public:
+    VulkanAssetLoader(const VulkanAssetLoader&) = delete;
+    void operator=(const VulkanAssetLoader&) = delete;
+};
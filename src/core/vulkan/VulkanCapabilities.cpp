@@ -0,0 +1,161 @@
+#include "pch.hpp"
+
+#include "VulkanCapabilities.hpp"
+#include "core/Hash.hpp"
+
+#include <cstring>
+
+// public
+
+VulkanCapabilities VulkanCapabilities::queryInstance()
+{
+    VulkanCapabilities capabilities;
+    capabilities.m_owner = "instance";
+
+    uint32_t extensionCount = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
+
+    for (uint32_t i = 0; i < extensionCount; i++)
+        capabilities.add(Kind::EXTENSION, extensions[i].extensionName, extensions[i].specVersion);
+
+    uint32_t layerCount = 0;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    std::vector<VkLayerProperties> layers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, layers.data());
+
+    for (uint32_t i = 0; i < layerCount; i++)
+        capabilities.add(Kind::LAYER, layers[i].layerName, layers[i].specVersion);
+
+    LOG_TRACE("Vulkan instance: {} extensions, {} layers available", extensionCount, layerCount);
+    return capabilities;
+}
+
+
+VulkanCapabilities VulkanCapabilities::queryDevice(VkPhysicalDevice physicalDevice, const char* deviceName)
+{
+    VulkanCapabilities capabilities;
+    capabilities.m_owner = fmt::format("\"{}\"", deviceName);
+
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    for (uint32_t i = 0; i < extensionCount; i++)
+        capabilities.add(Kind::EXTENSION, extensions[i].extensionName, extensions[i].specVersion);
+
+    return capabilities;
+}
+
+
+bool VulkanCapabilities::has(const char* name, Kind kind) const noexcept
+{
+    return find(name, kind) != nullptr;
+}
+
+
+uint32_t VulkanCapabilities::getVersion(const char* name, Kind kind) const noexcept
+{
+    auto capability = find(name, kind);
+    return capability ? capability->version : 0;
+}
+
+
+bool VulkanCapabilities::isEnabled(const char* name, Kind kind) const noexcept
+{
+    auto capability = find(name, kind);
+    return capability && capability->enabled;
+}
+
+
+void VulkanCapabilities::require(const char* name, Kind kind)
+{
+    if (!enableIfPresent(name, kind))
+        m_missing.emplace_back(kind, name);
+}
+
+
+bool VulkanCapabilities::enableIfPresent(const char* name, Kind kind)
+{
+    Capability* capability = find(name, kind);
+    if (!capability)
+        return false;
+
+    if (!capability->enabled) {
+        capability->enabled = true;
+        m_enabled[static_cast<size_t>(kind)].push_back(hashBytes(name, std::strlen(name)));
+    }
+
+    return true;
+}
+
+
+void VulkanCapabilities::checkRequired() const
+{
+    if (m_missing.empty())
+        return;
+
+    std::string msg = fmt::format("The following required Vulkan capabilities are not supported by the {}:", m_owner);
+    for (auto& [kind, name] : m_missing)
+        msg += fmt::format(" {} ({})", name, getKindName(kind));
+
+    throw Exception(msg);
+}
+
+
+std::vector<const char*> VulkanCapabilities::getEnabled(Kind kind) const
+{
+    auto& capabilities = m_capabilities[static_cast<size_t>(kind)];
+    auto& enabled = m_enabled[static_cast<size_t>(kind)];
+
+    std::vector<const char*> names;
+    names.reserve(enabled.size());
+
+    for (uint64_t hash : enabled)
+        names.push_back(capabilities.at(hash).name.c_str());
+
+    return names;
+}
+
+// private
+
+void VulkanCapabilities::add(Kind kind, const char* name, uint32_t version)
+{
+    auto& capabilities = m_capabilities[static_cast<size_t>(kind)];
+    auto [it, inserted] = capabilities.try_emplace(hashBytes(name, std::strlen(name)), Capability{name, version});
+
+    // Drivers don't list a name twice, two names sharing a hash would need a 64-bit collision
+    if (!inserted && it->second.name != name)
+        LOG_WARN("Vulkan {} {} collides with {}, ignored", getKindName(kind), name, it->second.name);
+}
+
+
+const VulkanCapabilities::Capability* VulkanCapabilities::find(const char* name, Kind kind) const noexcept
+{
+    auto& capabilities = m_capabilities[static_cast<size_t>(kind)];
+    auto it = capabilities.find(hashBytes(name, std::strlen(name)));
+
+    if (it == capabilities.end() || it->second.name != name)
+        return nullptr;
+
+    return &it->second;
+}
+
+
+VulkanCapabilities::Capability* VulkanCapabilities::find(const char* name, Kind kind) noexcept
+{
+    return const_cast<Capability*>(static_cast<const VulkanCapabilities*>(this)->find(name, kind));
+}
+
+
+const char* VulkanCapabilities::getKindName(Kind kind) noexcept
+{
+    switch (kind) {
+    case Kind::EXTENSION: return "extension";
+    case Kind::LAYER: return "layer";
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Extensions and layers of the Vulkan instance or of a physical device.
+// Enumerated once, then kept in hash maps with their spec versions so has() and require() are
+// O(1). Also builds the name lists of vkCreateInstance and vkCreateDevice: required names are
+// collected, every missing one is reported at once by checkRequired(), optional ones are
+// enabled only when present.
+class VulkanCapabilities
+{
+  public:
+    enum class Kind
+    {
+        EXTENSION,
+        LAYER
+    };
+
+  public:
+    VulkanCapabilities() = default;
+
+    // Instance extensions and layers the loader exposes
+    static VulkanCapabilities queryInstance();
+    // Device extensions, device layers are deprecated
+    static VulkanCapabilities queryDevice(VkPhysicalDevice physicalDevice, const char* deviceName);
+
+    bool has(const char* name, Kind kind = Kind::EXTENSION) const noexcept;
+    uint32_t getVersion(const char* name, Kind kind = Kind::EXTENSION) const noexcept;  // 0 if missing
+    bool isEnabled(const char* name, Kind kind = Kind::EXTENSION) const noexcept;
+
+    // Enables `name`, or remembers it for checkRequired() if missing
+    void require(const char* name, Kind kind = Kind::EXTENSION);
+    // Enables `name` if present, returns whether it is
+    bool enableIfPresent(const char* name, Kind kind = Kind::EXTENSION);
+    // Throws listing every required name that is missing
+    void checkRequired() const;
+
+    // In enabling order, the pointers live as long as these capabilities
+    std::vector<const char*> getEnabled(Kind kind = Kind::EXTENSION) const;
+
+  private:
+    struct Capability
+    {
+        std::string name;  // Tells hash collisions apart
+        uint32_t version;
+        bool enabled = false;
+    };
+
+    using CapabilityMap = std::unordered_map<uint64_t, Capability>;  // By name hash
+
+  private:
+    void add(Kind kind, const char* name, uint32_t version);
+    const Capability* find(const char* name, Kind kind) const noexcept;
+    Capability* find(const char* name, Kind kind) noexcept;
+
+    static const char* getKindName(Kind kind) noexcept;
+
+  private:
+    std::string m_owner;  // "instance" or the device name, for errors
+    std::array<CapabilityMap, 2> m_capabilities;  // By Kind
+    std::array<std::vector<uint64_t>, 2> m_enabled;  // Name hashes by Kind, survive copies unlike pointers
+    std::vector<std::pair<Kind, std::string>> m_missing;  // Required but not present
+};
@@ -0,0 +1,154 @@
+#include "pch.hpp"
+
+#include "VulkanCommandPools.hpp"
+#include "core/Profiler.hpp"
+
+VulkanCommandPools::VulkanCommandPools(
+    VkDevice device,
+    const VulkanDeviceDispatch& dispatch,
+    uint32_t queueFamilyIndex,
+    uint32_t threadCount,
+    uint32_t frameCount)
+    : m_device(device), m_dispatch(dispatch), m_threadCount(threadCount), m_frameCount(frameCount), m_pools(threadCount * frameCount)
+{
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;  // Reset as a whole, never per buffer
+    poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+    for (auto& pool : m_pools) {
+        if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &pool.handle) != VK_SUCCESS) {
+            // The destructor won't run
+            for (auto& created : m_pools)
+                vkDestroyCommandPool(m_device, created.handle, nullptr);
+
+            throw Exception("Failed to create command pool");
+        }
+
+        // A thread recording for the first time, late, doesn't grow the vectors mid frame
+        pool.primaries.reserve(COMMAND_BUFFER_ALLOCATION_BATCH);
+        pool.secondaries.reserve(COMMAND_BUFFER_ALLOCATION_BATCH);
+    }
+
+    LOG_TRACE("Initialized command pools ({} threads, {} frames)", threadCount, frameCount);
+}
+
+
+VulkanCommandPools::~VulkanCommandPools()
+{
+    LOG_TRACE("Destroying command pools");
+
+    // Frees their command buffers too
+    for (auto& pool : m_pools)
+        vkDestroyCommandPool(m_device, pool.handle, nullptr);
+}
+
+// public
+
+void VulkanCommandPools::beginFrame(uint32_t frameIndex)
+{
+    PROFILE_FUNCTION();
+
+    m_currentFrame = frameIndex % m_frameCount;
+
+    for (uint32_t i = 0; i < m_threadCount; i++) {
+        auto& pool = m_pools[m_currentFrame * m_threadCount + i];
+        if (pool.usedPrimaries == 0 && pool.usedSecondaries == 0) continue;
+
+        if (m_dispatch.vkResetCommandPool(m_device, pool.handle, 0) != VK_SUCCESS)
+            throw Exception("Failed to reset command pool");
+
+        pool.usedPrimaries = 0;
+        pool.usedSecondaries = 0;
+    }
+}
+
+
+VkCommandBuffer VulkanCommandPools::getPrimary()
+{
+    return getCommandBuffer(getThreadPool(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+}
+
+
+VkCommandBuffer VulkanCommandPools::getSecondary()
+{
+    return getCommandBuffer(getThreadPool(), VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+}
+
+
+void VulkanCommandPools::recordParallel(
+    JobSystem& jobSystem,
+    VkCommandBuffer primary,
+    const VkCommandBufferInheritanceInfo& inheritance,
+    uint32_t taskCount,
+    const RecordFunction& record,
+    std::vector<VkCommandBuffer>& commandBuffers)
+{
+    PROFILE_FUNCTION();
+
+    commandBuffers.resize(taskCount);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (inheritance.renderPass != VK_NULL_HANDLE)
+        beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    jobSystem.parallelFor(0, taskCount, 1, [&](size_t begin, size_t end) {
+        PROFILE_SCOPE("Record secondary command buffers");
+
+        for (size_t task = begin; task < end; task++) {
+            VkCommandBuffer commandBuffer = getSecondary();
+
+            if (m_dispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+                throw Exception("Failed to begin secondary command buffer");
+
+            record(static_cast<uint32_t>(task), commandBuffer);
+
+            if (m_dispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                throw Exception("Failed to record secondary command buffer");
+
+            commandBuffers[task] = commandBuffer;
+        }
+    });
+
+    // Task order, not completion order, so the result doesn't depend on the scheduling
+    m_dispatch.vkCmdExecuteCommands(primary, taskCount, commandBuffers.data());
+}
+
+// private
+
+VulkanCommandPools::ThreadPool& VulkanCommandPools::getThreadPool()
+{
+    uint32_t thread = JobSystem::getThreadIndex();
+    if (thread >= m_threadCount)
+        throw Exception("Command buffers can only be recorded from job system threads");
+
+    return m_pools[m_currentFrame * m_threadCount + thread];
+}
+
+
+VkCommandBuffer VulkanCommandPools::getCommandBuffer(ThreadPool& pool, VkCommandBufferLevel level)
+{
+    bool primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    auto& buffers = primary ? pool.primaries : pool.secondaries;
+    auto& used = primary ? pool.usedPrimaries : pool.usedSecondaries;
+
+    // Grow by batches, buffers survive the pool resets and get reused every frame after that
+    if (used == buffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = pool.handle;
+        allocInfo.level = level;
+        allocInfo.commandBufferCount = COMMAND_BUFFER_ALLOCATION_BATCH;
+
+        buffers.resize(used + COMMAND_BUFFER_ALLOCATION_BATCH);
+        if (m_dispatch.vkAllocateCommandBuffers(m_device, &allocInfo, buffers.data() + used) != VK_SUCCESS) {
+            buffers.resize(used);
+            throw Exception("Failed to allocate command buffers");
+        }
+    }
+
+    return buffers[used++];
+}
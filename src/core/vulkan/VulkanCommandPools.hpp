@@ -0,0 +1,73 @@
+#pragma once
+
+#include "core/jobs/JobSystem.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <vector>
+
+#define COMMAND_BUFFER_ALLOCATION_BATCH 16
+
+struct VulkanDeviceDispatch;
+
+// One VkCommandPool per job system thread and per frame in flight, so threads record without
+// any locking. Command buffers are never freed one by one: beginFrame() resets every pool of
+// the frame in one go and their buffers are handed out again.
+class VulkanCommandPools
+{
+  public:
+    using RecordFunction = std::function<void(uint32_t task, VkCommandBuffer commandBuffer)>;
+
+  public:
+    VulkanCommandPools(VkDevice device, const VulkanDeviceDispatch& dispatch, uint32_t queueFamilyIndex, uint32_t threadCount, uint32_t frameCount);
+    ~VulkanCommandPools();
+
+    // The device must be done with the previous use of this frame
+    void beginFrame(uint32_t frameIndex);
+
+    // From the calling thread's pool (a job system thread), valid until the frame comes back
+    VkCommandBuffer getPrimary();
+    VkCommandBuffer getSecondary();
+
+    // Records `taskCount` secondary command buffers across the job system, then executes them
+    // in `primary` in task order, whichever thread recorded them. `inheritance.renderPass`
+    // set means the secondaries continue the render pass begun in `primary`.
+    // `commandBuffers` receives the secondaries in task order: the caller's own storage, so
+    // concurrent calls don't share any and a vector kept across frames doesn't allocate
+    void recordParallel(
+        JobSystem& jobSystem,
+        VkCommandBuffer primary,
+        const VkCommandBufferInheritanceInfo& inheritance,
+        uint32_t taskCount,
+        const RecordFunction& record,
+        std::vector<VkCommandBuffer>& commandBuffers);
+
+  private:
+    // Only touched by its thread, padded so neighbours don't share a cache line
+    struct alignas(64) ThreadPool
+    {
+        VkCommandPool handle = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> primaries;
+        std::vector<VkCommandBuffer> secondaries;
+        uint32_t usedPrimaries = 0;
+        uint32_t usedSecondaries = 0;
+    };
+
+  private:
+    ThreadPool& getThreadPool();
+    VkCommandBuffer getCommandBuffer(ThreadPool& pool, VkCommandBufferLevel level);
+
+  private:
+    VkDevice m_device;
+    const VulkanDeviceDispatch& m_dispatch;
+    uint32_t m_threadCount;
+    uint32_t m_frameCount;
+
+    std::vector<ThreadPool> m_pools;  // [frame * m_threadCount + thread]
+    uint32_t m_currentFrame = 0;
+
+  public:
+    VulkanCommandPools(const VulkanCommandPools&) = delete;
+    void operator=(const VulkanCommandPools&) = delete;
+};
@@ -0,0 +1,140 @@
+#include "pch.hpp"
+
+#include "VulkanDescriptorAllocator.hpp"
+#include "core/Profiler.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+// Descriptors of each type reserved per set. Pools are shared by every layout, so this is a
+// guess at the average set, a pool short of one type just makes the next one get used
+static const std::pair<VkDescriptorType, float> s_descriptorsPerSet[] = {
+    {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f}};
+
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator(VkDevice device, const VulkanDeviceDispatch& dispatch, uint32_t threadCount, uint32_t frameCount)
+    : m_device(device), m_dispatch(dispatch), m_threadCount(threadCount), m_frameCount(frameCount), m_pools(threadCount * frameCount)
+{
+    // Pools are created on first use, threads that never allocate sets cost nothing. A thread
+    // allocating for the first time mid frame doesn't grow its vector though
+    for (auto& threadPools : m_pools)
+        threadPools.pools.reserve(DESCRIPTOR_POOL_RESERVED_COUNT);
+
+    LOG_TRACE("Initialized descriptor allocator ({} threads, {} frames)", threadCount, frameCount);
+}
+
+
+VulkanDescriptorAllocator::~VulkanDescriptorAllocator()
+{
+    size_t poolCount = 0;
+    for (auto& threadPools : m_pools) {
+        for (auto pool : threadPools.pools)
+            vkDestroyDescriptorPool(m_device, pool, nullptr);
+
+        poolCount += threadPools.pools.size();
+    }
+
+    LOG_DEBUG("Descriptor allocator: {} pools", poolCount);
+}
+
+// public
+
+void VulkanDescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+    PROFILE_FUNCTION();
+
+    m_currentFrame = frameIndex % m_frameCount;
+
+    for (uint32_t i = 0; i < m_threadCount; i++) {
+        auto& threadPools = m_pools[m_currentFrame * m_threadCount + i];
+        if (!threadPools.used) continue;
+
+        for (uint32_t j = 0; j <= threadPools.current && j < threadPools.pools.size(); j++) {
+            if (m_dispatch.vkResetDescriptorPool(m_device, threadPools.pools[j], 0) != VK_SUCCESS)
+                throw Exception("Failed to reset descriptor pool");
+        }
+
+        threadPools.current = 0;
+        threadPools.used = false;
+    }
+}
+
+
+VkDescriptorSet VulkanDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    auto& threadPools = getThreadPools();
+    threadPools.used = true;
+
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    while (true) {
+        bool newPool = threadPools.current == threadPools.pools.size();
+        if (newPool) {
+            threadPools.pools.push_back(createPool(threadPools.nextSetCount));
+            threadPools.nextSetCount = std::min<uint32_t>(threadPools.nextSetCount * 2, DESCRIPTOR_POOL_MAX_SETS);
+        }
+
+        allocInfo.descriptorPool = threadPools.pools[threadPools.current];
+
+        VkDescriptorSet set;
+        VkResult result = m_dispatch.vkAllocateDescriptorSets(m_device, &allocInfo, &set);
+
+        if (result == VK_SUCCESS)
+            return set;
+
+        // This pool is full, move on to the next one
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+            throw Exception("Failed to allocate descriptor set");
+
+        // A set that doesn't fit in an empty pool would make pools forever
+        if (newPool)
+            throw Exception("Descriptor set too large for the descriptor pools");
+
+        threadPools.current++;
+    }
+}
+
+// private
+
+VulkanDescriptorAllocator::ThreadPools& VulkanDescriptorAllocator::getThreadPools()
+{
+    uint32_t thread = JobSystem::getThreadIndex();
+    if (thread >= m_threadCount)
+        throw Exception("Descriptor sets can only be allocated from job system threads");
+
+    return m_pools[m_currentFrame * m_threadCount + thread];
+}
+
+
+VkDescriptorPool VulkanDescriptorAllocator::createPool(uint32_t setCount)
+{
+    std::array<VkDescriptorPoolSize, std::size(s_descriptorsPerSet)> poolSizes;
+    for (size_t i = 0; i < poolSizes.size(); i++) {
+        poolSizes[i].type = s_descriptorsPerSet[i].first;
+        poolSizes[i].descriptorCount = std::max(1u, static_cast<uint32_t>(s_descriptorsPerSet[i].second * setCount));
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = 0;  // Reset as a whole, never per set
+    poolInfo.maxSets = setCount;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+
+    VkDescriptorPool pool;
+    if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        throw Exception("Failed to create descriptor pool");
+
+    return pool;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+#define DESCRIPTOR_POOL_INITIAL_SETS 64
+#define DESCRIPTOR_POOL_MAX_SETS 4096  // Pools double in size up to this
+#define DESCRIPTOR_POOL_RESERVED_COUNT 8  // Per thread and frame, before its vector reallocates
+
+struct VulkanDeviceDispatch;
+
+// Descriptor sets that live for one frame in flight.
+// Like VulkanCommandPools, every job system thread has its own pools for every frame in flight,
+// so allocating never locks. When a thread's pool runs out, the next one is used, or created
+// twice as big. beginFrame() resets every pool of the frame in one go, the pools are kept and
+// reused, sets are never freed one by one.
+class VulkanDescriptorAllocator
+{
+  public:
+    VulkanDescriptorAllocator(VkDevice device, const VulkanDeviceDispatch& dispatch, uint32_t threadCount, uint32_t frameCount);
+    ~VulkanDescriptorAllocator();
+
+    // The device must be done with the previous use of this frame
+    void beginFrame(uint32_t frameIndex);
+
+    // From the calling thread's pools (a job system thread), valid until the frame comes back
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+  private:
+    // Only touched by its thread, padded so neighbours don't share a cache line
+    struct alignas(64) ThreadPools
+    {
+        std::vector<VkDescriptorPool> pools;
+        uint32_t current = 0;  // Pools before it are full
+        uint32_t nextSetCount = DESCRIPTOR_POOL_INITIAL_SETS;
+        bool used = false;  // Since the last reset
+    };
+
+  private:
+    ThreadPools& getThreadPools();
+    VkDescriptorPool createPool(uint32_t setCount);
+
+  private:
+    VkDevice m_device;
+    const VulkanDeviceDispatch& m_dispatch;
+    uint32_t m_threadCount;
+    uint32_t m_frameCount;
+
+    std::vector<ThreadPools> m_pools;  // [frame * m_threadCount + thread]
+    uint32_t m_currentFrame = 0;
+
+  public:
+    VulkanDescriptorAllocator(const VulkanDescriptorAllocator&) = delete;
+    void operator=(const VulkanDescriptorAllocator&) = delete;
+};
@@ -0,0 +1,148 @@
+#include "pch.hpp"
+
+#include "VulkanDescriptorLayoutCache.hpp"
+#include "core/Hash.hpp"
+
+VulkanDescriptorLayoutCache::VulkanDescriptorLayoutCache(VkDevice device)
+    : m_device(device)
+{
+}
+
+
+VulkanDescriptorLayoutCache::~VulkanDescriptorLayoutCache()
+{
+    size_t layoutCount = 0;
+    for (auto& [hash, layouts] : m_layouts) {
+        for (auto& cached : layouts)
+            vkDestroyDescriptorSetLayout(m_device, cached.layout, nullptr);
+
+        layoutCount += layouts.size();
+    }
+
+    LOG_DEBUG("Descriptor layout cache: {} layouts, {} hits / {} misses", layoutCount, m_hits.load(), m_misses.load());
+}
+
+// public
+
+VkDescriptorSetLayout VulkanDescriptorLayoutCache::getLayout(
+    const VkDescriptorSetLayoutBinding* bindings,
+    uint32_t bindingCount,
+    VkDescriptorSetLayoutCreateFlags flags)
+{
+    // Reused by the lookups of this thread, a hit doesn't allocate
+    static thread_local LayoutKey t_key;
+    makeKey(bindings, bindingCount, flags, t_key);
+    uint64_t hash = t_key.hash();
+
+    {
+        std::shared_lock lock(m_mutex);
+        if (VkDescriptorSetLayout layout = find(t_key, hash)) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return layout;
+        }
+    }
+
+    std::unique_lock lock(m_mutex);
+
+    // Another thread may have created it in the meantime
+    if (VkDescriptorSetLayout layout = find(t_key, hash)) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return layout;
+    }
+
+    CachedLayout cached;
+    makeKey(bindings, bindingCount, flags, cached.key);  // Owns its samplers, unlike t_key once reused
+
+    VkDescriptorSetLayoutCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    createInfo.flags = flags;
+    createInfo.bindingCount = static_cast<uint32_t>(cached.key.bindings.size());
+    createInfo.pBindings = cached.key.bindings.data();
+
+    if (vkCreateDescriptorSetLayout(m_device, &createInfo, nullptr, &cached.layout) != VK_SUCCESS)
+        throw Exception("Failed to create descriptor set layout");
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+
+    VkDescriptorSetLayout layout = cached.layout;
+    m_layouts[hash].push_back(std::move(cached));
+    return layout;
+}
+
+// private
+
+void VulkanDescriptorLayoutCache::makeKey(
+    const VkDescriptorSetLayoutBinding* bindings,
+    uint32_t bindingCount,
+    VkDescriptorSetLayoutCreateFlags flags,
+    LayoutKey& key)
+{
+    key.flags = flags;
+    key.bindings.assign(bindings, bindings + bindingCount);
+    key.immutableSamplers.clear();
+
+    std::sort(key.bindings.begin(), key.bindings.end(), [](auto& a, auto& b) { return a.binding < b.binding; });
+
+    for (auto& binding : key.bindings) {
+        if (binding.pImmutableSamplers)
+            key.immutableSamplers.insert(key.immutableSamplers.end(), binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount);
+    }
+
+    // Point at the copies, the vector doesn't move anymore
+    size_t samplerOffset = 0;
+    for (auto& binding : key.bindings) {
+        if (binding.pImmutableSamplers) {
+            binding.pImmutableSamplers = key.immutableSamplers.data() + samplerOffset;
+            samplerOffset += binding.descriptorCount;
+        }
+    }
+}
+
+
+VkDescriptorSetLayout VulkanDescriptorLayoutCache::find(const LayoutKey& key, uint64_t hash) const noexcept
+{
+    auto it = m_layouts.find(hash);
+    if (it == m_layouts.end())
+        return VK_NULL_HANDLE;
+
+    for (auto& cached : it->second) {
+        if (cached.key == key)
+            return cached.layout;
+    }
+
+    return VK_NULL_HANDLE;
+}
+
+// LayoutKey
+
+bool VulkanDescriptorLayoutCache::LayoutKey::operator==(const LayoutKey& other) const noexcept
+{
+    if (flags != other.flags || bindings.size() != other.bindings.size() || immutableSamplers != other.immutableSamplers)
+        return false;
+
+    for (size_t i = 0; i < bindings.size(); i++) {
+        auto& a = bindings[i];
+        auto& b = other.bindings[i];
+
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount
+            || a.stageFlags != b.stageFlags || (a.pImmutableSamplers == nullptr) != (b.pImmutableSamplers == nullptr))
+            return false;
+    }
+
+    return true;
+}
+
+
+uint64_t VulkanDescriptorLayoutCache::LayoutKey::hash() const noexcept
+{
+    // Field by field, the struct has padding
+    uint64_t hash = hashValue(flags);
+    for (auto& binding : bindings) {
+        hash = hashValue(binding.binding, hash);
+        hash = hashValue(binding.descriptorType, hash);
+        hash = hashValue(binding.descriptorCount, hash);
+        hash = hashValue(binding.stageFlags, hash);
+    }
+
+    return hashBytes(immutableSamplers.data(), immutableSamplers.size() * sizeof(VkSampler), hash);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+// Deduplicates descriptor set layouts.
+// Layouts are looked up by a hash of their bindings, so every caller describing the same
+// bindings (in any order) shares one VkDescriptorSetLayout, and pipeline layouts built from
+// them stay compatible. Layouts live as long as the cache. Thread safe.
+class VulkanDescriptorLayoutCache
+{
+  public:
+    explicit VulkanDescriptorLayoutCache(VkDevice device);
+    ~VulkanDescriptorLayoutCache();
+
+    VkDescriptorSetLayout getLayout(
+        const VkDescriptorSetLayoutBinding* bindings,
+        uint32_t bindingCount,
+        VkDescriptorSetLayoutCreateFlags flags = 0);
+
+    inline VkDescriptorSetLayout getLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        return getLayout(bindings.data(), static_cast<uint32_t>(bindings.size()));
+    }
+
+  private:
+    // Bindings sorted by binding number, immutable samplers copied out of the caller's arrays
+    struct LayoutKey
+    {
+        VkDescriptorSetLayoutCreateFlags flags = 0;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;  // pImmutableSamplers point in immutableSamplers
+        std::vector<VkSampler> immutableSamplers;
+
+        bool operator==(const LayoutKey& other) const noexcept;
+        uint64_t hash() const noexcept;
+    };
+
+    struct CachedLayout
+    {
+        LayoutKey key;
+        VkDescriptorSetLayout layout;
+    };
+
+  private:
+    static void makeKey(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount, VkDescriptorSetLayoutCreateFlags flags, LayoutKey& key);
+    VkDescriptorSetLayout find(const LayoutKey& key, uint64_t hash) const noexcept;
+
+  private:
+    VkDevice m_device;
+
+    mutable std::shared_mutex m_mutex;  // Lookups share it, insertions take it exclusively
+    std::unordered_map<uint64_t, std::vector<CachedLayout>> m_layouts;  // By key hash, collisions side by side
+
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+
+  public:
+    VulkanDescriptorLayoutCache(const VulkanDescriptorLayoutCache&) = delete;
+    void operator=(const VulkanDescriptorLayoutCache&) = delete;
+};
@@ -0,0 +1,130 @@
+#include "pch.hpp"
+
+#include "VulkanDescriptorTemplate.hpp"
+#include "VulkanDevice.hpp"
+
+// Scratch arrays of the fallback path, grown once to the largest template used by the thread
+struct DescriptorWriteScratch
+{
+    std::vector<VkWriteDescriptorSet> writes;
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    std::vector<VkBufferView> texelBufferViews;
+};
+
+static thread_local DescriptorWriteScratch t_scratch;
+
+
+static bool isImageDescriptor(VkDescriptorType type) noexcept
+{
+    return type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+           || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+           || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+}
+
+
+static bool isTexelBufferDescriptor(VkDescriptorType type) noexcept
+{
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+}
+
+
+VulkanDescriptorTemplate::VulkanDescriptorTemplate(
+    VulkanDevice& device,
+    VkDescriptorSetLayout layout,
+    const std::vector<VkDescriptorUpdateTemplateEntryKHR>& entries)
+    : m_device(device.getHandle()), m_dispatch(device.getDispatch()), m_entries(entries)
+{
+    for (auto& entry : m_entries) {
+        if (isImageDescriptor(entry.descriptorType))
+            m_imageInfoCount += entry.descriptorCount;
+        else if (isTexelBufferDescriptor(entry.descriptorType))
+            m_texelBufferViewCount += entry.descriptorCount;
+        else
+            m_bufferInfoCount += entry.descriptorCount;
+    }
+
+    if (!device.hasDescriptorUpdateTemplate())
+        return;
+
+    // Extension functions, only resolved when it is enabled
+    if (!m_dispatch.vkCreateDescriptorUpdateTemplateKHR || !m_dispatch.vkUpdateDescriptorSetWithTemplateKHR
+        || !m_dispatch.vkDestroyDescriptorUpdateTemplateKHR)
+        throw Exception("VK_KHR_descriptor_update_template is enabled but its functions are unavailable");
+
+    VkDescriptorUpdateTemplateCreateInfoKHR createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+    createInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(m_entries.size());
+    createInfo.pDescriptorUpdateEntries = m_entries.data();
+    createInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    createInfo.descriptorSetLayout = layout;
+
+    if (m_dispatch.vkCreateDescriptorUpdateTemplateKHR(m_device, &createInfo, nullptr, &m_template) != VK_SUCCESS)
+        throw Exception("Failed to create descriptor update template");
+}
+
+
+VulkanDescriptorTemplate::~VulkanDescriptorTemplate()
+{
+    if (m_template != VK_NULL_HANDLE)
+        m_dispatch.vkDestroyDescriptorUpdateTemplateKHR(m_device, m_template, nullptr);
+}
+
+// public
+
+void VulkanDescriptorTemplate::update(VkDescriptorSet set, const void* data) const
+{
+    if (m_template != VK_NULL_HANDLE)
+        m_dispatch.vkUpdateDescriptorSetWithTemplateKHR(m_device, set, m_template, data);
+    else
+        updateWithWrites(set, data);
+}
+
+// private
+
+void VulkanDescriptorTemplate::updateWithWrites(VkDescriptorSet set, const void* data) const
+{
+    auto& scratch = t_scratch;
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    // Sized up front, the writes point into these arrays
+    scratch.writes.resize(m_entries.size());
+    scratch.imageInfos.resize(m_imageInfoCount);
+    scratch.bufferInfos.resize(m_bufferInfoCount);
+    scratch.texelBufferViews.resize(m_texelBufferViewCount);
+
+    uint32_t imageInfoCount = 0, bufferInfoCount = 0, texelBufferViewCount = 0;
+
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        auto& entry = m_entries[i];
+        auto& write = scratch.writes[i];
+
+        write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = entry.dstBinding;
+        write.dstArrayElement = entry.dstArrayElement;
+        write.descriptorCount = entry.descriptorCount;
+        write.descriptorType = entry.descriptorType;
+
+        // The caller's struct may be strided, the writes need contiguous arrays
+        for (uint32_t j = 0; j < entry.descriptorCount; j++) {
+            const uint8_t* descriptor = bytes + entry.offset + j * entry.stride;
+
+            if (isImageDescriptor(entry.descriptorType)) {
+                if (j == 0) write.pImageInfo = &scratch.imageInfos[imageInfoCount];
+                std::memcpy(&scratch.imageInfos[imageInfoCount++], descriptor, sizeof(VkDescriptorImageInfo));
+
+            } else if (isTexelBufferDescriptor(entry.descriptorType)) {
+                if (j == 0) write.pTexelBufferView = &scratch.texelBufferViews[texelBufferViewCount];
+                std::memcpy(&scratch.texelBufferViews[texelBufferViewCount++], descriptor, sizeof(VkBufferView));
+
+            } else {
+                if (j == 0) write.pBufferInfo = &scratch.bufferInfos[bufferInfoCount];
+                std::memcpy(&scratch.bufferInfos[bufferInfoCount++], descriptor, sizeof(VkDescriptorBufferInfo));
+            }
+        }
+    }
+
+    m_dispatch.vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(scratch.writes.size()), scratch.writes.data(), 0, nullptr);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+
+class VulkanDevice;
+struct VulkanDeviceDispatch;
+
+// Descriptor set writes described once.
+// The entries tell where each descriptor sits in a struct of the caller (offset and stride,
+// as VkDescriptorImageInfo, VkDescriptorBufferInfo or VkBufferView), update() then writes a
+// whole set from one such struct. With VK_KHR_descriptor_update_template the driver reads the
+// struct directly, otherwise the writes are gathered in per-thread scratch arrays that keep
+// their capacity, no VkWriteDescriptorSet array is built from scratch per set.
+class VulkanDescriptorTemplate
+{
+  public:
+    VulkanDescriptorTemplate(VulkanDevice& device, VkDescriptorSetLayout layout, const std::vector<VkDescriptorUpdateTemplateEntryKHR>& entries);
+    ~VulkanDescriptorTemplate();
+
+    // Thread safe, as long as threads don't write the same set
+    void update(VkDescriptorSet set, const void* data) const;
+
+  private:
+    void updateWithWrites(VkDescriptorSet set, const void* data) const;
+
+  private:
+    VkDevice m_device;
+    const VulkanDeviceDispatch& m_dispatch;
+    std::vector<VkDescriptorUpdateTemplateEntryKHR> m_entries;
+
+    VkDescriptorUpdateTemplateKHR m_template = VK_NULL_HANDLE;  // VK_NULL_HANDLE without the extension
+
+    // Descriptors of each kind, to size the scratch arrays of the fallback once
+    uint32_t m_imageInfoCount = 0;
+    uint32_t m_bufferInfoCount = 0;
+    uint32_t m_texelBufferViewCount = 0;
+
+  public:
+    VulkanDescriptorTemplate(const VulkanDescriptorTemplate&) = delete;
+    void operator=(const VulkanDescriptorTemplate&) = delete;
+};
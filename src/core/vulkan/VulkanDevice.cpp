@@ -1,21 +1,85 @@
 #include "pch.hpp"
 
 #include "VulkanDevice.hpp"
+#include "VulkanInstance.hpp"
+#include "core/Profiler.hpp"
 
-VulkanDevice::VulkanDevice(VkInstance instance)
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+
+VulkanDevice::VulkanDevice(const VulkanInstance& instance, const Settings& settings, JobSystem& jobSystem)
+    : m_getPhysicalDeviceProperties2(instance.getPhysicalDeviceProperties2())
 {
+    PROFILE_FUNCTION();
+
     try {
-        selectPhysicalDevice(instance);  // Sets m_physicalDevice
+        selectPhysicalDevice(instance.getHandle(), settings);  // Sets m_deviceInfo
+        LOG_TRACE("Picked up physical device \"{}\" for rendering", m_deviceInfo.properties.deviceName);
+
+        createLogicalDevice(settings);  // Sets m_logicalDevice and the queues
 
-        // Debug / logging stuff
-        VkPhysicalDeviceProperties debugDP;
-        vkGetPhysicalDeviceProperties(m_physicalDevice, &debugDP);
-        LOG_TRACE("Picked up physical device \"{}\" for rendering", debugDP.deviceName);
+        m_allocator = std::make_unique<VulkanAllocator>(m_logicalDevice, m_deviceInfo.properties, m_deviceInfo.memoryProperties);
+        m_pipelineCache = std::make_unique<VulkanPipelineCache>(m_logicalDevice, m_deviceInfo.properties, settings.pipelineCachePath);
+        m_shaderLibrary = std::make_unique<VulkanShaderLibrary>(m_logicalDevice, settings, jobSystem);
+        m_pipelineStateCache = std::make_unique<VulkanPipelineStateCache>(
+            m_logicalDevice,
+            *m_pipelineCache,
+            *m_shaderLibrary,
+            jobSystem,
+            MAX_FRAMES_IN_FLIGHT,
+            m_hasPipelineCreationFeedback);
+        m_uploader = std::make_unique<VulkanUploader>(*this, UPLOADER_DEFAULT_STAGING_SIZE);
+        m_assetLoader = std::make_unique<VulkanAssetLoader>(*this);
+        m_commandPools = std::make_unique<VulkanCommandPools>(
+            m_logicalDevice,
+            m_dispatch,
+            getQueueFamilyIndex(QueueType::GRAPHICS),
+            std::max(settings.threadCount, 1u),
+            MAX_FRAMES_IN_FLIGHT);
+        m_descriptorLayoutCache = std::make_unique<VulkanDescriptorLayoutCache>(m_logicalDevice);
+        m_descriptorAllocator = std::make_unique<VulkanDescriptorAllocator>(
+            m_logicalDevice,
+            m_dispatch,
+            std::max(settings.threadCount, 1u),
+            MAX_FRAMES_IN_FLIGHT);
+        m_frameArena = std::make_unique<VulkanLinearArena>(
+            *m_allocator,
+            LINEAR_ARENA_DEFAULT_FRAME_SIZE,
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            MAX_FRAMES_IN_FLIGHT,
+            m_deviceInfo.properties.limits.minUniformBufferOffsetAlignment);
+        m_timestamps = std::make_unique<VulkanTimestamps>(
+            m_logicalDevice,
+            m_dispatch,
+            m_deviceInfo.properties.limits.timestampPeriod,
+            m_deviceInfo.queueFamilies[getQueueFamilyIndex(QueueType::GRAPHICS)].timestampValidBits,
+            std::max(settings.threadCount, 1u),
+            MAX_FRAMES_IN_FLIGHT);
+        createFrameFences();
 
         LOG_TRACE("Initialized Vulkan device");
 
     } catch (const Exception& ex) {
         LOG_ERROR("Failed to initialize Vulkan device");
+
+        // The destructor won't run
+        destroyFrameFences();
+        m_timestamps.reset();
+        m_frameArena.reset();
+        m_descriptorAllocator.reset();
+        m_descriptorLayoutCache.reset();
+        m_commandPools.reset();
+        m_assetLoader.reset();
+        m_uploader.reset();
+        m_pipelineStateCache.reset();
+        m_shaderLibrary.reset();
+        m_pipelineCache.reset();
+        m_allocator.reset();
+        if (m_logicalDevice != VK_NULL_HANDLE)
+            vkDestroyDevice(m_logicalDevice, nullptr);
+
         throw;
     }
 }
@@ -23,14 +87,91 @@ VulkanDevice::VulkanDevice(VkInstance instance)
 VulkanDevice::~VulkanDevice()
 {
     LOG_TRACE("Destroying Vulkan device");
+
+    vkDeviceWaitIdle(m_logicalDevice);
+
+    // Everything created from the logical device goes before it
+    destroyFrameFences();
+    m_timestamps.reset();
+    m_frameArena.reset();
+    m_descriptorAllocator.reset();
+    m_descriptorLayoutCache.reset();
+    m_commandPools.reset();
+    m_assetLoader.reset();
+    m_uploader.reset();
+    m_pipelineStateCache.reset();
+    m_shaderLibrary.reset();
+    m_pipelineCache.reset();
+    m_allocator.reset();
+
+    vkDestroyDevice(m_logicalDevice, nullptr);
 }
 
 // public
 
+VkResult VulkanDevice::submit(QueueType type, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+{
+    auto& queue = m_queues[static_cast<size_t>(type)];
+
+    std::lock_guard lock(m_queueLocks[queue.lockIndex]);
+    return m_dispatch.vkQueueSubmit(queue.handle, submitCount, submits, fence);
+}
+
+
+void VulkanDevice::submitFrame(uint32_t frameIndex, uint32_t submitCount, const VkSubmitInfo* submits)
+{
+    VkFence& fence = m_frameFences[frameIndex % MAX_FRAMES_IN_FLIGHT];
+    m_dispatch.vkResetFences(m_logicalDevice, 1, &fence);
+
+    if (submit(QueueType::GRAPHICS, submitCount, submits, fence) == VK_SUCCESS) return;
+
+    // Nothing will signal the reset fence, replace it with a signaled one
+    vkDestroyFence(m_logicalDevice, fence, nullptr);
+    fence = VK_NULL_HANDLE;
+    createFrameFence(fence);
+
+    throw Exception("Failed to submit the frame");
+}
+
+
+VkResult VulkanDevice::present(const VkPresentInfoKHR& presentInfo)
+{
+    auto& queue = m_queues[static_cast<size_t>(QueueType::GRAPHICS)];
+
+    std::lock_guard lock(m_queueLocks[queue.lockIndex]);
+    return m_dispatch.vkQueuePresentKHR(queue.handle, &presentInfo);
+}
+
+
+void VulkanDevice::beginFrame(uint32_t frameIndex)
+{
+    PROFILE_FUNCTION();
+
+    VkFence fence = getFrameFence(frameIndex);
+    if (m_dispatch.vkWaitForFences(m_logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+        throw Exception("Failed to wait for a frame in flight");
+
+    m_timestamps->beginFrame(frameIndex);
+    m_commandPools->beginFrame(frameIndex);
+    m_descriptorAllocator->beginFrame(frameIndex);
+    m_frameArena->beginFrame(frameIndex);
+    m_pipelineStateCache->beginFrame();
+}
+
+
+void VulkanDevice::waitForAllFrames()
+{
+    PROFILE_FUNCTION();
+
+    m_dispatch.vkWaitForFences(m_logicalDevice, static_cast<uint32_t>(m_frameFences.size()), m_frameFences.data(), VK_TRUE, UINT64_MAX);
+}
+
 // private
 
-void VulkanDevice::selectPhysicalDevice(VkInstance instance)
+void VulkanDevice::selectPhysicalDevice(VkInstance instance, const Settings& settings)
 {
+    PROFILE_FUNCTION();
+
     uint32_t deviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -40,64 +181,381 @@ void VulkanDevice::selectPhysicalDevice(VkInstance instance)
     std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
     vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
 
-    // Request the more suitable device from that list
-    m_physicalDevice = getBestPhysicalDevice(physicalDevices);
+    std::optional<PhysicalDeviceInfo> selected;
+    bool fromCache = false;
+
+    if (!settings.gpu.empty()) {
+        // The user knows best, but don't fall back silently if the choice can't work
+        selected = getRequestedPhysicalDevice(physicalDevices, settings.gpu);
+
+        if (!selected)
+            throw Exception("Requested GPU \"" + settings.gpu + "\" does not exist");
+
+        if (getPhysicalDeviceScore(*selected) == 0)
+            throw Exception("Requested GPU \"" + std::string(selected->properties.deviceName) + "\" is not suitable");
 
-    if (m_physicalDevice == VK_NULL_HANDLE)
+    } else {
+        // Fast path: the device picked by a previous launch, if it is still there
+        if (!settings.deviceCachePath.empty()) {
+            selected = getCachedPhysicalDevice(physicalDevices, settings.deviceCachePath);
+            fromCache = selected.has_value();
+        }
+
+        // Request the more suitable device from that list
+        if (!selected)
+            selected = getBestPhysicalDevice(physicalDevices);
+    }
+
+    if (!selected)
         throw Exception("No suitable GPU found");
+
+    m_deviceInfo = std::move(*selected);
+
+    // A one-off --gpu doesn't replace the cached choice
+    if (!fromCache && settings.gpu.empty() && !settings.deviceCachePath.empty()) {
+        std::ofstream cacheFile(settings.deviceCachePath, std::ios::trunc);
+        cacheFile << m_deviceInfo.getUUID() << std::endl;
+
+        if (!cacheFile)
+            LOG_WARN("Could not write the selected GPU to \"{}\"", settings.deviceCachePath);
+    }
 }
 
 
-VkPhysicalDevice VulkanDevice::getBestPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices) const noexcept
+void VulkanDevice::createLogicalDevice(const Settings& settings)
 {
-    std::multimap<unsigned long long, VkPhysicalDevice> sortedDevices;
+    PROFILE_FUNCTION();
 
-    for (const auto& device : physicalDevices) {
-        VkPhysicalDeviceProperties dp;
-        VkPhysicalDeviceFeatures df;
+    const auto& indices = m_deviceInfo.queueFamilyIndices;
+    uint32_t graphicsFamily = indices.graphicsFamilyIndex.value();
+
+    // Family and index within the family of every queue type. A dedicated family gets its own
+    // queue, as long as the family has enough of them
+    std::map<uint32_t, uint32_t> queueCounts;
+    auto requestQueue = [&](QueueType type, std::optional<uint32_t> family) {
+        auto& queue = m_queues[static_cast<size_t>(type)];
+        if (!family) {
+            queue = m_queues[static_cast<size_t>(QueueType::GRAPHICS)];
+            return std::make_pair(queue.familyIndex, 0u);
+        }
 
-        vkGetPhysicalDeviceProperties(device, &dp);
-        vkGetPhysicalDeviceFeatures(device, &df);
+        uint32_t index = std::min(queueCounts[*family]++, m_deviceInfo.queueFamilies[*family].queueCount - 1);
+        queue.familyIndex = *family;
+        return std::make_pair(*family, index);
+    };
 
-        unsigned long long score = 0;
-        // Add other criterias below
-        score += dp.limits.maxImageDimension2D;
-        if (dp.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) score += 1000;
+    std::array<std::pair<uint32_t, uint32_t>, 3> queueLocations = {
+        requestQueue(QueueType::GRAPHICS, graphicsFamily),
+        requestQueue(QueueType::TRANSFER, indices.transferFamilyIndex),
+        requestQueue(QueueType::COMPUTE, indices.computeFamilyIndex)};
 
-        // Add mandatory criterias below
-        if (!df.geometryShader) score = 0;
-        if (!getPhysicalDeviceQueueFamilyIndices(device).isComplete()) score = 0;
+    std::vector<float> queuePriorities(m_queues.size(), 1.0f);
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 
-        sortedDevices.insert({score, device});
+    for (auto [family, count] : queueCounts) {
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = family;
+        queueCreateInfo.queueCount = std::min(count, m_deviceInfo.queueFamilies[family].queueCount);
+        queueCreateInfo.pQueuePriorities = queuePriorities.data();
+        queueCreateInfos.push_back(queueCreateInfo);
     }
 
-    auto it = sortedDevices.rbegin();  // Valid if !sortedDevices.empty()
-    return !sortedDevices.empty() && it->first > 0 ? it->second : VK_NULL_HANDLE;
+    VulkanCapabilities& capabilities = m_deviceInfo.capabilities;
+
+    // Windows present through swapchains, headless ones render offscreen
+    if (!settings.headless)
+        capabilities.require(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+    // Optional extensions
+    m_hasPipelineCreationFeedback = capabilities.enableIfPresent(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+    m_hasDescriptorUpdateTemplate = capabilities.enableIfPresent(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME);
+
+    capabilities.checkRequired();
+    auto enabledExtensions = capabilities.getEnabled();
+
+    VkPhysicalDeviceFeatures deviceFeatures = {};
+
+    VkDeviceCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
+    createInfo.pQueueCreateInfos = queueCreateInfos.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
+    createInfo.pEnabledFeatures = &deviceFeatures;
+
+    if (vkCreateDevice(m_deviceInfo.handle, &createInfo, nullptr, &m_logicalDevice) != VK_SUCCESS)
+        throw Exception("Failed to create logical device");
+
+    m_dispatch.load(m_logicalDevice);
+
+    for (uint32_t i = 0; i < m_queues.size(); i++) {
+        auto& queue = m_queues[i];
+        vkGetDeviceQueue(m_logicalDevice, queueLocations[i].first, queueLocations[i].second, &queue.handle);
+
+        queue.lockIndex = i;
+        for (uint32_t j = 0; j < i; j++) {
+            if (m_queues[j].handle == queue.handle)
+                queue.lockIndex = m_queues[j].lockIndex;
+        }
+    }
+
+    LOG_DEBUG(
+        "Queue families: graphics {}, transfer {}{}, compute {}{}",
+        graphicsFamily,
+        m_queues[1].familyIndex,
+        indices.transferFamilyIndex ? "" : " (shared with graphics)",
+        m_queues[2].familyIndex,
+        indices.computeFamilyIndex ? "" : " (shared with graphics)");
 }
 
 
-VulkanDevice::QueueFamilyIndices VulkanDevice::getPhysicalDeviceQueueFamilyIndices(VkPhysicalDevice physicalDevice) const noexcept
+void VulkanDevice::createFrameFences()
 {
-    QueueFamilyIndices indices;
+    for (auto& fence : m_frameFences)
+        createFrameFence(fence);
+}
+
+
+void VulkanDevice::createFrameFence(VkFence& fence)
+{
+    // Signaled, the first wait on the frame in flight returns right away
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    if (vkCreateFence(m_logicalDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+        throw Exception("Failed to create frame in flight fence");
+}
+
+
+void VulkanDevice::destroyFrameFences() noexcept
+{
+    for (auto& fence : m_frameFences) {
+        if (fence != VK_NULL_HANDLE)
+            vkDestroyFence(m_logicalDevice, fence, nullptr);
+
+        fence = VK_NULL_HANDLE;
+    }
+}
+
+
+std::optional<VulkanDevice::PhysicalDeviceInfo> VulkanDevice::getCachedPhysicalDevice(
+    const std::vector<VkPhysicalDevice>& physicalDevices,
+    const std::string& cachePath) const
+{
+    std::ifstream cacheFile(cachePath);
+    std::string uuid;
+
+    if (!cacheFile || !std::getline(cacheFile, uuid) || uuid.empty())
+        return std::nullopt;
+
+    // Only the properties are needed to recognize it, the other devices are never fully queried
+    auto info = getRequestedPhysicalDevice(physicalDevices, uuid);
+
+    if (!info || getPhysicalDeviceScore(*info) == 0) {
+        LOG_TRACE("Cached GPU {} is gone or unsuitable, scanning all devices", uuid);
+        return std::nullopt;
+    }
+
+    LOG_TRACE("Using cached GPU choice {}", uuid);
+    return info;
+}
+
+
+std::optional<VulkanDevice::PhysicalDeviceInfo> VulkanDevice::getRequestedPhysicalDevice(
+    const std::vector<VkPhysicalDevice>& physicalDevices,
+    const std::string& request) const
+{
+    // An index in vkEnumeratePhysicalDevices order...
+    if (!request.empty() && std::all_of(request.begin(), request.end(), [](unsigned char c) { return std::isdigit(c); })) {
+        // strtoul rather than stoul, whose out_of_range isn't a runtime_error
+        errno = 0;
+        unsigned long index = std::strtoul(request.c_str(), nullptr, 10);
+        if (errno == ERANGE || index >= physicalDevices.size()) return std::nullopt;
+
+        return queryPhysicalDeviceInfo(physicalDevices[index], static_cast<uint32_t>(index));
+    }
+
+    // ...or a UUID as printed by PhysicalDeviceInfo::getUUID()
+    for (uint32_t i = 0; i < physicalDevices.size(); i++) {
+        PhysicalDeviceInfo candidate;
+        queryPhysicalDeviceIdentity(physicalDevices[i], i, candidate);
+
+        if (candidate.getUUID() == request)
+            return queryPhysicalDeviceInfo(physicalDevices[i], i);
+    }
+
+    return std::nullopt;
+}
+
+
+std::optional<VulkanDevice::PhysicalDeviceInfo> VulkanDevice::getBestPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices) const
+{
+    std::optional<PhysicalDeviceInfo> best;
+    unsigned long long bestScore = 0;
+
+    for (uint32_t i = 0; i < physicalDevices.size(); i++) {
+        auto info = queryPhysicalDeviceInfo(physicalDevices[i], i);
+        auto score = getPhysicalDeviceScore(info);
+
+        LOG_DEBUG("GPU {}: \"{}\" ({}), score {}", i, info.properties.deviceName, info.getUUID(), score);
+
+        if (score > bestScore) {
+            bestScore = score;
+            best = std::move(info);
+        }
+    }
+
+    return best;
+}
+
+
+VulkanDevice::PhysicalDeviceInfo VulkanDevice::queryPhysicalDeviceInfo(VkPhysicalDevice physicalDevice, uint32_t index) const
+{
+    PhysicalDeviceInfo info;
+    info.handle = physicalDevice;
+    queryPhysicalDeviceIdentity(physicalDevice, index, info);
+
+    vkGetPhysicalDeviceFeatures(physicalDevice, &info.features);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &info.memoryProperties);
 
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+    info.queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, info.queueFamilies.data());
+
+    info.capabilities = VulkanCapabilities::queryDevice(physicalDevice, info.properties.deviceName);
 
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+    info.queueFamilyIndices = getPhysicalDeviceQueueFamilyIndices(info.queueFamilies);
+
+    for (uint32_t i = 0; i < info.memoryProperties.memoryHeapCount; i++) {
+        if (info.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+            info.deviceLocalMemory += info.memoryProperties.memoryHeaps[i].size;
+    }
+
+    return info;
+}
+
+
+void VulkanDevice::queryPhysicalDeviceIdentity(VkPhysicalDevice physicalDevice, uint32_t index, PhysicalDeviceInfo& info) const
+{
+    info.index = index;
+
+    if (!m_getPhysicalDeviceProperties2) {
+        vkGetPhysicalDeviceProperties(physicalDevice, &info.properties);
+        return;
+    }
+
+    VkPhysicalDeviceIDPropertiesKHR idProperties = {};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES_KHR;
+
+    VkPhysicalDeviceProperties2KHR properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+    properties.pNext = &idProperties;
+
+    m_getPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    info.properties = properties.properties;
+    info.deviceUUID.emplace();
+    std::copy(std::begin(idProperties.deviceUUID), std::end(idProperties.deviceUUID), info.deviceUUID->begin());
+}
+
+
+VulkanDevice::QueueFamilyIndices VulkanDevice::getPhysicalDeviceQueueFamilyIndices(const std::vector<VkQueueFamilyProperties>& queueFamilies) noexcept
+{
+    QueueFamilyIndices indices;
+
+    // Transfer: a transfer only family (DMA engine) beats a compute one, graphics is the fallback
+    std::optional<uint32_t> computeTransferFamily;
 
     uint32_t index = 0;
     for (auto& q : queueFamilies) {
         if (q.queueCount > 0) {
-            if (q.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            bool graphics = q.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+            bool compute = q.queueFlags & VK_QUEUE_COMPUTE_BIT;
+            bool transfer = q.queueFlags & VK_QUEUE_TRANSFER_BIT;
+
+            if (graphics && !indices.graphicsFamilyIndex)
                 indices.graphicsFamilyIndex = index;
-        }
 
-        if (indices.isComplete())
-            break;
+            if (!graphics && compute && !indices.computeFamilyIndex)
+                indices.computeFamilyIndex = index;
+
+            // Graphics and compute families support transfers even without the bit
+            if (!graphics && !compute && transfer && !indices.transferFamilyIndex)
+                indices.transferFamilyIndex = index;
+            if (!graphics && compute && !computeTransferFamily)
+                computeTransferFamily = index;
+        }
 
         ++index;
     }
 
+    if (!indices.transferFamilyIndex)
+        indices.transferFamilyIndex = computeTransferFamily;
+
     return indices;
 }
+
+
+unsigned long long VulkanDevice::getPhysicalDeviceScore(const PhysicalDeviceInfo& info) noexcept
+{
+    // Add mandatory criterias below
+    if (!info.features.geometryShader) return 0;
+    if (!info.queueFamilyIndices.isComplete()) return 0;
+
+    unsigned long long score = 1;
+
+    // Add other criterias below
+    switch (info.properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 1000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 100000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 10000; break;
+    default: break;
+    }
+
+    score += info.deviceLocalMemory >> 20;  // VRAM in MiB
+
+    // Queue topology: dedicated transfer and compute families let uploads and compute run
+    // alongside graphics
+    bool dedicatedTransfer = false, dedicatedCompute = false;
+    for (auto& q : info.queueFamilies) {
+        if (q.queueCount == 0 || (q.queueFlags & VK_QUEUE_GRAPHICS_BIT)) continue;
+
+        if (q.queueFlags & VK_QUEUE_COMPUTE_BIT)
+            dedicatedCompute = true;
+        else if (q.queueFlags & VK_QUEUE_TRANSFER_BIT)
+            dedicatedTransfer = true;
+    }
+
+    if (dedicatedTransfer) score += 5000;
+    if (dedicatedCompute) score += 5000;
+
+    return score;
+}
+
+// PhysicalDeviceInfo
+
+std::string VulkanDevice::PhysicalDeviceInfo::getUUID() const
+{
+    std::string uuid;
+
+    if (deviceUUID) {
+        for (size_t i = 0; i < deviceUUID->size(); i++) {
+            if (i == 4 || i == 6 || i == 8 || i == 10)
+                uuid += '-';
+            uuid += fmt::format("{:02x}", (*deviceUUID)[i]);
+        }
+
+        return uuid;
+    }
+
+    // Without device UUIDs, identical GPUs only differ by their index. pipelineCacheUUID changes
+    // with the driver, which at worst costs one full device scan after a driver update
+    uuid = fmt::format("{:04x}-{:04x}-{}-", properties.vendorID, properties.deviceID, index);
+    for (auto byte : properties.pipelineCacheUUID)
+        uuid += fmt::format("{:02x}", byte);
+
+    return uuid;
+}
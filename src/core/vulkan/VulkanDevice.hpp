@@ -1,29 +1,163 @@
 #pragma once
 
+#include "VulkanAllocator.hpp"
+#include "VulkanAssetLoader.hpp"
+#include "VulkanCapabilities.hpp"
+#include "VulkanCommandPools.hpp"
+#include "VulkanDescriptorAllocator.hpp"
+#include "VulkanDescriptorLayoutCache.hpp"
+#include "VulkanLinearArena.hpp"
+#include "VulkanLoader.hpp"
+#include "VulkanPipelineCache.hpp"
+#include "VulkanPipelineStateCache.hpp"
+#include "VulkanShaderLibrary.hpp"
+#include "VulkanTimestamps.hpp"
+#include "VulkanUploader.hpp"
+#include "core/Settings.hpp"
+
 #include <vulkan/vulkan.hpp>
 
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#define MAX_FRAMES_IN_FLIGHT 2  // Frames the CPU may record while the device works on the previous ones
+
+class VulkanInstance;
 class VulkanDevice
 {
   public:
-    VulkanDevice(VkInstance instance);
-    ~VulkanDevice();
-
-  private:
     struct QueueFamilyIndices
     {
         std::optional<uint32_t> graphicsFamilyIndex;
+        std::optional<uint32_t> transferFamilyIndex;  // Only set for a family without graphics
+        std::optional<uint32_t> computeFamilyIndex;  // Only set for a family without graphics
         inline bool isComplete() const noexcept { return graphicsFamilyIndex.has_value(); }
     };
 
+    // Transfer and compute fall back to the graphics queue when the device has no dedicated family
+    enum class QueueType
+    {
+        GRAPHICS,
+        TRANSFER,
+        COMPUTE
+    };
+
+    // Everything selection and device creation need to know about a physical device, queried once
+    struct PhysicalDeviceInfo
+    {
+        VkPhysicalDevice handle = VK_NULL_HANDLE;
+        uint32_t index = 0;  // In vkEnumeratePhysicalDevices order
+        VkPhysicalDeviceProperties properties = {};
+        std::optional<std::array<uint8_t, VK_UUID_SIZE>> deviceUUID;  // Needs VK_KHR_external_memory_capabilities
+        VkPhysicalDeviceFeatures features = {};
+        VkPhysicalDeviceMemoryProperties memoryProperties = {};
+        std::vector<VkQueueFamilyProperties> queueFamilies;
+        VulkanCapabilities capabilities;  // Device extensions, the enabled ones once the device is created
+
+        QueueFamilyIndices queueFamilyIndices;
+        VkDeviceSize deviceLocalMemory = 0;  // Sum of the device local heaps
+
+        // deviceUUID if known, the model, driver and index otherwise
+        std::string getUUID() const;
+    };
+
+  public:
+    VulkanDevice(const VulkanInstance& instance, const Settings& settings, JobSystem& jobSystem);
+    ~VulkanDevice();
+
+    inline VkDevice getHandle() const noexcept { return m_logicalDevice; }
+    // This device's own entry points, for recording and submission
+    inline const VulkanDeviceDispatch& getDispatch() const noexcept { return m_dispatch; }
+    inline VkPhysicalDevice getPhysicalDevice() const noexcept { return m_deviceInfo.handle; }
+    inline const PhysicalDeviceInfo& getPhysicalDeviceInfo() const noexcept { return m_deviceInfo; }
+    inline const VkPhysicalDeviceProperties& getProperties() const noexcept { return m_deviceInfo.properties; }
+    inline const VulkanCapabilities& getCapabilities() const noexcept { return m_deviceInfo.capabilities; }
+    inline VkQueue getGraphicsQueue() const noexcept { return m_queues[0].handle; }
+    inline VkQueue getQueue(QueueType type) const noexcept { return m_queues[static_cast<size_t>(type)].handle; }
+    inline uint32_t getQueueFamilyIndex(QueueType type) const noexcept { return m_queues[static_cast<size_t>(type)].familyIndex; }
+
+    // vkQueueSubmit with the queue's lock held, a queue may be shared by several types and threads
+    VkResult submit(QueueType type, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+    // submit() to the graphics queue, signaling the frame's fence. Throws if it fails, leaving
+    // the fence signaled so the next beginFrame() doesn't wait forever
+    void submitFrame(uint32_t frameIndex, uint32_t submitCount, const VkSubmitInfo* submits);
+    // vkQueuePresentKHR on the graphics queue, with its lock held
+    VkResult present(const VkPresentInfoKHR& presentInfo);
+
+    // Waits until the device is done with the previous use of this frame in flight, then reads
+    // its timestamps and recycles its command and descriptor pools, its arena and the pipelines
+    // replaced by reloads. The frame's submissions signal getFrameFence()
+    void beginFrame(uint32_t frameIndex);
+    void waitForAllFrames();
+    inline VkFence getFrameFence(uint32_t frameIndex) const noexcept { return m_frameFences[frameIndex % MAX_FRAMES_IN_FLIGHT]; }
+
+    inline VulkanAllocator& getAllocator() noexcept { return *m_allocator; }
+    inline VulkanUploader& getUploader() noexcept { return *m_uploader; }
+    inline VulkanAssetLoader& getAssetLoader() noexcept { return *m_assetLoader; }  // Uploads through getUploader()
+    inline VulkanCommandPools& getCommandPools() noexcept { return *m_commandPools; }  // Graphics queue family
+    inline VulkanDescriptorLayoutCache& getDescriptorLayoutCache() noexcept { return *m_descriptorLayoutCache; }
+    inline VulkanDescriptorAllocator& getDescriptorAllocator() noexcept { return *m_descriptorAllocator; }  // Per frame sets
+    inline VulkanLinearArena& getFrameArena() noexcept { return *m_frameArena; }  // Per frame uniforms, vertices, staging
+    inline VulkanTimestamps& getTimestamps() noexcept { return *m_timestamps; }  // Graphics queue
+    inline VulkanPipelineCache& getPipelineCache() noexcept { return *m_pipelineCache; }
+    inline VulkanShaderLibrary& getShaderLibrary() noexcept { return *m_shaderLibrary; }
+    inline VulkanPipelineStateCache& getPipelineStateCache() noexcept { return *m_pipelineStateCache; }  // Shared VkPipelines
+    // Chain a VkPipelineCreationFeedbackCreateInfoEXT when creating pipelines if true
+    inline bool hasPipelineCreationFeedback() const noexcept { return m_hasPipelineCreationFeedback; }
+    // VulkanDescriptorTemplate falls back to plain descriptor writes if false
+    inline bool hasDescriptorUpdateTemplate() const noexcept { return m_hasDescriptorUpdateTemplate; }
+
   private:
-    void selectPhysicalDevice(VkInstance instance);
+    void selectPhysicalDevice(VkInstance instance, const Settings& settings);
+    void createLogicalDevice(const Settings& settings);
+    void createFrameFences();
+    void createFrameFence(VkFence& fence);
+    void destroyFrameFences() noexcept;
 
-    VkPhysicalDevice getBestPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices) const noexcept;
-    QueueFamilyIndices getPhysicalDeviceQueueFamilyIndices(VkPhysicalDevice physicalDevice) const noexcept;
+    std::optional<PhysicalDeviceInfo> getCachedPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices, const std::string& cachePath) const;
+    std::optional<PhysicalDeviceInfo> getRequestedPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices, const std::string& request) const;
+    std::optional<PhysicalDeviceInfo> getBestPhysicalDevice(const std::vector<VkPhysicalDevice>& physicalDevices) const;
+
+    PhysicalDeviceInfo queryPhysicalDeviceInfo(VkPhysicalDevice physicalDevice, uint32_t index) const;
+    // Only what getUUID() needs
+    void queryPhysicalDeviceIdentity(VkPhysicalDevice physicalDevice, uint32_t index, PhysicalDeviceInfo& info) const;
+    static QueueFamilyIndices getPhysicalDeviceQueueFamilyIndices(const std::vector<VkQueueFamilyProperties>& queueFamilies) noexcept;
+    static unsigned long long getPhysicalDeviceScore(const PhysicalDeviceInfo& info) noexcept;
 
   private:
-    VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+    PhysicalDeviceInfo m_deviceInfo;
+    PFN_vkGetPhysicalDeviceProperties2KHR m_getPhysicalDeviceProperties2;  // @see VulkanInstance
+
+    struct Queue
+    {
+        VkQueue handle = VK_NULL_HANDLE;
+        uint32_t familyIndex = 0;
+        uint32_t lockIndex = 0;  // Types sharing a VkQueue share a lock
+    };
+
     VkDevice m_logicalDevice = VK_NULL_HANDLE;
+    VulkanDeviceDispatch m_dispatch;
+    std::array<Queue, 3> m_queues;  // Indexed by QueueType
+    std::array<std::mutex, 3> m_queueLocks;
+    bool m_hasPipelineCreationFeedback = false;
+    bool m_hasDescriptorUpdateTemplate = false;
+
+    std::unique_ptr<VulkanAllocator> m_allocator;
+    std::unique_ptr<VulkanPipelineCache> m_pipelineCache;
+    std::unique_ptr<VulkanShaderLibrary> m_shaderLibrary;
+    std::unique_ptr<VulkanPipelineStateCache> m_pipelineStateCache;
+    std::unique_ptr<VulkanUploader> m_uploader;
+    std::unique_ptr<VulkanAssetLoader> m_assetLoader;
+    std::unique_ptr<VulkanCommandPools> m_commandPools;
+    std::unique_ptr<VulkanDescriptorLayoutCache> m_descriptorLayoutCache;
+    std::unique_ptr<VulkanDescriptorAllocator> m_descriptorAllocator;
+    std::unique_ptr<VulkanLinearArena> m_frameArena;
+    std::unique_ptr<VulkanTimestamps> m_timestamps;
+    std::array<VkFence, MAX_FRAMES_IN_FLIGHT> m_frameFences = {};
 
   private:
   public:
@@ -0,0 +1,124 @@
+#include "pch.hpp"
+
+#include "VulkanDevice.hpp"
+#include "VulkanFrameBatch.hpp"
+#include "core/Profiler.hpp"
+
+VulkanFrameBatch::VulkanFrameBatch(VulkanDevice& device)
+    : m_device(device)
+{
+}
+
+// public
+
+void VulkanFrameBatch::begin(uint32_t frameIndex)
+{
+    m_frameIndex = frameIndex;
+    m_device.beginFrame(frameIndex);
+
+    m_swapchains.clear();
+    m_commandBuffers.clear();
+    m_waitSemaphores.clear();
+    m_signalSemaphores.clear();
+    m_swapchainHandles.clear();
+    m_imageIndices.clear();
+    m_offscreenCommandBuffers.clear();
+    m_discardedSemaphores.clear();
+}
+
+
+void VulkanFrameBatch::add(VulkanSwapchain& swapchain, const VulkanSwapchain::Frame& frame, VkCommandBuffer commandBuffer)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_swapchains.push_back(&swapchain);
+    m_commandBuffers.push_back(commandBuffer);
+    m_waitSemaphores.push_back(frame.imageAvailable);
+    m_signalSemaphores.push_back(frame.renderFinished);
+    m_swapchainHandles.push_back(swapchain.getHandle());
+    m_imageIndices.push_back(frame.imageIndex);
+}
+
+
+void VulkanFrameBatch::add(VkCommandBuffer commandBuffer)
+{
+    std::lock_guard lock(m_mutex);
+    m_offscreenCommandBuffers.push_back(commandBuffer);
+}
+
+
+void VulkanFrameBatch::discard(const VulkanSwapchain::Frame& frame)
+{
+    std::lock_guard lock(m_mutex);
+    m_discardedSemaphores.push_back(frame.imageAvailable);
+}
+
+
+void VulkanFrameBatch::submit()
+{
+    PROFILE_FUNCTION();
+
+    uint32_t count = static_cast<uint32_t>(m_swapchains.size());
+    uint32_t offscreenCount = static_cast<uint32_t>(m_offscreenCommandBuffers.size());
+    uint32_t discardedCount = static_cast<uint32_t>(m_discardedSemaphores.size());
+    if (count == 0 && offscreenCount == 0 && discardedCount == 0) return;  // The frame fence stays signaled
+
+    // One VkSubmitInfo per frame, so a frame only waits for its own image
+    m_submitInfos.resize(count);
+    m_waitStages.assign(count, VK_PIPELINE_STAGE_TRANSFER_BIT);  // See Window::render
+
+    for (uint32_t i = 0; i < count; i++) {
+        auto& submitInfo = m_submitInfos[i];
+        submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &m_waitSemaphores[i];
+        submitInfo.pWaitDstStageMask = &m_waitStages[i];
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_commandBuffers[i];
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &m_signalSemaphores[i];
+    }
+
+    if (offscreenCount > 0) {
+        auto& submitInfo = m_submitInfos.emplace_back();
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = offscreenCount;
+        submitInfo.pCommandBuffers = m_offscreenCommandBuffers.data();
+    }
+
+    // Acquire semaphores must be waited on before they are signaled again, even with no work
+    if (discardedCount > 0) {
+        m_discardedStages.assign(discardedCount, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+        auto& submitInfo = m_submitInfos.emplace_back();
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = discardedCount;
+        submitInfo.pWaitSemaphores = m_discardedSemaphores.data();
+        submitInfo.pWaitDstStageMask = m_discardedStages.data();
+    }
+
+    m_device.submitFrame(m_frameIndex, static_cast<uint32_t>(m_submitInfos.size()), m_submitInfos.data());
+
+    if (count == 0) return;
+
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = count;
+    presentInfo.pWaitSemaphores = m_signalSemaphores.data();
+    presentInfo.swapchainCount = count;
+    presentInfo.pSwapchains = m_swapchainHandles.data();
+    presentInfo.pImageIndices = m_imageIndices.data();
+
+    m_presentResults.resize(count);
+    presentInfo.pResults = m_presentResults.data();
+
+    VkResult result = m_device.present(presentInfo);
+
+    // Out of date swapchains are reported per swapchain, the others were presented
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR)
+        throw Exception("Failed to present the frame");
+
+    for (uint32_t i = 0; i < count; i++)
+        m_swapchains[i]->onPresent(m_presentResults[i]);
+}
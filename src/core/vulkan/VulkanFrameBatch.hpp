@@ -0,0 +1,62 @@
+#pragma once
+
+#include "VulkanSwapchain.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <mutex>
+#include <vector>
+
+class VulkanDevice;
+
+// Every Window's frame, submitted together.
+// Windows record on the job system threads and add() what they recorded, then submit() makes
+// one vkQueueSubmit signaling the frame fence, and one vkQueuePresentKHR for every swapchain.
+// Headless Windows' frames are in the submit, not in the present.
+// The graphics queue lock is taken twice per frame, whatever the number of Windows.
+class VulkanFrameBatch
+{
+  public:
+    explicit VulkanFrameBatch(VulkanDevice& device);
+
+    // Waits for the frame in flight to be free again (see VulkanDevice::beginFrame)
+    void begin(uint32_t frameIndex);
+
+    // `commandBuffer` renders to `frame`, acquired from `swapchain`. Thread safe
+    void add(VulkanSwapchain& swapchain, const VulkanSwapchain::Frame& frame, VkCommandBuffer commandBuffer);
+    // `commandBuffer` renders offscreen, nothing to wait on or present. Thread safe
+    void add(VkCommandBuffer commandBuffer);
+    // `frame` was acquired but won't be rendered: its acquire semaphore is waited on and nothing
+    // is presented (see VulkanSwapchain::discard). Thread safe
+    void discard(const VulkanSwapchain::Frame& frame);
+
+    void submit();
+
+    inline uint32_t getFrameIndex() const noexcept { return m_frameIndex; }
+
+  private:
+    VulkanDevice& m_device;
+    uint32_t m_frameIndex = 0;
+
+    std::mutex m_mutex;  // Guards add()
+
+    // One entry per added frame, reused from one frame to the next
+    std::vector<VulkanSwapchain*> m_swapchains;
+    std::vector<VkCommandBuffer> m_commandBuffers;
+    std::vector<VkSemaphore> m_waitSemaphores;  // Image acquisitions
+    std::vector<VkSemaphore> m_signalSemaphores;  // Render finished, the presents wait on them
+    std::vector<VkSwapchainKHR> m_swapchainHandles;
+    std::vector<uint32_t> m_imageIndices;
+
+    std::vector<VkCommandBuffer> m_offscreenCommandBuffers;
+    std::vector<VkSemaphore> m_discardedSemaphores;  // Image acquisitions of discarded frames
+
+    std::vector<VkSubmitInfo> m_submitInfos;
+    std::vector<VkPipelineStageFlags> m_waitStages;
+    std::vector<VkPipelineStageFlags> m_discardedStages;
+    std::vector<VkResult> m_presentResults;
+
+  public:
+    VulkanFrameBatch(const VulkanFrameBatch&) = delete;
+    void operator=(const VulkanFrameBatch&) = delete;
+};
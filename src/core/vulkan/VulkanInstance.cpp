@@ -2,16 +2,23 @@
 
 #include "VulkanDevice.hpp"
 #include "VulkanInstance.hpp"
+#include "VulkanLoader.hpp"
 #include "core/Logger.hpp"
+#include "core/Profiler.hpp"
 
 #include <vulkan/vulkan.hpp>
 
-#include <algorithm>
 #include <map>
 #include <memory>
 
-VulkanInstance::VulkanInstance()
+static const char* const s_validationLayers[] = {
+    "VK_LAYER_KHRONOS_validation"};
+
+VulkanInstance::VulkanInstance(const Settings& settings, JobSystem& jobSystem)
+    : m_messageFilter(settings.mutedValidationMessages), m_headless(settings.headless)
 {
+    PROFILE_FUNCTION();
+
     try {
 #ifdef NDEBUG
         m_usingValidationLayers = false;
@@ -19,7 +26,11 @@ VulkanInstance::VulkanInstance()
         m_usingValidationLayers = true;
 #endif
 
-        if (!glfwVulkanSupported())
+        // Already done by the Application, not by the tools
+        VulkanLoader::load();
+
+        // GLFW is not initialized in headless mode, vkCreateInstance will fail instead
+        if (!m_headless && !glfwVulkanSupported())
             throw Exception("Vulkan is not available on this machine");
 
         VkApplicationInfo appInfo = {};  // Default everything to 0
@@ -35,59 +46,49 @@ VulkanInstance::VulkanInstance()
         createInfo.pApplicationInfo = &appInfo;
 
 
-        // Get required extensions
-        auto requiredExtensions = getRequiredExtensions();
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
-        createInfo.ppEnabledExtensionNames = requiredExtensions.data();
+        m_capabilities = VulkanCapabilities::queryInstance();
+
+        // Surface extensions, every missing one is reported at once by checkRequired()
+        for (const char* extension : getRequiredExtensions())
+            m_capabilities.require(extension);
 
+        // Device UUIDs, which tell identical GPUs apart (see VulkanDevice::PhysicalDeviceInfo)
+        if (m_capabilities.enableIfPresent(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+            m_capabilities.enableIfPresent(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME);
 
-        // Get validation layer
-        std::vector<const char*> validationLayers;
         VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo = {};
-        if (m_usingValidationLayers) {
-            validationLayers = getValidationLayers();
-            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-            createInfo.ppEnabledLayerNames = validationLayers.data();
+        if (m_usingValidationLayers)
+            enableValidationLayers();  // May turn m_usingValidationLayers off
 
+        if (m_usingValidationLayers) {
             populateDebugMessenger(debugCreateInfo);
             createInfo.pNext = &debugCreateInfo;
         }
 
+        m_capabilities.checkRequired();
 
-        // Get supported extensions
-        uint32_t extensionCount = 0;
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);  // Set extensionCount
-        std::vector<VkExtensionProperties> extensions(extensionCount);
-        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());  // Use extentionCount
+        auto enabledExtensions = m_capabilities.getEnabled(VulkanCapabilities::Kind::EXTENSION);
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
-
-        // Check if every required extension is supported
-        std::vector<VkExtensionProperties> unsupportedExtensions;
-        for (unsigned i = 0; i < createInfo.enabledExtensionCount; i++) {
-            auto it = std::find_if(
-                extensions.begin(),
-                extensions.end(),
-                [&](const VkExtensionProperties& ext) {
-                    return std::strcmp(createInfo.ppEnabledExtensionNames[i], ext.extensionName) == 0;
-                });
-
-            if (it == extensions.end())
-                unsupportedExtensions.push_back(extensions[i]);
-        }
-
-        if (!unsupportedExtensions.empty()) {
-            std::string msg = "The following required Vulkan extensions are not supported:";
-            for (auto& ext : unsupportedExtensions)
-                msg += " " + std::string(ext.extensionName);
-
-            throw Exception(msg);
-        }
+        auto enabledLayers = m_capabilities.getEnabled(VulkanCapabilities::Kind::LAYER);
+        createInfo.enabledLayerCount = static_cast<uint32_t>(enabledLayers.size());
+        createInfo.ppEnabledLayerNames = enabledLayers.data();
 
 
         // Finally create the instance
+        PROFILE_SCOPE("vkCreateInstance");
         if (vkCreateInstance(&createInfo, nullptr, &m_vkInstance) != VK_SUCCESS)
             throw Exception("Failed to create Vulkan instance");
 
+        VulkanLoader::loadInstance(m_vkInstance);
+
+        // The loader resolves extension functions whether they are enabled or not
+        if (m_capabilities.isEnabled(VK_KHR_EXTERNAL_MEMORY_CAPABILITIES_EXTENSION_NAME)) {
+            m_getPhysicalDeviceProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+                vkGetInstanceProcAddr(m_vkInstance, "vkGetPhysicalDeviceProperties2KHR"));
+        }
+
 
         // After that, we can setup the debug callback
         if (m_usingValidationLayers) {
@@ -100,7 +101,7 @@ VulkanInstance::VulkanInstance()
 
         // We may want to catch the creation of the VulkanDevice separately because
         // it does not technically prevent the instance from being initialized
-        m_vkDevice = std::make_unique<VulkanDevice>(m_vkInstance);
+        m_vkDevice = std::make_unique<VulkanDevice>(*this, settings, jobSystem);
 
         LOG_TRACE("Initialized Vulkan instance");
 
@@ -114,8 +115,13 @@ VulkanInstance::~VulkanInstance()
 {
     LOG_TRACE("Destroying Vulkan instance");
 
-    if (m_usingValidationLayers)
+    // The device must go before the instance it was created from
+    m_vkDevice.reset();
+
+    if (m_usingValidationLayers) {
         destroyDebugMessenger();
+        m_messageFilter.logSummary();  // Repeats since the last periodic summary
+    }
 
     vkDestroyInstance(m_vkInstance, nullptr);
 }
@@ -147,14 +153,11 @@ void VulkanInstance::setupDebugMessenger()
 void VulkanInstance::populateDebugMessenger(VkDebugUtilsMessengerCreateInfoEXT& createInfo) const noexcept
 {
     createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-    createInfo.messageSeverity =
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT |
-        VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-    createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    // Only subscribe to what the logger would print, the layers skip formatting the rest
+    createInfo.messageSeverity = VulkanMessageFilter::getSeverityMask();
+    createInfo.messageType = VulkanMessageFilter::getTypeMask();
     createInfo.pfnUserCallback = VulkanInstance::debugVLCallback;
-    createInfo.pUserData = (void*)this;  // Passing this instance in case we need it. Unused for now
+    createInfo.pUserData = (void*)this;  // For the message filter
 }
 
 
@@ -174,60 +177,42 @@ void VulkanInstance::destroyDebugMessenger() noexcept
 }
 
 
-const std::vector<const char*> VulkanInstance::getValidationLayers() const noexcept
+void VulkanInstance::enableValidationLayers()
 {
-    std::vector<const char*> usingValidationLayers = {
-        "VK_LAYER_KHRONOS_validation"};
-
-
-    // Check layers validity/availability
-    uint32_t layerCount;
-    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-
-    std::vector<VkLayerProperties> availableLayers(layerCount);
-    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-
-    std::string removedLayers;
-    for (int i = usingValidationLayers.size() - 1; i >= 0; i--) {
-        auto it = std::find_if(
-            availableLayers.begin(),
-            availableLayers.end(),
-            [&](const VkLayerProperties& avLayer) {
-                return std::strcmp(usingValidationLayers[i], avLayer.layerName) == 0;
-            });
-
-        if (it == availableLayers.end()) {
-            removedLayers += " " + std::string(usingValidationLayers[i]);
-            usingValidationLayers.erase(usingValidationLayers.begin() + i);
-        }
+    // Without the messenger, the layers' messages would bypass the logger and its filter
+    if (!m_capabilities.enableIfPresent(VK_EXT_DEBUG_UTILS_EXTENSION_NAME)) {
+        LOG_WARN("{} is unsupported, running without validation layers", VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        m_usingValidationLayers = false;
+        return;
     }
 
-    if (!removedLayers.empty()) {
-        LOG_WARN(
-            "The following Vulkan validation layers are invalid or unsupported and were removed (see {}):{}",
-            __FUNCTION__,
-            removedLayers);
+    std::string removedLayers;
+    for (const char* layer : s_validationLayers) {
+        if (!m_capabilities.enableIfPresent(layer, VulkanCapabilities::Kind::LAYER))
+            removedLayers += " " + std::string(layer);
     }
 
-
-    return usingValidationLayers;
+    if (!removedLayers.empty())
+        LOG_WARN("The following Vulkan validation layers are unsupported and were not enabled:{}", removedLayers);
 }
 
 
 const std::vector<const char*> VulkanInstance::getRequiredExtensions() const
 {
-    uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
+    std::vector<const char*> requiredExtensions;
 
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    // Headless rendering goes to offscreen images, no surface extension is needed
+    if (!m_headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
 
-    if (glfwExtensions == NULL)
-        throw Exception("No Vulkan extensions for window surface creation. Application can't draw to screen");
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    std::vector<const char*> requiredExtensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        if (glfwExtensions == NULL)
+            throw Exception("No Vulkan extensions for window surface creation. Application can't draw to screen");
 
-    if (m_usingValidationLayers)
-        requiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+        requiredExtensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     return requiredExtensions;
 }
@@ -239,32 +224,10 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanInstance::debugVLCallback(
     const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
     void* pUserData)
 {
-    // pUserData is "this" for now
-
-    switch (messageSeverity) {
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
-        //LOG_DEBUG("[Vulkan] ", pCallbackData->pMessage);
-        LOG_DEBUG("[Vulkan API Debug] {}", pCallbackData->pMessage);
-        break;
-
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-        //LOG_INFO(pCallbackData->pMessage);
-        LOG_DEBUG("[Vulkan API Info] {}", pCallbackData->pMessage);
-        break;
-
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-        //LOG_WARN(pCallbackData->pMessage);
-        LOG_DEBUG("[Vulkan API Warn] {}", pCallbackData->pMessage);
-        break;
-
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-        //LOG_ERROR(pCallbackData->pMessage);
-        LOG_DEBUG("[Vulkan API Error] {}", pCallbackData->pMessage);
-        break;
-
-    default:
-        break;
-    }
+    auto instance = static_cast<VulkanInstance*>(pUserData);
+
+    if (instance->m_messageFilter.shouldLog(messageSeverity, pCallbackData))
+        VulkanMessageFilter::logMessage(messageSeverity, pCallbackData->pMessage);
 
     return VK_FALSE;
 }
@@ -1,30 +1,34 @@
 #pragma once
 
+#include "VulkanCapabilities.hpp"
+#include "VulkanMessageFilter.hpp"
+#include "core/Settings.hpp"
+
 #include <vulkan/vulkan.hpp>
 
-#include <optional>
 #include <memory>
 
+class JobSystem;
 class VulkanDevice;
 class VulkanInstance
 {
   public:
-    VulkanInstance();
+    VulkanInstance(const Settings& settings, JobSystem& jobSystem);
     ~VulkanInstance();
 
-  private:
-    struct QueueFamilyIndices
-    {
-        std::optional<uint32_t> graphicsFamilyIndex;
-        inline bool isComplete() const noexcept { return graphicsFamilyIndex.has_value(); }
-    };
+    inline VkInstance getHandle() const noexcept { return m_vkInstance; }
+    inline VulkanDevice& getDevice() noexcept { return *m_vkDevice; }
+    inline const VulkanCapabilities& getCapabilities() const noexcept { return m_capabilities; }
+    inline VulkanMessageFilter& getMessageFilter() noexcept { return m_messageFilter; }  // Idle without validation layers
+    // vkGetPhysicalDeviceProperties2KHR, nullptr when device IDs can't be queried (extensions missing)
+    inline PFN_vkGetPhysicalDeviceProperties2KHR getPhysicalDeviceProperties2() const noexcept { return m_getPhysicalDeviceProperties2; }
 
   private:
     void setupDebugMessenger();
     void populateDebugMessenger(VkDebugUtilsMessengerCreateInfoEXT& createInfo) const noexcept;
     void destroyDebugMessenger() noexcept;
 
-    const std::vector<const char*> getValidationLayers() const noexcept;
+    void enableValidationLayers();
     const std::vector<const char*> getRequiredExtensions() const;
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugVLCallback(
@@ -35,10 +39,14 @@ class VulkanInstance
 
   private:
     VkInstance m_vkInstance;
+    VulkanCapabilities m_capabilities;  // What was enabled at creation
+    PFN_vkGetPhysicalDeviceProperties2KHR m_getPhysicalDeviceProperties2 = nullptr;
     std::unique_ptr<VulkanDevice> m_vkDevice;
 
     VkDebugUtilsMessengerEXT m_debugMessenger = nullptr;
+    VulkanMessageFilter m_messageFilter;
     bool m_usingValidationLayers;
+    bool m_headless;
 
   public:
     VulkanInstance(const VulkanInstance&) = delete;
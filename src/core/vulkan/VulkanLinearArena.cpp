@@ -0,0 +1,74 @@
+#include "pch.hpp"
+
+#include "VulkanLinearArena.hpp"
+
+VulkanLinearArena::VulkanLinearArena(
+    VulkanAllocator& allocator,
+    VkDeviceSize frameSize,
+    VkBufferUsageFlags usage,
+    uint32_t frameCount,
+    VkDeviceSize minAlignment)
+    : m_allocator(allocator), m_frameSize(frameSize), m_minAlignment(std::max<VkDeviceSize>(minAlignment, 1)), m_frames(frameCount)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = frameSize;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    try {
+        for (auto& frame : m_frames)
+            frame.allocation = m_allocator.createBuffer(bufferInfo, VulkanAllocator::MemoryUsage::CPU_TO_GPU, frame.buffer);
+
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to create linear arena");
+
+        // The destructor won't run
+        for (auto& frame : m_frames) {
+            if (frame.buffer != VK_NULL_HANDLE)
+                m_allocator.destroyBuffer(frame.buffer, frame.allocation);
+        }
+
+        throw;
+    }
+
+    beginFrame(0);
+}
+
+
+VulkanLinearArena::~VulkanLinearArena()
+{
+    LOG_DEBUG("Linear arena peak usage: {} / {} bytes per frame", getPeakUsage(), m_frameSize);
+
+    for (auto& frame : m_frames)
+        m_allocator.destroyBuffer(frame.buffer, frame.allocation);
+}
+
+// public
+
+void VulkanLinearArena::beginFrame(uint32_t frameIndex) noexcept
+{
+    m_currentFrame = &m_frames[frameIndex % m_frames.size()];
+    m_head.store(0, std::memory_order_relaxed);
+}
+
+
+VulkanLinearArena::Suballocation VulkanLinearArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    alignment = std::max(alignment, m_minAlignment);
+
+    // A thread losing the race retries from where the winner left the head
+    VkDeviceSize head = m_head.load(std::memory_order_relaxed);
+    VkDeviceSize offset;
+    do {
+        offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + size > m_frameSize)
+            throw Exception("Linear arena out of memory (" + std::to_string(offset + size) + " / " + std::to_string(m_frameSize) + " bytes)");
+    } while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+    VkDeviceSize peak = m_peakUsage.load(std::memory_order_relaxed);
+    while (peak < offset + size && !m_peakUsage.compare_exchange_weak(peak, offset + size, std::memory_order_relaxed)) {
+    }
+
+    return {m_currentFrame->buffer, offset, static_cast<char*>(m_currentFrame->allocation->mappedData) + offset};
+}
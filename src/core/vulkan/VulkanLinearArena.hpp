@@ -0,0 +1,59 @@
+#pragma once
+
+#include "VulkanAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <vector>
+
+#define LINEAR_ARENA_DEFAULT_FRAME_SIZE (4ull << 20)
+
+// Bump allocator for per-frame transient data (uniforms, dynamic vertices, staging).
+// Each frame in flight owns one persistently mapped buffer, beginFrame() rewinds it once the
+// device is done with that frame's previous content. Allocating is an atomic pointer bump, from
+// any thread, there is nothing to free.
+class VulkanLinearArena
+{
+  public:
+    struct Suballocation
+    {
+        VkBuffer buffer;
+        VkDeviceSize offset;
+        void* data;
+    };
+
+  public:
+    // `minAlignment` applies to every suballocation (ex. minUniformBufferOffsetAlignment)
+    VulkanLinearArena(VulkanAllocator& allocator, VkDeviceSize frameSize, VkBufferUsageFlags usage, uint32_t frameCount, VkDeviceSize minAlignment);
+    ~VulkanLinearArena();
+
+    // The frame must not be used by the device anymore. Not while other threads allocate
+    void beginFrame(uint32_t frameIndex) noexcept;
+    // Thread safe
+    Suballocation allocate(VkDeviceSize size, VkDeviceSize alignment = 1);
+
+    inline VkDeviceSize getFrameSize() const noexcept { return m_frameSize; }
+    inline VkDeviceSize getPeakUsage() const noexcept { return m_peakUsage.load(std::memory_order_relaxed); }
+
+  private:
+    struct Frame
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VulkanAllocator::Allocation* allocation = nullptr;
+    };
+
+  private:
+    VulkanAllocator& m_allocator;
+    VkDeviceSize m_frameSize;
+    VkDeviceSize m_minAlignment;
+
+    std::vector<Frame> m_frames;
+    Frame* m_currentFrame = nullptr;
+    std::atomic<VkDeviceSize> m_head{0};
+    std::atomic<VkDeviceSize> m_peakUsage{0};
+
+  public:
+    VulkanLinearArena(const VulkanLinearArena&) = delete;
+    void operator=(const VulkanLinearArena&) = delete;
+};
@@ -0,0 +1,97 @@
+#include "pch.hpp"
+
+#include "VulkanLoader.hpp"
+
+#include <dlfcn.h>
+
+#include <mutex>
+
+#define VULKAN_DEFINE_FUNCTION(name) PFN_##name name = nullptr;
+PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_INSTANCE_EXTENSION_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+VULKAN_DEVICE_EXTENSION_FUNCTIONS(VULKAN_DEFINE_FUNCTION)
+#undef VULKAN_DEFINE_FUNCTION
+
+// Initializing static members
+void* VulkanLoader::s_library = nullptr;
+const char* VulkanLoader::s_libraryName = nullptr;
+
+// In order of preference, the versioned name is the one installed without development files
+#ifdef __APPLE__
+static const char* const s_libraryNames[] = {"libvulkan.1.dylib", "libvulkan.dylib", "libMoltenVK.dylib"};
+#else
+static const char* const s_libraryNames[] = {"libvulkan.so.1", "libvulkan.so"};
+#endif
+
+// public
+
+void VulkanLoader::load()
+{
+    static std::once_flag s_loaded;
+    std::call_once(s_loaded, []() {
+        std::string tried;
+        for (const char* name : s_libraryNames) {
+            s_library = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+            if (s_library) {
+                s_libraryName = name;
+                break;
+            }
+
+            tried += " " + std::string(name);
+        }
+
+        if (!s_library)
+            throw Exception("No Vulkan library found (tried" + tried + "), install a Vulkan driver and its loader");
+
+        vkGetInstanceProcAddr = reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(s_library, "vkGetInstanceProcAddr"));
+        if (!vkGetInstanceProcAddr)
+            throw Exception(fmt::format("{} does not export vkGetInstanceProcAddr, it is not a Vulkan loader", s_libraryName));
+
+#define VULKAN_LOAD_GLOBAL(name)                                                                  \
+    name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(VK_NULL_HANDLE, #name));            \
+    if (!name)                                                                                     \
+        throw Exception(fmt::format("The Vulkan loader {} lacks " #name, s_libraryName));
+        VULKAN_GLOBAL_FUNCTIONS(VULKAN_LOAD_GLOBAL)
+#undef VULKAN_LOAD_GLOBAL
+
+        LOG_TRACE("Loaded the Vulkan loader {}", s_libraryName);
+    });
+}
+
+
+void VulkanLoader::loadInstance(VkInstance instance)
+{
+#define VULKAN_LOAD_INSTANCE(name)                                                     \
+    name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));        \
+    if (!name)                                                                          \
+        throw Exception("The Vulkan instance lacks " #name);
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE)
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_INSTANCE)
+#undef VULKAN_LOAD_INSTANCE
+
+#define VULKAN_LOAD_INSTANCE_EXTENSION(name) \
+    name = reinterpret_cast<PFN_##name>(vkGetInstanceProcAddr(instance, #name));
+    VULKAN_INSTANCE_EXTENSION_FUNCTIONS(VULKAN_LOAD_INSTANCE_EXTENSION)
+    VULKAN_DEVICE_EXTENSION_FUNCTIONS(VULKAN_LOAD_INSTANCE_EXTENSION)
+#undef VULKAN_LOAD_INSTANCE_EXTENSION
+}
+
+// VulkanDeviceDispatch
+
+void VulkanDeviceDispatch::load(VkDevice device)
+{
+#define VULKAN_LOAD_DEVICE(name)                                                   \
+    name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));        \
+    if (!name)                                                                      \
+        throw Exception("The Vulkan device lacks " #name);
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE)
+#undef VULKAN_LOAD_DEVICE
+
+#define VULKAN_LOAD_DEVICE_EXTENSION(name) \
+    name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+    VULKAN_DEVICE_EXTENSION_FUNCTIONS(VULKAN_LOAD_DEVICE_EXTENSION)
+#undef VULKAN_LOAD_DEVICE_EXTENSION
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+// The vk* functions below are pointers filled at runtime, the loader library's exported
+// prototypes would collide with them
+#ifndef VK_NO_PROTOTYPES
+#error "Build with VK_NO_PROTOTYPES defined (see premake5.lua)"
+#endif
+
+#include <vulkan/vulkan.h>
+
+// Resolved with vkGetInstanceProcAddr(nullptr, ...)
+#define VULKAN_GLOBAL_FUNCTIONS(X)              \
+    X(vkCreateInstance)                         \
+    X(vkEnumerateInstanceExtensionProperties)   \
+    X(vkEnumerateInstanceLayerProperties)
+
+// Resolved with vkGetInstanceProcAddr(instance, ...)
+#define VULKAN_INSTANCE_FUNCTIONS(X)            \
+    X(vkDestroyInstance)                        \
+    X(vkEnumeratePhysicalDevices)               \
+    X(vkGetPhysicalDeviceProperties)            \
+    X(vkGetPhysicalDeviceFeatures)              \
+    X(vkGetPhysicalDeviceMemoryProperties)      \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceFormatProperties)      \
+    X(vkEnumerateDeviceExtensionProperties)     \
+    X(vkCreateDevice)                           \
+    X(vkGetDeviceProcAddr)
+
+// VK_KHR_surface, nullptr when headless. Extensions that may be left disabled are resolved by
+// their user instead (see VulkanInstance::getPhysicalDeviceProperties2)
+#define VULKAN_INSTANCE_EXTENSION_FUNCTIONS(X)       \
+    X(vkDestroySurfaceKHR)                           \
+    X(vkGetPhysicalDeviceSurfaceSupportKHR)          \
+    X(vkGetPhysicalDeviceSurfaceCapabilitiesKHR)     \
+    X(vkGetPhysicalDeviceSurfaceFormatsKHR)          \
+    X(vkGetPhysicalDeviceSurfacePresentModesKHR)
+
+// Resolved with vkGetDeviceProcAddr(device, ...) in a VulkanDeviceDispatch, and as loader
+// trampolines with vkGetInstanceProcAddr(instance, ...) for the global pointers
+#define VULKAN_DEVICE_FUNCTIONS(X)     \
+    X(vkDestroyDevice)                 \
+    X(vkGetDeviceQueue)                \
+    X(vkQueueSubmit)                   \
+    X(vkDeviceWaitIdle)                \
+    X(vkAllocateMemory)                \
+    X(vkFreeMemory)                    \
+    X(vkMapMemory)                     \
+    X(vkBindBufferMemory)              \
+    X(vkBindImageMemory)               \
+    X(vkGetBufferMemoryRequirements)   \
+    X(vkGetImageMemoryRequirements)    \
+    X(vkCreateFence)                   \
+    X(vkDestroyFence)                  \
+    X(vkResetFences)                   \
+    X(vkGetFenceStatus)                \
+    X(vkWaitForFences)                 \
+    X(vkCreateSemaphore)               \
+    X(vkDestroySemaphore)              \
+    X(vkCreateQueryPool)               \
+    X(vkDestroyQueryPool)              \
+    X(vkGetQueryPoolResults)           \
+    X(vkCreateBuffer)                  \
+    X(vkDestroyBuffer)                 \
+    X(vkCreateImage)                   \
+    X(vkDestroyImage)                  \
+    X(vkCreateImageView)               \
+    X(vkDestroyImageView)              \
+    X(vkCreateShaderModule)            \
+    X(vkDestroyShaderModule)           \
+    X(vkCreatePipelineCache)           \
+    X(vkDestroyPipelineCache)          \
+    X(vkGetPipelineCacheData)          \
+    X(vkCreateGraphicsPipelines)       \
+    X(vkDestroyPipeline)               \
+    X(vkCreatePipelineLayout)          \
+    X(vkDestroyPipelineLayout)         \
+    X(vkCreateDescriptorSetLayout)     \
+    X(vkDestroyDescriptorSetLayout)    \
+    X(vkCreateDescriptorPool)          \
+    X(vkDestroyDescriptorPool)         \
+    X(vkResetDescriptorPool)           \
+    X(vkAllocateDescriptorSets)        \
+    X(vkUpdateDescriptorSets)          \
+    X(vkCreateFramebuffer)             \
+    X(vkDestroyFramebuffer)            \
+    X(vkCreateRenderPass)              \
+    X(vkDestroyRenderPass)             \
+    X(vkCreateCommandPool)             \
+    X(vkDestroyCommandPool)            \
+    X(vkResetCommandPool)              \
+    X(vkAllocateCommandBuffers)        \
+    X(vkBeginCommandBuffer)            \
+    X(vkEndCommandBuffer)              \
+    X(vkCmdPipelineBarrier)            \
+    X(vkCmdBindPipeline)               \
+    X(vkCmdBindDescriptorSets)         \
+    X(vkCmdSetViewport)                \
+    X(vkCmdDraw)                       \
+    X(vkCmdCopyBuffer)                 \
+    X(vkCmdCopyBufferToImage)          \
+    X(vkCmdCopyImage)                  \
+    X(vkCmdClearColorImage)            \
+    X(vkCmdBeginRenderPass)            \
+    X(vkCmdEndRenderPass)              \
+    X(vkCmdExecuteCommands)            \
+    X(vkCmdPushConstants)              \
+    X(vkCmdSetScissor)                 \
+    X(vkCmdResetQueryPool)             \
+    X(vkCmdWriteTimestamp)
+
+// VK_KHR_swapchain and VK_KHR_descriptor_update_template, nullptr when not enabled
+#define VULKAN_DEVICE_EXTENSION_FUNCTIONS(X)    \
+    X(vkCreateSwapchainKHR)                     \
+    X(vkDestroySwapchainKHR)                    \
+    X(vkGetSwapchainImagesKHR)                  \
+    X(vkAcquireNextImageKHR)                    \
+    X(vkQueuePresentKHR)                        \
+    X(vkCreateDescriptorUpdateTemplateKHR)      \
+    X(vkDestroyDescriptorUpdateTemplateKHR)     \
+    X(vkUpdateDescriptorSetWithTemplateKHR)
+
+#define VULKAN_DECLARE_FUNCTION(name) extern PFN_##name name;
+extern PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr;
+VULKAN_GLOBAL_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_INSTANCE_EXTENSION_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+VULKAN_DEVICE_EXTENSION_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+#undef VULKAN_DECLARE_FUNCTION
+
+// Device functions of one VkDevice, as returned by vkGetDeviceProcAddr: the driver's (or the
+// first layer's) entry points, without the loader's trampoline and its dispatch. Recording and
+// submission call through VulkanDevice::getDispatch(), creation and destruction through the
+// global pointers
+struct VulkanDeviceDispatch
+{
+#define VULKAN_DISPATCH_MEMBER(name) PFN_##name name = nullptr;
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+    VULKAN_DEVICE_EXTENSION_FUNCTIONS(VULKAN_DISPATCH_MEMBER)
+#undef VULKAN_DISPATCH_MEMBER
+
+    // Throws if a core function is missing
+    void load(VkDevice device);
+};
+
+// Meta-loader: the Vulkan loader library is opened at runtime rather than linked, so a
+// machine without it gets an error message instead of a dynamic linker failure, and every
+// vk* function is a pointer resolved through vkGetInstanceProcAddr.
+// The global pointers of device functions are loader trampolines, valid for every device
+class VulkanLoader
+{
+  public:
+    // Opens the library and resolves the global functions, once. Thread safe
+    static void load();
+    // Resolves the instance functions, and the device ones as trampolines. Any instance
+    // resolves the same trampolines, the last one created wins
+    static void loadInstance(VkInstance instance);
+
+    static inline const char* getLibraryName() noexcept { return s_libraryName; }
+
+  private:
+    static void* s_library;  // Never closed, the pointers stay valid until exit
+    static const char* s_libraryName;
+};
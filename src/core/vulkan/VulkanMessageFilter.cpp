@@ -0,0 +1,165 @@
+#include "pch.hpp"
+
+#include "VulkanMessageFilter.hpp"
+#include "core/Hash.hpp"
+#include "core/Logger.hpp"
+
+#include <cstring>
+#include <string_view>
+
+VulkanMessageFilter::VulkanMessageFilter(const std::vector<std::string>& mutedMessages)
+    : m_lastSummary(std::chrono::steady_clock::now())
+{
+    for (auto& m : mutedMessages) {
+        try {
+            size_t end = 0;
+            long long id = std::stoll(m, &end, 0);  // Accepts decimal and 0x prefixed hex
+
+            if (end == m.size()) {
+                // IDs are printed unsigned but reported as int32_t by the layers
+                m_mutedIDs.insert(static_cast<int32_t>(id));
+                continue;
+            }
+        } catch (const std::exception& ex) {
+            // Not a number, must be an ID name
+        }
+
+        m_mutedNames.insert(m);
+    }
+
+    if (!mutedMessages.empty())
+        LOG_TRACE("Muted {} Vulkan debug message IDs", mutedMessages.size());
+}
+
+// public
+
+bool VulkanMessageFilter::shouldLog(
+    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData)
+{
+    if (m_mutedIDs.count(pCallbackData->messageIdNumber))
+        return false;
+
+    if (!m_mutedNames.empty() && pCallbackData->pMessageIdName && m_mutedNames.count(pCallbackData->pMessageIdName))
+        return false;
+
+    // The same ID comes with other objects and values in its text, and loader messages all
+    // come with ID 0: both are told apart by text
+    const char* message = pCallbackData->pMessage ? pCallbackData->pMessage : "";
+    uint64_t key = hashBytes(message, std::strlen(message), hashValue(pCallbackData->messageIdNumber));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& stats = m_stats[key];
+    if (stats.count++ > 0) {
+        ++stats.repeatsSinceSummary;
+        m_pendingRepeats.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    stats.name = pCallbackData->pMessageIdName ? pCallbackData->pMessageIdName : "";
+    stats.id = pCallbackData->messageIdNumber;
+    stats.severity = messageSeverity;
+    return true;
+}
+
+
+void VulkanMessageFilter::update()
+{
+    if (m_pendingRepeats.load(std::memory_order_relaxed) == 0)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::chrono::steady_clock::now() - m_lastSummary < std::chrono::seconds(VALIDATION_SUMMARY_INTERVAL))
+            return;
+    }
+
+    logSummary();
+}
+
+
+void VulkanMessageFilter::logSummary()
+{
+    for (auto& line : collectSummary())
+        logMessage(line.first, line.second);
+}
+
+
+VkDebugUtilsMessageSeverityFlagsEXT VulkanMessageFilter::getSeverityMask() noexcept
+{
+    int level = std::min<int>(Logger::instance().getLoggingLevel(), LOG_COMPILE_LEVEL);
+
+    // Errors are always subscribed to, a messenger must have at least one severity
+    VkDebugUtilsMessageSeverityFlagsEXT mask = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (level >= Logger::LogLevel::LOG_WARN) mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    if (level >= Logger::LogLevel::LOG_DEBUG) mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    if (level >= Logger::LogLevel::LOG_TRACE) mask |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+
+    return mask;
+}
+
+
+VkDebugUtilsMessageTypeFlagsEXT VulkanMessageFilter::getTypeMask() noexcept
+{
+    int level = std::min<int>(Logger::instance().getLoggingLevel(), LOG_COMPILE_LEVEL);
+
+    VkDebugUtilsMessageTypeFlagsEXT mask = VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+    if (level >= Logger::LogLevel::LOG_DEBUG) mask |= VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT;  // Loader and layer chatter
+
+    return mask;
+}
+
+
+void VulkanMessageFilter::logMessage(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, std::string_view message)
+{
+    switch (messageSeverity) {
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT:
+        LOG_TRACE("[Vulkan API Debug] {}", message);
+        break;
+
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
+        LOG_DEBUG("[Vulkan API Info] {}", message);
+        break;
+
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+        LOG_WARN("[Vulkan API Warn] {}", message);
+        break;
+
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
+        LOG_ERROR("[Vulkan API Error] {}", message);
+        break;
+
+    default:
+        break;
+    }
+}
+
+// private
+
+std::vector<VulkanMessageFilter::SummaryLine> VulkanMessageFilter::collectSummary()
+{
+    std::vector<SummaryLine> lines;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& s : m_stats) {
+        auto& stats = s.second;
+        if (stats.repeatsSinceSummary == 0) continue;
+
+        lines.emplace_back(
+            stats.severity,
+            fmt::format(
+                "Message {} (0x{:08x}) repeated {} more times ({} total)",
+                stats.name.empty() ? "<unnamed>" : stats.name,
+                static_cast<uint32_t>(stats.id),
+                stats.repeatsSinceSummary,
+                stats.count));
+
+        stats.repeatsSinceSummary = 0;
+    }
+
+    m_pendingRepeats.store(0, std::memory_order_relaxed);
+    m_lastSummary = std::chrono::steady_clock::now();
+
+    return lines;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define VALIDATION_SUMMARY_INTERVAL 5  // Seconds between two summaries of repeated messages
+
+// Decides which debug messenger messages are worth logging.
+// Each message is identified by its ID number and a hash of its text: one ID reported about
+// different objects is logged once per object. Only the first occurrence is logged, repeats
+// are counted and summed up by update() and logSummary(). Muted IDs are never logged.
+class VulkanMessageFilter
+{
+  public:
+    // `mutedMessages` holds ID numbers (decimal or 0x hex) or ID names (VUID-...)
+    explicit VulkanMessageFilter(const std::vector<std::string>& mutedMessages);
+
+    // Thread safe, layers may call the messenger from any thread
+    bool shouldLog(
+        VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+        const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData);
+
+    // Once per frame: logs the repeats every VALIDATION_SUMMARY_INTERVAL seconds
+    void update();
+    void logSummary();
+
+    // Severity and type masks worth subscribing to at the current logging level
+    static VkDebugUtilsMessageSeverityFlagsEXT getSeverityMask() noexcept;
+    static VkDebugUtilsMessageTypeFlagsEXT getTypeMask() noexcept;
+    static void logMessage(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, std::string_view message);
+
+  private:
+    struct MessageStats
+    {
+        std::string name;
+        int32_t id;
+        VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+        uint64_t count = 0;
+        uint64_t repeatsSinceSummary = 0;
+    };
+
+  private:
+    using SummaryLine = std::pair<VkDebugUtilsMessageSeverityFlagBitsEXT, std::string>;
+    std::vector<SummaryLine> collectSummary();
+
+  private:
+    std::unordered_set<int32_t> m_mutedIDs;
+    std::unordered_set<std::string> m_mutedNames;
+
+    std::mutex m_mutex;
+    std::unordered_map<uint64_t, MessageStats> m_stats;  // By ID and text hash
+    std::chrono::steady_clock::time_point m_lastSummary;
+    std::atomic<uint64_t> m_pendingRepeats{0};  // Lets update() skip the lock
+
+  public:
+    VulkanMessageFilter(const VulkanMessageFilter&) = delete;
+    void operator=(const VulkanMessageFilter&) = delete;
+};
@@ -0,0 +1,229 @@
+#include "pch.hpp"
+
+#include "VulkanPipelineCache.hpp"
+#include "core/Hash.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PIPELINE_CACHE_MAGIC 0x43505654  // "TVPC"
+#define PIPELINE_CACHE_VERSION 1
+
+VulkanPipelineCache::VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, const std::string& path)
+    : m_device(device), m_deviceProperties(deviceProperties), m_path(path)
+{
+    if (!m_path.empty())
+        loadFromFile();
+
+    // Nothing usable on disk
+    if (m_pipelineCache == VK_NULL_HANDLE)
+        create(nullptr, 0);
+
+    LOG_TRACE("Initialized pipeline cache ({} bytes reused)", m_loadedSize);
+}
+
+
+VulkanPipelineCache::~VulkanPipelineCache()
+{
+    LOG_TRACE("Destroying pipeline cache");
+
+    try {
+        save();
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to save pipeline cache\n{}", ex.what());
+    }
+
+#if LOG_DEBUG_ENABLED
+    auto stats = getStats();
+    LOG_DEBUG(
+        "Pipeline cache: {} bytes loaded, {} bytes saved, {} hits / {} misses ({:.1f}% hit rate)",
+        stats.loadedSize,
+        stats.savedSize,
+        stats.hits,
+        stats.misses,
+        100.0 * stats.getHitRate());
+#endif
+
+    vkDestroyPipelineCache(m_device, m_pipelineCache, nullptr);
+}
+
+// public
+
+void VulkanPipelineCache::save()
+{
+    if (m_path.empty()) return;
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+        throw Exception("Failed to query pipeline cache size");
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(m_device, m_pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+        throw Exception("Failed to read pipeline cache data");
+
+    FileHeader header = makeHeader(data.data(), dataSize);
+
+    // Write everything aside, then atomically replace the previous file
+    std::string tmpPath = m_path + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw Exception("Could not open \"" + tmpPath + "\": " + std::strerror(errno));
+
+    auto writeAll = [&](const void* buffer, size_t size) {
+        auto bytes = static_cast<const char*>(buffer);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    };
+
+    bool ok = writeAll(&header, sizeof(header)) && writeAll(data.data(), dataSize) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+
+    if (!ok || std::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+        std::string error = std::strerror(errno);
+        unlink(tmpPath.c_str());
+        throw Exception("Could not write \"" + m_path + "\": " + error);
+    }
+
+    m_savedSize = dataSize;
+    LOG_TRACE("Saved pipeline cache to \"{}\" ({} bytes)", m_path, dataSize);
+}
+
+
+void VulkanPipelineCache::recordCreationFeedback(const VkPipelineCreationFeedbackEXT& feedback) noexcept
+{
+    if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+        return;
+
+    if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    else
+        m_misses.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+VulkanPipelineCache::Stats VulkanPipelineCache::getStats() const noexcept
+{
+    Stats stats;
+    stats.loadedSize = m_loadedSize;
+    stats.savedSize = m_savedSize;
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// private
+
+void VulkanPipelineCache::create(const void* initialData, size_t initialDataSize)
+{
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = initialDataSize;
+    createInfo.pInitialData = initialData;
+
+    if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_pipelineCache) != VK_SUCCESS) {
+        m_pipelineCache = VK_NULL_HANDLE;
+        throw Exception("Failed to create pipeline cache");
+    }
+}
+
+
+void VulkanPipelineCache::loadFromFile()
+{
+    int fd = open(m_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_TRACE("No pipeline cache found at \"{}\"", m_path);
+        return;
+    }
+
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+    size_t fileSize = 0;
+
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        fileSize = static_cast<size_t>(fileStat.st_size);
+        mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);  // The mapping stays valid
+
+    if (mapping == MAP_FAILED) {
+        LOG_WARN("Could not map pipeline cache \"{}\", starting with an empty one", m_path);
+        return;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, mapping, std::min(sizeof(header), fileSize));
+
+    const char* data = static_cast<const char*>(mapping) + sizeof(header);
+    if (fileSize >= sizeof(header) && isHeaderValid(header, fileSize) && isDataValid(data, header.dataSize, header.checksum)) {
+        try {
+            create(data, header.dataSize);
+            m_loadedSize = header.dataSize;
+        } catch (const Exception& ex) {
+            LOG_WARN("Driver rejected pipeline cache \"{}\", starting with an empty one", m_path);
+        }
+    } else {
+        LOG_DEBUG("Discarding pipeline cache \"{}\": other device or driver, or corrupt", m_path);
+    }
+
+    munmap(mapping, fileSize);
+}
+
+
+bool VulkanPipelineCache::isHeaderValid(const FileHeader& header, size_t fileSize) const noexcept
+{
+    return header.magic == PIPELINE_CACHE_MAGIC &&
+           header.version == PIPELINE_CACHE_VERSION &&
+           header.vendorID == m_deviceProperties.vendorID &&
+           header.deviceID == m_deviceProperties.deviceID &&
+           header.driverVersion == m_deviceProperties.driverVersion &&
+           std::memcmp(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+           header.dataSize == fileSize - sizeof(FileHeader);
+}
+
+
+bool VulkanPipelineCache::isDataValid(const void* data, size_t size, uint64_t expectedChecksum) const noexcept
+{
+    // The driver's own header must agree too, some drivers don't check it thoroughly
+    VkPipelineCacheHeaderVersionOne vkHeader;
+    if (size < sizeof(vkHeader)) return false;
+    std::memcpy(&vkHeader, data, sizeof(vkHeader));
+
+    return vkHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           vkHeader.vendorID == m_deviceProperties.vendorID &&
+           vkHeader.deviceID == m_deviceProperties.deviceID &&
+           std::memcmp(vkHeader.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+           checksum(data, size) == expectedChecksum;
+}
+
+
+VulkanPipelineCache::FileHeader VulkanPipelineCache::makeHeader(const void* data, size_t size) const noexcept
+{
+    FileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendorID = m_deviceProperties.vendorID;
+    header.deviceID = m_deviceProperties.deviceID;
+    header.driverVersion = m_deviceProperties.driverVersion;
+    std::memcpy(header.pipelineCacheUUID, m_deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = size;
+    header.checksum = checksum(data, size);
+    return header;
+}
+
+
+uint64_t VulkanPipelineCache::checksum(const void* data, size_t size) noexcept
+{
+    return hashBytes(data, size);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <string>
+
+// VkPipelineCache persisted to disk between runs.
+// The file starts with a header identifying the device and driver that produced it
+// (plus a checksum), a cache from another device, driver or a corrupt file is discarded.
+// Loading maps the file in memory and hands the mapping straight to the driver.
+// Saving writes a temporary file and renames it over the old one, so a crash never
+// leaves a truncated cache behind.
+class VulkanPipelineCache
+{
+  public:
+    struct Stats
+    {
+        size_t loadedSize = 0;  // Bytes of pipeline data reused from the previous run
+        size_t savedSize = 0;
+        uint64_t hits = 0;  // Pipeline creations reported as cache hits (needs VK_EXT_pipeline_creation_feedback)
+        uint64_t misses = 0;
+        inline double getHitRate() const noexcept { return hits + misses > 0 ? double(hits) / (hits + misses) : 0.0; }
+    };
+
+  public:
+    // An empty `path` keeps the cache in memory only
+    VulkanPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& deviceProperties, const std::string& path);
+    ~VulkanPipelineCache();  // Saves the cache
+
+    void save();
+    void recordCreationFeedback(const VkPipelineCreationFeedbackEXT& feedback) noexcept;
+
+    inline VkPipelineCache getHandle() const noexcept { return m_pipelineCache; }
+    Stats getStats() const noexcept;
+
+  private:
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint32_t reserved;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t checksum;  // FNV-1a of the data
+    };
+
+  private:
+    void create(const void* initialData, size_t initialDataSize);
+    void loadFromFile();
+
+    bool isHeaderValid(const FileHeader& header, size_t fileSize) const noexcept;
+    bool isDataValid(const void* data, size_t size, uint64_t expectedChecksum) const noexcept;
+    FileHeader makeHeader(const void* data, size_t size) const noexcept;
+    static uint64_t checksum(const void* data, size_t size) noexcept;
+
+  private:
+    VkDevice m_device;
+    VkPhysicalDeviceProperties m_deviceProperties;
+    std::string m_path;
+    VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+
+    size_t m_loadedSize = 0;
+    size_t m_savedSize = 0;
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+
+  public:
+    VulkanPipelineCache(const VulkanPipelineCache&) = delete;
+    void operator=(const VulkanPipelineCache&) = delete;
+};
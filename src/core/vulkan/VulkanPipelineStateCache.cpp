@@ -0,0 +1,610 @@
+#include "pch.hpp"
+
+#include "VulkanPipelineStateCache.hpp"
+#include "core/Hash.hpp"
+#include "core/Profiler.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include <cstring>
+
+template <typename T>
+static bool equalArrays(const std::vector<T>& a, const std::vector<T>& b) noexcept
+{
+    return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+
+template <typename T>
+static uint64_t hashArray(const std::vector<T>& values, uint64_t hash) noexcept
+{
+    hash = hashValue(values.size(), hash);
+    return hashBytes(values.data(), values.size() * sizeof(T), hash);
+}
+
+
+static bool isSameShader(const VulkanShader& a, const VulkanShader& b) noexcept
+{
+    return a.getPath() == b.getPath() && a.getDefines() == b.getDefines();
+}
+
+
+VulkanPipelineStateCache::VulkanPipelineStateCache(
+    VkDevice device,
+    VulkanPipelineCache& pipelineCache,
+    VulkanShaderLibrary& shaderLibrary,
+    JobSystem& jobSystem,
+    uint32_t frameCount,
+    bool creationFeedback)
+    : m_device(device),
+      m_pipelineCache(pipelineCache),
+      m_shaderLibrary(shaderLibrary),
+      m_jobSystem(jobSystem),
+      m_frameCount(frameCount),
+      m_creationFeedback(creationFeedback),
+      m_compilations(std::make_unique<JobCounter>())
+{
+    // Compiled now rather than on the first miss, in the middle of a frame
+    try {
+        m_shaderLibrary.get(FALLBACK_FRAGMENT_SHADER);
+        m_hasFallback = true;
+    } catch (const std::exception& ex) {
+        LOG_WARN("No fallback pipelines, draws will be skipped until their pipeline is ready\n{}", ex.what());
+    }
+
+    LOG_TRACE("Initialized pipeline state cache");
+}
+
+
+VulkanPipelineStateCache::~VulkanPipelineStateCache()
+{
+    // Queued compilations return right away
+    m_stopping.store(true);
+    m_jobSystem.wait(*m_compilations);
+
+    for (auto id : m_listeners)
+        m_shaderLibrary.removeReloadListener(id);
+
+    for (auto& [hash, pipelines] : m_pipelines) {
+        for (auto& pipeline : pipelines)
+            vkDestroyPipeline(m_device, pipeline->m_pipeline.load(), nullptr);
+    }
+
+    for (auto& retired : m_retiredPipelines)
+        vkDestroyPipeline(m_device, retired.pipeline, nullptr);
+
+    for (auto& [key, renderPass] : m_renderPasses)
+        vkDestroyRenderPass(m_device, renderPass, nullptr);
+
+    for (auto& [hash, layouts] : m_layouts) {
+        for (auto& [key, layout] : layouts)
+            vkDestroyPipelineLayout(m_device, layout, nullptr);
+    }
+
+#if LOG_DEBUG_ENABLED
+    size_t pipelineCount = 0;
+    for (auto& [hash, pipelines] : m_pipelines)
+        pipelineCount += pipelines.size();
+
+    auto stats = getStats();
+    LOG_DEBUG(
+        "Pipeline state cache: {} pipelines, {} hits / {} misses, {} compilations ({:.2f}ms on average)",
+        pipelineCount,
+        stats.hits,
+        stats.misses,
+        stats.compilations,
+        stats.compilations > 0 ? 1000.0 * stats.compileTime / stats.compilations : 0.0);
+#endif
+}
+
+// public
+
+std::shared_ptr<VulkanPipeline> VulkanPipelineStateCache::get(const VulkanPipelineDescription& description)
+{
+    if (!description.vertexShader || description.layout == VK_NULL_HANDLE)
+        throw Exception("A pipeline needs at least a vertex shader and a layout");
+
+    // Reused by the lookups of this thread, a hit doesn't allocate
+    static thread_local VulkanPipelineDescription t_normalized;
+    normalize(description, t_normalized);
+    uint64_t hash = t_normalized.hash();
+
+    std::shared_ptr<VulkanPipeline> pipeline;
+    {
+        std::shared_lock lock(m_mutex);
+        pipeline = find(t_normalized, hash);
+    }
+
+    if (pipeline)
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+    else
+        pipeline = create(t_normalized, hash, m_hasFallback && t_normalized.fragmentShader);
+
+    // Shaders must not outlive the device in a thread_local
+    t_normalized.vertexShader.reset();
+    t_normalized.fragmentShader.reset();
+
+    return pipeline;
+}
+
+
+VkPipelineLayout VulkanPipelineStateCache::getLayout(
+    const std::vector<VkDescriptorSetLayout>& setLayouts,
+    const std::vector<VkPushConstantRange>& pushConstantRanges)
+{
+    // Handles and ranges have no padding, their bytes are the key
+    std::vector<uint8_t> key(setLayouts.size() * sizeof(VkDescriptorSetLayout) + pushConstantRanges.size() * sizeof(VkPushConstantRange));
+    std::memcpy(key.data(), setLayouts.data(), setLayouts.size() * sizeof(VkDescriptorSetLayout));
+    std::memcpy(key.data() + setLayouts.size() * sizeof(VkDescriptorSetLayout), pushConstantRanges.data(), pushConstantRanges.size() * sizeof(VkPushConstantRange));
+    uint64_t hash = hashValue(setLayouts.size(), hashBytes(key.data(), key.size()));
+
+    std::unique_lock lock(m_mutex);
+
+    for (auto& [existingKey, layout] : m_layouts[hash]) {
+        if (existingKey == key)
+            return layout;
+    }
+
+    VkPipelineLayoutCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    createInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    createInfo.pSetLayouts = setLayouts.data();
+    createInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    createInfo.pPushConstantRanges = pushConstantRanges.data();
+
+    VkPipelineLayout layout;
+    if (vkCreatePipelineLayout(m_device, &createInfo, nullptr, &layout) != VK_SUCCESS)
+        throw Exception("Failed to create pipeline layout");
+
+    m_layouts[hash].emplace_back(std::move(key), layout);
+    return layout;
+}
+
+
+void VulkanPipelineStateCache::beginFrame()
+{
+    std::unique_lock lock(m_mutex);
+
+    m_frame++;
+
+    // Retired during frame F, they may be bound by its command buffers and the ones before.
+    // The frame fence of F has been waited for m_frameCount frames later
+    auto done = [&](const RetiredPipeline& retired) { return retired.frame + m_frameCount <= m_frame; };
+
+    for (auto& retired : m_retiredPipelines) {
+        if (done(retired))
+            vkDestroyPipeline(m_device, retired.pipeline, nullptr);
+    }
+
+    m_retiredPipelines.erase(std::remove_if(m_retiredPipelines.begin(), m_retiredPipelines.end(), done), m_retiredPipelines.end());
+}
+
+
+void VulkanPipelineStateCache::waitForCompilations()
+{
+    m_jobSystem.wait(*m_compilations);
+}
+
+
+VulkanPipelineStateCache::Stats VulkanPipelineStateCache::getStats() const noexcept
+{
+    Stats stats;
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    stats.misses = m_misses.load(std::memory_order_relaxed);
+    stats.compilations = m_compilationCount.load(std::memory_order_relaxed);
+    stats.compileTime = m_compileTimeNs.load(std::memory_order_relaxed) / 1e9;
+    return stats;
+}
+
+// private
+
+std::shared_ptr<VulkanPipeline> VulkanPipelineStateCache::find(const VulkanPipelineDescription& normalized, uint64_t hash) const
+{
+    auto it = m_pipelines.find(hash);
+    if (it == m_pipelines.end())
+        return nullptr;
+
+    for (auto& pipeline : it->second) {
+        if (pipeline->m_description == normalized)
+            return pipeline;
+    }
+
+    return nullptr;
+}
+
+
+std::shared_ptr<VulkanPipeline> VulkanPipelineStateCache::create(const VulkanPipelineDescription& normalized, uint64_t hash, bool withFallback)
+{
+    // Same state, drawn with the fallback fragment shader. It doesn't depend on the material's
+    // fragment shader, so every permutation of a material shares it
+    std::shared_ptr<VulkanPipeline> fallback;
+    if (withFallback) {
+        VulkanPipelineDescription fallbackDescription = normalized;
+        fallbackDescription.fragmentShader = m_shaderLibrary.get(FALLBACK_FRAGMENT_SHADER);
+
+        for (auto& attachment : fallbackDescription.blendAttachments)
+            attachment = {VK_FALSE, {}, {}, {}, {}, {}, {}, attachment.colorWriteMask};
+
+        uint64_t fallbackHash = fallbackDescription.hash();
+        {
+            std::shared_lock lock(m_mutex);
+            fallback = find(fallbackDescription, fallbackHash);
+        }
+
+        if (!fallback)
+            fallback = create(fallbackDescription, fallbackHash, false);
+    }
+
+    std::shared_ptr<VulkanPipeline> pipeline;
+    VulkanPipelineDescription description;
+    uint64_t generation;
+    {
+        std::unique_lock lock(m_mutex);
+
+        // Another thread may have created it in the meantime
+        if ((pipeline = find(normalized, hash))) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return pipeline;
+        }
+
+        pipeline = std::make_shared<VulkanPipeline>();
+        pipeline->m_description = normalized;
+        pipeline->m_hash = hash;
+        pipeline->m_layout = normalized.layout;
+        pipeline->m_fallback = std::move(fallback);
+        m_pipelines[hash].push_back(pipeline);
+
+        description = pipeline->m_description;
+        generation = pipeline->m_generation;
+    }
+
+    m_misses.fetch_add(1, std::memory_order_relaxed);
+
+    watchShader(normalized.vertexShader);
+    watchShader(normalized.fragmentShader);
+
+    compile(pipeline, std::move(description), generation);
+    return pipeline;
+}
+
+
+void VulkanPipelineStateCache::compile(const std::shared_ptr<VulkanPipeline>& pipeline, VulkanPipelineDescription description, uint64_t generation)
+{
+    m_jobSystem.runBackground([this, pipeline, description = std::move(description), generation] {
+        if (m_stopping.load(std::memory_order_relaxed)) return;
+
+        PROFILE_SCOPE("Compile pipeline");
+        auto startTime = std::chrono::steady_clock::now();
+
+        VkPipeline handle = VK_NULL_HANDLE;
+        try {
+            handle = createPipeline(description);
+        } catch (const Exception& ex) {
+            LOG_ERROR("{}\nThe pipeline keeps its previous version or the fallback", ex.what());
+            return;
+        }
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime);
+        m_compileTimeNs.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        m_compilationCount.fetch_add(1, std::memory_order_relaxed);
+
+        std::unique_lock lock(m_mutex);
+
+        // A reload queued a newer version meanwhile, this one was never bound
+        if (generation != pipeline->m_generation) {
+            vkDestroyPipeline(m_device, handle, nullptr);
+            return;
+        }
+
+        VkPipeline previous = pipeline->m_pipeline.exchange(handle, std::memory_order_acq_rel);
+        if (previous != VK_NULL_HANDLE)
+            m_retiredPipelines.push_back({previous, m_frame});
+
+    }, m_compilations.get());
+}
+
+
+VkPipeline VulkanPipelineStateCache::createPipeline(const VulkanPipelineDescription& description)
+{
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages = {};
+    uint32_t stageCount = 0;
+    for (auto& shader : {description.vertexShader, description.fragmentShader}) {
+        if (!shader) continue;
+
+        auto& stage = stages[stageCount++];
+        stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        stage.stage = shader->getStage();
+        stage.module = shader->getModule();
+        stage.pName = "main";
+    }
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(description.vertexBindings.size());
+    vertexInput.pVertexBindingDescriptions = description.vertexBindings.data();
+    vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.vertexAttributes.size());
+    vertexInput.pVertexAttributeDescriptions = description.vertexAttributes.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = description.topology;
+
+    VkPipelineViewportStateCreateInfo viewport = {};
+    viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewport.viewportCount = 1;
+    viewport.scissorCount = 1;
+
+    VkPipelineRasterizationStateCreateInfo rasterization = {};
+    rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterization.polygonMode = description.polygonMode;
+    rasterization.cullMode = description.cullMode;
+    rasterization.frontFace = description.frontFace;
+    rasterization.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisample = {};
+    multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisample.rasterizationSamples = description.samples;
+
+    VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = description.depthTest;
+    depthStencil.depthWriteEnable = description.depthWrite;
+    depthStencil.depthCompareOp = description.depthCompareOp;
+
+    VkPipelineColorBlendStateCreateInfo colorBlend = {};
+    colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlend.attachmentCount = static_cast<uint32_t>(description.blendAttachments.size());
+    colorBlend.pAttachments = description.blendAttachments.data();
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkGraphicsPipelineCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    createInfo.stageCount = stageCount;
+    createInfo.pStages = stages.data();
+    createInfo.pVertexInputState = &vertexInput;
+    createInfo.pInputAssemblyState = &inputAssembly;
+    createInfo.pViewportState = &viewport;
+    createInfo.pRasterizationState = &rasterization;
+    createInfo.pMultisampleState = &multisample;
+    createInfo.pDepthStencilState = &depthStencil;
+    createInfo.pColorBlendState = &colorBlend;
+    createInfo.pDynamicState = &dynamicState;
+    createInfo.layout = description.layout;
+    createInfo.renderPass = getRenderPass(description);
+    createInfo.subpass = 0;
+
+    VkPipelineCreationFeedbackEXT feedback = {};
+    VkPipelineCreationFeedbackCreateInfoEXT feedbackInfo = {};
+    if (m_creationFeedback) {
+        feedbackInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+        feedbackInfo.pPipelineCreationFeedback = &feedback;
+        createInfo.pNext = &feedbackInfo;
+    }
+
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(m_device, m_pipelineCache.getHandle(), 1, &createInfo, nullptr, &pipeline) != VK_SUCCESS)
+        throw Exception("Failed to create graphics pipeline (vertex shader \"" + description.vertexShader->getPath() + "\")");
+
+    if (m_creationFeedback)
+        m_pipelineCache.recordCreationFeedback(feedback);
+
+    return pipeline;
+}
+
+
+VkRenderPass VulkanPipelineStateCache::getRenderPass(const VulkanPipelineDescription& description)
+{
+    RenderPassKey key = {description.colorFormats, description.depthFormat, description.samples};
+
+    std::unique_lock lock(m_mutex);
+
+    for (auto& [existingKey, renderPass] : m_renderPasses) {
+        if (existingKey == key)
+            return renderPass;
+    }
+
+    // Only used to create pipelines: load and store operations and layouts don't matter for
+    // compatibility, formats and samples do
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> colorReferences;
+    for (auto format : key.colorFormats) {
+        colorReferences.push_back({static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+        attachments.push_back({
+            0,
+            format,
+            key.samples,
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    }
+
+    VkAttachmentReference depthReference = {static_cast<uint32_t>(attachments.size()), VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    if (key.depthFormat != VK_FORMAT_UNDEFINED) {
+        attachments.push_back({
+            0,
+            key.depthFormat,
+            key.samples,
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL});
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+    subpass.pColorAttachments = colorReferences.data();
+    subpass.pDepthStencilAttachment = key.depthFormat != VK_FORMAT_UNDEFINED ? &depthReference : nullptr;
+
+    VkRenderPassCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    createInfo.pAttachments = attachments.data();
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+
+    VkRenderPass renderPass;
+    if (vkCreateRenderPass(m_device, &createInfo, nullptr, &renderPass) != VK_SUCCESS)
+        throw Exception("Failed to create render pass");
+
+    m_renderPasses.emplace_back(std::move(key), renderPass);
+    return renderPass;
+}
+
+
+void VulkanPipelineStateCache::watchShader(const std::shared_ptr<const VulkanShader>& shader)
+{
+    if (!shader) return;
+
+    std::string key = shader->getPath();
+    for (auto& define : shader->getDefines())
+        key += '\0' + define;
+
+    {
+        std::unique_lock lock(m_mutex);
+        if (!m_watchedShaders.insert(key).second)
+            return;
+    }
+
+    auto id = m_shaderLibrary.addReloadListener(*shader, [this](auto& reloaded) { onShaderReload(reloaded); });
+
+    std::unique_lock lock(m_mutex);
+    m_listeners.push_back(id);
+}
+
+
+void VulkanPipelineStateCache::onShaderReload(const std::shared_ptr<const VulkanShader>& shader)
+{
+    std::vector<std::tuple<std::shared_ptr<VulkanPipeline>, VulkanPipelineDescription, uint64_t>> toCompile;
+    {
+        std::unique_lock lock(m_mutex);
+
+        std::vector<std::shared_ptr<VulkanPipeline>> changed;
+        for (auto& [hash, pipelines] : m_pipelines) {
+            for (auto& pipeline : pipelines) {
+                auto& description = pipeline->m_description;
+                bool uses = false;
+
+                for (auto stageShader : {&description.vertexShader, &description.fragmentShader}) {
+                    if (*stageShader && isSameShader(**stageShader, *shader)) {
+                        *stageShader = shader;
+                        uses = true;
+                    }
+                }
+
+                if (uses)
+                    changed.push_back(pipeline);
+            }
+        }
+
+        // The description changed, so did its hash: move them to their new bucket
+        for (auto& pipeline : changed) {
+            auto& bucket = m_pipelines[pipeline->m_hash];
+            bucket.erase(std::find(bucket.begin(), bucket.end(), pipeline));
+            if (bucket.empty())
+                m_pipelines.erase(pipeline->m_hash);
+
+            pipeline->m_hash = pipeline->m_description.hash();
+            m_pipelines[pipeline->m_hash].push_back(pipeline);
+
+            toCompile.emplace_back(pipeline, pipeline->m_description, ++pipeline->m_generation);
+        }
+    }
+
+    LOG_DEBUG("Shader \"{}\" reloaded, recompiling {} pipelines", shader->getPath(), toCompile.size());
+
+    // The previous versions stay bound until the new ones are ready
+    for (auto& [pipeline, description, generation] : toCompile)
+        compile(pipeline, std::move(description), generation);
+}
+
+
+void VulkanPipelineStateCache::normalize(const VulkanPipelineDescription& description, VulkanPipelineDescription& normalized)
+{
+    normalized.vertexShader = description.vertexShader;
+    normalized.fragmentShader = description.fragmentShader;
+
+    normalized.vertexBindings.assign(description.vertexBindings.begin(), description.vertexBindings.end());
+    std::sort(normalized.vertexBindings.begin(), normalized.vertexBindings.end(), [](auto& a, auto& b) { return a.binding < b.binding; });
+    normalized.vertexAttributes.assign(description.vertexAttributes.begin(), description.vertexAttributes.end());
+    std::sort(normalized.vertexAttributes.begin(), normalized.vertexAttributes.end(), [](auto& a, auto& b) { return a.location < b.location; });
+    normalized.topology = description.topology;
+
+    normalized.polygonMode = description.polygonMode;
+    normalized.cullMode = description.cullMode;
+    normalized.frontFace = description.frontFace;
+
+    normalized.depthTest = description.depthTest && description.depthFormat != VK_FORMAT_UNDEFINED;
+    normalized.depthWrite = normalized.depthTest && description.depthWrite;
+    normalized.depthCompareOp = normalized.depthTest ? description.depthCompareOp : VK_COMPARE_OP_NEVER;
+
+    normalized.colorFormats.assign(description.colorFormats.begin(), description.colorFormats.end());
+    normalized.blendAttachments.resize(normalized.colorFormats.size());
+    for (size_t i = 0; i < normalized.blendAttachments.size(); i++) {
+        VkPipelineColorBlendAttachmentState attachment = {};
+        attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        if (i < description.blendAttachments.size()) {
+            attachment = description.blendAttachments[i];
+            if (!attachment.blendEnable)
+                attachment = {VK_FALSE, {}, {}, {}, {}, {}, {}, attachment.colorWriteMask};
+        }
+
+        normalized.blendAttachments[i] = attachment;
+    }
+
+    normalized.depthFormat = description.depthFormat;
+    normalized.samples = description.samples;
+    normalized.layout = description.layout;
+}
+
+// VulkanPipelineDescription
+
+bool VulkanPipelineDescription::operator==(const VulkanPipelineDescription& other) const noexcept
+{
+    return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader
+           && equalArrays(vertexBindings, other.vertexBindings) && equalArrays(vertexAttributes, other.vertexAttributes)
+           && topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode
+           && frontFace == other.frontFace && depthTest == other.depthTest && depthWrite == other.depthWrite
+           && depthCompareOp == other.depthCompareOp && equalArrays(blendAttachments, other.blendAttachments)
+           && equalArrays(colorFormats, other.colorFormats) && depthFormat == other.depthFormat
+           && samples == other.samples && layout == other.layout;
+}
+
+
+uint64_t VulkanPipelineDescription::hash() const noexcept
+{
+    // Field by field, the struct has padding. The vertex input and blend structs don't
+    uint64_t hash = hashValue(vertexShader ? vertexShader->getHash() : 0);
+    hash = hashValue(fragmentShader ? fragmentShader->getHash() : 0, hash);
+    hash = hashArray(vertexBindings, hash);
+    hash = hashArray(vertexAttributes, hash);
+    hash = hashValue(topology, hash);
+    hash = hashValue(polygonMode, hash);
+    hash = hashValue(cullMode, hash);
+    hash = hashValue(frontFace, hash);
+    hash = hashValue(depthTest, hash);
+    hash = hashValue(depthWrite, hash);
+    hash = hashValue(depthCompareOp, hash);
+    hash = hashArray(blendAttachments, hash);
+    hash = hashArray(colorFormats, hash);
+    hash = hashValue(depthFormat, hash);
+    hash = hashValue(samples, hash);
+    return hashValue(layout, hash);
+}
+
+// RenderPassKey
+
+bool VulkanPipelineStateCache::RenderPassKey::operator==(const RenderPassKey& other) const noexcept
+{
+    return colorFormats == other.colorFormats && depthFormat == other.depthFormat && samples == other.samples;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "VulkanPipelineCache.hpp"
+#include "VulkanShaderLibrary.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#define FALLBACK_FRAGMENT_SHADER "fallback.frag"  // In the shader directory
+
+class JobSystem;
+class JobCounter;
+
+// Everything that makes a graphics pipeline. Viewport and scissor are always dynamic.
+// The render pass is described by what makes render passes compatible (formats and samples of
+// a single subpass), pipelines are shared by every compatible render pass.
+struct VulkanPipelineDescription
+{
+    std::shared_ptr<const VulkanShader> vertexShader;
+    std::shared_ptr<const VulkanShader> fragmentShader;
+
+    std::vector<VkVertexInputBindingDescription> vertexBindings;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+    VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+    bool depthTest = false;
+    bool depthWrite = false;  // Ignored without depthTest
+    VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // One per color format, missing ones are opaque. Factors are ignored when blending is off
+    std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+
+    std::vector<VkFormat> colorFormats;
+    VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;  // From VulkanPipelineStateCache::getLayout
+
+    bool operator==(const VulkanPipelineDescription& other) const noexcept;
+    uint64_t hash() const noexcept;
+};
+
+
+// A graphics pipeline shared by every request of the same description.
+// Bind getHandle() when recording: the compiled pipeline, or the fallback while it compiles
+// (the same state drawing with the fallback fragment shader), or VK_NULL_HANDLE when neither
+// is ready yet, then the draw is skipped.
+class VulkanPipeline
+{
+  public:
+    inline VkPipeline getHandle() const noexcept
+    {
+        VkPipeline pipeline = m_pipeline.load(std::memory_order_acquire);
+        return pipeline != VK_NULL_HANDLE || !m_fallback ? pipeline : m_fallback->getHandle();
+    }
+
+    inline bool isReady() const noexcept { return m_pipeline.load(std::memory_order_acquire) != VK_NULL_HANDLE; }
+    inline VkPipelineLayout getLayout() const noexcept { return m_layout; }
+
+  private:
+    friend class VulkanPipelineStateCache;
+
+    VulkanPipelineDescription m_description;  // Normalized, its shaders change with hot reload
+    uint64_t m_hash = 0;
+    VkPipelineLayout m_layout;
+    std::atomic<VkPipeline> m_pipeline{VK_NULL_HANDLE};
+    std::shared_ptr<VulkanPipeline> m_fallback;  // Null for fallbacks themselves
+    uint64_t m_generation = 0;  // Bumped by reloads, older compilations are dropped
+};
+
+
+// Graphics pipelines deduplicated by description, compiled in the background.
+// get() normalizes the description (sorted vertex input, ignored state cleared) and hashes it,
+// so material permutations asking for the same state share one VkPipeline. A miss returns at
+// once and compiles on a background job. Reloaded shaders recompile the pipelines that use
+// them, the previous VkPipeline is destroyed once the frames that may use it are done.
+class VulkanPipelineStateCache
+{
+  public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;  // Pipelines created, fallbacks included
+        uint64_t compilations = 0;  // Including reloads
+        double compileTime = 0.0;  // Seconds, summed over the workers
+    };
+
+  public:
+    VulkanPipelineStateCache(
+        VkDevice device,
+        VulkanPipelineCache& pipelineCache,
+        VulkanShaderLibrary& shaderLibrary,
+        JobSystem& jobSystem,
+        uint32_t frameCount,
+        bool creationFeedback);
+    ~VulkanPipelineStateCache();  // Waits for the compilations in progress
+
+    // Thread safe. Never waits for a compilation, unless the job system has no worker thread:
+    // background jobs then run inline, and a miss compiles on the calling thread
+    std::shared_ptr<VulkanPipeline> get(const VulkanPipelineDescription& description);
+
+    // Deduplicated too, lives as long as the cache
+    VkPipelineLayout getLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges = {});
+
+    // Destroys the pipelines replaced by reloads that the device is done with
+    void beginFrame();
+
+    // For loading screens and benchmarks, frames don't wait
+    void waitForCompilations();
+
+    Stats getStats() const noexcept;
+
+  private:
+    struct RenderPassKey
+    {
+        std::vector<VkFormat> colorFormats;
+        VkFormat depthFormat;
+        VkSampleCountFlagBits samples;
+        bool operator==(const RenderPassKey& other) const noexcept;
+    };
+
+    struct RetiredPipeline
+    {
+        VkPipeline pipeline;
+        uint64_t frame;  // Destroyed once the device is done with it
+    };
+
+  private:
+    std::shared_ptr<VulkanPipeline> find(const VulkanPipelineDescription& normalized, uint64_t hash) const;
+    std::shared_ptr<VulkanPipeline> create(const VulkanPipelineDescription& normalized, uint64_t hash, bool withFallback);
+    void compile(const std::shared_ptr<VulkanPipeline>& pipeline, VulkanPipelineDescription description, uint64_t generation);
+    VkPipeline createPipeline(const VulkanPipelineDescription& description);
+    VkRenderPass getRenderPass(const VulkanPipelineDescription& description);
+    void watchShader(const std::shared_ptr<const VulkanShader>& shader);
+    void onShaderReload(const std::shared_ptr<const VulkanShader>& shader);
+
+    static void normalize(const VulkanPipelineDescription& description, VulkanPipelineDescription& normalized);
+
+  private:
+    VkDevice m_device;
+    VulkanPipelineCache& m_pipelineCache;
+    VulkanShaderLibrary& m_shaderLibrary;
+    JobSystem& m_jobSystem;
+    uint32_t m_frameCount;
+    bool m_creationFeedback;
+    bool m_hasFallback = false;
+
+    mutable std::shared_mutex m_mutex;  // Guards the containers below and the pipelines' descriptions
+    std::unordered_map<uint64_t, std::vector<std::shared_ptr<VulkanPipeline>>> m_pipelines;  // By description hash
+    std::unordered_map<uint64_t, std::vector<std::pair<std::vector<uint8_t>, VkPipelineLayout>>> m_layouts;  // By hash of the key bytes
+    std::vector<std::pair<RenderPassKey, VkRenderPass>> m_renderPasses;  // A handful, compatibility only
+    std::unordered_set<std::string> m_watchedShaders;  // Path and defines
+    std::vector<VulkanShaderLibrary::ListenerID> m_listeners;
+    std::vector<RetiredPipeline> m_retiredPipelines;
+    uint64_t m_frame = 0;
+
+    std::unique_ptr<JobCounter> m_compilations;  // In flight
+    std::atomic<bool> m_stopping{false};
+
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+    std::atomic<uint64_t> m_compilationCount{0};
+    std::atomic<uint64_t> m_compileTimeNs{0};
+
+  public:
+    VulkanPipelineStateCache(const VulkanPipelineStateCache&) = delete;
+    void operator=(const VulkanPipelineStateCache&) = delete;
+};
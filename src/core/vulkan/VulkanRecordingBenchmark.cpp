@@ -0,0 +1,237 @@
+#include "pch.hpp"
+
+#include "VulkanRecordingBenchmark.hpp"
+#include "core/Profiler.hpp"
+
+#define BENCH_TARGET_SIZE 256
+
+VulkanRecordingBenchmark::VulkanRecordingBenchmark(VulkanDevice& device, JobSystem& jobSystem)
+    : m_device(device), m_jobSystem(jobSystem)
+{
+    try {
+        createTarget();
+
+    } catch (const Exception& ex) {
+        // The destructor won't run
+        destroyTarget();
+        throw;
+    }
+}
+
+
+VulkanRecordingBenchmark::~VulkanRecordingBenchmark()
+{
+    destroyTarget();
+}
+
+// public
+
+std::vector<VulkanRecordingBenchmark::Result> VulkanRecordingBenchmark::run(uint32_t drawsPerFrame, uint32_t frameCount)
+{
+    std::vector<Result> results;
+
+    uint32_t maxThreads = m_jobSystem.getThreadCount();
+    for (uint32_t threads = 1;; threads = std::min(threads * 2, maxThreads)) {
+        results.push_back(measure(threads, drawsPerFrame, frameCount));
+
+        LOG_INFO(
+            "Recording benchmark: {:>2} threads, {:>11.0f} draws/s, {:.3f} ms/frame ({:.2f}x)",
+            threads,
+            results.back().drawsPerSecond,
+            results.back().frameTimeMs,
+            results.back().drawsPerSecond / results.front().drawsPerSecond);
+
+        if (threads == maxThreads) break;
+    }
+
+    return results;
+}
+
+// private
+
+void VulkanRecordingBenchmark::createTarget()
+{
+    VkDevice device = m_device.getHandle();
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {BENCH_TARGET_SIZE, BENCH_TARGET_SIZE, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    m_imageAllocation = m_device.getAllocator().createImage(imageInfo, VulkanAllocator::MemoryUsage::GPU_ONLY, m_image);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = m_image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = imageInfo.format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    if (vkCreateImageView(device, &viewInfo, nullptr, &m_imageView) != VK_SUCCESS)
+        throw Exception("Failed to create benchmark image view");
+
+    VkAttachmentDescription attachment = {};
+    attachment.format = imageInfo.format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = 1;
+    renderPassInfo.pAttachments = &attachment;
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+        throw Exception("Failed to create benchmark render pass");
+
+    VkFramebufferCreateInfo framebufferInfo = {};
+    framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.renderPass = m_renderPass;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &m_imageView;
+    framebufferInfo.width = BENCH_TARGET_SIZE;
+    framebufferInfo.height = BENCH_TARGET_SIZE;
+    framebufferInfo.layers = 1;
+
+    if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &m_framebuffer) != VK_SUCCESS)
+        throw Exception("Failed to create benchmark framebuffer");
+
+    VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_VERTEX_BIT, 0, 4 * sizeof(float)};
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+        throw Exception("Failed to create benchmark pipeline layout");
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    for (auto& fence : m_fences) {
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+            throw Exception("Failed to create benchmark fence");
+    }
+}
+
+
+void VulkanRecordingBenchmark::destroyTarget() noexcept
+{
+    VkDevice device = m_device.getHandle();
+    vkDeviceWaitIdle(device);
+
+    for (auto fence : m_fences)
+        vkDestroyFence(device, fence, nullptr);
+
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+    vkDestroyFramebuffer(device, m_framebuffer, nullptr);
+    vkDestroyRenderPass(device, m_renderPass, nullptr);
+    vkDestroyImageView(device, m_imageView, nullptr);
+
+    if (m_image != VK_NULL_HANDLE)
+        m_device.getAllocator().destroyImage(m_image, m_imageAllocation);
+}
+
+
+VulkanRecordingBenchmark::Result VulkanRecordingBenchmark::measure(uint32_t threadCount, uint32_t drawsPerFrame, uint32_t frameCount)
+{
+    PROFILE_FUNCTION();
+
+    VkDevice device = m_device.getHandle();
+    auto& dispatch = m_device.getDispatch();
+    auto& commandPools = m_device.getCommandPools();
+
+    VkCommandBufferInheritanceInfo inheritance = {};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = m_renderPass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = m_framebuffer;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkClearValue clearValue = {};
+
+    VkRenderPassBeginInfo renderPassBegin = {};
+    renderPassBegin.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassBegin.renderPass = m_renderPass;
+    renderPassBegin.framebuffer = m_framebuffer;
+    renderPassBegin.renderArea = {{0, 0}, {BENCH_TARGET_SIZE, BENCH_TARGET_SIZE}};
+    renderPassBegin.clearValueCount = 1;
+    renderPassBegin.pClearValues = &clearValue;
+
+    // One task per thread, each records an equal share of the draws
+    auto recordDraws = [&](uint32_t task, VkCommandBuffer commandBuffer) {
+        uint32_t begin = drawsPerFrame * task / threadCount;
+        uint32_t end = drawsPerFrame * (task + 1) / threadCount;
+
+        for (uint32_t draw = begin; draw < end; draw++) {
+            VkRect2D scissor = {{static_cast<int32_t>(draw % BENCH_TARGET_SIZE), 0}, {1, BENCH_TARGET_SIZE}};
+            float constants[4] = {static_cast<float>(draw), 0.0f, 0.0f, 1.0f};
+
+            dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            dispatch.vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants), constants);
+        }
+    };
+
+    std::vector<VkCommandBuffer> secondaries;
+    secondaries.reserve(threadCount);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        uint32_t frameIndex = frame % MAX_FRAMES_IN_FLIGHT;
+
+        dispatch.vkWaitForFences(device, 1, &m_fences[frameIndex], VK_TRUE, UINT64_MAX);
+        dispatch.vkResetFences(device, 1, &m_fences[frameIndex]);
+        commandPools.beginFrame(frameIndex);
+
+        VkCommandBuffer primary = commandPools.getPrimary();
+        if (dispatch.vkBeginCommandBuffer(primary, &beginInfo) != VK_SUCCESS)
+            throw Exception("Failed to begin benchmark command buffer");
+
+        dispatch.vkCmdBeginRenderPass(primary, &renderPassBegin, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        commandPools.recordParallel(m_jobSystem, primary, inheritance, threadCount, recordDraws, secondaries);
+        dispatch.vkCmdEndRenderPass(primary);
+
+        if (dispatch.vkEndCommandBuffer(primary) != VK_SUCCESS)
+            throw Exception("Failed to record benchmark command buffer");
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &primary;
+
+        if (m_device.submit(VulkanDevice::QueueType::GRAPHICS, 1, &submitInfo, m_fences[frameIndex]) != VK_SUCCESS)
+            throw Exception("Failed to submit benchmark frame");
+    }
+
+    dispatch.vkWaitForFences(device, static_cast<uint32_t>(m_fences.size()), m_fences.data(), VK_TRUE, UINT64_MAX);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return {threadCount, double(drawsPerFrame) * frameCount / elapsed.count(), 1000.0 * elapsed.count() / frameCount};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <vector>
+
+#define BENCH_RECORDING_DRAWS 20000  // Per frame
+#define BENCH_RECORDING_FRAMES 200  // Per thread count
+
+// Measures draw recording and submission throughput against the number of recording threads.
+// Every frame records the draws into secondary command buffers spread over N tasks
+// (VulkanCommandPools::recordParallel), executes them in one render pass and submits, with
+// MAX_FRAMES_IN_FLIGHT frames in flight.
+// There is no pipeline to draw with yet, so each draw records the per-draw state a real one
+// carries (scissor and push constants) without the vkCmdDraw itself.
+class VulkanRecordingBenchmark
+{
+  public:
+    struct Result
+    {
+        uint32_t threadCount;
+        double drawsPerSecond;
+        double frameTimeMs;
+    };
+
+  public:
+    VulkanRecordingBenchmark(VulkanDevice& device, JobSystem& jobSystem);
+    ~VulkanRecordingBenchmark();
+
+    // From 1 thread up to every job system thread, doubling each time
+    std::vector<Result> run(uint32_t drawsPerFrame, uint32_t frameCount);
+
+  private:
+    void createTarget();
+    void destroyTarget() noexcept;
+    Result measure(uint32_t threadCount, uint32_t drawsPerFrame, uint32_t frameCount);
+
+  private:
+    VulkanDevice& m_device;
+    JobSystem& m_jobSystem;
+
+    VkImage m_image = VK_NULL_HANDLE;
+    VulkanAllocator::Allocation* m_imageAllocation = nullptr;
+    VkImageView m_imageView = VK_NULL_HANDLE;
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    VkFramebuffer m_framebuffer = VK_NULL_HANDLE;
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    std::array<VkFence, MAX_FRAMES_IN_FLIGHT> m_fences = {};
+
+  public:
+    VulkanRecordingBenchmark(const VulkanRecordingBenchmark&) = delete;
+    void operator=(const VulkanRecordingBenchmark&) = delete;
+};
@@ -0,0 +1,838 @@
+#include "pch.hpp"
+
+#include "VulkanRenderGraph.hpp"
+#include "VulkanDevice.hpp"
+#include "core/Hash.hpp"
+#include "core/Profiler.hpp"
+
+struct AccessInfo
+{
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageLayout layout;
+    VkImageUsageFlags usage;
+    bool write;
+    const char* name;
+};
+
+// Indexed by VulkanRenderGraph::Access
+static const AccessInfo s_accessInfos[] = {
+    {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+     VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+     true,
+     "color attachment"},
+    {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+     true,
+     "depth attachment"},
+    {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+     VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+     false,
+     "depth read"},
+    {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+     VK_IMAGE_USAGE_SAMPLED_BIT,
+     false,
+     "sampled"},
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT,
+     VK_IMAGE_LAYOUT_GENERAL,
+     VK_IMAGE_USAGE_STORAGE_BIT,
+     false,
+     "storage read"},
+    {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_GENERAL,
+     VK_IMAGE_USAGE_STORAGE_BIT,
+     true,
+     "storage write"},
+    {VK_PIPELINE_STAGE_TRANSFER_BIT,
+     VK_ACCESS_TRANSFER_READ_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+     VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+     false,
+     "transfer src"},
+    {VK_PIPELINE_STAGE_TRANSFER_BIT,
+     VK_ACCESS_TRANSFER_WRITE_BIT,
+     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+     VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+     true,
+     "transfer dst"}};
+
+
+// Only writes need to be made available, reads just have to be done
+static const VkAccessFlags s_writeAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+                                           | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+
+static inline const AccessInfo& getAccessInfo(VulkanRenderGraph::Access access) noexcept
+{
+    return s_accessInfos[static_cast<size_t>(access)];
+}
+
+
+static VkImageAspectFlags getAspect(VkFormat format) noexcept
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT: return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_S8_UINT: return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default: return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+
+static const char* getLayoutName(VkImageLayout layout) noexcept
+{
+    switch (layout) {
+    case VK_IMAGE_LAYOUT_UNDEFINED: return "undefined";
+    case VK_IMAGE_LAYOUT_GENERAL: return "general";
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "color attachment";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "depth attachment";
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "depth read only";
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "shader read only";
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "transfer src";
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: return "transfer dst";
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "present src";
+    default: return "other";
+    }
+}
+
+
+VulkanRenderGraph::PassBuilder& VulkanRenderGraph::PassBuilder::use(ResourceID resource, Access access)
+{
+    if (resource >= m_graph.m_resources.size())
+        throw Exception("Render graph \"" + m_graph.m_name + "\": unknown resource used by pass \"" + m_graph.m_passes[m_pass].name + "\"");
+
+    m_graph.m_passes[m_pass].uses.push_back({resource, access});
+    return *this;
+}
+
+
+VulkanRenderGraph::PassBuilder& VulkanRenderGraph::PassBuilder::sideEffects()
+{
+    m_graph.m_passes[m_pass].sideEffects = true;
+    return *this;
+}
+
+
+VulkanRenderGraph::VulkanRenderGraph(VulkanDevice& device, const std::string& name)
+    : m_device(device), m_name(name)
+{
+}
+
+
+VulkanRenderGraph::~VulkanRenderGraph()
+{
+    destroyRetiredImages(true);
+    destroyPhysicalImages(m_physical);
+}
+
+// public
+
+void VulkanRenderGraph::reset()
+{
+    // Cleared, not released: the next frame declares about as much. Clearing m_passes would
+    // free the uses of every pass, addPass() gives them back instead
+    for (auto& pass : m_passes) {
+        pass.uses.clear();
+        m_spareUses.push_back(std::move(pass.uses));
+    }
+
+    m_resources.clear();
+    m_passes.clear();
+}
+
+
+VulkanRenderGraph::ResourceID VulkanRenderGraph::createImage(const std::string& name, const ImageDescription& description)
+{
+    Resource& resource = m_resources.emplace_back();
+    resource.name = name;
+    resource.description = description;
+
+    return static_cast<ResourceID>(m_resources.size() - 1);
+}
+
+
+VulkanRenderGraph::ResourceID VulkanRenderGraph::importImage(
+    const std::string& name,
+    VkImage image,
+    VkImageView view,
+    const ImageDescription& description,
+    const ImportedState& initialState,
+    const ImportedState& finalState)
+{
+    Resource& resource = m_resources.emplace_back();
+    resource.name = name;
+    resource.description = description;
+    resource.imported = true;
+    resource.image = image;
+    resource.view = view;
+    resource.initialState = initialState;
+    resource.finalState = finalState;
+
+    return static_cast<ResourceID>(m_resources.size() - 1);
+}
+
+
+VulkanRenderGraph::PassBuilder VulkanRenderGraph::addPass(const std::string& name, RecordFunction record)
+{
+    Pass& pass = m_passes.emplace_back();
+    pass.name = name;
+    pass.record = std::move(record);
+
+    if (!m_spareUses.empty()) {
+        pass.uses = std::move(m_spareUses.back());
+        m_spareUses.pop_back();
+    }
+
+    return PassBuilder(*this, static_cast<uint32_t>(m_passes.size() - 1));
+}
+
+
+bool VulkanRenderGraph::compile()
+{
+    PROFILE_FUNCTION();
+
+    destroyRetiredImages(false);
+
+    uint64_t shapeHash = hashShape();
+    if (m_compiled && shapeHash == m_shapeHash) {
+        bindResources();
+        return false;
+    }
+
+    // Frames in flight may still use them
+    if (!m_physical.images.empty()) {
+        m_physical.retiredAt = m_executeCount;
+        m_retired.push_back(std::move(m_physical));
+        m_physical = {};
+    }
+
+    m_compiled = false;
+
+    try {
+        cullPasses();
+        computeLifetimes();
+        createTransientImages();
+        planBarriers();
+        batchBarriers();
+
+    } catch (...) {
+        destroyPhysicalImages(m_physical);
+        m_physical = {};
+        throw;
+    }
+
+    m_shapeHash = shapeHash;
+    m_compiled = true;
+    m_stats.compileCount++;
+
+    bindResources();
+
+    LOG_DEBUG(
+        "Compiled render graph \"{}\": {} passes ({} culled), {} barriers in {} calls, {} KiB of transient memory ({} KiB without aliasing)",
+        m_name,
+        m_stats.passCount,
+        m_stats.culledPassCount,
+        m_stats.barrierCount,
+        m_stats.barrierCallCount,
+        m_stats.transientBytes >> 10,
+        m_stats.unaliasedBytes >> 10);
+
+    return true;
+}
+
+
+void VulkanRenderGraph::execute(VkCommandBuffer commandBuffer)
+{
+    PROFILE_FUNCTION();
+
+    if (!m_compiled)
+        throw Exception("Render graph \"" + m_name + "\" executed without being compiled");
+
+    uint32_t passCount = static_cast<uint32_t>(m_alivePasses.size());
+    VulkanTimestamps& timestamps = m_device.getTimestamps();
+
+    // Point i is before alive pass i, the last one after every pass
+    for (uint32_t point = 0; point <= passCount; point++) {
+        uint32_t begin = m_batchBegins[point], end = m_batchBegins[point + 1];
+
+        if (begin < end) {
+            VkPipelineStageFlags srcStages = 0, dstStages = 0;
+            m_imageBarriers.clear();
+
+            for (uint32_t i = begin; i < end; i++) {
+                const Barrier& barrier = m_barriers[i];
+                const Resource& resource = m_resources[barrier.resource];
+
+                VkImageMemoryBarrier& imageBarrier = m_imageBarriers.emplace_back();
+                imageBarrier = {};
+                imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                imageBarrier.srcAccessMask = barrier.srcAccess;
+                imageBarrier.dstAccessMask = barrier.dstAccess;
+                imageBarrier.oldLayout = barrier.oldLayout;
+                imageBarrier.newLayout = barrier.newLayout;
+                imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                imageBarrier.image = resource.image;
+                imageBarrier.subresourceRange = {
+                    getAspect(resource.description.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+
+                srcStages |= barrier.srcStages;
+                dstStages |= barrier.dstStages;
+            }
+
+            m_device.getDispatch().vkCmdPipelineBarrier(
+                commandBuffer,
+                srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                static_cast<uint32_t>(m_imageBarriers.size()), m_imageBarriers.data());
+        }
+
+        if (point < passCount) {
+            PROFILE_SCOPE("Render pass");
+            const Pass& pass = m_passes[m_alivePasses[point]];
+
+            uint32_t scope = timestamps.beginScope(commandBuffer, m_scopeNames[point]);
+            if (pass.record)
+                pass.record(commandBuffer, *this);
+            timestamps.endScope(commandBuffer, scope);
+        }
+    }
+
+    m_executeCount++;
+}
+
+
+VkImage VulkanRenderGraph::getImage(ResourceID resource) const noexcept
+{
+    return m_resources[resource].image;
+}
+
+
+VkImageView VulkanRenderGraph::getImageView(ResourceID resource) const noexcept
+{
+    return m_resources[resource].view;
+}
+
+
+VkExtent2D VulkanRenderGraph::getExtent(ResourceID resource) const noexcept
+{
+    return m_resources[resource].description.extent;
+}
+
+
+std::string VulkanRenderGraph::dump() const
+{
+    if (!m_compiled)
+        return "Render graph \"" + m_name + "\": not compiled\n";
+
+    std::string text = fmt::format(
+        "Render graph \"{}\" (compiled {} times)\n"
+        "  {} passes, {} culled\n"
+        "  {} barriers in {} vkCmdPipelineBarrier calls\n",
+        m_name,
+        m_stats.compileCount,
+        m_stats.passCount,
+        m_stats.culledPassCount,
+        m_stats.barrierCount,
+        m_stats.barrierCallCount);
+
+    auto dumpBatch = [&](uint32_t point) {
+        uint32_t begin = m_batchBegins[point], end = m_batchBegins[point + 1];
+        if (begin == end) return;
+
+        text += fmt::format("    barrier call ({} images)\n", end - begin);
+        for (uint32_t i = begin; i < end; i++) {
+            auto& barrier = m_barriers[i];
+            text += fmt::format(
+                "      {}: {} -> {}, stages {:#x} -> {:#x}, access {:#x} -> {:#x}\n",
+                m_resources[barrier.resource].name,
+                getLayoutName(barrier.oldLayout),
+                getLayoutName(barrier.newLayout),
+                barrier.srcStages,
+                barrier.dstStages,
+                barrier.srcAccess,
+                barrier.dstAccess);
+        }
+    };
+
+    // Passes in declaration order, culled ones included
+    uint32_t point = 0;
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+        const Pass& pass = m_passes[i];
+        bool alive = point < m_alivePasses.size() && m_alivePasses[point] == i;
+
+        if (alive)
+            dumpBatch(point);
+
+        text += fmt::format("  {} \"{}\"{}\n", alive ? fmt::format("[{}]", point) : "[-]", pass.name, alive ? "" : " (culled)");
+        for (auto& use : pass.uses)
+            text += fmt::format("      {} ({})\n", m_resources[use.resource].name, getAccessInfo(use.access).name);
+
+        if (alive)
+            point++;
+    }
+
+    dumpBatch(static_cast<uint32_t>(m_alivePasses.size()));
+
+    VkDeviceSize saved = m_stats.unaliasedBytes - m_stats.transientBytes;
+    text += fmt::format(
+        "  Transient memory: {} KiB in {} allocations, {} KiB without aliasing ({:.0f}% saved)\n",
+        m_stats.transientBytes >> 10,
+        m_slots.size(),
+        m_stats.unaliasedBytes >> 10,
+        m_stats.unaliasedBytes > 0 ? 100.0 * saved / m_stats.unaliasedBytes : 0.0);
+
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        text += fmt::format("    allocation {}: {} KiB,", i, m_slots[i].size >> 10);
+        for (auto transient : m_slots[i].transients) {
+            auto& t = m_transients[transient];
+            text += fmt::format(" {} [{}, {}]", m_resources[t.resource].name, t.firstPass, t.lastPass);
+        }
+        text += "\n";
+    }
+
+    return text;
+}
+
+// private
+
+uint64_t VulkanRenderGraph::hashShape() const noexcept
+{
+    uint64_t hash = HASH_SEED;
+
+    for (auto& resource : m_resources) {
+        hash = hashBytes(resource.name.data(), resource.name.size(), hash);
+        hash = hashValue(resource.description, hash);
+        hash = hashValue(resource.imported, hash);
+
+        if (resource.imported) {
+            hash = hashValue(resource.initialState, hash);
+            hash = hashValue(resource.finalState, hash);
+        }
+    }
+
+    for (auto& pass : m_passes) {
+        hash = hashBytes(pass.name.data(), pass.name.size(), hash);
+        hash = hashValue(pass.sideEffects, hash);
+
+        for (auto& use : pass.uses) {
+            hash = hashValue(use.resource, hash);
+            hash = hashValue(use.access, hash);
+        }
+    }
+
+    return hash;
+}
+
+
+void VulkanRenderGraph::cullPasses()
+{
+    // Backwards: a pass is needed if a later needed pass uses what it writes, or it writes an
+    // imported image. Writes don't end a dependency, attachments may load what was there
+    std::vector<bool> needed(m_resources.size());
+    std::vector<bool> alive(m_passes.size());
+
+    for (size_t i = 0; i < m_resources.size(); i++)
+        needed[i] = m_resources[i].imported;
+
+    for (size_t i = m_passes.size(); i-- > 0;) {
+        const Pass& pass = m_passes[i];
+
+        alive[i] = pass.sideEffects;
+        for (auto& use : pass.uses)
+            alive[i] = alive[i] || (getAccessInfo(use.access).write && needed[use.resource]);
+
+        if (alive[i]) {
+            for (auto& use : pass.uses)
+                needed[use.resource] = true;
+        }
+    }
+
+    m_alivePasses.clear();
+    m_scopeNames.clear();
+    for (uint32_t i = 0; i < m_passes.size(); i++) {
+        if (alive[i]) {
+            m_alivePasses.push_back(i);
+            m_scopeNames.push_back(m_name + "/" + m_passes[i].name);
+        }
+    }
+
+    m_stats.passCount = static_cast<uint32_t>(m_passes.size());
+    m_stats.culledPassCount = static_cast<uint32_t>(m_passes.size() - m_alivePasses.size());
+}
+
+
+void VulkanRenderGraph::computeLifetimes()
+{
+    m_transients.clear();
+    m_transientIndices.assign(m_resources.size(), -1);
+
+    for (uint32_t i = 0; i < m_alivePasses.size(); i++) {
+        for (auto& use : m_passes[m_alivePasses[i]].uses) {
+            if (m_resources[use.resource].imported) continue;
+
+            int32_t& index = m_transientIndices[use.resource];
+            if (index < 0) {
+                index = static_cast<int32_t>(m_transients.size());
+                m_transients.push_back({use.resource, i, i, {}});
+            }
+
+            m_transients[index].lastPass = i;
+        }
+    }
+}
+
+
+void VulkanRenderGraph::createTransientImages()
+{
+    VkDevice device = m_device.getHandle();
+
+    // Every use decides the usage flags, all of them are known now
+    std::vector<VkImageUsageFlags> usages(m_transients.size());
+    for (auto passIndex : m_alivePasses) {
+        for (auto& use : m_passes[passIndex].uses) {
+            if (m_transientIndices[use.resource] >= 0)
+                usages[m_transientIndices[use.resource]] |= getAccessInfo(use.access).usage;
+        }
+    }
+
+    m_stats.unaliasedBytes = 0;
+
+    for (size_t i = 0; i < m_transients.size(); i++) {
+        const Resource& resource = m_resources[m_transients[i].resource];
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = resource.description.format;
+        imageInfo.extent = {resource.description.extent.width, resource.description.extent.height, 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = resource.description.samples;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = usages[i];
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VkImage image;
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+            throw Exception("Render graph \"" + m_name + "\": failed to create transient image \"" + resource.name + "\"");
+
+        m_physical.images.push_back(image);
+        vkGetImageMemoryRequirements(device, image, &m_transients[i].requirements);
+        m_stats.unaliasedBytes += m_transients[i].requirements.size;
+    }
+
+    assignSlots();
+
+    m_stats.transientBytes = 0;
+    for (auto& slot : m_slots) {
+        VkMemoryRequirements requirements = {slot.size, slot.alignment, slot.memoryTypeBits};
+        slot.allocation = m_device.getAllocator().allocate(requirements, VulkanAllocator::MemoryUsage::GPU_ONLY, VulkanAllocator::ResourceKind::OPTIMAL);
+        m_physical.allocations.push_back(slot.allocation);
+        m_stats.transientBytes += slot.size;
+    }
+
+    for (size_t i = 0; i < m_transients.size(); i++) {
+        const Resource& resource = m_resources[m_transients[i].resource];
+        const VulkanAllocator::Allocation* allocation = m_slots[m_transients[i].slot].allocation;
+
+        if (vkBindImageMemory(device, m_physical.images[i], allocation->memory, allocation->offset) != VK_SUCCESS)
+            throw Exception("Render graph \"" + m_name + "\": failed to bind transient image \"" + resource.name + "\"");
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_physical.images[i];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = resource.description.format;
+        viewInfo.subresourceRange = {getAspect(resource.description.format), 0, 1, 0, 1};
+
+        VkImageView view;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+            throw Exception("Render graph \"" + m_name + "\": failed to create transient image view \"" + resource.name + "\"");
+
+        m_physical.views.push_back(view);
+    }
+}
+
+
+void VulkanRenderGraph::assignSlots()
+{
+    m_slots.clear();
+
+    // Biggest first, so a slot is sized by its first image and the small ones fill the gaps
+    std::vector<uint32_t> order(m_transients.size());
+    for (uint32_t i = 0; i < order.size(); i++)
+        order[i] = i;
+
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return m_transients[a].requirements.size > m_transients[b].requirements.size;
+    });
+
+    for (auto index : order) {
+        Transient& transient = m_transients[index];
+
+        auto overlaps = [&](const Slot& slot) {
+            for (auto other : slot.transients) {
+                if (transient.firstPass <= m_transients[other].lastPass && m_transients[other].firstPass <= transient.lastPass)
+                    return true;
+            }
+            return false;
+        };
+
+        uint32_t slotIndex = 0;
+        while (slotIndex < m_slots.size()
+               && ((m_slots[slotIndex].memoryTypeBits & transient.requirements.memoryTypeBits) == 0 || overlaps(m_slots[slotIndex])))
+            slotIndex++;
+
+        if (slotIndex == m_slots.size())
+            m_slots.emplace_back();
+
+        Slot& slot = m_slots[slotIndex];
+        slot.size = std::max(slot.size, transient.requirements.size);
+        slot.alignment = std::max(slot.alignment, transient.requirements.alignment);
+        slot.memoryTypeBits &= transient.requirements.memoryTypeBits;
+        slot.transients.push_back(index);
+        transient.slot = slotIndex;
+    }
+
+    for (auto& slot : m_slots) {
+        std::sort(slot.transients.begin(), slot.transients.end(), [&](uint32_t a, uint32_t b) {
+            return m_transients[a].firstPass < m_transients[b].firstPass;
+        });
+    }
+}
+
+
+void VulkanRenderGraph::planBarriers()
+{
+    struct State
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags writeStages = 0;  // Of the last write, or layout transition
+        VkAccessFlags writeAccess = 0;
+        VkPipelineStageFlags readStages = 0;  // Since the last write
+        VkPipelineStageFlags visibleStages = 0;  // The last write is visible to these
+        VkAccessFlags visibleAccess = 0;
+        uint32_t nextPoint = 0;  // A barrier can't go before this point
+    };
+
+    // What a transient was last used for, its memory's next user waits on it
+    std::vector<VkPipelineStageFlags> finalStages(m_transients.size());
+    std::vector<VkAccessFlags> finalWrites(m_transients.size());
+    for (auto passIndex : m_alivePasses) {
+        for (auto& use : m_passes[passIndex].uses) {
+            int32_t index = m_transientIndices[use.resource];
+            if (index < 0) continue;
+
+            auto& info = getAccessInfo(use.access);
+            finalStages[index] |= info.stages;
+            if (info.write)
+                finalWrites[index] |= info.access & s_writeAccess;
+        }
+    }
+
+    std::vector<State> states(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        auto& resource = m_resources[i];
+        if (resource.imported) {
+            states[i].layout = resource.initialState.layout;
+            states[i].writeStages = resource.initialState.stages;
+            states[i].writeAccess = resource.initialState.access;
+        }
+    }
+
+    // Transients wait on the previous image of their memory, the first one on the last image of
+    // the previous frame (itself if it isn't aliased)
+    for (auto& slot : m_slots) {
+        for (size_t i = 0; i < slot.transients.size(); i++) {
+            uint32_t previous = i > 0 ? slot.transients[i - 1] : slot.transients.back();
+            State& state = states[m_transients[slot.transients[i]].resource];
+
+            state.writeStages = finalStages[previous];
+            state.writeAccess = finalWrites[previous];
+            state.nextPoint = i > 0 ? m_transients[previous].lastPass + 1 : 0;
+        }
+    }
+
+    m_barriers.clear();
+
+    auto addBarrier = [&](ResourceID resource, State& state, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, VkImageLayout newLayout, uint32_t point) {
+        Barrier barrier = {};
+        barrier.resource = resource;
+        barrier.srcStages = state.writeStages | state.readStages;
+        barrier.dstStages = dstStages;
+        barrier.srcAccess = state.writeAccess;
+        barrier.dstAccess = dstAccess;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = newLayout;
+        barrier.earliest = state.nextPoint;
+        barrier.latest = point;
+        m_barriers.push_back(barrier);
+    };
+
+    struct MergedUse
+    {
+        ResourceID resource;
+        AccessInfo info;
+    };
+    std::vector<MergedUse> uses;
+
+    for (uint32_t point = 0; point < m_alivePasses.size(); point++) {
+        const Pass& pass = m_passes[m_alivePasses[point]];
+
+        // A resource used several ways by a pass gets one barrier for all of them
+        uses.clear();
+        for (auto& use : pass.uses) {
+            auto& info = getAccessInfo(use.access);
+            auto it = std::find_if(uses.begin(), uses.end(), [&](const MergedUse& merged) { return merged.resource == use.resource; });
+
+            if (it == uses.end()) {
+                uses.push_back({use.resource, info});
+            } else if (it->info.layout != info.layout) {
+                throw Exception(
+                    "Render graph \"" + m_name + "\": pass \"" + pass.name + "\" uses \"" + m_resources[use.resource].name
+                    + "\" in two layouts");
+            } else {
+                it->info.stages |= info.stages;
+                it->info.access |= info.access;
+                it->info.write = it->info.write || info.write;
+            }
+        }
+
+        for (auto& [resource, info] : uses) {
+            State& state = states[resource];
+
+            if (state.layout != info.layout || info.write) {
+                addBarrier(resource, state, info.stages, info.access, info.layout, point);
+
+                // A layout transition is a write too, later readers in other stages wait on it
+                state.layout = info.layout;
+                state.writeStages = info.stages;
+                state.writeAccess = info.access & s_writeAccess;
+                state.readStages = info.write ? 0 : info.stages;
+                state.visibleStages = info.write ? 0 : info.stages;
+                state.visibleAccess = info.write ? 0 : info.access;
+
+            } else if ((state.visibleStages & info.stages) != info.stages || (state.visibleAccess & info.access) != info.access) {
+                addBarrier(resource, state, info.stages, info.access, info.layout, point);
+
+                state.readStages |= info.stages;
+                state.visibleStages |= info.stages;
+                state.visibleAccess |= info.access;
+
+            } else {
+                state.readStages |= info.stages;
+            }
+
+            state.nextPoint = point + 1;
+        }
+    }
+
+    // Imported images are left as the caller wants them
+    uint32_t endPoint = static_cast<uint32_t>(m_alivePasses.size());
+    for (ResourceID i = 0; i < m_resources.size(); i++) {
+        const Resource& resource = m_resources[i];
+        if (!resource.imported) continue;
+
+        VkImageLayout finalLayout = resource.finalState.layout == VK_IMAGE_LAYOUT_UNDEFINED ? states[i].layout : resource.finalState.layout;
+        if (finalLayout != states[i].layout || resource.finalState.access != 0)
+            addBarrier(i, states[i], resource.finalState.stages, resource.finalState.access, finalLayout, endPoint);
+    }
+}
+
+
+void VulkanRenderGraph::batchBarriers()
+{
+    // Fewest points hitting every [earliest, latest] range: take the barriers by latest point,
+    // one that isn't covered yet opens a new point as late as it can go
+    std::stable_sort(m_barriers.begin(), m_barriers.end(), [](const Barrier& a, const Barrier& b) { return a.latest < b.latest; });
+
+    int64_t point = -1;
+    for (auto& barrier : m_barriers) {
+        if (point < barrier.earliest)
+            point = barrier.latest;
+
+        barrier.point = static_cast<uint32_t>(point);
+    }
+
+    std::stable_sort(m_barriers.begin(), m_barriers.end(), [](const Barrier& a, const Barrier& b) { return a.point < b.point; });
+
+    uint32_t pointCount = static_cast<uint32_t>(m_alivePasses.size()) + 1;
+    m_batchBegins.assign(pointCount + 1, 0);
+
+    uint32_t barrierIndex = 0;
+    m_stats.barrierCallCount = 0;
+
+    for (uint32_t i = 0; i <= pointCount; i++) {
+        m_batchBegins[i] = barrierIndex;
+
+        uint32_t batchBegin = barrierIndex;
+        while (barrierIndex < m_barriers.size() && m_barriers[barrierIndex].point == i)
+            barrierIndex++;
+
+        if (barrierIndex > batchBegin)
+            m_stats.barrierCallCount++;
+    }
+
+    m_stats.barrierCount = static_cast<uint32_t>(m_barriers.size());
+}
+
+
+void VulkanRenderGraph::bindResources()
+{
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        int32_t index = m_transientIndices[i];
+        if (index < 0) continue;
+
+        m_resources[i].image = m_physical.images[index];
+        m_resources[i].view = m_physical.views[index];
+    }
+}
+
+
+void VulkanRenderGraph::destroyPhysicalImages(PhysicalImages& physical) noexcept
+{
+    VkDevice device = m_device.getHandle();
+
+    for (auto view : physical.views)
+        vkDestroyImageView(device, view, nullptr);
+    for (auto image : physical.images)
+        vkDestroyImage(device, image, nullptr);
+    for (auto allocation : physical.allocations)
+        m_device.getAllocator().free(allocation);
+}
+
+
+void VulkanRenderGraph::destroyRetiredImages(bool all) noexcept
+{
+    // Executions and frames in flight go together: once this many more executions are
+    // recorded, the device is done with the older ones (see VulkanDevice::beginFrame)
+    auto it = m_retired.begin();
+    while (it != m_retired.end()) {
+        if (all || it->retiredAt + MAX_FRAMES_IN_FLIGHT <= m_executeCount) {
+            destroyPhysicalImages(*it);
+            it = m_retired.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
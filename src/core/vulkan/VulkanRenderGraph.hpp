@@ -0,0 +1,228 @@
+#pragma once
+
+#include "VulkanAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class VulkanDevice;
+
+// The passes of a frame and the images they use, rebuilt every frame.
+// Passes declare how they use each image, compile() then:
+//  - culls the passes whose results never reach an imported image (or that have no side effects)
+//  - derives every layout transition and memory dependency, and places them so they fit in as
+//    few vkCmdPipelineBarrier calls as possible: a barrier may run anywhere between the previous
+//    use of its image and the pass that needs it, several share a call whenever their ranges
+//    overlap. Stages of barriers sharing a call are merged, which may add a false dependency
+//  - creates the transient images and aliases their memory: images whose lifetimes don't overlap
+//    share one allocation
+// The result is cached by the shape of the graph (resources, passes and uses, not the imported
+// handles), so a graph built the same way every frame is only compiled once. Transient images
+// keep their memory from one frame to the next: the first barrier of the frame waits on their
+// last use by the previous one, it is the same queue. Images only, one per graph and thread.
+// Every pass is a timestamp scope (see VulkanTimestamps), named "Graph/Pass".
+class VulkanRenderGraph
+{
+  public:
+    typedef uint32_t ResourceID;
+
+    // How a pass uses an image, decides its layout and what the barriers wait on
+    enum class Access : uint8_t
+    {
+        COLOR_ATTACHMENT,  // Written
+        DEPTH_ATTACHMENT,  // Written
+        DEPTH_READ,  // Depth test without writes
+        SAMPLED,  // Read by fragment shaders
+        STORAGE_READ,  // Compute shaders
+        STORAGE_WRITE,
+        TRANSFER_SRC,
+        TRANSFER_DST  // Written
+    };
+
+    struct ImageDescription
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {};
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    };
+
+    // What an imported image is in before the graph runs, or must be left in
+    struct ImportedState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkAccessFlags access = 0;
+    };
+
+    using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, const VulkanRenderGraph& graph)>;
+
+    class PassBuilder
+    {
+      public:
+        PassBuilder& use(ResourceID resource, Access access);
+        PassBuilder& sideEffects();  // Never culled
+
+      private:
+        friend class VulkanRenderGraph;
+        PassBuilder(VulkanRenderGraph& graph, uint32_t pass) : m_graph(graph), m_pass(pass) { }
+
+        VulkanRenderGraph& m_graph;
+        uint32_t m_pass;
+    };
+
+    struct Stats
+    {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t barrierCount = 0;
+        uint32_t barrierCallCount = 0;  // vkCmdPipelineBarrier per execute()
+        VkDeviceSize transientBytes = 0;  // Allocated for the transient images
+        VkDeviceSize unaliasedBytes = 0;  // What they would take without aliasing
+        uint64_t compileCount = 0;
+    };
+
+  public:
+    VulkanRenderGraph(VulkanDevice& device, const std::string& name);
+    ~VulkanRenderGraph();  // The device must be done with the executed graphs
+
+    // Starts a new frame, previous resources and passes are forgotten
+    void reset();
+
+    ResourceID createImage(const std::string& name, const ImageDescription& description);
+    ResourceID importImage(
+        const std::string& name,
+        VkImage image,
+        VkImageView view,
+        const ImageDescription& description,
+        const ImportedState& initialState,
+        const ImportedState& finalState);
+
+    // Passes run in the order they are added
+    PassBuilder addPass(const std::string& name, RecordFunction record);
+
+    // True if the graph had to be compiled again, false if the cached result was used
+    bool compile();
+    void execute(VkCommandBuffer commandBuffer);
+
+    // Only valid in the record functions of execute()
+    VkImage getImage(ResourceID resource) const noexcept;
+    VkImageView getImageView(ResourceID resource) const noexcept;
+    VkExtent2D getExtent(ResourceID resource) const noexcept;
+
+    // Passes, barriers and memory of the last compile(), for humans
+    std::string dump() const;
+    inline const Stats& getStats() const noexcept { return m_stats; }
+
+  private:
+    struct Use
+    {
+        ResourceID resource;
+        Access access;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        RecordFunction record;
+        std::vector<Use> uses;
+        bool sideEffects = false;
+    };
+
+    struct Resource
+    {
+        std::string name;
+        ImageDescription description;
+        bool imported = false;
+        VkImage image = VK_NULL_HANDLE;  // Imported, or set by compile()
+        VkImageView view = VK_NULL_HANDLE;
+        ImportedState initialState;
+        ImportedState finalState;
+    };
+
+    // Scheduled between two passes, merged with the others scheduled at the same point
+    struct Barrier
+    {
+        ResourceID resource;
+        VkPipelineStageFlags srcStages;
+        VkPipelineStageFlags dstStages;
+        VkAccessFlags srcAccess;
+        VkAccessFlags dstAccess;
+        VkImageLayout oldLayout;
+        VkImageLayout newLayout;
+        uint32_t earliest;  // Point: before this alive pass, or after the last one
+        uint32_t latest;
+        uint32_t point = 0;
+    };
+
+    struct Transient
+    {
+        ResourceID resource;
+        uint32_t firstPass;  // Alive pass indices
+        uint32_t lastPass;
+        VkMemoryRequirements requirements;
+        uint32_t slot = 0;
+    };
+
+    // Memory shared by transient images with disjoint lifetimes
+    struct Slot
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memoryTypeBits = ~0u;
+        std::vector<uint32_t> transients;  // In lifetime order
+        VulkanAllocator::Allocation* allocation = nullptr;
+    };
+
+    struct PhysicalImages
+    {
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+        std::vector<VulkanAllocator::Allocation*> allocations;
+        uint64_t retiredAt = 0;  // Executions when it was replaced
+    };
+
+  private:
+    uint64_t hashShape() const noexcept;
+    void cullPasses();
+    void computeLifetimes();
+    void assignSlots();
+    void createTransientImages();
+    void planBarriers();
+    void batchBarriers();
+    void bindResources();
+    void destroyPhysicalImages(PhysicalImages& physical) noexcept;
+    void destroyRetiredImages(bool all) noexcept;
+
+  private:
+    VulkanDevice& m_device;
+    std::string m_name;
+
+    // Declared by the current frame
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<std::vector<Use>> m_spareUses;  // Of the previous frame's passes, with their capacity
+
+    // Compiled, reused while the shape hash doesn't change
+    uint64_t m_shapeHash = 0;
+    bool m_compiled = false;
+    std::vector<uint32_t> m_alivePasses;  // Indices into m_passes, in execution order
+    std::vector<std::string> m_scopeNames;  // "Graph/Pass" timestamp scopes, by alive pass
+    std::vector<Transient> m_transients;
+    std::vector<int32_t> m_transientIndices;  // By resource, -1 for imported or unused ones
+    std::vector<Slot> m_slots;
+    std::vector<Barrier> m_barriers;  // Sorted by point
+    std::vector<uint32_t> m_batchBegins;  // First barrier of every point, one more for the end
+    PhysicalImages m_physical;  // Of m_transients
+    std::vector<PhysicalImages> m_retired;
+    Stats m_stats;
+
+    std::vector<VkImageMemoryBarrier> m_imageBarriers;  // Reused by execute()
+    uint64_t m_executeCount = 0;
+
+  public:
+    VulkanRenderGraph(const VulkanRenderGraph&) = delete;
+    void operator=(const VulkanRenderGraph&) = delete;
+};
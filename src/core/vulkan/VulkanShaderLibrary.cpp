@@ -0,0 +1,258 @@
+#include "pch.hpp"
+
+#include "VulkanShaderLibrary.hpp"
+#include "core/Hash.hpp"
+#include "core/Profiler.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include <filesystem>
+
+static VkShaderStageFlagBits getShaderStage(shaderc_shader_kind kind) noexcept
+{
+    switch (kind) {
+    case shaderc_vertex_shader: return VK_SHADER_STAGE_VERTEX_BIT;
+    case shaderc_fragment_shader: return VK_SHADER_STAGE_FRAGMENT_BIT;
+    case shaderc_compute_shader: return VK_SHADER_STAGE_COMPUTE_BIT;
+    case shaderc_geometry_shader: return VK_SHADER_STAGE_GEOMETRY_BIT;
+    case shaderc_tess_control_shader: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+    case shaderc_tess_evaluation_shader: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+    default: return VK_SHADER_STAGE_ALL;
+    }
+}
+
+
+VulkanShader::VulkanShader(VkDevice device, const std::string& path, const std::vector<std::string>& defines, const ShaderCompiler::Result& compiled)
+    : m_device(device), m_stage(getShaderStage(compiled.kind)), m_path(path), m_defines(defines)
+{
+    m_hash = hashBytes(compiled.spirv.data(), compiled.spirv.size() * sizeof(uint32_t));
+
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = compiled.spirv.size() * sizeof(uint32_t);
+    createInfo.pCode = compiled.spirv.data();
+
+    if (vkCreateShaderModule(m_device, &createInfo, nullptr, &m_module) != VK_SUCCESS)
+        throw Exception("Failed to create shader module for \"" + path + "\"");
+}
+
+
+VulkanShader::~VulkanShader()
+{
+    vkDestroyShaderModule(m_device, m_module, nullptr);
+}
+
+
+VulkanShaderLibrary::VulkanShaderLibrary(VkDevice device, const Settings& settings, JobSystem& jobSystem)
+    : m_device(device),
+      m_directory(std::filesystem::path(settings.shaderDirectory).lexically_normal().string()),
+      m_compiler(m_directory, settings.shaderCachePath),
+      m_jobSystem(jobSystem),
+      m_compilations(std::make_unique<JobCounter>())
+{
+    if (settings.shaderHotReload) {
+        try {
+            m_watcher = std::make_unique<FileWatcher>(m_directory);
+        } catch (const Exception& ex) {
+            LOG_WARN("Shader hot reload disabled\n{}", ex.what());
+            m_watcher.reset();
+        }
+    }
+
+    LOG_TRACE("Initialized shader library (\"{}\", hot reload {})", m_directory, m_watcher ? "on" : "off");
+}
+
+
+VulkanShaderLibrary::~VulkanShaderLibrary()
+{
+    // Queued compilations return right away
+    m_stopping.store(true);
+    m_jobSystem.wait(*m_compilations);
+
+    LOG_DEBUG("Shader library: {} shaders", m_shaders.size());
+}
+
+// public
+
+std::shared_ptr<const VulkanShader> VulkanShaderLibrary::get(const std::string& path, const std::vector<std::string>& defines)
+{
+    std::string fullPath = (std::filesystem::path(m_directory) / path).lexically_normal().string();
+    std::string key = makeKey(fullPath, defines);
+
+    {
+        std::lock_guard lock(m_mutex);
+
+        auto it = m_shaders.find(key);
+        if (it != m_shaders.end())
+            return it->second.shader;
+    }
+
+    // Without the lock, other shaders can be requested meanwhile
+    auto compiled = m_compiler.compile(fullPath, defines);
+    auto shader = std::make_shared<const VulkanShader>(m_device, fullPath, defines, compiled);
+
+    std::lock_guard lock(m_mutex);
+
+    // Another thread may have built it in the meantime, everyone gets the same one
+    auto [it, inserted] = m_shaders.try_emplace(key);
+    if (inserted) {
+        it->second.shader = std::move(shader);
+        it->second.includes = std::move(compiled.includes);
+    }
+
+    return it->second.shader;
+}
+
+
+VulkanShaderLibrary::ListenerID VulkanShaderLibrary::addReloadListener(const VulkanShader& shader, ReloadCallback callback)
+{
+    std::lock_guard lock(m_mutex);
+
+    ListenerID id = m_nextListenerID++;
+    m_listeners[id] = {makeKey(shader.getPath(), shader.getDefines()), std::move(callback)};
+    return id;
+}
+
+
+void VulkanShaderLibrary::removeReloadListener(ListenerID id)
+{
+    std::lock_guard lock(m_mutex);
+    m_listeners.erase(id);
+}
+
+
+void VulkanShaderLibrary::applyReloads()
+{
+    if (!m_watcher) return;
+
+    PROFILE_FUNCTION();
+
+    m_changedPaths.clear();
+    m_watcher->poll(m_changedPaths);
+
+    if (!m_changedPaths.empty())
+        queueReloads(m_changedPaths);
+
+    if (!m_hasCompiled.load(std::memory_order_acquire))
+        return;
+
+    std::vector<Compilation> compiled;
+    {
+        std::lock_guard lock(m_compileMutex);
+        compiled.swap(m_compiled);
+        m_hasCompiled.store(false, std::memory_order_relaxed);
+    }
+
+    std::vector<ReloadCallback> callbacks;
+    for (auto& compilation : compiled) {
+        callbacks.clear();
+        {
+            std::lock_guard lock(m_mutex);
+
+            auto& entry = m_shaders[compilation.key];
+
+            // Edited while compiling, this version may already be stale
+            if (entry.dirty) {
+                entry.dirty = false;
+                m_toCompile.push_back({compilation.key, compilation.path, compilation.defines, nullptr, {}});
+            } else {
+                entry.reloading = false;
+            }
+
+            if (!compilation.shader) continue;  // Failed, already reported
+
+            entry.shader = compilation.shader;
+            entry.includes = std::move(compilation.includes);
+
+            for (auto& [id, listener] : m_listeners) {
+                if (listener.key == compilation.key)
+                    callbacks.push_back(listener.callback);
+            }
+        }
+
+        LOG_INFO("Reloaded shader \"{}\" ({} listeners)", compilation.path, callbacks.size());
+
+        // Outside the lock, listeners may request shaders
+        for (auto& callback : callbacks)
+            callback(compilation.shader);
+    }
+
+    for (auto& compilation : m_toCompile)
+        compile(std::move(compilation));
+    m_toCompile.clear();
+}
+
+// private
+
+void VulkanShaderLibrary::queueReloads(const std::vector<std::string>& changedPaths)
+{
+    {
+        std::lock_guard lock(m_mutex);
+
+        for (auto& [key, entry] : m_shaders) {
+            auto& shader = *entry.shader;
+            bool changed = false;
+            for (auto& path : changedPaths) {
+                changed = changed || path == shader.getPath()
+                          || std::find(entry.includes.begin(), entry.includes.end(), path) != entry.includes.end();
+            }
+
+            if (!changed) continue;
+
+            // Compiled again by applyReloads() once the current compilation is done
+            if (entry.reloading) {
+                entry.dirty = true;
+                continue;
+            }
+
+            entry.reloading = true;
+            m_toCompile.push_back({key, shader.getPath(), shader.getDefines(), nullptr, {}});
+        }
+    }
+
+    if (m_toCompile.empty()) return;
+
+    LOG_DEBUG("Shader sources changed, recompiling {} shaders", m_toCompile.size());
+
+    // Outside the lock, with a single worker the compilation runs inline
+    for (auto& compilation : m_toCompile)
+        compile(std::move(compilation));
+    m_toCompile.clear();
+}
+
+
+void VulkanShaderLibrary::compile(Compilation compilation)
+{
+    m_jobSystem.runBackground([this, compilation = std::move(compilation)]() mutable {
+        if (m_stopping.load(std::memory_order_relaxed)) return;
+
+        PROFILE_SCOPE("Compile shader");
+
+        try {
+            auto compiled = m_compiler.compile(compilation.path, compilation.defines);
+            compilation.shader = std::make_shared<const VulkanShader>(m_device, compilation.path, compilation.defines, compiled);
+            compilation.includes = std::move(compiled.includes);
+
+        } catch (const std::exception& ex) {
+            LOG_ERROR("Shader reload failed, keeping the previous version\n{}", ex.what());
+        }
+
+        std::lock_guard lock(m_compileMutex);
+        m_compiled.push_back(std::move(compilation));
+        m_hasCompiled.store(true, std::memory_order_release);
+
+    }, m_compilations.get());
+}
+
+
+std::string VulkanShaderLibrary::makeKey(const std::string& path, const std::vector<std::string>& defines)
+{
+    // Same define set in another order, same shader
+    std::vector<std::string> sortedDefines(defines);
+    std::sort(sortedDefines.begin(), sortedDefines.end());
+
+    std::string key = path;
+    for (auto& define : sortedDefines)
+        key += '\0' + define;
+
+    return key;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "core/FileWatcher.hpp"
+#include "core/Settings.hpp"
+#include "core/ShaderCompiler.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+class JobCounter;
+
+// A shader module and what it was built from.
+// Shared: a pipeline being created keeps its modules alive while a reload replaces them
+class VulkanShader
+{
+  public:
+    VulkanShader(VkDevice device, const std::string& path, const std::vector<std::string>& defines, const ShaderCompiler::Result& compiled);
+    ~VulkanShader();
+
+    inline VkShaderModule getModule() const noexcept { return m_module; }
+    inline VkShaderStageFlagBits getStage() const noexcept { return m_stage; }
+    inline const std::string& getPath() const noexcept { return m_path; }
+    inline const std::vector<std::string>& getDefines() const noexcept { return m_defines; }
+    inline uint64_t getHash() const noexcept { return m_hash; }  // Of the SPIR-V, changes with a reload
+
+  private:
+    VkDevice m_device;
+    VkShaderModule m_module = VK_NULL_HANDLE;
+    VkShaderStageFlagBits m_stage;
+    std::string m_path;
+    std::vector<std::string> m_defines;
+    uint64_t m_hash;
+
+  public:
+    VulkanShader(const VulkanShader&) = delete;
+    void operator=(const VulkanShader&) = delete;
+};
+
+
+// Every shader module of the device, one per source file and define set.
+// With hot reload, changes to the shader directory are picked up by applyReloads() and only the
+// shaders that use the changed file (directly or through #include) are recompiled, as background
+// jobs. Once a shader is rebuilt, the next applyReloads() swaps it in and calls its reload
+// listeners, which rebuild their own pipelines. A shader that fails to compile keeps its previous
+// version. A shader edited again while it compiles is compiled once more afterwards.
+class VulkanShaderLibrary
+{
+  public:
+    typedef uint64_t ListenerID;
+    using ReloadCallback = std::function<void(const std::shared_ptr<const VulkanShader>& shader)>;
+
+  public:
+    VulkanShaderLibrary(VkDevice device, const Settings& settings, JobSystem& jobSystem);
+    ~VulkanShaderLibrary();  // Waits for the compilations in progress
+
+    // `path` is relative to the shader directory. Compiled (or loaded from the cache) on the first
+    // request, on the calling thread. Thread safe, throws if the shader doesn't compile
+    std::shared_ptr<const VulkanShader> get(const std::string& path, const std::vector<std::string>& defines = {});
+
+    // `callback` is called by applyReloads() with every new version of `shader`
+    ListenerID addReloadListener(const VulkanShader& shader, ReloadCallback callback);
+    void removeReloadListener(ListenerID id);
+
+    // Once per frame, from the main thread. Never waits for a compilation, unless the main
+    // thread is the only worker (@see JobSystem::runBackground)
+    void applyReloads();
+
+  private:
+    struct Entry
+    {
+        std::shared_ptr<const VulkanShader> shader;
+        std::vector<std::string> includes;
+        bool reloading = false;  // Queued or being compiled
+        bool dirty = false;      // Changed again while reloading
+    };
+
+    struct Listener
+    {
+        std::string key;
+        ReloadCallback callback;
+    };
+
+    struct Compilation
+    {
+        std::string key;
+        std::string path;
+        std::vector<std::string> defines;
+        std::shared_ptr<const VulkanShader> shader;  // Null if it failed
+        std::vector<std::string> includes;
+    };
+
+  private:
+    void queueReloads(const std::vector<std::string>& changedPaths);
+    void compile(Compilation compilation);
+
+    static std::string makeKey(const std::string& path, const std::vector<std::string>& defines);
+
+  private:
+    VkDevice m_device;
+    std::string m_directory;
+    ShaderCompiler m_compiler;
+
+    std::mutex m_mutex;  // Guards m_shaders and m_listeners
+    std::unordered_map<std::string, Entry> m_shaders;  // By makeKey()
+    std::map<ListenerID, Listener> m_listeners;  // Called in registration order
+    ListenerID m_nextListenerID = 1;
+
+    // Hot reload, none of it exists when disabled
+    JobSystem& m_jobSystem;
+    std::unique_ptr<FileWatcher> m_watcher;
+    std::vector<std::string> m_changedPaths;  // Reused every frame
+    std::vector<Compilation> m_toCompile;     // Reused every frame
+    std::unique_ptr<JobCounter> m_compilations;  // In flight
+    std::mutex m_compileMutex;  // Guards m_compiled
+    std::vector<Compilation> m_compiled;
+    std::atomic<bool> m_hasCompiled{false};  // Lets applyReloads() skip the lock
+    std::atomic<bool> m_stopping{false};
+
+  public:
+    VulkanShaderLibrary(const VulkanShaderLibrary&) = delete;
+    void operator=(const VulkanShaderLibrary&) = delete;
+};
@@ -0,0 +1,316 @@
+#include "pch.hpp"
+
+#include "VulkanSwapchain.hpp"
+#include "core/Profiler.hpp"
+
+VulkanSwapchain::VulkanSwapchain(VulkanDevice& device, VkSurfaceKHR surface, VkExtent2D extent, VkPresentModeKHR presentMode)
+    : m_device(device), m_surface(surface), m_requestedPresentMode(presentMode), m_requestedExtent(extent)
+{
+    PROFILE_FUNCTION();
+
+    try {
+        VkBool32 presentSupport = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(
+            m_device.getPhysicalDevice(),
+            m_device.getQueueFamilyIndex(VulkanDevice::QueueType::GRAPHICS),
+            m_surface,
+            &presentSupport);
+
+        if (!presentSupport)
+            throw Exception("The graphics queue can't present to this surface");
+
+        createSyncObjects();
+
+        // A minimized Window gets its swapchain when it is restored
+        m_outdated = !create();
+
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to initialize swapchain");
+
+        // The destructor won't run
+        destroyImageViews();
+        if (m_swapchain != VK_NULL_HANDLE)
+            vkDestroySwapchainKHR(m_device.getHandle(), m_swapchain, nullptr);
+        destroySyncObjects();
+
+        throw;
+    }
+}
+
+
+VulkanSwapchain::~VulkanSwapchain()
+{
+    LOG_TRACE("Destroying swapchain");
+
+    m_device.waitForAllFrames();
+
+    destroyImageViews();
+    if (m_swapchain != VK_NULL_HANDLE)
+        vkDestroySwapchainKHR(m_device.getHandle(), m_swapchain, nullptr);
+    destroySyncObjects();
+}
+
+// public
+
+bool VulkanSwapchain::acquire(uint32_t frameIndex, Frame& frame)
+{
+    PROFILE_FUNCTION();
+
+    if (m_outdated) {
+        // Images of the old swapchain may still be rendered to
+        m_device.waitForAllFrames();
+
+        if (!create()) return false;
+        m_outdated = false;
+    }
+
+    frame.index = frameIndex % MAX_FRAMES_IN_FLIGHT;
+    frame.imageAvailable = m_imageAvailable[frame.index];
+
+    VkResult result = m_device.getDispatch().vkAcquireNextImageKHR(
+        m_device.getHandle(),
+        m_swapchain,
+        UINT64_MAX,
+        frame.imageAvailable,
+        VK_NULL_HANDLE,
+        &frame.imageIndex);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        m_outdated = true;
+        return false;
+    }
+
+    // Still presentable, it is recreated before the next frame
+    if (result == VK_SUBOPTIMAL_KHR)
+        m_outdated = true;
+    else if (result != VK_SUCCESS)
+        throw Exception("Failed to acquire a swapchain image");
+
+    frame.image = m_images[frame.imageIndex];
+    frame.imageView = m_imageViews[frame.imageIndex];
+    frame.renderFinished = m_renderFinished[frame.imageIndex];
+
+    return true;
+}
+
+
+void VulkanSwapchain::onPresent(VkResult result)
+{
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+        m_outdated = true;
+    else if (result != VK_SUCCESS)
+        throw Exception("Failed to present a swapchain image");
+}
+
+
+void VulkanSwapchain::resize(VkExtent2D extent) noexcept
+{
+    m_requestedExtent = extent;
+    m_outdated = true;
+}
+
+
+const char* VulkanSwapchain::getPresentModeName(VkPresentModeKHR presentMode) noexcept
+{
+    switch (presentMode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+    case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+    case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+    default: return "unknown";
+    }
+}
+
+// private
+
+void VulkanSwapchain::createSyncObjects()
+{
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    for (auto& semaphore : m_imageAvailable) {
+        if (vkCreateSemaphore(m_device.getHandle(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            throw Exception("Failed to create swapchain semaphore");
+    }
+}
+
+
+void VulkanSwapchain::destroySyncObjects() noexcept
+{
+    for (auto& semaphore : m_imageAvailable) {
+        if (semaphore != VK_NULL_HANDLE)
+            vkDestroySemaphore(m_device.getHandle(), semaphore, nullptr);
+
+        semaphore = VK_NULL_HANDLE;
+    }
+
+    for (auto semaphore : m_renderFinished)
+        vkDestroySemaphore(m_device.getHandle(), semaphore, nullptr);
+
+    m_renderFinished.clear();
+}
+
+
+bool VulkanSwapchain::create()
+{
+    PROFILE_FUNCTION();
+
+    VkPhysicalDevice physicalDevice = m_device.getPhysicalDevice();
+
+    VkSurfaceCapabilitiesKHR capabilities;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, m_surface, &capabilities);
+
+    VkExtent2D extent = chooseExtent(capabilities);
+    if (extent.width == 0 || extent.height == 0)
+        return false;
+
+    m_format = chooseSurfaceFormat();
+    m_presentMode = choosePresentMode();
+
+    // One more than the minimum, so acquiring doesn't wait on the presentation engine
+    uint32_t imageCount = capabilities.minImageCount + 1;
+    if (capabilities.maxImageCount > 0)
+        imageCount = std::min(imageCount, capabilities.maxImageCount);
+
+    VkSwapchainKHR oldSwapchain = m_swapchain;
+
+    VkSwapchainCreateInfoKHR createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface = m_surface;
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = m_format.format;
+    createInfo.imageColorSpace = m_format.colorSpace;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;  // The only usage every surface supports
+    createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;  // Rendered and presented on the graphics queue
+    createInfo.preTransform = capabilities.currentTransform;
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = m_presentMode;
+    createInfo.clipped = VK_TRUE;
+    createInfo.oldSwapchain = oldSwapchain;
+
+    if (vkCreateSwapchainKHR(m_device.getHandle(), &createInfo, nullptr, &m_swapchain) != VK_SUCCESS) {
+        m_swapchain = oldSwapchain;
+        throw Exception("Failed to create swapchain");
+    }
+
+    // Retired by the new one, nothing in flight uses it anymore
+    destroyImageViews();
+    if (oldSwapchain != VK_NULL_HANDLE)
+        vkDestroySwapchainKHR(m_device.getHandle(), oldSwapchain, nullptr);
+
+    m_extent = extent;
+    m_generation++;
+
+    vkGetSwapchainImagesKHR(m_device.getHandle(), m_swapchain, &imageCount, nullptr);
+    m_images.resize(imageCount);
+    vkGetSwapchainImagesKHR(m_device.getHandle(), m_swapchain, &imageCount, m_images.data());
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = m_format.format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    m_imageViews.reserve(imageCount);
+    for (auto image : m_images) {
+        viewInfo.image = image;
+
+        VkImageView imageView;
+        if (vkCreateImageView(m_device.getHandle(), &viewInfo, nullptr, &imageView) != VK_SUCCESS)
+            throw Exception("Failed to create swapchain image view");
+
+        m_imageViews.push_back(imageView);
+    }
+
+    // Kept across recreations, a present of the old swapchain may still wait on them
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    while (m_renderFinished.size() < imageCount) {
+        VkSemaphore semaphore;
+        if (vkCreateSemaphore(m_device.getHandle(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+            throw Exception("Failed to create swapchain semaphore");
+
+        m_renderFinished.push_back(semaphore);
+    }
+
+    LOG_DEBUG(
+        "Created swapchain ({}x{}, {} images, {} present mode)",
+        extent.width,
+        extent.height,
+        imageCount,
+        getPresentModeName(m_presentMode));
+
+    return true;
+}
+
+
+void VulkanSwapchain::destroyImageViews() noexcept
+{
+    for (auto imageView : m_imageViews)
+        vkDestroyImageView(m_device.getHandle(), imageView, nullptr);
+
+    m_imageViews.clear();
+    m_images.clear();  // Owned by the swapchain
+}
+
+
+VkSurfaceFormatKHR VulkanSwapchain::chooseSurfaceFormat() const
+{
+    uint32_t formatCount = 0;
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_device.getPhysicalDevice(), m_surface, &formatCount, nullptr);
+
+    if (formatCount == 0)
+        throw Exception("The surface has no format");
+
+    std::vector<VkSurfaceFormatKHR> formats(formatCount);
+    vkGetPhysicalDeviceSurfaceFormatsKHR(m_device.getPhysicalDevice(), m_surface, &formatCount, formats.data());
+
+    VkSurfaceFormatKHR preferred = {VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+
+    // The surface has no preferred format
+    if (formats.size() == 1 && formats[0].format == VK_FORMAT_UNDEFINED)
+        return preferred;
+
+    for (auto& format : formats) {
+        if (format.format == preferred.format && format.colorSpace == preferred.colorSpace)
+            return format;
+    }
+
+    return formats[0];
+}
+
+
+VkPresentModeKHR VulkanSwapchain::choosePresentMode() const
+{
+    uint32_t modeCount = 0;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_device.getPhysicalDevice(), m_surface, &modeCount, nullptr);
+    std::vector<VkPresentModeKHR> modes(modeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(m_device.getPhysicalDevice(), m_surface, &modeCount, modes.data());
+
+    if (std::find(modes.begin(), modes.end(), m_requestedPresentMode) != modes.end())
+        return m_requestedPresentMode;
+
+    // Logged once, recreations fall back silently
+    if (m_swapchain == VK_NULL_HANDLE) {
+        LOG_WARN(
+            "Present mode {} is not supported by the surface, falling back to fifo",
+            getPresentModeName(m_requestedPresentMode));
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+
+VkExtent2D VulkanSwapchain::chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const noexcept
+{
+    // Otherwise the surface size is set by the swapchain
+    if (capabilities.currentExtent.width != UINT32_MAX)
+        return capabilities.currentExtent;
+
+    return {
+        std::clamp(m_requestedExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width),
+        std::clamp(m_requestedExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height)};
+}
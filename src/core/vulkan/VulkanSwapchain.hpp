@@ -0,0 +1,90 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <vector>
+
+// A Window's swapchain.
+// Every frame in flight has its own acquire semaphore, the device's frame fences tell when it
+// can be reused (see VulkanDevice::beginFrame). Render finished semaphores are per image: an
+// image is only acquired again once its previous present is done with the semaphore. Frames
+// are submitted and presented by a VulkanFrameBatch, on the graphics queue.
+class VulkanSwapchain
+{
+  public:
+    struct Frame
+    {
+        uint32_t index = 0;  // Frame in flight slot
+        uint32_t imageIndex = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView imageView = VK_NULL_HANDLE;
+        VkSemaphore imageAvailable = VK_NULL_HANDLE;  // Wait on it before writing to the image
+        VkSemaphore renderFinished = VK_NULL_HANDLE;  // Signal it from the last submission, the present waits on it
+    };
+
+  public:
+    // `presentMode` falls back to FIFO, the only one every surface supports
+    VulkanSwapchain(VulkanDevice& device, VkSurfaceKHR surface, VkExtent2D extent, VkPresentModeKHR presentMode);
+    ~VulkanSwapchain();  // Waits for the frames in flight
+
+    // Acquires the next image for the frame in flight, VulkanDevice::beginFrame() must have
+    // been called for it. False when there is nothing to render to this time (minimized, or the
+    // swapchain was just recreated): skip the frame
+    bool acquire(uint32_t frameIndex, Frame& frame);
+    // The result of the present of the acquired image
+    void onPresent(VkResult result);
+    // The acquired image won't be presented (see VulkanFrameBatch::discard). The swapchain is
+    // recreated at the next acquire(), which gives the image back
+    inline void discard() noexcept { m_outdated = true; }
+
+    // The new size is applied at the next acquire()
+    void resize(VkExtent2D extent) noexcept;
+
+    inline VkSwapchainKHR getHandle() const noexcept { return m_swapchain; }
+    inline VkFormat getFormat() const noexcept { return m_format.format; }
+    inline VkExtent2D getExtent() const noexcept { return m_extent; }
+    inline VkPresentModeKHR getPresentMode() const noexcept { return m_presentMode; }
+    inline uint32_t getImageCount() const noexcept { return static_cast<uint32_t>(m_images.size()); }
+    // Bumped whenever the images are recreated, after waiting for every frame in flight: what
+    // was built on the previous ones (framebuffers) can be destroyed right away. 0 until created
+    inline uint64_t getGeneration() const noexcept { return m_generation; }
+
+    static const char* getPresentModeName(VkPresentModeKHR presentMode) noexcept;
+
+  private:
+    void createSyncObjects();
+    void destroySyncObjects() noexcept;
+
+    // Replaces the current swapchain, if any. False if the surface has a null extent
+    bool create();
+    void destroyImageViews() noexcept;
+
+    VkSurfaceFormatKHR chooseSurfaceFormat() const;
+    VkPresentModeKHR choosePresentMode() const;
+    VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities) const noexcept;
+
+  private:
+    VulkanDevice& m_device;
+    VkSurfaceKHR m_surface;
+
+    VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+    VkSurfaceFormatKHR m_format = {};
+    VkPresentModeKHR m_requestedPresentMode;
+    VkPresentModeKHR m_presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    VkExtent2D m_requestedExtent;
+    VkExtent2D m_extent = {};
+    bool m_outdated = false;  // Recreate at the next acquire()
+    uint64_t m_generation = 0;
+
+    std::vector<VkImage> m_images;
+    std::vector<VkImageView> m_imageViews;
+    std::vector<VkSemaphore> m_renderFinished;  // Per image
+    std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> m_imageAvailable = {};  // Per frame in flight
+
+  public:
+    VulkanSwapchain(const VulkanSwapchain&) = delete;
+    void operator=(const VulkanSwapchain&) = delete;
+};
@@ -0,0 +1,193 @@
+#include "pch.hpp"
+
+#include "VulkanTimestamps.hpp"
+#include "core/Profiler.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+VulkanTimestamps::VulkanTimestamps(
+    VkDevice device,
+    const VulkanDeviceDispatch& dispatch,
+    float timestampPeriod,
+    uint32_t validBits,
+    uint32_t threadCount,
+    uint32_t frameCount)
+    : m_device(device),
+      m_dispatch(dispatch),
+      m_period(timestampPeriod),
+      m_validMask(validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1),
+      m_threadCount(threadCount),
+      m_frameCount(frameCount),
+      m_scopes(threadCount * frameCount)
+{
+    if (!isSupported()) {
+        LOG_WARN("The graphics queue has no timestamps, GPU times won't be measured");
+        return;
+    }
+
+    try {
+        VkQueryPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = threadCount * TIMESTAMP_SCOPES_PER_THREAD * 2;
+
+        for (uint32_t i = 0; i < frameCount; i++) {
+            VkQueryPool pool;
+            if (vkCreateQueryPool(m_device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+                throw Exception("Failed to create timestamp query pool");
+
+            m_pools.push_back(pool);
+        }
+
+    } catch (const Exception& ex) {
+        // The destructor won't run
+        for (auto pool : m_pools)
+            vkDestroyQueryPool(m_device, pool, nullptr);
+
+        throw;
+    }
+
+    // Reserved up front: a thread timing its first scope mid frame doesn't allocate
+    for (auto& threadScopes : m_scopes) {
+        threadScopes.names.resize(TIMESTAMP_SCOPES_PER_THREAD);
+        for (auto& name : threadScopes.names)
+            name.reserve(TIMESTAMP_NAME_CAPACITY);
+    }
+
+    m_queryResults.resize(TIMESTAMP_SCOPES_PER_THREAD * 2);
+    m_results.reserve(threadCount * TIMESTAMP_SCOPES_PER_THREAD);
+    m_spareNames.resize(threadCount * TIMESTAMP_SCOPES_PER_THREAD);
+    for (auto& name : m_spareNames)
+        name.reserve(TIMESTAMP_NAME_CAPACITY);
+
+    LOG_TRACE("Initialized timestamps ({} threads, {} frames, {:.2f}ns per tick)", threadCount, frameCount, m_period);
+}
+
+
+VulkanTimestamps::~VulkanTimestamps()
+{
+    for (auto pool : m_pools)
+        vkDestroyQueryPool(m_device, pool, nullptr);
+
+    LOG_DEBUG("Timestamps: {} scopes timed, {} dropped", m_timedScopes, m_droppedScopes);
+}
+
+// public
+
+void VulkanTimestamps::beginFrame(uint32_t frameIndex)
+{
+    PROFILE_FUNCTION();
+
+    m_currentFrame = frameIndex % m_frameCount;
+
+    // Names longer than the small string buffer would be allocated again every frame
+    for (auto& result : m_results)
+        m_spareNames.push_back(std::move(result.name));
+
+    m_results.clear();
+    m_frameTime = 0.0;
+
+    if (!isSupported())
+        return;
+
+    // Ticks relative to the first begin read, wrapped to the valid bits
+    bool hasReference = false;
+    uint64_t reference = 0;
+    int64_t frameBegin = INT64_MAX, frameEnd = INT64_MIN;
+
+    auto relative = [&](uint64_t ticks) {
+        uint64_t delta = (ticks - reference) & m_validMask;
+        return delta > m_validMask / 2 ? static_cast<int64_t>(delta) - static_cast<int64_t>(m_validMask) - 1 : static_cast<int64_t>(delta);
+    };
+
+    for (uint32_t thread = 0; thread < m_threadCount; thread++) {
+        auto& threadScopes = m_scopes[m_currentFrame * m_threadCount + thread];
+        if (threadScopes.count == 0) continue;
+
+        uint32_t count = std::min<uint32_t>(threadScopes.count, TIMESTAMP_SCOPES_PER_THREAD);
+        m_droppedScopes += threadScopes.count - count;
+        threadScopes.count = 0;
+
+        // No VK_QUERY_RESULT_WAIT_BIT: the frame fence was waited on, anything not available
+        // now was never submitted
+        VkResult result = m_dispatch.vkGetQueryPoolResults(
+            m_device,
+            m_pools[m_currentFrame],
+            thread * TIMESTAMP_SCOPES_PER_THREAD * 2,
+            count * 2,
+            count * 2 * sizeof(uint64_t),
+            m_queryResults.data(),
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT);
+
+        if (result != VK_SUCCESS) {
+            m_droppedScopes += count;
+            continue;
+        }
+
+        if (!hasReference) {
+            reference = m_queryResults[0];
+            hasReference = true;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            int64_t begin = relative(m_queryResults[i * 2]), end = relative(m_queryResults[i * 2 + 1]);
+
+            std::string name;
+            if (!m_spareNames.empty()) {
+                name = std::move(m_spareNames.back());
+                m_spareNames.pop_back();
+            }
+
+            name = threadScopes.names[i];
+            m_results.push_back({std::move(name), (end - begin) * m_period * 1e-6});
+            frameBegin = std::min(frameBegin, begin);
+            frameEnd = std::max(frameEnd, end);
+        }
+
+        m_timedScopes += count;
+    }
+
+    if (!m_results.empty())
+        m_frameTime = (frameEnd - frameBegin) * m_period * 1e-6;
+}
+
+
+uint32_t VulkanTimestamps::beginScope(VkCommandBuffer commandBuffer, const std::string& name)
+{
+    if (!isSupported())
+        return TIMESTAMP_NO_SCOPE;
+
+    auto& threadScopes = getThreadScopes();
+    uint32_t index = threadScopes.count++;  // Counted even when full, to report the dropped ones
+    if (index >= TIMESTAMP_SCOPES_PER_THREAD)
+        return TIMESTAMP_NO_SCOPE;
+
+    threadScopes.names[index] = name;
+
+    // Reset in the command buffer, Vulkan 1.0 can't reset queries from the host
+    uint32_t query = (JobSystem::getThreadIndex() * TIMESTAMP_SCOPES_PER_THREAD + index) * 2;
+    m_dispatch.vkCmdResetQueryPool(commandBuffer, m_pools[m_currentFrame], query, 2);
+    m_dispatch.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_pools[m_currentFrame], query);
+
+    return query;
+}
+
+
+void VulkanTimestamps::endScope(VkCommandBuffer commandBuffer, uint32_t scope)
+{
+    if (scope == TIMESTAMP_NO_SCOPE)
+        return;
+
+    m_dispatch.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_pools[m_currentFrame], scope + 1);
+}
+
+// private
+
+VulkanTimestamps::ThreadScopes& VulkanTimestamps::getThreadScopes()
+{
+    uint32_t thread = JobSystem::getThreadIndex();
+    if (thread >= m_threadCount)
+        throw Exception("Timestamp scopes can only be opened from job system threads");
+
+    return m_scopes[m_currentFrame * m_threadCount + thread];
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+#include <vector>
+
+#define TIMESTAMP_SCOPES_PER_THREAD 64  // Per frame in flight, scopes past it aren't timed
+#define TIMESTAMP_NO_SCOPE UINT32_MAX
+#define TIMESTAMP_NAME_CAPACITY 64  // Longer scope names are copied on the heap
+
+struct VulkanDeviceDispatch;
+
+// GPU time of named scopes of the command buffers, read back without stalling.
+// Every frame in flight has its own query pool, split between the job system threads like
+// VulkanCommandPools, so scopes are opened without locking. A frame's queries are read when the
+// frame comes back to beginFrame(), after its fence: they are done, nothing waits for them.
+// Devices whose graphics queue has no timestamps time nothing, scopes are then no-ops.
+class VulkanTimestamps
+{
+  public:
+    struct Result
+    {
+        std::string name;
+        double milliseconds;
+    };
+
+  public:
+    VulkanTimestamps(VkDevice device, const VulkanDeviceDispatch& dispatch, float timestampPeriod, uint32_t validBits, uint32_t threadCount, uint32_t frameCount);
+    ~VulkanTimestamps();
+
+    // Reads the previous use of this frame in flight, the device must be done with it
+    void beginFrame(uint32_t frameIndex);
+
+    // Outside render passes, on a job system thread. TIMESTAMP_NO_SCOPE when not timed,
+    // endScope() ignores it
+    uint32_t beginScope(VkCommandBuffer commandBuffer, const std::string& name);
+    void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+    inline bool isSupported() const noexcept { return m_validMask != 0; }
+
+    // Of the frame read by the last beginFrame(), empty if it timed nothing. The frame time
+    // spans the first scope to the last one, whatever their command buffers
+    inline const std::vector<Result>& getResults() const noexcept { return m_results; }
+    inline double getFrameTime() const noexcept { return m_frameTime; }
+
+  private:
+    // Only touched by its thread, padded so neighbours don't share a cache line
+    struct alignas(64) ThreadScopes
+    {
+        std::vector<std::string> names;  // Reused, to keep their capacity
+        uint32_t count = 0;  // Opened since the last read
+    };
+
+  private:
+    ThreadScopes& getThreadScopes();
+
+  private:
+    VkDevice m_device;
+    const VulkanDeviceDispatch& m_dispatch;
+    double m_period;  // Nanoseconds per tick
+    uint64_t m_validMask;
+    uint32_t m_threadCount;
+    uint32_t m_frameCount;
+
+    std::vector<VkQueryPool> m_pools;  // By frame in flight, 2 queries per scope
+    std::vector<ThreadScopes> m_scopes;  // [frame * m_threadCount + thread]
+    uint32_t m_currentFrame = 0;
+
+    std::vector<uint64_t> m_queryResults;  // Reused by beginFrame()
+    std::vector<Result> m_results;
+    std::vector<std::string> m_spareNames;  // Of the previous results, to keep their capacity
+    double m_frameTime = 0.0;
+
+    uint64_t m_timedScopes = 0;
+    uint64_t m_droppedScopes = 0;  // Out of queries, or never submitted
+
+  public:
+    VulkanTimestamps(const VulkanTimestamps&) = delete;
+    void operator=(const VulkanTimestamps&) = delete;
+};
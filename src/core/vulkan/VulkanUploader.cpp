@@ -0,0 +1,430 @@
+#include "pch.hpp"
+
+#include "VulkanUploader.hpp"
+#include "VulkanDevice.hpp"
+#include "core/Profiler.hpp"
+
+#include <cstring>
+
+VulkanUploader::VulkanUploader(VulkanDevice& device, VkDeviceSize stagingSize)
+    : m_device(device),
+      m_transferFamily(device.getQueueFamilyIndex(VulkanDevice::QueueType::TRANSFER)),
+      m_graphicsFamily(device.getQueueFamilyIndex(VulkanDevice::QueueType::GRAPHICS)),
+      m_stagingSize(stagingSize),
+      m_copyAlignment(std::max<VkDeviceSize>(device.getProperties().limits.optimalBufferCopyOffsetAlignment, 16))
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = stagingSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    m_stagingAllocation = m_device.getAllocator().createBuffer(bufferInfo, VulkanAllocator::MemoryUsage::CPU_TO_GPU, m_stagingBuffer);
+
+    try {
+        createCommandObjects();
+
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to initialize uploader");
+
+        // The destructor won't run
+        destroyCommandObjects();
+        m_device.getAllocator().destroyBuffer(m_stagingBuffer, m_stagingAllocation);
+
+        throw;
+    }
+
+    LOG_TRACE(
+        "Initialized uploader ({} MiB staging, {})",
+        m_stagingSize >> 20,
+        hasOwnershipTransfer() ? "dedicated transfer queue" : "graphics queue");
+}
+
+
+VulkanUploader::~VulkanUploader()
+{
+    LOG_TRACE("Destroying uploader");
+
+    try {
+        waitIdle();
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to wait for pending uploads\n{}", ex.what());
+        vkDeviceWaitIdle(m_device.getHandle());
+    }
+
+    LOG_DEBUG("Uploader: {} bytes in {} submissions", m_uploadedBytes, m_submitCount);
+
+    destroyCommandObjects();
+    m_device.getAllocator().destroyBuffer(m_stagingBuffer, m_stagingAllocation);
+}
+
+// public
+
+void VulkanUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+    std::lock_guard lock(m_mutex);
+
+    auto bytes = static_cast<const char*>(data);
+
+    while (size > 0) {
+        VkDeviceSize chunkSize = std::min(size, m_stagingSize / 2);
+
+        // May submit the recording batch to make room, so it goes before getRecordingBatch()
+        VkDeviceSize stagingOffset = allocateStaging(chunkSize, m_copyAlignment);
+        std::memcpy(static_cast<char*>(m_stagingAllocation->mappedData) + stagingOffset, bytes, chunkSize);
+
+        Batch& batch = getRecordingBatch();
+        batch.stagingEnd = m_stagingHead;
+
+        VkBufferCopy region = {stagingOffset, offset, chunkSize};
+        m_device.getDispatch().vkCmdCopyBuffer(batch.transferCommands, m_stagingBuffer, buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = hasOwnershipTransfer() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = hasOwnershipTransfer() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = chunkSize;
+        batch.bufferBarriers.push_back(barrier);
+
+        m_uploadedBytes += chunkSize;
+        bytes += chunkSize;
+        offset += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+
+void VulkanUploader::uploadImage(
+    VkImage image,
+    const VkImageSubresourceLayers& subresource,
+    VkExtent3D extent,
+    const void* data,
+    VkDeviceSize size,
+    VkImageLayout finalLayout)
+{
+    std::lock_guard lock(m_mutex);
+
+    if (size > m_stagingSize / 2)
+        throw Exception("Image upload of " + std::to_string(size) + " bytes does not fit in the staging buffer");
+
+    VkDeviceSize stagingOffset = allocateStaging(size, m_copyAlignment);
+    std::memcpy(static_cast<char*>(m_stagingAllocation->mappedData) + stagingOffset, data, size);
+
+    Batch& batch = getRecordingBatch();
+    batch.stagingEnd = m_stagingHead;
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = {subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount};
+
+    m_device.getDispatch().vkCmdPipelineBarrier(
+        batch.transferCommands,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset = stagingOffset;
+    region.imageSubresource = subresource;
+    region.imageExtent = extent;
+    m_device.getDispatch().vkCmdCopyBufferToImage(batch.transferCommands, m_stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    // Released at submission, along with the layout transition
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = finalLayout;
+    barrier.srcQueueFamilyIndex = hasOwnershipTransfer() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = hasOwnershipTransfer() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+    batch.imageBarriers.push_back(barrier);
+
+    m_uploadedBytes += size;
+}
+
+
+void VulkanUploader::flush()
+{
+    std::lock_guard lock(m_mutex);
+
+    while (retireOldestBatch(false)) { }
+
+    Batch& batch = m_batches[m_currentBatch];
+    if (batch.recording)
+        submitBatch(batch);
+}
+
+
+void VulkanUploader::waitIdle()
+{
+    std::lock_guard lock(m_mutex);
+
+    Batch& batch = m_batches[m_currentBatch];
+    if (batch.recording)
+        submitBatch(batch);
+
+    while (retireOldestBatch(true)) { }
+}
+
+// private
+
+void VulkanUploader::createCommandObjects()
+{
+    VkDevice device = m_device.getHandle();
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    poolInfo.queueFamilyIndex = m_transferFamily;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &m_transferPool) != VK_SUCCESS)
+        throw Exception("Failed to create transfer command pool");
+
+    if (hasOwnershipTransfer()) {
+        poolInfo.queueFamilyIndex = m_graphicsFamily;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &m_graphicsPool) != VK_SUCCESS)
+            throw Exception("Failed to create upload acquire command pool");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (auto& batch : m_batches) {
+        allocInfo.commandPool = m_transferPool;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &batch.transferCommands) != VK_SUCCESS)
+            throw Exception("Failed to allocate upload command buffer");
+
+        if (hasOwnershipTransfer()) {
+            allocInfo.commandPool = m_graphicsPool;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &batch.acquireCommands) != VK_SUCCESS)
+                throw Exception("Failed to allocate upload acquire command buffer");
+
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.transferDone) != VK_SUCCESS)
+                throw Exception("Failed to create upload semaphore");
+        }
+
+        if (vkCreateFence(device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS)
+            throw Exception("Failed to create upload fence");
+    }
+}
+
+
+void VulkanUploader::destroyCommandObjects() noexcept
+{
+    VkDevice device = m_device.getHandle();
+
+    for (auto& batch : m_batches) {
+        vkDestroyFence(device, batch.fence, nullptr);
+        vkDestroySemaphore(device, batch.transferDone, nullptr);
+    }
+
+    // Frees the command buffers too
+    vkDestroyCommandPool(device, m_graphicsPool, nullptr);
+    vkDestroyCommandPool(device, m_transferPool, nullptr);
+}
+
+
+VulkanUploader::Batch& VulkanUploader::getRecordingBatch()
+{
+    Batch& batch = m_batches[m_currentBatch];
+    if (batch.recording) return batch;
+
+    // Every batch is in flight, this one is the oldest
+    while (batch.pending)
+        retireOldestBatch(true);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (m_device.getDispatch().vkBeginCommandBuffer(batch.transferCommands, &beginInfo) != VK_SUCCESS)
+        throw Exception("Failed to begin upload command buffer");
+
+    batch.recording = true;
+    return batch;
+}
+
+
+VkDeviceSize VulkanUploader::allocateStaging(VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = 0;
+
+    // Full: submit what is recorded and wait for the oldest submission to give back its space
+    while (!tryAllocateStaging(size, alignment, offset)) {
+        Batch& batch = m_batches[m_currentBatch];
+        if (batch.recording)
+            submitBatch(batch);
+
+        if (!retireOldestBatch(true))
+            throw Exception("Upload of " + std::to_string(size) + " bytes does not fit in the staging buffer");
+    }
+
+    return offset;
+}
+
+
+bool VulkanUploader::tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) noexcept
+{
+    // The head never catches up with the tail, so head == tail means empty
+    VkDeviceSize aligned = (m_stagingHead + alignment - 1) / alignment * alignment;
+
+    if (m_stagingHead >= m_stagingTail) {
+        if (aligned + size <= m_stagingSize) {
+            offset = aligned;
+        } else if (size < m_stagingTail) {
+            offset = 0;  // Wrap around
+        } else {
+            return false;
+        }
+
+    } else if (aligned + size < m_stagingTail) {
+        offset = aligned;
+
+    } else {
+        return false;
+    }
+
+    m_stagingHead = offset + size;
+    return true;
+}
+
+
+void VulkanUploader::submitBatch(Batch& batch)
+{
+    PROFILE_FUNCTION();
+
+    const VulkanDeviceDispatch& dispatch = m_device.getDispatch();
+
+    // Release to the graphics family, or make the writes visible if there is a single family
+    VkAccessFlags dstAccess = hasOwnershipTransfer() ? 0 : VK_ACCESS_MEMORY_READ_BIT;
+    for (auto& barrier : batch.bufferBarriers)
+        barrier.dstAccessMask = dstAccess;
+    for (auto& barrier : batch.imageBarriers)
+        barrier.dstAccessMask = dstAccess;
+
+    dispatch.vkCmdPipelineBarrier(
+        batch.transferCommands,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        hasOwnershipTransfer() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0, nullptr,
+        static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+        static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+
+    if (dispatch.vkEndCommandBuffer(batch.transferCommands) != VK_SUCCESS)
+        throw Exception("Failed to record upload command buffer");
+
+    VkSubmitInfo transferSubmit = {};
+    transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferSubmit.commandBufferCount = 1;
+    transferSubmit.pCommandBuffers = &batch.transferCommands;
+
+    if (!hasOwnershipTransfer()) {
+        if (m_device.submit(VulkanDevice::QueueType::TRANSFER, 1, &transferSubmit, batch.fence) != VK_SUCCESS)
+            throw Exception("Failed to submit uploads");
+
+    } else {
+        transferSubmit.signalSemaphoreCount = 1;
+        transferSubmit.pSignalSemaphores = &batch.transferDone;
+
+        if (m_device.submit(VulkanDevice::QueueType::TRANSFER, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+            throw Exception("Failed to submit uploads");
+
+        // Matching acquire on the graphics queue, once the transfer signaled
+        for (auto& barrier : batch.bufferBarriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+        for (auto& barrier : batch.imageBarriers) {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (dispatch.vkBeginCommandBuffer(batch.acquireCommands, &beginInfo) != VK_SUCCESS)
+            throw Exception("Failed to begin upload acquire command buffer");
+
+        dispatch.vkCmdPipelineBarrier(
+            batch.acquireCommands,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            0, nullptr,
+            static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+            static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+
+        if (dispatch.vkEndCommandBuffer(batch.acquireCommands) != VK_SUCCESS)
+            throw Exception("Failed to record upload acquire command buffer");
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+        VkSubmitInfo acquireSubmit = {};
+        acquireSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        acquireSubmit.waitSemaphoreCount = 1;
+        acquireSubmit.pWaitSemaphores = &batch.transferDone;
+        acquireSubmit.pWaitDstStageMask = &waitStage;
+        acquireSubmit.commandBufferCount = 1;
+        acquireSubmit.pCommandBuffers = &batch.acquireCommands;
+
+        if (m_device.submit(VulkanDevice::QueueType::GRAPHICS, 1, &acquireSubmit, batch.fence) != VK_SUCCESS)
+            throw Exception("Failed to submit upload acquire barriers");
+    }
+
+    batch.bufferBarriers.clear();
+    batch.imageBarriers.clear();
+    batch.recording = false;
+    batch.pending = true;
+
+    m_submitCount++;
+    m_currentBatch = (m_currentBatch + 1) % UPLOADER_BATCH_COUNT;
+}
+
+
+bool VulkanUploader::retireOldestBatch(bool wait)
+{
+    Batch& batch = m_batches[m_oldestBatch];
+    if (!batch.pending) return false;
+
+    const VulkanDeviceDispatch& dispatch = m_device.getDispatch();
+    VkDevice device = m_device.getHandle();
+
+    if (wait) {
+        if (dispatch.vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+            throw Exception("Failed to wait for uploads");
+    } else if (dispatch.vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+        return false;
+    }
+
+    dispatch.vkResetFences(device, 1, &batch.fence);
+    batch.pending = false;
+
+    // Command buffers are reset implicitly when recorded again
+    m_stagingTail = batch.stagingEnd;
+    if (m_stagingTail == m_stagingHead)
+        m_stagingHead = m_stagingTail = 0;
+
+    m_oldestBatch = (m_oldestBatch + 1) % UPLOADER_BATCH_COUNT;
+    return true;
+}
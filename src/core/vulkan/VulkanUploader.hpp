@@ -0,0 +1,97 @@
+#pragma once
+
+#include "VulkanAllocator.hpp"
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#define UPLOADER_DEFAULT_STAGING_SIZE (32ull << 20)
+#define UPLOADER_BATCH_COUNT 4  // Submissions in flight before uploads have to wait
+
+class VulkanDevice;
+
+// Asynchronous uploads to device local memory.
+// Data is copied right away into a persistently mapped staging ring buffer and the copies
+// are recorded for the transfer queue. flush() submits them: when the transfer queue has its
+// own family, the resources are released by it and acquired by the graphics queue in a
+// second submission waiting on a semaphore, so the next graphics submissions see the data
+// without any wait on the CPU. Staging space is reclaimed as the transfers complete.
+// Destination resources must use VK_SHARING_MODE_EXCLUSIVE. Thread safe.
+class VulkanUploader
+{
+  public:
+    VulkanUploader(VulkanDevice& device, VkDeviceSize stagingSize);
+    ~VulkanUploader();  // Waits for the pending uploads
+
+    // Buffers bigger than the staging ring are split over several submissions
+    void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+    // Uploads one subresource and leaves it in `finalLayout`. Previous content is discarded
+    void uploadImage(
+        VkImage image,
+        const VkImageSubresourceLayers& subresource,
+        VkExtent3D extent,
+        const void* data,
+        VkDeviceSize size,
+        VkImageLayout finalLayout);
+
+    void flush();  // Submits the recorded uploads, doesn't wait
+    void waitIdle();  // Flushes and waits for every upload to land
+
+  private:
+    struct Batch
+    {
+        VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+        VkCommandBuffer acquireCommands = VK_NULL_HANDLE;  // Recorded for the graphics queue
+        VkSemaphore transferDone = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkDeviceSize stagingEnd = 0;  // Staging is free up to here once the batch completes
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;  // Queue family ownership transfers
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+
+        bool recording = false;
+        bool pending = false;
+    };
+
+  private:
+    void createCommandObjects();
+    void destroyCommandObjects() noexcept;
+
+    Batch& getRecordingBatch();
+    VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+    bool tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) noexcept;
+    void submitBatch(Batch& batch);
+    bool retireOldestBatch(bool wait);  // False if nothing was pending, or still is without `wait`
+
+    inline bool hasOwnershipTransfer() const noexcept { return m_transferFamily != m_graphicsFamily; }
+
+  private:
+    VulkanDevice& m_device;
+    uint32_t m_transferFamily;
+    uint32_t m_graphicsFamily;
+
+    std::mutex m_mutex;
+
+    VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+    VulkanAllocator::Allocation* m_stagingAllocation = nullptr;
+    VkDeviceSize m_stagingSize;
+    VkDeviceSize m_stagingHead = 0;  // Next free byte
+    VkDeviceSize m_stagingTail = 0;  // Oldest byte still in use by the device
+    VkDeviceSize m_copyAlignment;
+
+    VkCommandPool m_transferPool = VK_NULL_HANDLE;
+    VkCommandPool m_graphicsPool = VK_NULL_HANDLE;
+    std::array<Batch, UPLOADER_BATCH_COUNT> m_batches;
+    uint32_t m_currentBatch = 0;  // Recording, or next to record
+    uint32_t m_oldestBatch = 0;  // Oldest pending submission
+
+    uint64_t m_uploadedBytes = 0;
+    uint64_t m_submitCount = 0;
+
+  public:
+    VulkanUploader(const VulkanUploader&) = delete;
+    void operator=(const VulkanUploader&) = delete;
+};
@@ -3,49 +3,515 @@
 #include "Window.hpp"
 #include "core/Exception.hpp"
 #include "core/Logger.hpp"
+#include "core/Profiler.hpp"
+#include "core/vulkan/VulkanDescriptorTemplate.hpp"
+#include "core/vulkan/VulkanDevice.hpp"
+#include "core/vulkan/VulkanFrameBatch.hpp"
+#include "core/vulkan/VulkanInstance.hpp"
+#include "core/vulkan/VulkanPipelineStateCache.hpp"
 
 #include <GLFW/glfw3.h>
 
-Window::Window(int width, int height, const std::string& title)
-    : m_title(title)
+#include <cstring>
+
+// The uniform block of background.frag
+struct BackgroundUniforms
 {
-    try {
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    float topColor[4];
+    float bottomColor[4];
+};
 
-        m_glfwWindow = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
+static const BackgroundUniforms s_backgroundUniforms = {{0.10f, 0.12f, 0.16f, 1.0f}, {0.02f, 0.02f, 0.03f, 1.0f}};
 
-        if (!m_glfwWindow) {
-            throw Exception("GLFW failed to create window \"" + title + "\"");
-        }
 
-        glfwSetWindowUserPointer(m_glfwWindow, this);  // To get the Window object from the GLFW pointer
+Window::Window(int width, int height, const std::string& title, const Settings& settings)
+    : m_title(title),
+      m_width(width),
+      m_height(height),
+      m_headless(settings.headless),
+      m_dumpRenderGraph(settings.dumpRenderGraph),
+      m_presentMode(settings.presentMode)
+{
+    PROFILE_FUNCTION();
+
+    // A headless Window gets its offscreen image once attached
+    if (m_headless) {
+        LOG_TRACE("Initialized headless Window \"{}\" ({}, {})", title, width, height);
+        return;
+    }
 
-        glfwMakeContextCurrent(nullptr);
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
-        LOG_TRACE("Initialized Window \"{}\" ({}, {})", title, width, height);
+    m_glfwWindow = glfwCreateWindow(width, height, title.c_str(), NULL, NULL);
 
-    } catch (const Exception& ex) {
+    if (!m_glfwWindow) {
         LOG_ERROR("Failed to initialize Window \"{}\"", title);
-        throw;
+        throw Exception("GLFW failed to create window \"" + title + "\"");
     }
+
+    glfwSetWindowUserPointer(m_glfwWindow, this);  // To get the Window object from the GLFW pointer
+
+    // Anything that changes what the Window shows wakes it up from idle
+    glfwSetWindowRefreshCallback(m_glfwWindow, Window::redrawCallbackGLFW);
+    glfwSetWindowSizeCallback(m_glfwWindow, Window::sizeCallbackGLFW);
+    glfwSetFramebufferSizeCallback(m_glfwWindow, Window::framebufferSizeCallbackGLFW);
+    glfwSetWindowFocusCallback(m_glfwWindow, Window::stateCallbackGLFW);
+    glfwSetWindowIconifyCallback(m_glfwWindow, Window::stateCallbackGLFW);
+    glfwSetKeyCallback(m_glfwWindow, Window::keyCallbackGLFW);
+    glfwSetMouseButtonCallback(m_glfwWindow, Window::mouseButtonCallbackGLFW);
+    glfwSetCursorPosCallback(m_glfwWindow, Window::cursorCallbackGLFW);
+
+    glfwMakeContextCurrent(nullptr);
+
+    LOG_TRACE("Created GLFW window \"{}\" ({}, {})", title, width, height);
+}
+
+
+Window::Window(int width, int height, const std::string& title, VulkanInstance& vulkan, const Settings& settings)
+    : Window(width, height, title, settings)
+{
+    // The delegated constructor is done, the destructor runs if this throws
+    attach(vulkan);
 }
 
 
 Window::~Window()
 {
     LOG_TRACE("Destroying Window \"{}\"", m_title);
-    glfwDestroyWindow(m_glfwWindow);
+
+    // The render graph's images and the offscreen one may still be in use
+    if (m_device)
+        m_device->waitForAllFrames();
+
+    m_renderGraph.reset();
+    destroyFramebuffers();
+    destroyBackground();
+    if (m_offscreenView != VK_NULL_HANDLE)
+        vkDestroyImageView(m_device->getHandle(), m_offscreenView, nullptr);
+    if (m_offscreenImage != VK_NULL_HANDLE)
+        m_device->getAllocator().destroyImage(m_offscreenImage, m_offscreenAllocation);
+
+    // The swapchain goes before its surface, which goes before its window
+    m_swapchain.reset();
+    if (m_surface != VK_NULL_HANDLE)
+        vkDestroySurfaceKHR(m_vkInstance, m_surface, nullptr);
+
+    if (m_glfwWindow)
+        glfwDestroyWindow(m_glfwWindow);
 }
 
 // public
 
-void Window::update() const
+void Window::attach(VulkanInstance& vulkan)
+{
+    PROFILE_FUNCTION();
+
+    if (isAttached())
+        throw Exception("Window \"" + m_title + "\" is already attached");
+
+    m_vkInstance = vulkan.getHandle();
+    m_device = &vulkan.getDevice();
+
+    if (m_headless) {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.format = WINDOW_OFFSCREEN_FORMAT;
+        imageInfo.extent = {static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height), 1};
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        m_offscreenAllocation = m_device->getAllocator().createImage(imageInfo, VulkanAllocator::MemoryUsage::GPU_ONLY, m_offscreenImage);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = m_offscreenImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = WINDOW_OFFSCREEN_FORMAT;
+        viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+        if (vkCreateImageView(m_device->getHandle(), &viewInfo, nullptr, &m_offscreenView) != VK_SUCCESS)
+            throw Exception("Failed to create the offscreen image view of Window \"" + m_title + "\"");
+
+        m_renderGraph = std::make_unique<VulkanRenderGraph>(*m_device, m_title);
+        createBackground(WINDOW_OFFSCREEN_FORMAT);
+
+        LOG_TRACE("Created the offscreen image of Window \"{}\" ({}, {})", m_title, m_width, m_height);
+        return;
+    }
+
+    try {
+        if (glfwCreateWindowSurface(m_vkInstance, m_glfwWindow, nullptr, &m_surface) != VK_SUCCESS)
+            throw Exception("Failed to create a surface for window \"" + m_title + "\"");
+
+        // Pixels, which differ from the screen coordinates on high DPI displays
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(m_glfwWindow, &framebufferWidth, &framebufferHeight);
+
+        m_swapchain = std::make_unique<VulkanSwapchain>(
+            *m_device,
+            m_surface,
+            VkExtent2D{static_cast<uint32_t>(framebufferWidth), static_cast<uint32_t>(framebufferHeight)},
+            m_presentMode);
+
+        m_renderGraph = std::make_unique<VulkanRenderGraph>(*m_device, m_title);
+
+        // A minimized Window gets them with its swapchain, in render()
+        if (m_swapchain->getGeneration() > 0) {
+            createBackground(m_swapchain->getFormat());
+            m_swapchainGeneration = m_swapchain->getGeneration();
+        }
+
+        LOG_TRACE("Initialized Window \"{}\" ({}, {})", m_title, m_width, m_height);
+
+    } catch (const Exception& ex) {
+        LOG_ERROR("Failed to initialize Window \"{}\"", m_title);
+        throw;
+    }
+}
+
+
+void Window::update(VulkanFrameBatch& batch)
+{
+    PROFILE_FUNCTION();
+
+    // A skipped frame is drawn again next time
+    if (m_headless)
+        renderOffscreen(batch);
+    else if (!render(batch))
+        return;
+
+    m_needsRedraw = false;
+}
+
+
+bool Window::isIdle() const noexcept
 {
+    if (m_headless)
+        return false;
+
+    return !m_needsRedraw || glfwGetWindowAttrib(m_glfwWindow, GLFW_ICONIFIED);
 }
 
 
 bool Window::shouldClose() noexcept
 {
-    return glfwWindowShouldClose(m_glfwWindow);
+    // Headless Windows can't be closed by the user
+    return m_glfwWindow && glfwWindowShouldClose(m_glfwWindow);
+}
+
+// private
+
+void Window::redrawCallbackGLFW(GLFWwindow* window)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+
+void Window::sizeCallbackGLFW(GLFWwindow* window, int width, int height)
+{
+    auto w = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    w->m_width = width;
+    w->m_height = height;
+    w->requestRedraw();
+}
+
+
+void Window::framebufferSizeCallbackGLFW(GLFWwindow* window, int width, int height)
+{
+    auto w = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (w->m_swapchain)
+        w->m_swapchain->resize({static_cast<uint32_t>(width), static_cast<uint32_t>(height)});
+
+    w->requestRedraw();
+}
+
+
+void Window::stateCallbackGLFW(GLFWwindow* window, int state)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+
+void Window::keyCallbackGLFW(GLFWwindow* window, int key, int scancode, int action, int mods)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+
+void Window::mouseButtonCallbackGLFW(GLFWwindow* window, int button, int action, int mods)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+
+void Window::cursorCallbackGLFW(GLFWwindow* window, double x, double y)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+
+bool Window::render(VulkanFrameBatch& batch)
+{
+    VulkanSwapchain::Frame frame;
+    if (!m_swapchain->acquire(batch.getFrameIndex(), frame))
+        return false;
+
+    // The first barrier is chained to the acquire semaphore wait, which happens at the transfer
+    // stage. The present waits on the semaphore signal, which makes the writes visible
+    VkCommandBuffer commandBuffer;
+    try {
+        // Recreated, after waiting for every frame: nothing uses the old framebuffers anymore
+        if (m_swapchain->getGeneration() != m_swapchainGeneration) {
+            destroyFramebuffers();
+            if (m_swapchain->getFormat() != m_renderFormat) {
+                destroyBackground();
+                createBackground(m_swapchain->getFormat());
+            }
+
+            m_swapchainGeneration = m_swapchain->getGeneration();
+        }
+
+        updateBackground();
+        commandBuffer = record(
+            frame.image,
+            frame.imageView,
+            {m_swapchain->getFormat(), m_swapchain->getExtent()},
+            {VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0});
+
+    } catch (const std::exception& ex) {
+        // The image is ours and its semaphore gets signaled, neither can be left behind
+        batch.discard(frame);
+        m_swapchain->discard();
+        throw;
+    }
+
+    batch.add(*m_swapchain, frame, commandBuffer);
+    return true;
+}
+
+
+void Window::renderOffscreen(VulkanFrameBatch& batch)
+{
+    updateBackground();
+
+    // Left ready to be copied out. Frames in flight share the image, the queue orders them
+    VkCommandBuffer commandBuffer = record(
+        m_offscreenImage,
+        m_offscreenView,
+        {WINDOW_OFFSCREEN_FORMAT, {static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height)}},
+        {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0});
+
+    batch.add(commandBuffer);
+}
+
+
+void Window::createBackground(VkFormat format)
+{
+    // The render graph does the layout transitions, before and after
+    VkAttachmentDescription attachment = {};
+    attachment.format = format;
+    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorReference;
+
+    VkRenderPassCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    createInfo.attachmentCount = 1;
+    createInfo.pAttachments = &attachment;
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(m_device->getHandle(), &createInfo, nullptr, &m_renderPass) != VK_SUCCESS)
+        throw Exception("Failed to create the render pass of Window \"" + m_title + "\"");
+
+    m_renderFormat = format;
+
+    // Compatible with the render pass: same format, same samples. Compiled in the background,
+    // the Window is only cleared meanwhile
+    try {
+        auto& shaderLibrary = m_device->getShaderLibrary();
+        auto& pipelineStateCache = m_device->getPipelineStateCache();
+
+        VkDescriptorSetLayoutBinding binding = {0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr};
+        m_backgroundSetLayout = m_device->getDescriptorLayoutCache().getLayout(&binding, 1);
+        m_backgroundTemplate = std::make_unique<VulkanDescriptorTemplate>(
+            *m_device,
+            m_backgroundSetLayout,
+            std::vector<VkDescriptorUpdateTemplateEntryKHR>{{0, 0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, sizeof(VkDescriptorBufferInfo)}});
+
+        VulkanPipelineDescription description;
+        description.vertexShader = shaderLibrary.get(WINDOW_BACKGROUND_VERTEX_SHADER);
+        description.fragmentShader = shaderLibrary.get(WINDOW_BACKGROUND_FRAGMENT_SHADER);
+        description.cullMode = VK_CULL_MODE_NONE;
+        description.colorFormats = {format};
+        description.layout = pipelineStateCache.getLayout({m_backgroundSetLayout});
+
+        m_backgroundPipeline = pipelineStateCache.get(description);
+
+    } catch (const Exception& ex) {
+        LOG_WARN("Window \"{}\" has no background, it is only cleared\n{}", m_title, ex.what());
+    }
+}
+
+
+void Window::destroyBackground() noexcept
+{
+    m_backgroundPipeline.reset();  // The state cache keeps the VkPipeline
+    m_backgroundTemplate.reset();
+    m_backgroundSetLayout = VK_NULL_HANDLE;
+    m_backgroundSet = VK_NULL_HANDLE;
+
+    if (m_renderPass != VK_NULL_HANDLE)
+        vkDestroyRenderPass(m_device->getHandle(), m_renderPass, nullptr);
+
+    m_renderPass = VK_NULL_HANDLE;
+    m_renderFormat = VK_FORMAT_UNDEFINED;
+}
+
+
+void Window::updateBackground()
+{
+    m_backgroundSet = VK_NULL_HANDLE;
+    if (!m_backgroundPipeline)
+        return;
+
+    // Both rewound with the frame, nothing to free
+    auto uniforms = m_device->getFrameArena().allocate(sizeof(BackgroundUniforms));
+    std::memcpy(uniforms.data, &s_backgroundUniforms, sizeof(BackgroundUniforms));
+
+    VkDescriptorBufferInfo bufferInfo = {uniforms.buffer, uniforms.offset, sizeof(BackgroundUniforms)};
+    m_backgroundSet = m_device->getDescriptorAllocator().allocate(m_backgroundSetLayout);
+    m_backgroundTemplate->update(m_backgroundSet, &bufferInfo);
+}
+
+
+VkFramebuffer Window::getFramebuffer(VkImageView view, VkExtent2D extent)
+{
+    for (auto& [framebufferView, framebuffer] : m_framebuffers) {
+        if (framebufferView == view)
+            return framebuffer;
+    }
+
+    VkFramebufferCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    createInfo.renderPass = m_renderPass;
+    createInfo.attachmentCount = 1;
+    createInfo.pAttachments = &view;
+    createInfo.width = extent.width;
+    createInfo.height = extent.height;
+    createInfo.layers = 1;
+
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(m_device->getHandle(), &createInfo, nullptr, &framebuffer) != VK_SUCCESS)
+        throw Exception("Failed to create a framebuffer for Window \"" + m_title + "\"");
+
+    m_framebuffers.emplace_back(view, framebuffer);
+    return framebuffer;
+}
+
+
+void Window::destroyFramebuffers() noexcept
+{
+    for (auto& [view, framebuffer] : m_framebuffers)
+        vkDestroyFramebuffer(m_device->getHandle(), framebuffer, nullptr);
+
+    m_framebuffers.clear();
+}
+
+
+VkCommandBuffer Window::record(
+    VkImage image,
+    VkImageView view,
+    const VulkanRenderGraph::ImageDescription& description,
+    const VulkanRenderGraph::ImportedState& finalState)
+{
+    // The calling thread's pool for this frame in flight, reset by VulkanFrameBatch::begin()
+    VkCommandBuffer commandBuffer = m_device->getCommandPools().getPrimary();
+    const VulkanDeviceDispatch& dispatch = m_device->getDispatch();
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    dispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // Previous content is discarded
+    VulkanRenderGraph& graph = *m_renderGraph;
+    graph.reset();
+
+    auto backbuffer = graph.importImage(
+        "Backbuffer",
+        image,
+        view,
+        description,
+        {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TRANSFER_BIT, 0},
+        finalState);
+
+    // Small captures, std::function keeps them inline instead of allocating every frame
+    graph.addPass("Background", [this, backbuffer](VkCommandBuffer commandBuffer, const VulkanRenderGraph& graph) {
+        const VulkanDeviceDispatch& dispatch = m_device->getDispatch();
+        VkExtent2D extent = graph.getExtent(backbuffer);
+
+        // Cleared by the render pass, which is all there is while the pipeline compiles
+        VkClearValue clearValue = {};
+        clearValue.color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+
+        VkRenderPassBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        beginInfo.renderPass = m_renderPass;
+        beginInfo.framebuffer = getFramebuffer(graph.getImageView(backbuffer), extent);
+        beginInfo.renderArea = {{0, 0}, extent};
+        beginInfo.clearValueCount = 1;
+        beginInfo.pClearValues = &clearValue;
+        dispatch.vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkPipeline pipeline = m_backgroundPipeline ? m_backgroundPipeline->getHandle() : VK_NULL_HANDLE;
+        if (pipeline != VK_NULL_HANDLE) {
+            VkViewport viewport = {0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f};
+            VkRect2D scissor = {{0, 0}, extent};
+
+            dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            dispatch.vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                m_backgroundPipeline->getLayout(),
+                0,
+                1,
+                &m_backgroundSet,
+                0,
+                nullptr);
+            dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+            dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+            dispatch.vkCmdDraw(commandBuffer, 3, 1, 0, 0);  // See fullscreen.vert
+        }
+
+        dispatch.vkCmdEndRenderPass(commandBuffer);
+    }).use(backbuffer, VulkanRenderGraph::Access::COLOR_ATTACHMENT);
+
+    if (graph.compile() && m_dumpRenderGraph)
+        LOG_INFO("{}", graph.dump());
+
+    graph.execute(commandBuffer);
+
+    if (dispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw Exception("Failed to record the frame of Window \"" + m_title + "\"");
+
+    return commandBuffer;
 }
\ No newline at end of file
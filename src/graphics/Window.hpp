@@ -1,24 +1,112 @@
 #pragma once
 
+#include "core/Settings.hpp"
+#include "core/vulkan/VulkanRenderGraph.hpp"
+#include "core/vulkan/VulkanSwapchain.hpp"
+
 #include <GLFW/glfw3.h>
 
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+#define WINDOW_OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM  // Of headless Windows
+#define WINDOW_BACKGROUND_VERTEX_SHADER "fullscreen.vert"  // In the shader directory
+#define WINDOW_BACKGROUND_FRAGMENT_SHADER "background.frag"
+
+class VulkanDescriptorTemplate;
+class VulkanDevice;
+class VulkanFrameBatch;
+class VulkanInstance;
+class VulkanPipeline;
 
+// A GLFW window and its swapchain. Headless Windows have neither, they render to an image of
+// their size instead, submitted with the others but never presented.
+// Built in two steps so GLFW windows can be created while Vulkan is still coming up: the
+// constructor without a VulkanInstance only creates the GLFW window, attach() its surface,
+// swapchain and render graph. Only attached Windows can be updated
 class Window
 {
   public:
-    Window() : Window(640, 480){};
-    explicit Window(int width, int height) : Window(width, height, "Tuto"){};
-    explicit Window(int width, int height, const std::string& title);
-    ~Window();
+    explicit Window(int width, int height, const std::string& title, const Settings& settings);
+    explicit Window(int width, int height, const std::string& title, VulkanInstance& vulkan, const Settings& settings);
+    ~Window();  // Waits for the frames in flight
 
-    void update() const;
+    // Once per Window, on the main thread. Creates the offscreen image of headless Windows
+    void attach(VulkanInstance& vulkan);
+    inline bool isAttached() const noexcept { return m_device != nullptr; }
+
+    // Records the frame and adds it to `batch`, which submits and presents it. Can run on any
+    // job system thread, one per Window
+    void update(VulkanFrameBatch& batch);
     bool shouldClose() noexcept;
+
+    // Idle Windows have nothing new to draw: they are minimized, or nothing happened
+    // to them since the last update(). Headless Windows are never idle
+    bool isIdle() const noexcept;
+    inline void requestRedraw() noexcept { m_needsRedraw = true; }
+
     inline const std::string& getTitle() const noexcept { return m_title; }
+    inline bool isHeadless() const noexcept { return m_headless; }
+    inline int getWidth() const noexcept { return m_width; }
+    inline int getHeight() const noexcept { return m_height; }
 
   private:
-    GLFWwindow* m_glfwWindow = nullptr;
+    static void redrawCallbackGLFW(GLFWwindow* window);
+    static void sizeCallbackGLFW(GLFWwindow* window, int width, int height);
+    static void framebufferSizeCallbackGLFW(GLFWwindow* window, int width, int height);
+    static void stateCallbackGLFW(GLFWwindow* window, int state);
+    static void keyCallbackGLFW(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void mouseButtonCallbackGLFW(GLFWwindow* window, int button, int action, int mods);
+    static void cursorCallbackGLFW(GLFWwindow* window, double x, double y);
+
+    bool render(VulkanFrameBatch& batch);  // False if the frame was skipped
+    void renderOffscreen(VulkanFrameBatch& batch);
+    // The render pass and pipeline of the background pass, for images of `format`
+    void createBackground(VkFormat format);
+    void destroyBackground() noexcept;
+    // Writes the frame's uniforms, in the frame arena, and the descriptor set pointing at them
+    void updateBackground();
+    // Cached by view, the views of a swapchain only change with its generation
+    VkFramebuffer getFramebuffer(VkImageView view, VkExtent2D extent);
+    void destroyFramebuffers() noexcept;
+
+    // The frame's commands, rendering to `image` and leaving it in `finalState`
+    VkCommandBuffer record(
+        VkImage image,
+        VkImageView view,
+        const VulkanRenderGraph::ImageDescription& description,
+        const VulkanRenderGraph::ImportedState& finalState);
+
+  private:
+    GLFWwindow* m_glfwWindow = nullptr;  // nullptr for headless Windows
+    VkInstance m_vkInstance = VK_NULL_HANDLE;
+    VulkanDevice* m_device = nullptr;  // Set by attach()
+    VkSurfaceKHR m_surface = VK_NULL_HANDLE;
+    std::unique_ptr<VulkanSwapchain> m_swapchain;  // nullptr for headless Windows
+    VkImage m_offscreenImage = VK_NULL_HANDLE;  // Headless Windows only
+    VulkanAllocator::Allocation* m_offscreenAllocation = nullptr;
+    VkImageView m_offscreenView = VK_NULL_HANDLE;
+    std::unique_ptr<VulkanRenderGraph> m_renderGraph;  // Rebuilt every frame, compiled once
+
+    // The graph has no render passes, the background pass begins its own
+    VkFormat m_renderFormat = VK_FORMAT_UNDEFINED;  // Of the render pass and the pipeline
+    VkRenderPass m_renderPass = VK_NULL_HANDLE;
+    std::shared_ptr<VulkanPipeline> m_backgroundPipeline;  // Null if its shaders don't build
+    VkDescriptorSetLayout m_backgroundSetLayout = VK_NULL_HANDLE;  // Owned by the layout cache
+    std::unique_ptr<VulkanDescriptorTemplate> m_backgroundTemplate;
+    VkDescriptorSet m_backgroundSet = VK_NULL_HANDLE;  // Of the frame being recorded
+    std::vector<std::pair<VkImageView, VkFramebuffer>> m_framebuffers;
+    uint64_t m_swapchainGeneration = 0;  // Of m_framebuffers
+
     std::string m_title;
+    int m_width;
+    int m_height;
+    bool m_headless;
+    bool m_needsRedraw = true;
+    bool m_dumpRenderGraph;
+    VkPresentModeKHR m_presentMode;
 
   public:
     Window(const Window&) = delete;
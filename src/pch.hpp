@@ -26,4 +26,5 @@
 #include <vector>
 
 #include "core/Exception.hpp"
-#include "core/Logger.hpp"
\ No newline at end of file
+#include "core/Logger.hpp"
+#include "core/vulkan/VulkanLoader.hpp"
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "pch.hpp"
+
+#include "AllocationCounter.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// libstdc++'s array and nothrow forms call the plain and aligned ones below, which counts them too
+static std::atomic<uint64_t> s_allocationCount{0};
+
+
+uint64_t getAllocationCount() noexcept
+{
+    return s_allocationCount.load(std::memory_order_relaxed);
+}
+
+
+void* operator new(size_t size)
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* pointer = std::malloc(size > 0 ? size : 1))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    s_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+    // aligned_alloc wants a multiple of the alignment
+    size_t align = static_cast<size_t>(alignment);
+    if (void* pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align))
+        return pointer;
+
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
+
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept
+{
+    std::free(pointer);
+}
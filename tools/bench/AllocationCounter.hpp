@@ -0,0 +1,7 @@
+#pragma once
+
+#include <cstdint>
+
+// Calls to the global operator new since the program started, from every thread. The bench
+// replaces operator new to count them, the engine's own builds are left alone
+uint64_t getAllocationCount() noexcept;
@@ -0,0 +1,248 @@
+#include "pch.hpp"
+
+#include "BenchJson.hpp"
+#include "BenchSuite.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Headless benchmark of the engine: runs BenchSuite, writes the results as JSON and compares
+// them to a baseline written by a previous run. Exits with 1 when a result regressed past the
+// tolerance or a check failed, so it can gate a CI job running on a software driver:
+//   bench --icd /usr/share/vulkan/icd.d/lvp_icd.x86_64.json --baseline FILE
+// where FILE was written on the same machine by an earlier run with --update-baseline
+
+#define BENCH_RESULTS_VERSION 1
+#define BENCH_DEFAULT_TOLERANCE 10.0  // Percent
+
+struct Options
+{
+    std::string output = "bench.json";
+    std::string baseline;
+    bool updateBaseline = false;
+    double tolerance = BENCH_DEFAULT_TOLERANCE;
+    uint32_t repeat = BENCH_DEFAULT_REPEAT;
+    uint32_t threadCount = 0;
+    std::string icd;
+    std::string gpu;
+};
+
+
+static void stdoutUsage() noexcept
+{
+    std::cout << "Usage: bench [OPTION]...\n"
+              << "Measure the engine headless and compare the results to a baseline\n\n"
+              << "  -o, --output FILE      Write the results to FILE (default=bench.json)\n"
+              << "  --baseline FILE        Compare the results to FILE, exit with 1 on regressions\n"
+              << "  --update-baseline      Write the results to the --baseline FILE instead of comparing\n"
+              << "  --tolerance PERCENT    Allowed regression before failing (default=" << BENCH_DEFAULT_TOLERANCE << ")\n"
+              << "  --repeat COUNT         Runs of every benchmark, the median is kept (default=" << BENCH_DEFAULT_REPEAT << ")\n"
+              << "  --threads COUNT        Job system threads (0=one per hardware thread, default)\n"
+              << "  --icd FILE             Vulkan driver manifest to load, e.g. a software one (lavapipe)\n"
+              << "  --gpu GPU              Use this GPU (index or UUID)\n"
+              << "  -h, --help             Display this help and exit" << std::endl;
+}
+
+
+static bool processCommandLineArgs(int argc, const char* argv[], Options& options) noexcept
+{
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+
+        if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+            stdoutUsage();
+            return false;
+
+        } else if ((!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output")) && hasValue) {
+            options.output = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--baseline") && hasValue) {
+            options.baseline = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--update-baseline")) {
+            options.updateBaseline = true;
+
+        } else if (!std::strcmp(argv[i], "--tolerance") && hasValue) {
+            options.tolerance = std::atof(argv[++i]);
+
+        } else if (!std::strcmp(argv[i], "--repeat") && hasValue) {
+            options.repeat = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+
+        } else if (!std::strcmp(argv[i], "--threads") && hasValue) {
+            options.threadCount = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 0));
+
+        } else if (!std::strcmp(argv[i], "--icd") && hasValue) {
+            options.icd = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--gpu") && hasValue) {
+            options.gpu = argv[++i];
+
+        } else {
+            stdoutUsage();
+            return false;
+        }
+    }
+
+    if (options.updateBaseline && options.baseline.empty()) {
+        std::cerr << "bench: --update-baseline needs --baseline FILE" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+
+static std::string toJson(const std::vector<BenchResult>& results, const std::string& deviceName)
+{
+    std::string json = fmt::format(
+        "{{\n  \"version\": {},\n  \"device\": {},\n  \"results\": [\n",
+        BENCH_RESULTS_VERSION,
+        quoteJson(deviceName));
+
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& result = results[i];
+        json += fmt::format(
+            "    {{\"name\": {}, \"unit\": {}, \"value\": {:.6g}, \"higherIsBetter\": {}}}{}\n",
+            quoteJson(result.name),
+            quoteJson(result.unit),
+            result.value,
+            result.higherIsBetter ? "true" : "false",
+            i + 1 < results.size() ? "," : "");
+    }
+
+    return json + "  ]\n}\n";
+}
+
+
+static void writeFile(const std::string& path, const std::string& content)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << content;
+    if (!file)
+        throw Exception("Failed to write \"" + path + "\"");
+}
+
+
+// Number of regressions. A baseline entry may set its own "tolerance" (percent)
+static uint32_t compareToBaseline(const std::vector<BenchResult>& results, const std::string& deviceName, const std::string& path, double tolerance)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw Exception("Failed to open baseline \"" + path + "\"");
+
+    std::stringstream text;
+    text << file.rdbuf();
+    JsonValue baseline = parseJson(text.str());
+
+    const JsonValue* device = baseline.find("device");
+    if (device && device->string != deviceName)
+        LOG_WARN("The baseline was measured on \"{}\", not \"{}\": the numbers may not compare", device->string, deviceName);
+
+    const JsonValue* entries = baseline.find("results");
+    if (!entries || entries->type != JsonValue::Type::ARRAY)
+        throw Exception("Baseline \"" + path + "\" has no results");
+
+    uint32_t regressions = 0;
+
+    for (auto& result : results) {
+        auto it = std::find_if(entries->array.begin(), entries->array.end(), [&](const JsonValue& entry) {
+            const JsonValue* name = entry.find("name");
+            return name && name->string == result.name;
+        });
+
+        const JsonValue* value = it != entries->array.end() ? it->find("value") : nullptr;
+        if (!value || value->number <= 0.0) {
+            LOG_WARN("{}: not in the baseline", result.name);
+            continue;
+        }
+
+        const JsonValue* entryTolerance = it->find("tolerance");
+        double allowed = entryTolerance ? entryTolerance->number : tolerance;
+
+        // Positive when worse, whichever way is better
+        double change = 100.0 * (result.value - value->number) / value->number;
+        double regression = result.higherIsBetter ? -change : change;
+
+        if (regression > allowed) {
+            LOG_ERROR(
+                "REGRESSION {}: {:.3f} {} against {:.3f} in the baseline ({:+.1f}%, tolerance {:.1f}%)",
+                result.name,
+                result.value,
+                result.unit,
+                value->number,
+                change,
+                allowed);
+            regressions++;
+        } else {
+            LOG_INFO("{}: {:+.1f}% against the baseline", result.name, change);
+        }
+    }
+
+    return regressions;
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!processCommandLineArgs(argc, const_cast<const char**>(argv), options))
+        return 1;
+
+    try {
+        // Before the loader reads them, on the first Vulkan call
+        if (!options.icd.empty()) {
+            setenv("VK_ICD_FILENAMES", options.icd.c_str(), 1);
+            setenv("VK_DRIVER_FILES", options.icd.c_str(), 1);
+        }
+
+        Logger::instance();
+
+        // The calling thread is worker 0, it records the offscreen frames
+        JobSystem jobSystem(options.threadCount);
+
+        // Cold starts every time, nothing persisted, nothing on screen
+        Settings settings;
+        settings.headless = true;
+        settings.threadCount = jobSystem.getThreadCount();
+        settings.pipelineCachePath.clear();
+        settings.deviceCachePath.clear();
+        settings.shaderCachePath.clear();
+        settings.shaderHotReload = false;
+        settings.gpu = options.gpu;
+
+        BenchSuite suite(settings, jobSystem, options.repeat);
+        auto results = suite.run();
+
+        std::string json = toJson(results, suite.getDeviceName());
+        writeFile(options.output, json);
+        LOG_INFO("Wrote {} results to \"{}\"", results.size(), options.output);
+
+        if (options.updateBaseline) {
+            writeFile(options.baseline, json);
+            LOG_INFO("Updated baseline \"{}\"", options.baseline);
+
+        } else if (!options.baseline.empty()) {
+            uint32_t regressions = compareToBaseline(results, suite.getDeviceName(), options.baseline, options.tolerance);
+            if (regressions > 0) {
+                LOG_ERROR("{} of {} results regressed past the baseline", regressions, results.size());
+                return 1;
+            }
+        }
+
+        if (suite.getFailedChecks() > 0) {
+            LOG_ERROR("{} checks failed", suite.getFailedChecks());
+            return 1;
+        }
+
+    } catch (const std::exception& ex) {
+        std::cerr << "bench: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
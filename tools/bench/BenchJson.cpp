@@ -0,0 +1,190 @@
+#include "pch.hpp"
+
+#include "BenchJson.hpp"
+
+#include <cstdlib>
+
+// Recursive descent over the whole text, baselines are a few kilobytes
+class JsonParser
+{
+  public:
+    explicit JsonParser(const std::string& text) : m_text(text) { }
+
+    JsonValue parseDocument()
+    {
+        JsonValue value = parseValue();
+        skipSpaces();
+        if (m_position != m_text.size())
+            fail("trailing characters");
+
+        return value;
+    }
+
+  private:
+    JsonValue parseValue()
+    {
+        skipSpaces();
+        if (m_position == m_text.size())
+            fail("unexpected end");
+
+        JsonValue value;
+        char c = m_text[m_position];
+
+        if (c == '{') {
+            value.type = JsonValue::Type::OBJECT;
+            m_position++;
+
+            if (!consume('}')) {
+                do {
+                    skipSpaces();
+                    std::string key = parseString();
+                    expect(':');
+                    value.object.emplace_back(std::move(key), parseValue());
+                } while (consume(','));
+
+                expect('}');
+            }
+
+        } else if (c == '[') {
+            value.type = JsonValue::Type::ARRAY;
+            m_position++;
+
+            if (!consume(']')) {
+                do {
+                    value.array.push_back(parseValue());
+                } while (consume(','));
+
+                expect(']');
+            }
+
+        } else if (c == '"') {
+            value.type = JsonValue::Type::STRING;
+            value.string = parseString();
+
+        } else if (m_text.compare(m_position, 4, "true") == 0 || m_text.compare(m_position, 5, "false") == 0) {
+            value.type = JsonValue::Type::BOOLEAN;
+            value.boolean = c == 't';
+            m_position += value.boolean ? 4 : 5;
+
+        } else if (m_text.compare(m_position, 4, "null") == 0) {
+            m_position += 4;
+
+        } else {
+            const char* begin = m_text.c_str() + m_position;
+            char* end;
+            value.type = JsonValue::Type::NUMBER;
+            value.number = std::strtod(begin, &end);
+
+            if (end == begin)
+                fail("unexpected character");
+
+            m_position += end - begin;
+        }
+
+        return value;
+    }
+
+    std::string parseString()
+    {
+        if (!consume('"'))
+            fail("expected a string");
+
+        std::string string;
+        while (m_position < m_text.size() && m_text[m_position] != '"') {
+            char c = m_text[m_position++];
+
+            if (c == '\\') {
+                if (m_position == m_text.size())
+                    break;
+
+                // \u escapes are kept as is, the names written by the benchmark are ASCII
+                switch (char escaped = m_text[m_position++]) {
+                case 'n': string += '\n'; break;
+                case 't': string += '\t'; break;
+                case 'r': string += '\r'; break;
+                case 'b': string += '\b'; break;
+                case 'f': string += '\f'; break;
+                case 'u': string += "\\u"; break;
+                default: string += escaped; break;
+                }
+            } else {
+                string += c;
+            }
+        }
+
+        if (!consume('"'))
+            fail("unterminated string");
+
+        return string;
+    }
+
+    void skipSpaces() noexcept
+    {
+        while (m_position < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_position])))
+            m_position++;
+    }
+
+    bool consume(char c) noexcept
+    {
+        skipSpaces();
+        if (m_position < m_text.size() && m_text[m_position] == c) {
+            m_position++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!consume(c))
+            fail(std::string("expected '") + c + "'");
+    }
+
+    [[noreturn]] void fail(const std::string& reason) const
+    {
+        throw Exception("Invalid JSON at offset " + std::to_string(m_position) + ": " + reason);
+    }
+
+  private:
+    const std::string& m_text;
+    size_t m_position = 0;
+};
+
+
+const JsonValue* JsonValue::find(const std::string& key) const noexcept
+{
+    for (auto& [name, value] : object) {
+        if (name == key)
+            return &value;
+    }
+
+    return nullptr;
+}
+
+
+JsonValue parseJson(const std::string& text)
+{
+    return JsonParser(text).parseDocument();
+}
+
+
+std::string quoteJson(const std::string& text)
+{
+    std::string quoted = "\"";
+
+    for (char c : text) {
+        switch (c) {
+        case '"': quoted += "\\\""; break;
+        case '\\': quoted += "\\\\"; break;
+        case '\n': quoted += "\\n"; break;
+        case '\t': quoted += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+                quoted += fmt::format("\\u{:04x}", c);
+            else
+                quoted += c;
+        }
+    }
+
+    return quoted + "\"";
+}
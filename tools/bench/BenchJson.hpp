@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON to read back the results and baselines the benchmark writes.
+// Objects keep their key order, numbers are doubles. Throws on malformed text
+struct JsonValue
+{
+    enum class Type
+    {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT
+    };
+
+    Type type = Type::NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const std::string& key) const noexcept;  // nullptr if missing or not an object
+};
+
+JsonValue parseJson(const std::string& text);
+std::string quoteJson(const std::string& text);
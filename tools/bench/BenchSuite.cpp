@@ -0,0 +1,407 @@
+#include "pch.hpp"
+
+#include "AllocationCounter.hpp"
+#include "BenchSuite.hpp"
+#include "core/Application.hpp"
+#include "core/AsyncLogSink.hpp"
+#include "core/SlotMap.hpp"
+#include "core/vulkan/VulkanDevice.hpp"
+#include "core/vulkan/VulkanInstance.hpp"
+#include "core/vulkan/VulkanPipelineStateCache.hpp"
+#include "core/vulkan/VulkanRenderGraph.hpp"
+#include "graphics/Window.hpp"
+
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <cstring>
+#include <filesystem>
+
+using Clock = std::chrono::steady_clock;
+using ms = std::chrono::duration<double, std::milli>;
+using seconds = std::chrono::duration<double>;
+
+
+BenchSuite::BenchSuite(const Settings& settings, JobSystem& jobSystem, uint32_t repeat)
+    : m_settings(settings), m_jobSystem(jobSystem), m_repeat(std::max(repeat, 1u))
+{
+}
+
+// public
+
+std::vector<BenchResult> BenchSuite::run()
+{
+    m_results.clear();
+    m_failedChecks = 0;
+
+    benchInstance();
+    benchWindows();
+    benchLogger();
+    benchAllocator();
+    benchOffscreenFrames();
+    checkFrameAllocations();
+    checkDefragmentation();
+
+    return m_results;
+}
+
+// private
+
+void BenchSuite::benchInstance()
+{
+    double instanceTime = median(std::min(m_repeat, static_cast<uint32_t>(BENCH_INSTANCE_RUNS)), [&] {
+        auto start = Clock::now();
+        VulkanInstance instance(m_settings, m_jobSystem);
+        double elapsed = ms(Clock::now() - start).count();
+
+        m_deviceName = instance.getDevice().getProperties().deviceName;
+        return elapsed;
+    });
+
+    // Another device on a live instance, to tell the two apart
+    VulkanInstance instance(m_settings, m_jobSystem);
+    double deviceTime = median(std::min(m_repeat, static_cast<uint32_t>(BENCH_INSTANCE_RUNS)), [&] {
+        auto start = Clock::now();
+        VulkanDevice device(instance, m_settings, m_jobSystem);
+        return ms(Clock::now() - start).count();
+    });
+
+    addResult("vulkan_instance", "ms", instanceTime, false);  // Its device included
+    addResult("vulkan_device", "ms", deviceTime, false);
+}
+
+
+void BenchSuite::benchWindows()
+{
+    VulkanInstance instance(m_settings, m_jobSystem);
+
+    // Like Application: a registry reserved up front, Windows coming and going in any order
+    double windowsPerSecond = median(m_repeat, [&] {
+        SlotMap<std::unique_ptr<Window>> windows;
+        windows.reserve(WINDOW_CAPACITY);
+        std::vector<SlotMap<std::unique_ptr<Window>>::Handle> handles;
+        handles.reserve(WINDOW_CAPACITY);
+
+        auto start = Clock::now();
+
+        for (uint32_t round = 0; round < BENCH_WINDOW_ROUNDS; round++) {
+            handles.clear();
+            for (uint32_t i = 0; i < WINDOW_CAPACITY; i++)
+                handles.push_back(windows.insert(std::make_unique<Window>(640, 480, "Bench", instance, m_settings)));
+
+            // Every other one, then the rest: erasures fill holes from the end
+            for (uint32_t i = 0; i < WINDOW_CAPACITY; i += 2)
+                windows.erase(handles[i]);
+            for (uint32_t i = 1; i < WINDOW_CAPACITY; i += 2)
+                windows.erase(handles[i]);
+        }
+
+        return BENCH_WINDOW_ROUNDS * WINDOW_CAPACITY / seconds(Clock::now() - start).count();
+    });
+
+    addResult("window_churn", "windows/s", windowsPerSecond, true);
+}
+
+
+void BenchSuite::benchLogger()
+{
+    std::string path = (std::filesystem::temp_directory_path() / "bench_log.txt").string();
+
+    // The engine's pattern, a message like the per frame ones. Like LOG_IMPL, async messages are deferred
+    static constexpr char format[] = "Frame {} of Window \"{}\" took {:.3f}ms";
+    auto logMessages = [&](spdlog::logger& logger, AsyncLogSink* asyncSink) {
+        logger.set_pattern("[%T:%e] <%l> %v");
+
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < BENCH_LOG_MESSAGES; i++) {
+            if (!asyncSink || !asyncSink->logDeferred(logger, spdlog::level::info, format, i, "Bench", i * 0.001))
+                logger.info(format, i, "Bench", i * 0.001);
+        }
+        logger.flush();
+
+        return BENCH_LOG_MESSAGES / seconds(Clock::now() - start).count();
+    };
+
+    double syncRate = median(m_repeat, [&] {
+        auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path, true);
+        spdlog::logger logger("bench", fileSink);
+        return logMessages(logger, nullptr);
+    });
+
+    // Flushing waits for the flush thread, the rate includes the writes
+    double asyncRate = median(m_repeat, [&] {
+        auto fileSink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(path, true);
+        auto asyncSink = std::make_shared<AsyncLogSink>(
+            std::vector<spdlog::sink_ptr>{fileSink}, ASYNC_LOG_DEFAULT_QUEUE_SIZE, Logger::OverflowPolicy::BLOCK);
+        spdlog::logger logger("bench", asyncSink);
+
+        double rate = logMessages(logger, asyncSink.get());
+        asyncSink->stop();
+        return rate;
+    });
+
+    std::filesystem::remove(path);
+
+    addResult("log_sync", "messages/s", syncRate, true);
+    addResult("log_async", "messages/s", asyncRate, true);
+}
+
+
+void BenchSuite::benchAllocator()
+{
+    VulkanInstance instance(m_settings, m_jobSystem);
+    auto& allocator = instance.getDevice().getAllocator();
+
+    // Buffers of a few typical sizes, a window of them alive at any time
+    static const VkDeviceSize sizes[] = {4 << 10, 64 << 10, 256 << 10, 1 << 20, 16 << 10};
+    std::vector<VulkanAllocator::Allocation*> live(256, nullptr);
+
+    double allocationsPerSecond = median(m_repeat, [&] {
+        auto start = Clock::now();
+
+        for (uint32_t i = 0; i < BENCH_ALLOCATIONS; i++) {
+            auto& slot = live[(i * 7) % live.size()];
+            allocator.free(slot);
+
+            VkMemoryRequirements requirements = {sizes[i % std::size(sizes)], 256, ~0u};
+            slot = allocator.allocate(requirements, VulkanAllocator::MemoryUsage::GPU_ONLY, VulkanAllocator::ResourceKind::LINEAR);
+        }
+
+        for (auto& allocation : live) {
+            allocator.free(allocation);
+            allocation = nullptr;
+        }
+
+        return BENCH_ALLOCATIONS / seconds(Clock::now() - start).count();
+    });
+
+    addResult("allocator", "allocations/s", allocationsPerSecond, true);
+}
+
+
+void BenchSuite::benchOffscreenFrames()
+{
+    VulkanInstance instance(m_settings, m_jobSystem);
+    VulkanDevice& device = instance.getDevice();
+
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.extent = {BENCH_FRAME_SIZE, BENCH_FRAME_SIZE, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage target;
+    auto targetAllocation = device.getAllocator().createImage(imageInfo, VulkanAllocator::MemoryUsage::GPU_ONLY, target);
+
+    const VulkanDeviceDispatch& dispatch = device.getDispatch();
+    VulkanRenderGraph graph(device, "Offscreen");
+    VulkanRenderGraph::ImageDescription description = {imageInfo.format, {BENCH_FRAME_SIZE, BENCH_FRAME_SIZE}};
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    // A window's frame without the swapchain: a transient image cleared and copied to the target
+    auto recordFrame = [&](VkCommandBuffer commandBuffer) {
+        graph.reset();
+
+        auto output = graph.importImage(
+            "Output",
+            target,
+            VK_NULL_HANDLE,
+            description,
+            {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TRANSFER_BIT, 0},
+            {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, 0});
+        auto scene = graph.createImage("Scene", description);
+
+        graph.addPass("Clear", [&dispatch, scene](VkCommandBuffer commandBuffer, const VulkanRenderGraph& graph) {
+            VkClearColorValue clearColor = {{0.0f, 0.0f, 0.0f, 1.0f}};
+            VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+            dispatch.vkCmdClearColorImage(commandBuffer, graph.getImage(scene), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+        }).use(scene, VulkanRenderGraph::Access::TRANSFER_DST);
+
+        graph.addPass("Copy", [&dispatch, scene, output](VkCommandBuffer commandBuffer, const VulkanRenderGraph& graph) {
+            VkImageCopy region = {};
+            region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+            region.extent = {BENCH_FRAME_SIZE, BENCH_FRAME_SIZE, 1};
+            dispatch.vkCmdCopyImage(
+                commandBuffer,
+                graph.getImage(scene), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                graph.getImage(output), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                1, &region);
+        }).use(scene, VulkanRenderGraph::Access::TRANSFER_SRC).use(output, VulkanRenderGraph::Access::TRANSFER_DST);
+
+        graph.compile();
+        graph.execute(commandBuffer);
+    };
+
+    double gpuTime = 0.0;
+    uint32_t gpuFrames = 0;
+
+    // The main thread is job system worker 0, it records like a Window would
+    auto runFrames = [&](uint64_t first, uint32_t count) {
+        for (uint64_t frame = first; frame < first + count; frame++) {
+            uint32_t frameIndex = frame % MAX_FRAMES_IN_FLIGHT;
+            device.beginFrame(frameIndex);
+
+            if (!device.getTimestamps().getResults().empty()) {
+                gpuTime += device.getTimestamps().getFrameTime();
+                gpuFrames++;
+            }
+
+            VkCommandBuffer commandBuffer = device.getCommandPools().getPrimary();
+            dispatch.vkBeginCommandBuffer(commandBuffer, &beginInfo);
+            recordFrame(commandBuffer);
+            if (dispatch.vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+                throw Exception("Failed to record benchmark frame");
+
+            VkSubmitInfo submitInfo = {};
+            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+
+            device.submitFrame(frameIndex, 1, &submitInfo);
+        }
+    };
+
+    try {
+        uint64_t frame = 0;
+        runFrames(frame, BENCH_WARMUP_FRAMES);
+        frame += BENCH_WARMUP_FRAMES;
+
+        double frameTime = median(m_repeat, [&] {
+            auto start = Clock::now();
+            runFrames(frame, BENCH_FRAMES);
+            device.waitForAllFrames();
+            frame += BENCH_FRAMES;
+
+            return ms(Clock::now() - start).count() / BENCH_FRAMES;
+        });
+
+        addResult("offscreen_frame", "ms", frameTime, false);
+
+        // Timestamps are read a few frames late, warm up frames included: an average, not a median
+        if (gpuFrames > 0)
+            addResult("offscreen_gpu_frame", "ms", gpuTime / gpuFrames, false);
+
+    } catch (...) {
+        device.waitForAllFrames();
+        device.getAllocator().destroyImage(target, targetAllocation);
+        throw;
+    }
+
+    device.waitForAllFrames();
+    device.getAllocator().destroyImage(target, targetAllocation);
+}
+
+
+void BenchSuite::checkFrameAllocations()
+{
+    // Application's own frame loop, on the suite's JobSystem. Headless Windows render every frame
+    Application app(m_settings, &m_jobSystem);
+    for (uint32_t i = 0; i < BENCH_ALLOCATION_WINDOWS; i++)
+        app.createWindow(BENCH_FRAME_SIZE, BENCH_FRAME_SIZE, "Bench");
+
+    app.waitForVulkan();
+
+    // Warm: render graphs compiled, job and descriptor pools grown, frame batch vectors sized,
+    // background pipeline compiled
+    for (uint32_t i = 0; i < BENCH_WARMUP_FRAMES; i++)
+        app.runFrame();
+    app.m_VulkanInstance->getDevice().getPipelineStateCache().waitForCompilations();
+
+    uint64_t allocationCount = getAllocationCount();
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+        app.runFrame();
+    allocationCount = getAllocationCount() - allocationCount;
+
+    if (allocationCount > 0) {
+        LOG_ERROR("FAILED frame_allocations: {} heap allocations in {} frames, expected none", allocationCount, BENCH_FRAMES);
+        m_failedChecks++;
+    } else {
+        LOG_INFO("{:<20} {:>14} allocations in {} frames", "frame_allocations", 0, BENCH_FRAMES);
+    }
+}
+
+
+void BenchSuite::checkDefragmentation()
+{
+    VulkanInstance instance(m_settings, m_jobSystem);
+    auto& device = instance.getDevice();
+
+    // An allocator of its own, its blocks hold nothing but the check's allocations
+    VulkanAllocator allocator(device.getHandle(), device.getProperties(), device.getPhysicalDeviceInfo().memoryProperties);
+
+    // Host visible: the copy owed for each move is a memcpy
+    VkMemoryRequirements requirements = {BENCH_DEFRAGMENTATION_SIZE, ALLOCATOR_MIN_SLOT_SIZE, ~0u};
+    auto allocate = [&] {
+        return allocator.allocate(requirements, VulkanAllocator::MemoryUsage::CPU_TO_GPU, VulkanAllocator::ResourceKind::LINEAR);
+    };
+
+    // A full block and one allocation in a second block, which moves to a hole made in the first
+    std::vector<VulkanAllocator::Allocation*> allocations = {allocate()};
+    while (allocations.back()->memory == allocations.front()->memory)
+        allocations.push_back(allocate());
+
+    VulkanAllocator::Allocation* moved = allocations.back();
+    auto movedData = static_cast<uint8_t*>(moved->mappedData);
+    for (VkDeviceSize i = 0; i < BENCH_DEFRAGMENTATION_SIZE; i++)
+        movedData[i] = static_cast<uint8_t>(i * 31);
+
+    auto hole = allocations.begin() + allocations.size() / 2;
+    VkDeviceMemory holeMemory = (*hole)->memory;
+    VkDeviceSize holeOffset = (*hole)->offset;
+    void* holeData = (*hole)->mappedData;
+    allocator.free(*hole);
+    allocations.erase(hole);
+
+    auto moves = allocator.beginDefragmentation();
+    bool planned = moves.size() == 1 && moves[0].allocation == moved && moves[0].dstMemory == holeMemory && moves[0].dstOffset == holeOffset;
+    if (planned)
+        std::memcpy(holeData, movedData, moves[0].size);
+
+    allocator.endDefragmentation(moves);
+
+    bool kept = true;
+    auto data = static_cast<const uint8_t*>(moved->mappedData);
+    for (VkDeviceSize i = 0; i < BENCH_DEFRAGMENTATION_SIZE && planned; i++)
+        kept = kept && data[i] == static_cast<uint8_t>(i * 31);
+
+    if (!planned) {
+        LOG_ERROR("FAILED defragmentation: {} moves planned, expected the last allocation moved to the freed slot", moves.size());
+        m_failedChecks++;
+    } else if (moved->memory != holeMemory || moved->offset != holeOffset || moved->mappedData != holeData || !kept) {
+        LOG_ERROR("FAILED defragmentation: the moved allocation doesn't point at its new place and content");
+        m_failedChecks++;
+    } else {
+        LOG_INFO("{:<20} {:>14} moves, content and new offset checked", "defragmentation", moves.size());
+    }
+
+    for (auto allocation : allocations)
+        allocator.free(allocation);
+}
+
+
+double BenchSuite::median(uint32_t runs, const std::function<double()>& measure) const
+{
+    std::vector<double> values;
+    for (uint32_t i = 0; i < runs; i++)
+        values.push_back(measure());
+
+    std::sort(values.begin(), values.end());
+    return runs % 2 ? values[runs / 2] : (values[runs / 2 - 1] + values[runs / 2]) / 2.0;
+}
+
+
+void BenchSuite::addResult(const std::string& name, const std::string& unit, double value, bool higherIsBetter)
+{
+    LOG_INFO("{:<20} {:>14.3f} {}", name, value, unit);
+    m_results.push_back({name, unit, value, higherIsBetter});
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/Settings.hpp"
+#include "core/jobs/JobSystem.hpp"
+
+#include <string>
+#include <vector>
+
+#define BENCH_DEFAULT_REPEAT 5  // Runs of every benchmark, the median is kept
+#define BENCH_INSTANCE_RUNS 3  // Instance creations are slow, they get fewer runs
+#define BENCH_WINDOW_ROUNDS 2000  // Of WINDOW_CAPACITY Windows created then destroyed
+#define BENCH_LOG_MESSAGES 100000
+#define BENCH_ALLOCATIONS 20000
+#define BENCH_FRAMES 300
+#define BENCH_WARMUP_FRAMES 10  // Not measured: first compilation, pools growing
+#define BENCH_FRAME_SIZE 512
+#define BENCH_ALLOCATION_WINDOWS 2  // Headless, like Application's two Windows
+#define BENCH_DEFRAGMENTATION_SIZE (64 << 10)  // A size class with a few dozen slots per block
+
+struct BenchResult
+{
+    std::string name;
+    std::string unit;
+    double value;
+    bool higherIsBetter;
+};
+
+// The engine's building blocks, measured headless: Vulkan instance and device creation, Window
+// registry churn, logging, device memory allocation and offscreen frames through a render graph.
+// Also checks that Application's frame loop doesn't allocate once warm and that defragmentation
+// keeps the content of what it moves, a failed check isn't a result but fails the run. Runs on whatever driver the loader picks, a software one (lavapipe,
+// SwiftShader) works.
+class BenchSuite
+{
+  public:
+    BenchSuite(const Settings& settings, JobSystem& jobSystem, uint32_t repeat);
+
+    std::vector<BenchResult> run();
+
+    inline const std::string& getDeviceName() const noexcept { return m_deviceName; }
+    inline uint32_t getFailedChecks() const noexcept { return m_failedChecks; }
+
+  private:
+    void benchInstance();
+    void benchWindows();
+    void benchLogger();
+    void benchAllocator();
+    void benchOffscreenFrames();
+    void checkFrameAllocations();
+    void checkDefragmentation();
+
+    // Median of `runs` calls of `measure`
+    double median(uint32_t runs, const std::function<double()>& measure) const;
+    void addResult(const std::string& name, const std::string& unit, double value, bool higherIsBetter);
+
+  private:
+    Settings m_settings;
+    JobSystem& m_jobSystem;
+    uint32_t m_repeat;
+
+    std::string m_deviceName;
+    std::vector<BenchResult> m_results;
+    uint32_t m_failedChecks = 0;
+
+  public:
+    BenchSuite(const BenchSuite&) = delete;
+    void operator=(const BenchSuite&) = delete;
+};
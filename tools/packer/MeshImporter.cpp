@@ -0,0 +1,185 @@
+#include "MeshImporter.hpp"
+#include "core/Exception.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+// Indices of an OBJ face corner, 0 when the element is missing
+typedef std::tuple<int64_t, int64_t, int64_t> Corner;
+
+static int64_t resolveIndex(int64_t index, size_t count, const std::string& path, size_t line)
+{
+    // Negative indices count from the last element defined so far
+    int64_t resolved = index < 0 ? static_cast<int64_t>(count) + index + 1 : index;
+    if (resolved < 1 || resolved > static_cast<int64_t>(count))
+        throw Exception(path + ":" + std::to_string(line) + ": index " + std::to_string(index) + " out of range");
+
+    return resolved;
+}
+
+
+static Corner parseCorner(const std::string& token, size_t positions, size_t uvs, size_t normals, const std::string& path, size_t line)
+{
+    // v, v/vt, v//vn or v/vt/vn
+    int64_t indices[3] = {0, 0, 0};
+    size_t counts[3] = {positions, uvs, normals};
+
+    size_t begin = 0;
+    for (int i = 0; i < 3 && begin <= token.size(); i++) {
+        size_t end = token.find('/', begin);
+        if (end == std::string::npos) end = token.size();
+
+        if (end > begin) {
+            try {
+                indices[i] = resolveIndex(std::stoll(token.substr(begin, end - begin)), counts[i], path, line);
+            } catch (const std::logic_error&) {
+                throw Exception(path + ":" + std::to_string(line) + ": invalid face corner \"" + token + "\"");
+            }
+        }
+
+        begin = end + 1;
+    }
+
+    if (indices[0] == 0)
+        throw Exception(path + ":" + std::to_string(line) + ": face corner without a position");
+
+    return {indices[0], indices[1], indices[2]};
+}
+
+
+ImportedMesh importObj(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw Exception("Failed to open \"" + path + "\"");
+
+    std::vector<std::array<float, 3>> positions;
+    std::vector<std::array<float, 2>> uvs;
+    std::vector<std::array<float, 3>> normals;
+
+    ImportedMesh mesh;
+    std::map<Corner, uint32_t> vertexIndices;
+    std::vector<bool> needsNormal;  // Per vertex: smoothed from the faces
+
+    std::string lineText;
+    std::vector<uint32_t> face;
+    size_t lineNumber = 0;
+
+    while (std::getline(file, lineText)) {
+        lineNumber++;
+
+        std::istringstream line(lineText);
+        std::string keyword;
+        line >> keyword;
+
+        if (keyword == "v") {
+            auto& position = positions.emplace_back();
+            line >> position[0] >> position[1] >> position[2];
+
+        } else if (keyword == "vt") {
+            auto& uv = uvs.emplace_back();
+            line >> uv[0] >> uv[1];
+
+        } else if (keyword == "vn") {
+            auto& normal = normals.emplace_back();
+            line >> normal[0] >> normal[1] >> normal[2];
+
+        } else if (keyword == "f") {
+            face.clear();
+
+            std::string token;
+            while (line >> token) {
+                Corner corner = parseCorner(token, positions.size(), uvs.size(), normals.size(), path, lineNumber);
+
+                auto [it, inserted] = vertexIndices.try_emplace(corner, static_cast<uint32_t>(mesh.vertices.size()));
+                if (inserted) {
+                    auto [positionIndex, uvIndex, normalIndex] = corner;
+                    AssetPackVertex vertex = {};
+
+                    for (int i = 0; i < 3; i++)
+                        vertex.position[i] = positions[positionIndex - 1][i];
+
+                    if (uvIndex > 0) {
+                        vertex.uv[0] = uvs[uvIndex - 1][0];
+                        vertex.uv[1] = 1.0f - uvs[uvIndex - 1][1];
+                    }
+
+                    if (normalIndex > 0) {
+                        for (int i = 0; i < 3; i++)
+                            vertex.normal[i] = normals[normalIndex - 1][i];
+                    }
+
+                    mesh.vertices.push_back(vertex);
+                    needsNormal.push_back(normalIndex == 0);
+                }
+
+                face.push_back(it->second);
+            }
+
+            if (face.size() < 3)
+                throw Exception(path + ":" + std::to_string(lineNumber) + ": face with less than 3 corners");
+
+            for (size_t i = 2; i < face.size(); i++) {
+                mesh.indices.push_back(face[0]);
+                mesh.indices.push_back(face[i - 1]);
+                mesh.indices.push_back(face[i]);
+            }
+        }
+
+        if (line.fail() && !line.eof())
+            throw Exception(path + ":" + std::to_string(lineNumber) + ": malformed \"" + keyword + "\" line");
+    }
+
+    // Area weighted: the cross product is twice the triangle's area
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        AssetPackVertex* corners[3] = {
+            &mesh.vertices[mesh.indices[i]],
+            &mesh.vertices[mesh.indices[i + 1]],
+            &mesh.vertices[mesh.indices[i + 2]]};
+
+        float a[3], b[3];
+        for (int j = 0; j < 3; j++) {
+            a[j] = corners[1]->position[j] - corners[0]->position[j];
+            b[j] = corners[2]->position[j] - corners[0]->position[j];
+        }
+
+        float normal[3] = {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+
+        for (int k = 0; k < 3; k++) {
+            if (!needsNormal[mesh.indices[i + k]]) continue;
+
+            for (int j = 0; j < 3; j++)
+                corners[k]->normal[j] += normal[j];
+        }
+    }
+
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        if (!needsNormal[i]) continue;
+
+        float* normal = mesh.vertices[i].normal;
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (length > 0.0f) {
+            for (int j = 0; j < 3; j++)
+                normal[j] /= length;
+        }
+    }
+
+    for (int j = 0; j < 3; j++) {
+        mesh.boundsMin[j] = mesh.vertices.empty() ? 0.0f : INFINITY;
+        mesh.boundsMax[j] = mesh.vertices.empty() ? 0.0f : -INFINITY;
+    }
+
+    for (auto& vertex : mesh.vertices) {
+        for (int j = 0; j < 3; j++) {
+            mesh.boundsMin[j] = std::min(mesh.boundsMin[j], vertex.position[j]);
+            mesh.boundsMax[j] = std::max(mesh.boundsMax[j], vertex.position[j]);
+        }
+    }
+
+    return mesh;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "core/AssetPackFormat.hpp"
+
+#include <string>
+#include <vector>
+
+struct ImportedMesh
+{
+    std::vector<AssetPackVertex> vertices;
+    std::vector<uint32_t> indices;  // Narrowed to 16 bits when they fit, by the writer
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+// Wavefront OBJ: positions, texture coordinates and normals of every face, triangulated as fans.
+// Vertices sharing the same position, texture coordinate and normal are merged. Missing normals
+// are smoothed from the faces, texture coordinates are flipped to the top left origin.
+// Materials, groups and smoothing groups are ignored. Throws on malformed files
+ImportedMesh importObj(const std::string& path);
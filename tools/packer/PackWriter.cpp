@@ -0,0 +1,150 @@
+#include "PackWriter.hpp"
+#include "core/Exception.hpp"
+#include "core/Hash.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+PackWriter::PackWriter(const std::string& path, std::vector<std::string> names)
+    : m_path(path), m_tmpPath(path + ".tmp"), m_names(std::move(names))
+{
+    auto hashName = [](const std::string& name) { return hashBytes(name.data(), name.size()); };
+
+    // Equal names end up next to each other, colliding hashes too
+    std::sort(m_names.begin(), m_names.end(), [&](const std::string& a, const std::string& b) {
+        uint64_t hashA = hashName(a), hashB = hashName(b);
+        return hashA != hashB ? hashA < hashB : a < b;
+    });
+
+    for (size_t i = 1; i < m_names.size(); i++) {
+        if (m_names[i] == m_names[i - 1])
+            throw Exception("Two assets are named \"" + m_names[i] + "\"");
+    }
+
+    for (auto& name : m_names) {
+        m_nameOffsets.push_back(static_cast<uint32_t>(m_nameData.size()));
+        m_nameData += name;
+    }
+
+    m_file.open(m_tmpPath, std::ios::binary | std::ios::trunc);
+    if (!m_file)
+        throw Exception("Failed to create \"" + m_tmpPath + "\"");
+
+    // Header and table of contents are written last, once the payloads are placed
+    m_offset = sizeof(AssetPackHeader) + m_names.size() * sizeof(AssetPackEntry) + m_nameData.size();
+    m_entries.reserve(m_names.size());
+}
+
+
+PackWriter::~PackWriter()
+{
+    if (!m_finished) {
+        m_file.close();
+        std::remove(m_tmpPath.c_str());
+    }
+}
+
+// public
+
+void PackWriter::addMesh(const ImportedMesh& mesh)
+{
+    // 16 bit indices halve the index data when every vertex can be reached
+    bool shortIndices = mesh.vertices.size() <= 0x10000;
+    uint64_t vertexSize = mesh.vertices.size() * sizeof(AssetPackVertex);
+    uint64_t indexSize = mesh.indices.size() * (shortIndices ? sizeof(uint16_t) : sizeof(uint32_t));
+
+    AssetPackEntry& entry = beginEntry(AssetType::MESH);
+    entry.mesh.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    entry.mesh.vertexStride = sizeof(AssetPackVertex);
+    entry.mesh.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    entry.mesh.indexType = shortIndices ? 0 : 1;
+    entry.mesh.indexOffset = vertexSize;
+    std::copy(mesh.boundsMin, mesh.boundsMin + 3, entry.mesh.boundsMin);
+    std::copy(mesh.boundsMax, mesh.boundsMax + 3, entry.mesh.boundsMax);
+    entry.payloadSize = vertexSize + indexSize;
+
+    writePayload(mesh.vertices.data(), vertexSize);
+
+    if (shortIndices) {
+        std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+        writePayload(indices.data(), indexSize);
+    } else {
+        writePayload(mesh.indices.data(), indexSize);
+    }
+}
+
+
+void PackWriter::addTexture(const ImportedTexture& texture)
+{
+    AssetPackEntry& entry = beginEntry(AssetType::TEXTURE);
+    entry.texture = texture.info;
+    entry.payloadSize = texture.payload.size();
+
+    writePayload(texture.payload.data(), texture.payload.size());
+}
+
+
+void PackWriter::finish()
+{
+    if (m_entries.size() != m_names.size())
+        throw Exception("Only " + std::to_string(m_entries.size()) + " of " + std::to_string(m_names.size()) + " assets were packed");
+
+    AssetPackHeader header = {};
+    header.magic = ASSET_PACK_MAGIC;
+    header.version = ASSET_PACK_VERSION;
+    header.entryCount = static_cast<uint32_t>(m_entries.size());
+    header.alignment = ASSET_PACK_ALIGNMENT;
+    header.fileSize = m_offset;
+    header.namesOffset = sizeof(AssetPackHeader) + m_entries.size() * sizeof(AssetPackEntry);
+    header.namesSize = m_nameData.size();
+    header.tocChecksum = hashBytes(m_entries.data(), m_entries.size() * sizeof(AssetPackEntry));
+    header.tocChecksum = hashBytes(m_nameData.data(), m_nameData.size(), header.tocChecksum);
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(reinterpret_cast<const char*>(m_entries.data()), m_entries.size() * sizeof(AssetPackEntry));
+    m_file.write(m_nameData.data(), m_nameData.size());
+    m_file.close();
+
+    if (m_file.fail())
+        throw Exception("Failed to write \"" + m_tmpPath + "\"");
+
+    if (std::rename(m_tmpPath.c_str(), m_path.c_str()) != 0)
+        throw Exception("Failed to rename \"" + m_tmpPath + "\" to \"" + m_path + "\"");
+
+    m_finished = true;
+}
+
+// private
+
+AssetPackEntry& PackWriter::beginEntry(AssetType type)
+{
+    if (m_entries.size() == m_names.size())
+        throw Exception("More assets than names");
+
+    // Where the previous entry's payload ends, aligned
+    m_offset = alignAssetOffset(m_offset, ASSET_PACK_ALIGNMENT);
+
+    auto& name = m_names[m_entries.size()];
+
+    AssetPackEntry entry = {};
+    entry.nameHash = hashBytes(name.data(), name.size());
+    entry.nameOffset = m_nameOffsets[m_entries.size()];
+    entry.nameSize = static_cast<uint32_t>(name.size());
+    entry.type = type;
+    entry.payloadOffset = m_offset;
+
+    m_entries.push_back(entry);
+    return m_entries.back();
+}
+
+
+void PackWriter::writePayload(const void* data, uint64_t size)
+{
+    m_file.seekp(m_offset);
+    m_file.write(static_cast<const char*>(data), size);
+    if (m_file.fail())
+        throw Exception("Failed to write \"" + m_tmpPath + "\"");
+
+    m_offset += size;
+}
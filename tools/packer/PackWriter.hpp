@@ -0,0 +1,46 @@
+#pragma once
+
+#include "MeshImporter.hpp"
+#include "TextureImporter.hpp"
+#include "core/AssetPackFormat.hpp"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes an asset pack one asset at a time, so only one payload is in memory.
+// The names are known up front: they are sorted by hash, and assets must then be added in
+// getNames() order, which puts the payloads in table order. The pack is written to a temporary
+// file and renamed into place by finish(), an interrupted run leaves the previous pack intact.
+class PackWriter
+{
+  public:
+    PackWriter(const std::string& path, std::vector<std::string> names);  // Throws on duplicate names
+    ~PackWriter();  // Removes the temporary file if finish() wasn't called
+
+    inline const std::vector<std::string>& getNames() const noexcept { return m_names; }
+
+    void addMesh(const ImportedMesh& mesh);
+    void addTexture(const ImportedTexture& texture);
+    void finish();
+
+  private:
+    AssetPackEntry& beginEntry(AssetType type);
+    void writePayload(const void* data, uint64_t size);
+
+  private:
+    std::string m_path;
+    std::string m_tmpPath;
+    std::ofstream m_file;
+
+    std::vector<std::string> m_names;
+    std::vector<AssetPackEntry> m_entries;
+    std::vector<uint32_t> m_nameOffsets;  // In m_nameData, by name
+    std::string m_nameData;
+    uint64_t m_offset = 0;  // End of the last payload
+    bool m_finished = false;
+
+  public:
+    PackWriter(const PackWriter&) = delete;
+    void operator=(const PackWriter&) = delete;
+};
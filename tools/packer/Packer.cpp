@@ -0,0 +1,189 @@
+#include "MeshImporter.hpp"
+#include "PackWriter.hpp"
+#include "TextureImporter.hpp"
+#include "core/AssetPackFormat.hpp"
+#include "core/Exception.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+
+// Offline asset packer: imports meshes and textures and writes them as an asset pack
+// (see core/AssetPackFormat.hpp), to be mapped by the engine with --assets.
+
+struct Options
+{
+    std::string output = "assets.pack";
+    std::string root;  // Asset names are the input paths relative to it, or as given
+    std::vector<std::string> inputs;
+    bool srgb = true;
+    bool mips = true;
+    std::string listPath;
+};
+
+
+static void stdoutUsage() noexcept
+{
+    std::cout << "Usage: packer [OPTION]... INPUT...\n"
+              << "Pack OBJ meshes (.obj) and Netpbm textures (.pgm, .ppm, .pam) into an asset pack\n\n"
+              << "  -o, --output FILE    Write the pack to FILE (default=assets.pack)\n"
+              << "  --root DIR           Name the assets by their path relative to DIR\n"
+              << "  --linear             Textures hold data, not colors (UNORM instead of SRGB)\n"
+              << "  --no-mips            Only store the full resolution of the textures\n"
+              << "  --list FILE          Print the content of the pack FILE and exit\n"
+              << "  -h, --help           Display this help and exit" << std::endl;
+}
+
+
+static bool processCommandLineArgs(int argc, const char* argv[], Options& options) noexcept
+{
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+
+        if (!std::strcmp(argv[i], "-h") || !std::strcmp(argv[i], "--help")) {
+            stdoutUsage();
+            return false;
+
+        } else if ((!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--output")) && hasValue) {
+            options.output = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--root") && hasValue) {
+            options.root = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--list") && hasValue) {
+            options.listPath = argv[++i];
+
+        } else if (!std::strcmp(argv[i], "--linear")) {
+            options.srgb = false;
+
+        } else if (!std::strcmp(argv[i], "--no-mips")) {
+            options.mips = false;
+
+        } else if (argv[i][0] == '-') {
+            stdoutUsage();
+            return false;
+
+        } else {
+            options.inputs.push_back(argv[i]);
+        }
+    }
+
+    if (options.inputs.empty() && options.listPath.empty()) {
+        stdoutUsage();
+        return false;
+    }
+
+    return true;
+}
+
+
+static std::string getAssetName(const std::string& input, const std::string& root)
+{
+    std::filesystem::path path = std::filesystem::path(input).lexically_normal();
+    if (!root.empty())
+        path = path.lexically_relative(std::filesystem::path(root).lexically_normal());
+
+    // The same name on every platform
+    return path.generic_string();
+}
+
+
+static void listPack(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw Exception("Failed to open \"" + path + "\"");
+
+    AssetPackHeader header = {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!file || header.magic != ASSET_PACK_MAGIC)
+        throw Exception("\"" + path + "\" is not an asset pack");
+
+    std::vector<AssetPackEntry> entries(header.entryCount);
+    std::string names(header.namesSize, '\0');
+    file.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(AssetPackEntry));
+    file.seekg(header.namesOffset);
+    file.read(names.data(), names.size());
+    if (!file)
+        throw Exception("\"" + path + "\" is truncated");
+
+    std::cout << path << ": version " << header.version << ", " << header.entryCount << " assets, "
+              << header.fileSize << " bytes\n";
+
+    for (auto& entry : entries) {
+        std::cout << std::setw(12) << entry.payloadOffset << std::setw(12) << entry.payloadSize << "  ";
+
+        if (entry.type == AssetType::MESH) {
+            std::cout << "mesh     " << entry.mesh.vertexCount << " vertices, " << entry.mesh.indexCount
+                      << (entry.mesh.indexType == 0 ? " 16" : " 32") << " bit indices";
+        } else {
+            std::cout << "texture  " << entry.texture.width << "x" << entry.texture.height << ", "
+                      << entry.texture.mipLevels << " mips, format " << entry.texture.format;
+        }
+
+        std::cout << "  " << names.substr(entry.nameOffset, entry.nameSize) << "\n";
+    }
+}
+
+
+static void pack(const Options& options)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::unordered_map<std::string, std::string> inputs;  // By asset name
+    std::vector<std::string> names;
+    for (auto& input : options.inputs) {
+        std::string name = getAssetName(input, options.root);
+        inputs[name] = input;
+        names.push_back(name);
+    }
+
+    PackWriter writer(options.output, names);
+
+    for (auto& name : writer.getNames()) {
+        const std::string& input = inputs[name];
+        std::string extension = std::filesystem::path(input).extension().string();
+
+        if (extension == ".obj") {
+            writer.addMesh(importObj(input));
+        } else if (extension == ".pgm" || extension == ".ppm" || extension == ".pam") {
+            writer.addTexture(importNetpbm(input, options.srgb, options.mips));
+        } else {
+            throw Exception("\"" + input + "\": unknown asset type");
+        }
+
+        std::cout << "Packed " << name << std::endl;
+    }
+
+    writer.finish();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "Wrote " << options.output << " (" << names.size() << " assets, "
+              << std::filesystem::file_size(options.output) << " bytes) in " << std::fixed << std::setprecision(2)
+              << seconds << " s" << std::endl;
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!processCommandLineArgs(argc, const_cast<const char**>(argv), options))
+        return 1;
+
+    try {
+        if (!options.listPath.empty())
+            listPack(options.listPath);
+        else
+            pack(options);
+
+    } catch (const std::exception& ex) {
+        std::cerr << "packer: " << ex.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
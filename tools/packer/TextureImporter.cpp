@@ -0,0 +1,199 @@
+#include "TextureImporter.hpp"
+#include "core/Exception.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;  // RGBA8
+};
+
+
+static float srgbToLinear(float value) noexcept
+{
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float linearToSrgb(float value) noexcept
+{
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+
+// Next whitespace separated token of a PGM or PPM header, comments skipped
+static std::string readToken(const std::vector<uint8_t>& data, size_t& position)
+{
+    while (position < data.size()) {
+        if (data[position] == '#') {
+            while (position < data.size() && data[position] != '\n')
+                position++;
+        } else if (std::isspace(data[position])) {
+            position++;
+        } else {
+            break;
+        }
+    }
+
+    size_t begin = position;
+    while (position < data.size() && !std::isspace(data[position]))
+        position++;
+
+    return std::string(data.begin() + begin, data.begin() + position);
+}
+
+
+static uint32_t parseNumber(const std::string& token, const std::string& path)
+{
+    if (token.empty() || token.size() > 9 || !std::all_of(token.begin(), token.end(), ::isdigit))
+        throw Exception("\"" + path + "\": invalid Netpbm header");
+
+    return static_cast<uint32_t>(std::stoul(token));
+}
+
+
+static Image readNetpbm(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw Exception("Failed to open \"" + path + "\"");
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t position = 0;
+    std::string magic = readToken(data, position);
+    uint32_t width = 0, height = 0, channels = 0, maxValue = 0;
+
+    if (magic == "P5" || magic == "P6") {
+        channels = magic == "P5" ? 1 : 3;
+        width = parseNumber(readToken(data, position), path);
+        height = parseNumber(readToken(data, position), path);
+        maxValue = parseNumber(readToken(data, position), path);
+        position++;  // A single whitespace before the pixels
+
+    } else if (magic == "P7") {
+        while (true) {
+            std::string key = readToken(data, position);
+            if (key == "ENDHDR" || key.empty()) break;
+
+            std::string value = readToken(data, position);
+            if (key == "WIDTH") width = parseNumber(value, path);
+            else if (key == "HEIGHT") height = parseNumber(value, path);
+            else if (key == "DEPTH") channels = parseNumber(value, path);
+            else if (key == "MAXVAL") maxValue = parseNumber(value, path);
+            // TUPLTYPE is implied by the depth
+        }
+        position++;  // The newline after ENDHDR
+
+    } else {
+        throw Exception("\"" + path + "\" is not a binary PGM, PPM or PAM image");
+    }
+
+    if (maxValue != 255 || channels < 1 || channels > 4)
+        throw Exception("\"" + path + "\": only 8 bit images with 1 to 4 channels are supported");
+
+    if (width == 0 || height == 0 || width > (1u << 16) || height > (1u << 16))
+        throw Exception("\"" + path + "\": invalid size " + std::to_string(width) + "x" + std::to_string(height));
+
+    size_t pixelCount = size_t(width) * height;
+    if (position > data.size() || data.size() - position < pixelCount * channels)
+        throw Exception("\"" + path + "\" is truncated");
+
+    Image image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(pixelCount * 4);
+
+    // Gray (with alpha) is spread over the color channels
+    const uint8_t* source = data.data() + position;
+    for (size_t i = 0; i < pixelCount; i++, source += channels) {
+        uint8_t* pixel = &image.pixels[i * 4];
+        bool gray = channels <= 2;
+        bool hasAlpha = channels == 2 || channels == 4;
+
+        pixel[0] = source[0];
+        pixel[1] = gray ? source[0] : source[1];
+        pixel[2] = gray ? source[0] : source[2];
+        pixel[3] = hasAlpha ? source[channels - 1] : 255;
+    }
+
+    return image;
+}
+
+
+static Image downsample(const Image& source, bool srgb)
+{
+    Image image;
+    image.width = std::max(source.width / 2, 1u);
+    image.height = std::max(source.height / 2, 1u);
+    image.pixels.resize(size_t(image.width) * image.height * 4);
+
+    for (uint32_t y = 0; y < image.height; y++) {
+        for (uint32_t x = 0; x < image.width; x++) {
+            // Odd sizes: the last row and column are sampled twice
+            uint32_t x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+            uint32_t y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+            const uint8_t* samples[4] = {
+                &source.pixels[(size_t(y0) * source.width + x0) * 4],
+                &source.pixels[(size_t(y0) * source.width + x1) * 4],
+                &source.pixels[(size_t(y1) * source.width + x0) * 4],
+                &source.pixels[(size_t(y1) * source.width + x1) * 4]};
+
+            uint8_t* pixel = &image.pixels[(size_t(y) * image.width + x) * 4];
+            for (int channel = 0; channel < 4; channel++) {
+                bool linearize = srgb && channel < 3;  // Alpha is always linear
+
+                float sum = 0.0f;
+                for (auto sample : samples)
+                    sum += linearize ? srgbToLinear(sample[channel] / 255.0f) : sample[channel] / 255.0f;
+
+                float value = linearize ? linearToSrgb(sum / 4.0f) : sum / 4.0f;
+                pixel[channel] = static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+    }
+
+    return image;
+}
+
+
+ImportedTexture importNetpbm(const std::string& path, bool srgb, bool generateMips)
+{
+    Image image = readNetpbm(path);
+
+    ImportedTexture texture;
+    texture.info = {};
+    texture.info.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    texture.info.width = image.width;
+    texture.info.height = image.height;
+    texture.info.layerCount = 1;
+    texture.info.blockSize = 4;
+    texture.info.blockExtent = 1;
+    texture.info.mipLevels = 1;
+
+    if (generateMips) {
+        uint32_t largest = std::max(image.width, image.height);
+        while (largest >> texture.info.mipLevels && texture.info.mipLevels < ASSET_PACK_MAX_MIP_LEVELS)
+            texture.info.mipLevels++;
+    }
+
+    texture.payload.resize(getAssetMipOffset(texture.info, texture.info.mipLevels));
+
+    for (uint32_t level = 0; level < texture.info.mipLevels; level++) {
+        if (level > 0)
+            image = downsample(image, srgb);
+
+        std::memcpy(texture.payload.data() + getAssetMipOffset(texture.info, level), image.pixels.data(), image.pixels.size());
+    }
+
+    return texture;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "core/AssetPackFormat.hpp"
+
+#include <string>
+#include <vector>
+
+struct ImportedTexture
+{
+    AssetPackTexture info;
+    std::vector<uint8_t> payload;  // Every mip level, laid out as getAssetMipOffset() says
+};
+
+// Netpbm images (binary PGM, PPM and PAM, 8 bits per channel), expanded to RGBA8.
+// The mip chain is box filtered down to 1x1, in linear space for sRGB textures. Throws on
+// malformed or unsupported files
+ImportedTexture importNetpbm(const std::string& path, bool srgb, bool generateMips);